@@ -0,0 +1,276 @@
+/*****************************************************************
+*
+* bench.c
+*
+* Headless benchmark of netlink.c's main loop.
+*
+* The benchmark build (make -C host bench) plays a network game
+* over xbsim.c's loopback line, with no v-blank timer, so MainLoop
+* runs as fast as the host can take it. Both players press the
+* same scripted pads, which win games, pick "Yes" to play again and
+* so keep a game going for any number of frames; the same build
+* gives the same frames and final state every run. Start during
+* the game opens a new session, so it is only pressed at "Play
+* again?", and the frames timed are mostly played ones.
+*
+* The build turns on the profiler (source/perf) and reports its
+* sections on the master CPU, and the high-water marks of the main
+* loop's arenas and pools (source/memory.h). malloc is wrapped to
+* count allocations; the loop must make none, and the run fails if
+* it does or if an arena or pool ran out.
+*
+* Environment:
+*	XBSIM_FRAMES	frames to run (1000000)
+*	XBSIM_BENCH_MIN	exit with 1 below this many frames per second, for CI
+*
+*****************************************************************/
+
+#include <yaul.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "xbsim.h"
+#include "bench.h"
+#include "replay.h"
+#include "memory.h"
+#include "perf.h"
+
+#define	kBenchRight		(1 << 15)	/* kRIGHT in netlink.c */
+#define	kBenchStart		(1 << 11)
+#define	kBenchA			(1 << 10)
+
+#define	kBenchHold		8			/* v-blanks a step is held, a frame or more */
+#define	kBenchSteps		8
+
+#define	kBenchMemories	8
+
+#define	BenchNs(cycles)			((cycles) * (1e9 / kPerfClock))
+
+/* Score with A now and then, so most frames are played; at "Play */
+/* again?" move to Yes and press Start. Each step is held for */
+/* kBenchHold v-blanks, so a frame sees it whatever the rate. */
+
+static const unsigned short gGameSteps[] =
+{
+	kBenchA, 0, 0, 0, 0, 0, 0, 0
+};
+
+static const unsigned short gPlayAgainSteps[] =
+{
+	kBenchRight, 0, kBenchStart, 0
+};
+
+static unsigned short gPadScript[kBenchSteps * kBenchHold];
+
+static long gFrameLimit;
+static long gMinRate;
+static long gFrames;
+static int gPlayAgain;
+static uint64_t gRunStart;
+static uint64_t gRunEnd;
+static unsigned long gStateChecksum;
+
+static int gCounting;
+static unsigned long gAllocations;
+static unsigned long gAllocatedBytes;
+
+typedef struct
+{
+	const char		*name;
+	unsigned long	high;
+	unsigned long	size;
+	unsigned long	failures;
+} BenchMemoryUse;
+
+static BenchMemoryUse gMemories[kBenchMemories];
+static int gMemoryCount;
+
+
+static uint64_t BenchNow(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+
+/*
+//
+// malloc and friends, counted while the loop runs. The link wraps
+// them with -Wl,--wrap.
+//
+*/
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *block, size_t size);
+
+static void BenchCountAllocation(size_t size)
+{
+	if (gCounting)
+	{
+		gAllocations++;
+		gAllocatedBytes += size;
+	}
+}
+
+void *__wrap_malloc(size_t size)
+{
+	BenchCountAllocation(size);
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+	BenchCountAllocation(count * size);
+	return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *block, size_t size)
+{
+	BenchCountAllocation(size);
+	return __real_realloc(block, size);
+}
+
+
+/*
+//
+// This function has the pads play the game's script, or the "Play
+// again?" one.
+//
+*/
+
+static void BenchScript(int playAgain)
+{
+	const unsigned short *steps;
+	int count, iii;
+
+	gPlayAgain = playAgain;
+
+	steps = playAgain ? gPlayAgainSteps : gGameSteps;
+	count = playAgain ? sizeof(gPlayAgainSteps) / sizeof(gPlayAgainSteps[0])
+		: sizeof(gGameSteps) / sizeof(gGameSteps[0]);
+
+	for (iii = 0; iii < count * kBenchHold; iii++)
+		gPadScript[iii] = steps[iii / kBenchHold];
+
+	YaulSimSetPadScript(gPadScript, count * kBenchHold);
+}
+
+
+int BenchFrame(const void *state, unsigned size, int playAgain)
+{
+	if (playAgain != gPlayAgain)
+		BenchScript(playAgain);
+
+	if (gFrames == 0)
+	{
+		gRunStart = BenchNow();
+		gCounting = 1;
+		PerfReset();
+	}
+
+	if (gFrames == gFrameLimit)
+	{
+		gRunEnd = BenchNow();
+		gCounting = 0;
+		gStateChecksum = ReplayChecksum(state, size);
+		return 0;
+	}
+
+	gFrames++;
+	return 1;
+}
+
+
+void BenchMemory(const char *name, unsigned long high, unsigned long size,
+	unsigned long failures)
+{
+	BenchMemoryUse *use;
+
+	if (gMemoryCount == kBenchMemories)
+		return;
+
+	use = &gMemories[gMemoryCount++];
+	use->name = name;
+	use->high = high;
+	use->size = size;
+	use->failures = failures;
+}
+
+
+int BenchReport(void)
+{
+	PerfTotals totals;
+	MemoryRam ram;
+	double seconds, rate, frameNs;
+	unsigned long failures;
+	int iii;
+
+	seconds = (gRunEnd - gRunStart) * 1e-9;
+	rate = seconds > 0 ? gFrames / seconds : 0.0;
+	frameNs = gFrames ? (gRunEnd - gRunStart) / (double)gFrames : 0.0;
+
+	printf("bench: %ld frames in %.3f s, %.0f frames/s, %.1f ns/frame\n",
+		gFrames, seconds, rate, frameNs);
+
+	printf("bench: %-9s %10s %9s %9s %9s %6s\n", "section", "calls", "avg ns", "min ns", "max ns", "frame");
+	for (iii = 0; iii < kPerfSections; iii++)
+	{
+		PerfGetTotals(kPerfMaster, iii, &totals);
+		if (totals.calls == 0)
+			continue;
+
+		printf("bench: %-9s %10lu %9.1f %9.0f %9.0f %5.1f%%\n", PerfSectionName(iii), totals.calls,
+			BenchNs(totals.cycles / (double)totals.calls), BenchNs(totals.min), BenchNs(totals.max),
+			gRunEnd > gRunStart ? BenchNs(totals.cycles) * 100.0 / (gRunEnd - gRunStart) : 0.0);
+	}
+
+	failures = 0;
+	for (iii = 0; iii < gMemoryCount; iii++)
+	{
+		printf("bench: memory %-9s %6lu of %6lu, %lu failed\n", gMemories[iii].name,
+			gMemories[iii].high, gMemories[iii].size, gMemories[iii].failures);
+		failures += gMemories[iii].failures;
+	}
+
+	MemoryGetRam(&ram);
+	printf("bench: ram %lu of %lu B used, %lu B left\n", ram.used, ram.size,
+		ram.used < ram.size ? ram.size - ram.used : 0);
+
+	printf("bench: allocations %lu (%lu B), state checksum %08lx\n",
+		gAllocations, gAllocatedBytes, gStateChecksum);
+	fflush(stdout);
+
+	if (gAllocations > 0)
+	{
+		printf("bench: the main loop called malloc\n");
+		return 1;
+	}
+
+	if (failures > 0)
+	{
+		printf("bench: an arena or pool ran out\n");
+		return 1;
+	}
+
+	if (gMinRate > 0 && rate < gMinRate)
+	{
+		printf("bench: below XBSIM_BENCH_MIN (%ld frames/s)\n", gMinRate);
+		return 1;
+	}
+
+	return 0;
+}
+
+
+static void __attribute__ ((constructor (kXBSimBenchPriority))) BenchStart(void)
+{
+	gFrameLimit = XBSimEnv("XBSIM_FRAMES", 1000000);
+	gMinRate = XBSimEnv("XBSIM_BENCH_MIN", 0);
+
+	BenchScript(0);
+}
@@ -0,0 +1,31 @@
+/*****************************************************************
+*
+* bench.h
+*
+* Hooks netlink.c calls in the benchmark build (NETLINK_BENCH),
+* see bench.c.
+*
+*****************************************************************/
+
+
+#ifndef __BENCH__
+#define	__BENCH__
+
+/* Call at the top of every MainLoop frame with the game state, and */
+/* whether it is asking to play again: the pads only press Start */
+/* then. Returns 0 once the run is over. */
+
+int BenchFrame(const void *state, unsigned size, int playAgain);
+
+/* Notes how much of an arena (bytes) or pool (blocks) the run used, */
+/* for the report. Call before BenchReport. */
+
+void BenchMemory(const char *name, unsigned long high, unsigned long size,
+	unsigned long failures);
+
+/* Prints the results; returns the exit status */
+
+int BenchReport(void);
+
+
+#endif	/* __BENCH__ */
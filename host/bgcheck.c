@@ -0,0 +1,253 @@
+/*****************************************************************
+*
+* bgcheck.c
+*
+* Host check of source/background.c against the asset archive.
+*
+* The theme list (BGLIST00.TXT) and its images come out of an
+* archive nlpack built, through a BackgroundReadProc that reads the
+* file and can be told to fail. The scheduler is stood in for by
+* SchedAddTask and SchedRemoveTask below, which only keep the task,
+* so the check runs BackgroundInit's idle task itself. It checks:
+*
+*	- screens that name the same image share its slot, and showing
+*	  one after the other reads nothing
+*	- every image shown is the archive's, palette and pixels
+*	- with three slots, the least recently shown image goes first,
+*	  and never the one on screen
+*	- the image read ahead is finished a kBackgroundChunk at a time
+*	  by the idle task, and then shown without reading
+*	- a read that fails fails the show, and the next one works
+*	- BackgroundEnd takes the idle task off the scheduler
+*
+*	netlink-bgcheck [-v] [ARCHIVE]
+*
+* ARCHIVE is NLASSETS.PAK unless given; make -C host bgcheck packs
+* it out of cd the way the game's build does.
+*
+*****************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "background.h"
+#include "hostutil.h"
+
+#define	kCheckSlots			3
+
+static unsigned char *gArchive;
+static unsigned long gArchiveSize;
+static unsigned long gReads;
+static unsigned long gReadBytes;
+static int gFailReads;
+static int gVerbose;
+static int gFailed;
+
+static SchedTask *gTask;		/* what the scheduler would run */
+
+
+/* The scheduler, as far as background.c sees it */
+
+void SchedAddTask(SchedTask *task, SchedProc proc, void *work, unsigned long period)
+{
+	task->proc = proc;
+	task->work = work;
+	task->period = period;
+	task->next = NULL;
+	gTask = task;
+}
+
+void SchedRemoveTask(SchedTask *task)
+{
+	if (gTask == task)
+		gTask = NULL;
+}
+
+
+static int CheckRead(unsigned long offset, void *buffer, unsigned long size, void *ref)
+{
+	if (gFailReads || offset > gArchiveSize || size > gArchiveSize - offset)
+		return 0;
+
+	memcpy(buffer, gArchive + offset, size);
+	gReads++;
+	gReadBytes += size;
+	return 1;
+}
+
+
+static void Check(int ok, const char *what)
+{
+	if (gVerbose || !ok)
+		printf("bgcheck: %-58s %s\n", what, ok ? "ok" : "FAILED");
+
+	if (!ok)
+		gFailed++;
+}
+
+
+/*
+//
+// This function shows screen and checks that what came back is the
+// archive's image. Returns the bytes it read.
+//
+*/
+
+static unsigned long CheckShow(BackgroundCache *cache, int screen)
+{
+	Background background;
+	unsigned long before;
+	char what[80];
+	int ok;
+
+	before = gReadBytes;
+	ok = BackgroundShow(cache, screen, &background);
+
+	snprintf(what, sizeof(what), "screen %d shows %s", screen, ok ? background.asset.name : "nothing");
+	Check(ok, what);
+	if (!ok)
+		return 0;
+
+	snprintf(what, sizeof(what), "screen %d's palette and pixels are the archive's", screen);
+	Check(memcmp(background.palette, gArchive + background.asset.paletteOffset,
+			background.asset.paletteColors * 2) == 0
+		&& PackChecksum(background.pixels, background.asset.dataSize) == background.asset.checksum,
+		what);
+
+	return gReadBytes - before;
+}
+
+
+static int CheckCached(const BackgroundCache *cache, int screen)
+{
+	return cache->images[cache->screens[screen]].slot >= 0;
+}
+
+
+int main(int argc, char **argv)
+{
+	static BackgroundCache cache;
+	const char *path;
+	Pack pack;
+	PackAsset list;
+	const PackAsset *asset;
+	Background background;
+	unsigned char *memory;
+	unsigned long slotSize, size, chunks, runs;
+	int image, iii;
+
+	path = "NLASSETS.PAK";
+	for (iii = 1; iii < argc; iii++)
+	{
+		if (strcmp(argv[iii], "-v") == 0)
+			gVerbose = 1;
+		else
+			path = argv[iii];
+	}
+
+	gArchive = HostLoad(path, &gArchiveSize);
+	if (gArchive == NULL || !PackOpen(&pack, gArchive, gArchiveSize)
+		|| !PackFind(&pack, "BGLIST00.TXT", &list))
+	{
+		fprintf(stderr, "bgcheck: %s isn't an archive with BGLIST00.TXT\n", path);
+		return 1;
+	}
+
+	/* Once with room for everything, to learn the slot size */
+
+	memory = malloc(kBackgroundSlots * (1UL << 20));
+	if (memory == NULL
+		|| !BackgroundInit(&cache, &pack, CheckRead, NULL, (const char *)gArchive + list.dataOffset,
+			list.dataSize, memory, kBackgroundSlots * (1UL << 20)))
+	{
+		fprintf(stderr, "bgcheck: BackgroundInit failed\n");
+		return 1;
+	}
+	slotSize = cache.slotSize;
+	Check(gTask == &cache.idleTask && gTask->period == 1, "BackgroundInit puts the idle task on");
+	BackgroundEnd(&cache);
+	Check(gTask == NULL, "BackgroundEnd takes it off");
+
+	Check(!BackgroundInit(&cache, &pack, CheckRead, NULL, (const char *)gArchive + list.dataOffset,
+		list.dataSize, memory, slotSize * 2 - 1) && gTask == NULL,
+		"a budget short of two images fails, with no task");
+
+	if (!BackgroundInit(&cache, &pack, CheckRead, NULL, (const char *)gArchive + list.dataOffset,
+		list.dataSize, memory, slotSize * kCheckSlots))
+	{
+		fprintf(stderr, "bgcheck: BackgroundInit failed with %d slots\n", kCheckSlots);
+		return 1;
+	}
+	Check(cache.slotCount == kCheckSlots, "the budget holds three slots");
+
+	/* STANDARD.BMP is screens 25, 26, 39, 40 and 44 */
+
+	Check(cache.screens[25] >= 0 && cache.screens[25] == cache.screens[26]
+		&& cache.screens[25] == cache.screens[39] && cache.screens[25] == cache.screens[44],
+		"screens naming the same image share it");
+	asset = &cache.images[cache.screens[25]].asset;
+	Check(CheckShow(&cache, 25) == asset->paletteColors * 2 + asset->dataSize,
+		"the first show reads the image, palette and pixels");
+	Check(CheckShow(&cache, 26) == 0 && CheckShow(&cache, 39) == 0 && cache.hits == 2,
+		"the screens sharing it read nothing");
+
+	/* Least recently shown out first. Nothing is known to follow */
+	/* 35, 36 or 38 yet, so nothing is read ahead. */
+
+	BackgroundEnd(&cache);
+	BackgroundInit(&cache, &pack, CheckRead, NULL, (const char *)gArchive + list.dataOffset,
+		list.dataSize, memory, slotSize * kCheckSlots);
+	gReadBytes = 0;
+
+	CheckShow(&cache, 35);
+	CheckShow(&cache, 36);
+	CheckShow(&cache, 38);
+	Check(CheckShow(&cache, 35) == 0 && cache.ahead < 0, "an image still in its slot reads nothing");
+	Check(CheckCached(&cache, 35) && CheckCached(&cache, 36) && CheckCached(&cache, 38),
+		"three images fill the three slots");
+
+	/* 42 takes 36's slot, the least recently shown; 44 (STANDARD.BMP), */
+	/* read ahead after 42, takes 38's. 35 was shown since. */
+
+	CheckShow(&cache, 42);
+	Check(!CheckCached(&cache, 36), "the least recently shown image goes first");
+	Check(!CheckCached(&cache, 38) && CheckCached(&cache, 35) && CheckCached(&cache, 42),
+		"the next least recently shown goes for the read-ahead");
+	Check(cache.ahead == cache.screens[44], "what follows 42 is read ahead");
+
+	/* Read ahead to the end, a chunk a run */
+
+	image = cache.screens[44];
+	size = cache.images[image].size;
+	chunks = (cache.images[image].asset.dataSize + kBackgroundChunk - 1) / kBackgroundChunk;
+
+	for (runs = 0; cache.ahead >= 0 && gTask != NULL && runs < 1000; runs++)
+		gTask->proc(gTask->work);
+
+	Check(cache.ahead < 0 && cache.slots[cache.images[image].slot].loaded == size,
+		"the idle task finishes the read-ahead");
+	Check(runs == chunks, "a kBackgroundChunk a run");
+	Check(CheckShow(&cache, 44) == 0 && cache.stallBytes + cache.aheadBytes == gReadBytes,
+		"the image read ahead is shown without reading");
+
+	/* Reads that fail. 36 takes 35's slot, the least recently shown, */
+	/* and 38, which followed 36 before, is read ahead in 42's. */
+
+	gFailReads = 1;
+	Check(!BackgroundShow(&cache, 36, &background), "a failed read fails the show");
+	gFailReads = 0;
+	Check(CheckShow(&cache, 36) > 0 && CheckShow(&cache, 36) == 0, "and the next show reads it");
+	Check(!CheckCached(&cache, 35) && !CheckCached(&cache, 42) && CheckCached(&cache, 44)
+		&& cache.ahead == cache.screens[38], "in the least recently shown slots");
+
+	BackgroundEnd(&cache);
+	Check(gTask == NULL, "BackgroundEnd takes the task off");
+
+	printf("bgcheck: %lu B slots, %d images, %lu shown, %lu hits, %lu B waited for, %lu B ahead, %d failed\n",
+		slotSize, cache.imageCount, cache.shown, cache.hits, cache.stallBytes, cache.aheadBytes, gFailed);
+
+	free(memory);
+	free(gArchive);
+	return gFailed != 0;
+}
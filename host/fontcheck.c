@@ -0,0 +1,297 @@
+/*****************************************************************
+*
+* fontcheck.c
+*
+* Host check of source/font.c against the shipped font sheets and
+* width tables, out of the asset archive.
+*
+* Every sheet (ARIA10B.BMP, ...) with a table in its WDT (ARIAB.WDT)
+* is uploaded to a pretend VDP1 VRAM, and each glyph checked against
+* the sheet: its sprite is as wide as its ink rounded up to 8 pixels,
+* no ink is cut off, and the pixels are the sheet's with the
+* background swapped to 0. Then, with one of the fonts:
+*
+*	- a run is laid out where FontMeasure says, and found again
+*	  without laying it out; so is the same text in another font
+*	- with the cache full, the least recently used run goes first
+*	- text longer than kFontRunLength is cut short
+*	- FontDraw adds nothing once the commands, with room for the
+*	  end, would run past the batch's capacity
+*
+*	netlink-fontcheck [-v] [ARCHIVE]
+*
+* ARCHIVE is NLASSETS.PAK unless given; make -C host fontcheck packs
+* it out of cd the way the game's build does.
+*
+*****************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "font.h"
+#include "pack.h"
+#include "hostutil.h"
+
+#define	kCheckVramSize		(512 * 1024)	/* all of VDP1 VRAM */
+#define	kCheckCommands		64
+
+static unsigned char *gArchive;
+static unsigned long gArchiveSize;
+static int gVerbose;
+static int gFailed;
+
+
+static void Check(int ok, const char *what)
+{
+	if (gVerbose || !ok)
+		printf("fontcheck: %-56s %s\n", what, ok ? "ok" : "FAILED");
+
+	if (!ok)
+		gFailed++;
+}
+
+
+static unsigned CheckPixel(const unsigned char *sheet, unsigned long rate, int x, int y)
+{
+	unsigned char pair = sheet[y * rate + x / 2];
+
+	return (x & 1) ? (pair & 15) : (pair >> 4);
+}
+
+
+/*
+//
+// This function checks every glyph FontUpload wrote against the
+// sheet. Returns 0 if any is wrong.
+//
+*/
+
+static int CheckGlyphs(const Font *font, const PackAsset *sheet, const unsigned char *vram)
+{
+	const unsigned char *pixels = gArchive + sheet->dataOffset;
+	const unsigned short *sprite;
+	int cell, glyph, ink, width, x, y;
+	unsigned value, want;
+
+	cell = sheet->width / kFontGlyphs;
+
+	for (glyph = 0; glyph < kFontGlyphs; glyph++)
+	{
+		/* Where the ink ends, on the sheet */
+
+		ink = 0;
+		for (y = 0; y < sheet->height; y++)
+		{
+			for (x = 0; x < cell; x++)
+			{
+				if (CheckPixel(pixels, sheet->rate, glyph * cell + x, y) != font->background)
+				{
+					if (x + 1 > ink)
+						ink = x + 1;
+				}
+			}
+		}
+
+		if (ink == 0)
+		{
+			if (font->size[glyph] != 0)
+				return 0;
+			continue;
+		}
+
+		width = (font->size[glyph] >> 8) * 8;
+		if (width != ((ink + 7) & ~7) || (font->size[glyph] & 0xFF) != sheet->height)
+			return 0;
+
+		/* FontUpload writes a word, four pixels, at a time, in the */
+		/* host's byte order here */
+
+		sprite = (const unsigned short *)(vram + font->address[glyph] * 8UL);
+		for (y = 0; y < sheet->height; y++)
+		{
+			for (x = 0; x < width; x++)
+			{
+				value = (sprite[(y * width + x) / 4] >> (12 - (x & 3) * 4)) & 15;
+				want = (x < cell) ? CheckPixel(pixels, sheet->rate, glyph * cell + x, y) : font->background;
+
+				if (want == font->background)
+					want = 0;
+				else if (want == 0)
+					want = font->background;
+
+				if (value != want)
+					return 0;
+			}
+		}
+	}
+
+	return 1;
+}
+
+
+/*
+//
+// This function uploads every sheet that has a width table, and
+// leaves the last font of points points in font. Returns how many
+// sheets it checked.
+//
+*/
+
+static int CheckSheets(const Pack *pack, unsigned char *vram, int points, Font *font)
+{
+	PackAsset sheet, wdt;
+	Font loaded;
+	char name[kPackNameSize], what[96];
+	unsigned long used;
+	int sheetPoints, length, sheets, ok;
+	unsigned iii;
+
+	sheets = 0;
+	for (iii = 0; iii < pack->count; iii++)
+	{
+		PackGet(pack, iii, &sheet);
+
+		/* FAMI, the points, the style: its table is in FAMIstyle.WDT */
+
+		length = (int)strlen(sheet.name);
+		if (sheet.type != kPackImage || length < 9 || strcmp(sheet.name + length - 4, ".BMP") != 0
+			|| (strncmp(sheet.name, "ARIA", 4) != 0 && strncmp(sheet.name, "LUCI", 4) != 0))
+			continue;
+
+		sheetPoints = atoi(sheet.name + 4);
+		snprintf(name, sizeof(name), "%.4s%.*s.WDT", sheet.name,
+			length - 4 - 4 - (sheetPoints >= 10 ? 2 : 1), sheet.name + 4 + (sheetPoints >= 10 ? 2 : 1));
+
+		if (!PackFind(pack, name, &wdt))
+			continue;
+
+		if (!FontInit(&loaded, gArchive + wdt.dataOffset, wdt.dataSize, sheetPoints))
+		{
+			snprintf(what, sizeof(what), "%s: %s has no %d point table", sheet.name, name, sheetPoints);
+			Check(FontSizeIndex(sheetPoints) < 0, what);
+			continue;
+		}
+
+		memset(vram, 0, kCheckVramSize);
+		used = FontUpload(&loaded, gArchive + sheet.dataOffset, sheet.width, sheet.height,
+			sheet.rate, vram, 0, kCheckVramSize, 0);
+
+		ok = (sheet.format == kPackIndexed4 && used > 0 && CheckGlyphs(&loaded, &sheet, vram));
+		snprintf(what, sizeof(what), "%s: %lu B, glyphs trimmed to their ink", sheet.name, used);
+		Check(ok, what);
+		sheets++;
+
+		if (ok && sheetPoints == points && font->height == 0)
+			*font = loaded;
+	}
+
+	return sheets;
+}
+
+
+int main(int argc, char **argv)
+{
+	static unsigned char vram[kCheckVramSize];
+	static FontCommand commands[kCheckCommands];
+	static Font font, other;
+	static FontRunCache cache;
+	const FontRun *run, *first, *oldest;
+	const char *path;
+	char text[kFontRunLength + 16];
+	unsigned short palette[16], sheetPalette[16];
+	FontBatch batch;
+	Pack pack;
+	unsigned long hits;
+	int sheets, iii;
+
+	path = "NLASSETS.PAK";
+	for (iii = 1; iii < argc; iii++)
+	{
+		if (strcmp(argv[iii], "-v") == 0)
+			gVerbose = 1;
+		else
+			path = argv[iii];
+	}
+
+	gArchive = HostLoad(path, &gArchiveSize);
+	if (gArchive == NULL || !PackOpen(&pack, gArchive, gArchiveSize))
+	{
+		fprintf(stderr, "fontcheck: %s isn't an archive\n", path);
+		return 1;
+	}
+
+	sheets = CheckSheets(&pack, vram, 10, &font);
+	if (sheets == 0 || font.height == 0)
+	{
+		fprintf(stderr, "fontcheck: no 10 point sheets in %s\n", path);
+		return 1;
+	}
+
+	Check(font.size[0] == 0, "the space has no sprite");
+
+	for (iii = 0; iii < 16; iii++)
+		sheetPalette[iii] = (unsigned short)(0x8000 | iii);
+	FontPalette(&font, sheetPalette, palette);
+	Check(palette[0] == sheetPalette[font.background] && palette[font.background] == sheetPalette[0],
+		"the palette swaps the background to 0");
+
+	/* Runs */
+
+	other = font;
+	first = FontRunGet(&cache, &font, "Player 1");
+	Check(first->width == FontMeasure(&font, "Player 1") && first->count == 7,
+		"a run is as wide as FontMeasure says, a glyph a letter");
+	Check(first->x[0] == 0 && first->x[1] > first->x[0] && first->x[6] < first->width,
+		"its glyphs go left to right");
+	Check(FontRunGet(&cache, &font, "Player 1") == first && cache.hits == 1 && cache.misses == 1,
+		"the same text is found again");
+	oldest = FontRunGet(&cache, &other, "Player 1");
+	Check(oldest != first && cache.misses == 2, "the same text in another font isn't");
+
+	for (iii = 0; iii < kFontRuns - 2; iii++)
+	{
+		snprintf(text, sizeof(text), "Label %d", iii);
+		FontRunGet(&cache, &font, text);
+	}
+	Check(cache.misses == kFontRuns, "the cache fills up");
+
+	/* The other font's run is the least recently used now */
+
+	FontRunGet(&cache, &font, "Player 1");
+	FontRunGet(&cache, &font, "Label 0");
+	hits = cache.hits;
+	Check(FontRunGet(&cache, &font, "Player 2") == oldest, "a new run takes the least recently used one");
+	Check(FontRunGet(&cache, &font, "Player 1") == first && FontRunGet(&cache, &font, "Label 0") != oldest
+		&& cache.hits == hits + 2, "and the runs used since stay");
+	Check(FontRunGet(&cache, &other, "Player 1") != oldest && cache.hits == hits + 2,
+		"the run it took is laid out again");
+
+	memset(text, 'W', kFontRunLength + 8);
+	text[kFontRunLength + 8] = 0;
+	run = FontRunGet(&cache, &font, text);
+	Check(strlen(run->text) == kFontRunLength && run->count == kFontRunLength,
+		"text past kFontRunLength is cut short");
+
+	/* Batches */
+
+	run = FontRunGet(&cache, &font, "Player 1");
+	FontBatchInit(&batch, commands, run->count);
+	Check(!FontDraw(&batch, run, 0, 0) && batch.count == 0, "a run with no room for the end isn't drawn");
+
+	FontBatchInit(&batch, commands, run->count * 2 + 1);
+	Check(FontDraw(&batch, run, 16, 8) && batch.count == run->count, "a run that fits is drawn");
+	Check(commands[1].xa == 16 + run->x[1] && commands[1].ya == 8
+		&& commands[1].address == font.address[run->glyph[1]] && commands[1].size == font.size[run->glyph[1]],
+		"a glyph each, where the run put it");
+	Check(FontDraw(&batch, run, 16, 40) && !FontDraw(&batch, run, 16, 72) && batch.count == run->count * 2,
+		"and once the batch is full, nothing more is");
+	Check(FontBatchEnd(&batch) == run->count * 2 + 1 && commands[run->count * 2].control == 0x8000,
+		"the end still fits");
+
+	printf("fontcheck: %d sheets, %lu run hits, %lu misses, %d failed\n",
+		sheets, cache.hits, cache.misses, gFailed);
+
+	free(gArchive);
+	return gFailed != 0;
+}
@@ -0,0 +1,197 @@
+/*****************************************************************
+*
+* gifbench.c
+*
+* Host benchmark of source/gif.c against the shipped GIFs.
+*
+* Each file is read into memory and decoded repeat times, fed to
+* GifFeed a CD sector at a time, into an 8-bit target laid out as
+* rows (or 8x8 cells with -c). The decode rate is reported in MB/s
+* of GIF data in and of pixels out, for every file with -v and for
+* all of them together. Every file is also decoded once in one piece
+* and must come out the same as it did a sector at a time.
+*
+*	netlink-gifbench [-c] [-v] [-n REPEAT] [-s SECTOR] [DIR]
+*
+* DIR is cd/NETLINK unless given; make -C host gifbench runs it so.
+*
+*****************************************************************/
+
+#include <dirent.h>
+#include <fnmatch.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gif.h"
+#include "hostutil.h"
+
+#define	kBenchSector		2048
+
+static GifDecoder gDecoder;
+
+
+/*
+//
+// This function decodes data into target, sector bytes at a time.
+// Returns 0 if the decoder fails or doesn't finish.
+//
+*/
+
+static int BenchDecode(const unsigned char *data, unsigned long size, const GifTarget *target,
+	unsigned long sector)
+{
+	unsigned long offset, count;
+
+	GifInit(&gDecoder, target);
+
+	for (offset = 0; offset < size && !GifDone(&gDecoder); offset += count)
+	{
+		count = size - offset;
+		if (count > sector)
+			count = sector;
+
+		if (!GifFeed(&gDecoder, data + offset, count))
+			return 0;
+	}
+
+	return GifDone(&gDecoder);
+}
+
+
+int main(int argc, char **argv)
+{
+	const char *dirName = "../cd/NETLINK";
+	char path[1024];
+	DIR *dir;
+	struct dirent *entry;
+	GifTarget target;
+	unsigned char *data, *pixels, *whole;
+	unsigned long size, bytes, sector, pixelBytes, totalIn, totalOut;
+	double start, seconds, totalSeconds;
+	int repeat, cells, verbose, files, failed, width, height, iii;
+
+	repeat = 20;
+	sector = kBenchSector;
+	cells = 0;
+	verbose = 0;
+
+	for (iii = 1; iii < argc; iii++)
+	{
+		if (strcmp(argv[iii], "-c") == 0)
+			cells = 1;
+		else if (strcmp(argv[iii], "-v") == 0)
+			verbose = 1;
+		else if (strcmp(argv[iii], "-n") == 0 && iii + 1 < argc)
+			repeat = atoi(argv[++iii]);
+		else if (strcmp(argv[iii], "-s") == 0 && iii + 1 < argc)
+			sector = strtoul(argv[++iii], NULL, 0);
+		else if (argv[iii][0] != '-')
+			dirName = argv[iii];
+		else
+		{
+			fprintf(stderr, "usage: %s [-c] [-v] [-n REPEAT] [-s SECTOR] [DIR]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	if (repeat < 1 || sector < 1)
+		return 2;
+
+	dir = opendir(dirName);
+	if (dir == NULL)
+	{
+		fprintf(stderr, "gifbench: can't open %s\n", dirName);
+		return 1;
+	}
+
+	files = 0;
+	failed = 0;
+	totalIn = 0;
+	totalOut = 0;
+	totalSeconds = 0;
+
+	while ((entry = readdir(dir)) != NULL)
+	{
+		if (fnmatch("*.[Gg][Ii][Ff]", entry->d_name, 0) != 0)
+			continue;
+
+		snprintf(path, sizeof(path), "%s/%s", dirName, entry->d_name);
+		data = HostLoad(path, &size);
+		if (data == NULL || size < 10)
+		{
+			free(data);
+			continue;
+		}
+
+		/* The logical screen size, padded to 8 for cells and VDP1 */
+
+		width = ((data[6] | (data[7] << 8)) + 7) & ~7;
+		height = ((data[8] | (data[9] << 8)) + 7) & ~7;
+		pixelBytes = (unsigned long)width * height;
+
+		pixels = calloc(pixelBytes, 1);
+		whole = calloc(pixelBytes, 1);
+
+		target.width = width;
+		target.height = height;
+		target.rate = width;
+		target.layout = cells ? kPackCells : kPackRows;
+		target.bits = 8;
+
+		target.pixels = whole;
+		if (!BenchDecode(data, size, &target, size))
+		{
+			printf("gifbench: %-12s failed\n", entry->d_name);
+			failed++;
+			free(data);
+			free(pixels);
+			free(whole);
+			continue;
+		}
+
+		target.pixels = pixels;
+		start = HostNow();
+		for (iii = 0; iii < repeat; iii++)
+			BenchDecode(data, size, &target, sector);
+		seconds = HostNow() - start;
+
+		if (memcmp(pixels, whole, pixelBytes) != 0)
+		{
+			printf("gifbench: %-12s differs fed %lu bytes at a time\n", entry->d_name, sector);
+			failed++;
+		}
+
+		bytes = (unsigned long)gDecoder.frameWidth * gDecoder.frameHeight;
+		if (verbose)
+			printf("gifbench: %-12s %4dx%-4d %7lu B %s %7.1f MB/s in %7.1f MB/s out\n",
+				entry->d_name, gDecoder.frameWidth, gDecoder.frameHeight, size,
+				gDecoder.interlaced ? "i" : " ", size * (double)repeat / seconds / 1e6,
+				bytes * (double)repeat / seconds / 1e6);
+
+		files++;
+		totalIn += size;
+		totalOut += bytes;
+		totalSeconds += seconds;
+
+		free(data);
+		free(pixels);
+		free(whole);
+	}
+
+	closedir(dir);
+
+	if (files == 0 || totalSeconds <= 0)
+	{
+		fprintf(stderr, "gifbench: no GIFs in %s\n", dirName);
+		return 1;
+	}
+
+	printf("gifbench: %d files, %lu B in, %lu pixels out, %d failed, %s, %lu B sectors\n",
+		files, totalIn, totalOut, failed, cells ? "cells" : "rows", sector);
+	printf("gifbench: %.1f MB/s in, %.1f MB/s out, %.3f ms a pass\n",
+		totalIn * (double)repeat / totalSeconds / 1e6, totalOut * (double)repeat / totalSeconds / 1e6,
+		totalSeconds * 1e3 / repeat);
+
+	return failed != 0;
+}
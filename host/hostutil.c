@@ -0,0 +1,49 @@
+/*****************************************************************
+*
+* hostutil.c
+*
+* File loading and timing for the host tools, see hostutil.h.
+*
+*****************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "hostutil.h"
+
+
+unsigned char *HostLoad(const char *path, unsigned long *size)
+{
+	FILE *file;
+	unsigned char *data;
+	long length;
+
+	file = fopen(path, "rb");
+	if (file == NULL)
+		return NULL;
+
+	fseek(file, 0, SEEK_END);
+	length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	data = malloc(length > 0 ? length : 1);
+	if (data != NULL && fread(data, 1, length, file) != (size_t)length)
+	{
+		free(data);
+		data = NULL;
+	}
+
+	fclose(file);
+	*size = (unsigned long)length;
+	return data;
+}
+
+
+double HostNow(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
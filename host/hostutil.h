@@ -0,0 +1,25 @@
+/*****************************************************************
+*
+* hostutil.h
+*
+* File loading and timing shared by the host benchmarks and checks
+* (gifbench.c, jpegbench.c, soundbench.c, bgcheck.c, fontcheck.c and
+* htmlcheck.c).
+*
+*****************************************************************/
+
+
+#ifndef __HOSTUTIL__
+#define	__HOSTUTIL__
+
+/* Reads the whole of path into a block from malloc and sets size. */
+/* Returns NULL if it can't; the caller frees the block. */
+
+unsigned char *HostLoad(const char *path, unsigned long *size);
+
+/* Returns a monotonic time in seconds */
+
+double HostNow(void);
+
+
+#endif	/* __HOSTUTIL__ */
@@ -0,0 +1,264 @@
+/*****************************************************************
+*
+* htmlcheck.c
+*
+* Host check of source/html.c against the shipped pages.
+*
+* Every page in cd/NETLINK is laid out three times, fed to HtmlFeed
+* in one piece, a byte at a time and a CD sector at a time, and the
+* three must come out the same: title, colors, boxes, their text and
+* the page height. That is the point of a streaming tokenizer, which
+* has to pick up where the last piece stopped in the middle of a tag,
+* an attribute or an entity. It is done for the top of the page and
+* for a viewport further down.
+*
+* Each page is then cut short at a few places, and garbage made of
+* the characters HTML cares about is fed in the same three ways. A
+* page cut short or garbage needn't look like anything, but it must
+* still come out the same every way, and its boxes must stay inside
+* the page's arena.
+*
+*	netlink-htmlcheck [-v] [DIR]
+*
+* DIR is cd/NETLINK unless given; make -C host htmlcheck runs it so.
+*
+*****************************************************************/
+
+#include <dirent.h>
+#include <fnmatch.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "html.h"
+#include "hostutil.h"
+
+#define	kCheckSector		2048
+#define	kCheckWidth			304		/* the NETLINK page, inside its frame */
+#define	kCheckHeight		224
+#define	kCheckGarbage		16384
+
+static HtmlPage gWhole;
+static HtmlPage gPieces;
+static int gVerbose;
+
+
+/* A dbgio-like grid whose cells grow with the font size */
+
+static int CheckMeasure(const char *text, int length, int style, void *ref)
+{
+	return length * (5 + (style & kHtmlSizeMask)) + ((style & kHtmlBold) ? length : 0);
+}
+
+static int CheckLineHeight(int style, void *ref)
+{
+	return 8 + 2 * (style & kHtmlSizeMask);
+}
+
+static const HtmlMetrics kCheckMetrics = { CheckMeasure, CheckLineHeight, NULL };
+
+
+static void CheckLayout(HtmlPage *page, const unsigned char *data, unsigned long size,
+	unsigned long piece, int top)
+{
+	unsigned long offset, length;
+
+	HtmlInit(page, &kCheckMetrics, kCheckWidth, top, kCheckHeight);
+
+	for (offset = 0; offset < size; offset += length)
+	{
+		length = (size - offset < piece) ? size - offset : piece;
+		HtmlFeed(page, data + offset, length);
+	}
+
+	HtmlFinish(page);
+}
+
+
+/*
+//
+// This function returns 1 if two layouts of a page came out the
+// same. The tokenizer and layout state they were left in can differ
+// in what's left over, so only what was laid out is compared.
+//
+*/
+
+static int CheckSame(const HtmlPage *a, const HtmlPage *b)
+{
+	return strcmp(a->title, b->title) == 0
+		&& a->background == b->background && a->foreground == b->foreground
+		&& a->linkColor == b->linkColor
+		&& a->count == b->count && memcmp(a->boxes, b->boxes, a->count * sizeof(HtmlBox)) == 0
+		&& a->arenaUsed == b->arenaUsed && memcmp(a->arena, b->arena, a->arenaUsed) == 0
+		&& a->height == b->height && a->truncated == b->truncated;
+}
+
+
+/*
+//
+// This function returns 1 if the boxes stay inside the page.
+//
+*/
+
+static int CheckBounds(const HtmlPage *page)
+{
+	const HtmlBox *box;
+	int iii;
+
+	if (page->count < 0 || page->count > kHtmlBoxes || page->arenaUsed > kHtmlArenaSize
+		|| memchr(page->title, 0, kHtmlTitleSize) == NULL)
+		return 0;
+
+	for (iii = 0; iii < page->count; iii++)
+	{
+		box = &page->boxes[iii];
+
+		if ((unsigned)box->text + box->length > page->arenaUsed
+			|| (box->link != kHtmlNone && box->link >= page->arenaUsed)
+			|| box->x < 0 || box->y < 0 || box->y > page->height)
+			return 0;
+	}
+
+	return 1;
+}
+
+
+/*
+//
+// This function lays data out in one piece, a byte at a time and a
+// sector at a time, with the viewport at top, and returns 1 if all
+// three came out the same and in bounds.
+//
+*/
+
+static int CheckFeeds(const unsigned char *data, unsigned long size, int top)
+{
+	CheckLayout(&gWhole, data, size, size ? size : 1, top);
+	if (!CheckBounds(&gWhole))
+		return 0;
+
+	CheckLayout(&gPieces, data, size, 1, top);
+	if (!CheckSame(&gWhole, &gPieces))
+		return 0;
+
+	CheckLayout(&gPieces, data, size, kCheckSector, top);
+	return CheckSame(&gWhole, &gPieces);
+}
+
+
+/*
+//
+// This function makes size bytes of garbage, mostly the characters
+// the tokenizer changes state on.
+//
+*/
+
+static void CheckGarbage(unsigned char *data, unsigned long size, unsigned long seed)
+{
+	static const char kAlphabet[] = "<<>>&&;;#=\"\"''/!- \n\tabpBRhfontimg0x9A";
+	unsigned long iii;
+
+	for (iii = 0; iii < size; iii++)
+	{
+		seed = seed * 1103515245UL + 12345UL;
+		if ((seed >> 16) % 8 == 0)
+			data[iii] = (unsigned char)(seed >> 24);
+		else
+			data[iii] = (unsigned char)kAlphabet[(seed >> 16) % (sizeof(kAlphabet) - 1)];
+	}
+}
+
+
+int main(int argc, char **argv)
+{
+	const char *dirName;
+	DIR *dir;
+	struct dirent *entry;
+	char path[1024];
+	unsigned char *data, *garbage;
+	unsigned long size, totalBytes, cut;
+	int files, failed, ok, iii;
+
+	dirName = "cd/NETLINK";
+	for (iii = 1; iii < argc; iii++)
+	{
+		if (strcmp(argv[iii], "-v") == 0)
+			gVerbose = 1;
+		else
+			dirName = argv[iii];
+	}
+
+	dir = opendir(dirName);
+	if (dir == NULL)
+	{
+		fprintf(stderr, "htmlcheck: can't open %s\n", dirName);
+		return 1;
+	}
+
+	files = 0;
+	failed = 0;
+	totalBytes = 0;
+
+	while ((entry = readdir(dir)) != NULL)
+	{
+		if (fnmatch("*.[Hh][Tt][Mm]", entry->d_name, 0) != 0)
+			continue;
+
+		snprintf(path, sizeof(path), "%s/%s", dirName, entry->d_name);
+		data = HostLoad(path, &size);
+		if (data == NULL)
+			continue;
+
+		ok = CheckFeeds(data, size, 0);
+		if (!ok)
+			printf("htmlcheck: %-12s differs fed a piece at a time\n", entry->d_name);
+
+		if (ok && gVerbose)
+			printf("htmlcheck: %-12s %6lu B %3d boxes %5u B text, %5d pixels%s \"%s\"\n",
+				entry->d_name, size, gWhole.count, gWhole.arenaUsed, gWhole.height,
+				gWhole.truncated ? " truncated" : "", gWhole.title);
+
+		if (ok && !(ok = CheckFeeds(data, size, kCheckHeight)))
+			printf("htmlcheck: %-12s differs further down\n", entry->d_name);
+
+		/* Cut short, including in the middle of the first tag */
+
+		for (cut = 1; ok && cut < size; cut = cut * 3 + 1)
+		{
+			if (!(ok = CheckFeeds(data, cut, 0)))
+				printf("htmlcheck: %-12s differs cut short at %lu bytes\n", entry->d_name, cut);
+		}
+
+		if (!ok)
+			failed++;
+
+		files++;
+		totalBytes += size;
+		free(data);
+	}
+
+	closedir(dir);
+
+	if (files == 0)
+	{
+		fprintf(stderr, "htmlcheck: no pages in %s\n", dirName);
+		return 1;
+	}
+
+	/* Garbage */
+
+	garbage = malloc(kCheckGarbage);
+	for (iii = 0; garbage != NULL && iii < 8; iii++)
+	{
+		CheckGarbage(garbage, kCheckGarbage, 1996 + iii);
+		if (!CheckFeeds(garbage, kCheckGarbage, 0))
+		{
+			printf("htmlcheck: garbage %d differs fed a piece at a time\n", iii);
+			failed++;
+		}
+	}
+	free(garbage);
+
+	printf("htmlcheck: %d pages, %lu B, and 8 of garbage, %d failed\n", files, totalBytes, failed);
+	return failed != 0;
+}
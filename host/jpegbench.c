@@ -0,0 +1,190 @@
+/*****************************************************************
+*
+* jpegbench.c
+*
+* Host benchmark of source/jpeg.c against the shipped JPEGs.
+*
+* Each file is read into memory and decoded repeat times at every
+* scale, full size down to 1/8, fed to JpegFeed a CD sector at a
+* time, into an RGB1555 bitmap. The decode rate is reported in MB/s
+* of JPEG data in and megapixels out, for every file with -v and for
+* all of them together at each scale. Every file is also decoded once
+* in one piece and must come out the same as it did a sector at a
+* time.
+*
+*	netlink-jpegbench [-v] [-n REPEAT] [-s SECTOR] [DIR]
+*
+* DIR is cd/NETLINK unless given; make -C host jpegbench runs it so.
+*
+*****************************************************************/
+
+#include <dirent.h>
+#include <fnmatch.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "jpeg.h"
+#include "hostutil.h"
+
+#define	kBenchSector		2048
+#define	kBenchScales		4
+#define	kBenchRate			(kJpegMaxWidth * 2)
+#define	kBenchBitmapSize	(kBenchRate * kJpegMaxWidth)
+
+static JpegDecoder gDecoder;
+static unsigned char gPixels[kBenchBitmapSize];
+static unsigned char gWhole[kBenchBitmapSize];
+
+
+/*
+//
+// This function decodes data into pixels at scale, sector bytes at
+// a time. Returns 0 if the decoder fails or doesn't finish.
+//
+*/
+
+static int BenchDecode(const unsigned char *data, unsigned long size, unsigned char *pixels,
+	int scale, unsigned long sector)
+{
+	JpegTarget target;
+	unsigned long offset, count;
+
+	target.pixels = pixels;
+	target.width = kJpegMaxWidth;
+	target.height = kJpegMaxWidth;
+	target.rate = kBenchRate;
+	JpegInit(&gDecoder, &target, scale);
+
+	for (offset = 0; offset < size && !JpegDone(&gDecoder); offset += count)
+	{
+		count = size - offset;
+		if (count > sector)
+			count = sector;
+
+		if (!JpegFeed(&gDecoder, data + offset, count))
+			return 0;
+	}
+
+	return JpegDone(&gDecoder);
+}
+
+
+int main(int argc, char **argv)
+{
+	const char *dirName = "../cd/NETLINK";
+	char path[1024];
+	DIR *dir;
+	struct dirent *entry;
+	unsigned char *data;
+	unsigned long size, sector, totalIn, totalOut[kBenchScales];
+	double start, seconds, totalSeconds[kBenchScales];
+	int repeat, verbose, files, failed, scale, iii;
+
+	repeat = 20;
+	sector = kBenchSector;
+	verbose = 0;
+
+	for (iii = 1; iii < argc; iii++)
+	{
+		if (strcmp(argv[iii], "-v") == 0)
+			verbose = 1;
+		else if (strcmp(argv[iii], "-n") == 0 && iii + 1 < argc)
+			repeat = atoi(argv[++iii]);
+		else if (strcmp(argv[iii], "-s") == 0 && iii + 1 < argc)
+			sector = strtoul(argv[++iii], NULL, 0);
+		else if (argv[iii][0] != '-')
+			dirName = argv[iii];
+		else
+		{
+			fprintf(stderr, "usage: %s [-v] [-n REPEAT] [-s SECTOR] [DIR]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	if (repeat < 1 || sector < 1)
+		return 2;
+
+	dir = opendir(dirName);
+	if (dir == NULL)
+	{
+		fprintf(stderr, "jpegbench: can't open %s\n", dirName);
+		return 1;
+	}
+
+	files = 0;
+	failed = 0;
+	totalIn = 0;
+	memset(totalOut, 0, sizeof(totalOut));
+	memset(totalSeconds, 0, sizeof(totalSeconds));
+
+	while ((entry = readdir(dir)) != NULL)
+	{
+		if (fnmatch("*.[Jj][Pp][Ee]", entry->d_name, 0) != 0
+			&& fnmatch("*.[Jj][Pp][Gg]", entry->d_name, 0) != 0)
+			continue;
+
+		snprintf(path, sizeof(path), "%s/%s", dirName, entry->d_name);
+		data = HostLoad(path, &size);
+		if (data == NULL)
+			continue;
+
+		for (scale = 0; scale < kBenchScales; scale++)
+		{
+			memset(gWhole, 0, sizeof(gWhole));
+			if (!BenchDecode(data, size, gWhole, scale, size))
+			{
+				printf("jpegbench: %-12s failed at 1/%d\n", entry->d_name, 1 << scale);
+				failed++;
+				break;
+			}
+
+			memset(gPixels, 0, sizeof(gPixels));
+			start = HostNow();
+			for (iii = 0; iii < repeat; iii++)
+				BenchDecode(data, size, gPixels, scale, sector);
+			seconds = HostNow() - start;
+
+			if (memcmp(gPixels, gWhole, sizeof(gPixels)) != 0)
+			{
+				printf("jpegbench: %-12s differs at 1/%d fed %lu bytes at a time\n",
+					entry->d_name, 1 << scale, sector);
+				failed++;
+			}
+
+			if (verbose)
+				printf("jpegbench: %-12s 1/%d %3dx%-3d %6lu B %7.1f MB/s in %6.1f Mpixels/s out\n",
+					entry->d_name, 1 << scale, gDecoder.outWidth, gDecoder.outHeight, size,
+					size * (double)repeat / seconds / 1e6,
+					(double)gDecoder.outWidth * gDecoder.outHeight * repeat / seconds / 1e6);
+
+			totalOut[scale] += (unsigned long)gDecoder.outWidth * gDecoder.outHeight;
+			totalSeconds[scale] += seconds;
+		}
+
+		files++;
+		totalIn += size;
+		free(data);
+	}
+
+	closedir(dir);
+
+	if (files == 0)
+	{
+		fprintf(stderr, "jpegbench: no JPEGs in %s\n", dirName);
+		return 1;
+	}
+
+	printf("jpegbench: %d files, %lu B in, %d failed, %lu B sectors, decoder %lu B\n",
+		files, totalIn, failed, sector, (unsigned long)sizeof(JpegDecoder));
+
+	for (scale = 0; scale < kBenchScales && totalSeconds[scale] > 0; scale++)
+	{
+		printf("jpegbench: 1/%d %7.1f MB/s in, %6.1f Mpixels/s out, %.3f ms a pass\n",
+			1 << scale, totalIn * (double)repeat / totalSeconds[scale] / 1e6,
+			totalOut[scale] * (double)repeat / totalSeconds[scale] / 1e6,
+			totalSeconds[scale] * 1e3 / repeat);
+	}
+
+	return failed != 0;
+}
@@ -0,0 +1,492 @@
+/*****************************************************************
+*
+* soundbench.c
+*
+* Host check and benchmark of the sound driver's ADPCM codec
+* (m68k/adpcm.c) and mixer (m68k/mixer.c) against the shipped WAVs.
+*
+* Every WAV is encoded, and decoded again both in one piece and a few
+* samples at a time, which must agree; the signal to noise ratio
+* against the WAV and the decode rate are reported, for every file
+* with -v and for all of them together, as is how much of them sound
+* RAM holds as ADPCM and as PCM.
+*
+* Then the encoded sounds are loaded into a pretend sound RAM with
+* source/sound.c, and SECONDS of random UI sounds are played through
+* the command ring and the mixer, the bench standing in for the
+* driver's main loop and for the SCSP: a timer tick every kMixerTick
+* samples, the main loop coming round every so often (at most LOOP
+* samples apart), and a slot for every voice walking its ring at the
+* sound's pitch. Every ring sample a slot plays must be the sound's
+* own, or silence after it; one that isn't (the mixer fell behind the
+* slot or ran over it) is counted as bad.
+*
+*	netlink-soundbench [-v] [-n REPEAT] [-t SECONDS] [-l LOOP] [DIR]
+*
+* DIR is cd/NETLINK unless given; make -C host soundbench runs it so.
+*
+*****************************************************************/
+
+#include <dirent.h>
+#include <fnmatch.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "adpcm.h"
+#include "mixer.h"
+#include "nlpack.h"
+#include "sound.h"
+#include "hostutil.h"
+
+#define	kBenchSounds		kSoundSamples
+#define	kBenchChunk			7			/* samples a decode, to cross bytes and blocks */
+
+typedef struct
+{
+	char			name[256];
+	unsigned long	rate;
+	unsigned long	count;				/* samples */
+	unsigned long	pcmSize;			/* bytes, as the WAV's own PCM */
+	unsigned long	size;				/* bytes of ADPCM */
+	unsigned char	*adpcm;
+	short			*decoded;			/* padded to AdpcmSamples(size) */
+	int				sample;				/* in the sound table */
+} BenchSound;
+
+typedef struct
+{
+	int				on;
+	int				sound;
+	int				loop;
+	unsigned long	position;			/* 16.16 ring samples */
+	unsigned long	checked;			/* next ring sample to check */
+} BenchSlot;
+
+static BenchSound gSounds[kBenchSounds];
+static int gSoundCount;
+static unsigned char gRAM[kSoundRAMSize];
+static unsigned char gArchive[kSoundRAMSize * 4];
+static unsigned long gArchiveSize;
+static Sound gSound;
+static Mixer gMixer;
+static BenchSlot gSlots[kSoundVoices];
+static int gVoiceSound[kSoundVoices];
+static int gSampleSound[kSoundSamples];		/* the sound loaded as each sample */
+
+
+static int BenchRead(unsigned long offset, void *buffer, unsigned long size, void *ref)
+{
+	if (offset > gArchiveSize || size > gArchiveSize - offset)
+		return 0;
+
+	memcpy(buffer, gArchive + offset, size);
+	return 1;
+}
+
+
+/*
+//
+// This function encodes one WAV and checks it decodes the same in
+// pieces as whole. Returns 0 if it doesn't.
+//
+*/
+
+static int BenchEncode(BenchSound *sound, const NLSound *wav, double *noise, double *signal)
+{
+	Adpcm adpcm;
+	short *pieces, *source;
+	unsigned long length, done, got, iii;
+	double difference;
+
+	sound->rate = wav->rate;
+	sound->count = wav->frames;
+	sound->pcmSize = wav->frames * (wav->bits / 8);
+
+	source = malloc((wav->frames + 1) * sizeof(short));
+	for (iii = 0; iii < wav->frames; iii++)
+		source[iii] = (short)(wav->bits == 8 ? wav->samples[iii] * 256 : wav->samples[iii]);
+
+	sound->adpcm = malloc(AdpcmBytes(sound->count) + 1);
+	sound->size = AdpcmEncode(source, sound->count, sound->adpcm);
+	length = AdpcmSamples(sound->size);
+
+	sound->decoded = malloc((length + 1) * sizeof(short));
+	pieces = malloc((length + 1) * sizeof(short));
+
+	AdpcmStart(&adpcm, sound->adpcm, sound->size);
+	done = AdpcmDecode(&adpcm, sound->decoded, length + 1);
+
+	AdpcmStart(&adpcm, sound->adpcm, sound->size);
+	for (got = 0; got < length; got += iii)
+	{
+		iii = AdpcmDecode(&adpcm, pieces + got, kBenchChunk);
+		if (iii == 0)
+			break;
+	}
+
+	*noise = 0;
+	*signal = 0;
+	for (iii = 0; iii < sound->count && iii < done; iii++)
+	{
+		difference = (double)sound->decoded[iii] - source[iii];
+		*noise += difference * difference;
+		*signal += (double)source[iii] * source[iii];
+	}
+
+	iii = (sound->size == AdpcmBytes(sound->count) && done == length && got == length
+		&& length >= sound->count && length <= sound->count + 1
+		&& memcmp(pieces, sound->decoded, length * sizeof(short)) == 0);
+
+	free(pieces);
+	free(source);
+	return (int)iii;
+}
+
+
+/*
+//
+// This function walks the slots on by one SCSP sample, checking each
+// ring sample as a slot comes to it. Returns the bad ones.
+//
+*/
+
+static unsigned long BenchSlots(unsigned long *checked)
+{
+	BenchSlot *slot;
+	BenchSound *sound;
+	MixerVoice *voice;
+	unsigned long at, length, bad;
+	short expected;
+	int iii;
+
+	bad = 0;
+	for (iii = 0; iii < kSoundVoices; iii++)
+	{
+		slot = &gSlots[iii];
+		if (!slot->on)
+			continue;
+
+		voice = &gMixer.voices[iii];
+		sound = &gSounds[slot->sound];
+		length = AdpcmSamples(sound->size);
+
+		for (; slot->checked <= slot->position >> 16; slot->checked++)
+		{
+			at = slot->checked;
+			if (slot->loop)
+				expected = sound->decoded[at % length];
+			else
+				expected = (at < length) ? sound->decoded[at] : 0;
+
+			if (voice->ring[at & (kSoundRingSamples - 1)] != expected)
+				bad++;
+			(*checked)++;
+		}
+
+		slot->position += voice->step;
+	}
+
+	return bad;
+}
+
+
+/*
+//
+// This function is the driver's main loop coming round: the commands,
+// the ticks since last time, and the slots keyed off and on.
+//
+*/
+
+static void BenchMainLoop(unsigned long ticks, double *mixing)
+{
+	volatile SoundShared *shared = gSound.shared;
+	volatile SoundCommand *command;
+	MixerVoice *voice;
+	double start;
+	int iii;
+
+	start = HostNow();
+
+	while (shared->tail != shared->head)
+	{
+		command = &shared->commands[shared->tail];
+		if (command->op == kSoundPlay)
+		{
+			iii = MixerPlay(&gMixer, command->voice, command->sample, command->volume,
+				command->pan, command->flags);
+			if (iii >= 0)
+				gVoiceSound[iii] = gSampleSound[command->sample];
+		}
+		else if (command->op == kSoundStop)
+			MixerStop(&gMixer, command->voice);
+
+		shared->tail = (uint16_t)((shared->tail + 1) % kSoundCommands);
+	}
+
+	for (iii = 0; iii < kSoundVoices; iii++)
+	{
+		voice = &gMixer.voices[iii];
+		if (voice->keyOff)
+		{
+			gSlots[iii].on = 0;
+			voice->keyOff = 0;
+		}
+	}
+
+	MixerAdvance(&gMixer, ticks * kMixerTick);
+	MixerFill(&gMixer);
+
+	for (iii = 0; iii < kSoundVoices; iii++)
+	{
+		voice = &gMixer.voices[iii];
+		if (voice->keyOff)
+		{
+			gSlots[iii].on = 0;
+			voice->keyOff = 0;
+		}
+
+		if (voice->keyOn)
+		{
+			gSlots[iii].on = 1;
+			gSlots[iii].sound = gVoiceSound[iii];
+			gSlots[iii].loop = voice->loop;
+			gSlots[iii].position = 0;
+			gSlots[iii].checked = 0;
+			voice->keyOn = 0;
+		}
+	}
+
+	shared->voices = (uint16_t)MixerVoices(&gMixer);
+	*mixing += HostNow() - start;
+}
+
+
+int main(int argc, char **argv)
+{
+	const char *dirName = "../cd/NETLINK";
+	char path[1024];
+	DIR *dir;
+	struct dirent *entry;
+	NLSound wav;
+	Adpcm adpcm;
+	BenchSound *sound;
+	PackAsset asset;
+	unsigned char *data;
+	unsigned char driver[kSoundHeader + sizeof(SoundHeader)];
+	SoundHeader *header;
+	unsigned long size, totalCount, totalPCM, totalSize, checked, bad, played, ticks, now, next;
+	unsigned long pcm8, pcm16, fit, loopGap, seconds, output;
+	double start, decodeSeconds, mixing, noise, signal, totalNoise, totalSignal;
+	int repeat, verbose, failed, iii, sss;
+
+	repeat = 20;
+	seconds = 60;
+	loopGap = kMixerTick * 2;
+	verbose = 0;
+
+	for (iii = 1; iii < argc; iii++)
+	{
+		if (strcmp(argv[iii], "-v") == 0)
+			verbose = 1;
+		else if (strcmp(argv[iii], "-n") == 0 && iii + 1 < argc)
+			repeat = atoi(argv[++iii]);
+		else if (strcmp(argv[iii], "-t") == 0 && iii + 1 < argc)
+			seconds = strtoul(argv[++iii], NULL, 0);
+		else if (strcmp(argv[iii], "-l") == 0 && iii + 1 < argc)
+			loopGap = strtoul(argv[++iii], NULL, 0);
+		else if (argv[iii][0] != '-')
+			dirName = argv[iii];
+		else
+		{
+			fprintf(stderr, "usage: %s [-v] [-n REPEAT] [-t SECONDS] [-l LOOP] [DIR]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	if (repeat < 1 || loopGap < 1)
+		return 2;
+
+	dir = opendir(dirName);
+	if (dir == NULL)
+	{
+		fprintf(stderr, "soundbench: can't open %s\n", dirName);
+		return 1;
+	}
+
+	AdpcmInit();
+
+	failed = 0;
+	totalCount = 0;
+	totalPCM = 0;
+	totalSize = 0;
+	totalNoise = 0;
+	totalSignal = 0;
+
+	while ((entry = readdir(dir)) != NULL && gSoundCount < kBenchSounds)
+	{
+		if (fnmatch("*.[Ww][Aa][Vv]", entry->d_name, 0) != 0)
+			continue;
+
+		snprintf(path, sizeof(path), "%s/%s", dirName, entry->d_name);
+		data = HostLoad(path, &size);
+		if (data == NULL)
+			continue;
+
+		memset(&wav, 0, sizeof(wav));
+		if (WavRead(data, size, &wav) != NULL || wav.frames == 0)
+		{
+			free(data);
+			continue;
+		}
+
+		sound = &gSounds[gSoundCount];
+		snprintf(sound->name, sizeof(sound->name), "%s", entry->d_name);
+		if (!BenchEncode(sound, &wav, &noise, &signal))
+		{
+			printf("soundbench: %-12s doesn't decode the same in pieces\n", sound->name);
+			failed++;
+		}
+
+		if (verbose)
+			printf("soundbench: %-12s %5lu Hz %2d bits %6lu samples %6lu B PCM %6lu B ADPCM %5.1f dB\n",
+				sound->name, sound->rate, wav.bits, sound->count, sound->pcmSize, sound->size,
+				noise > 0 ? 10 * log10(signal / noise) : 99.0);
+
+		totalCount += sound->count;
+		totalPCM += sound->pcmSize;
+		totalSize += sound->size;
+		totalNoise += noise;
+		totalSignal += signal;
+		gSoundCount++;
+
+		free(wav.samples);
+		free(data);
+	}
+
+	closedir(dir);
+
+	if (gSoundCount == 0)
+	{
+		fprintf(stderr, "soundbench: no WAVs in %s\n", dirName);
+		return 1;
+	}
+
+	/* Decode rate */
+
+	start = HostNow();
+	for (iii = 0; iii < repeat; iii++)
+	{
+		for (sss = 0; sss < gSoundCount; sss++)
+		{
+			AdpcmStart(&adpcm, gSounds[sss].adpcm, gSounds[sss].size);
+			AdpcmDecode(&adpcm, gSounds[sss].decoded, AdpcmSamples(gSounds[sss].size));
+		}
+	}
+	decodeSeconds = HostNow() - start;
+
+	/* How many fit in sound RAM each way */
+
+	pcm8 = pcm16 = fit = 0;
+	for (sss = 0, size = 0; sss < gSoundCount; sss++)
+		if ((size += gSounds[sss].count) <= kSoundRAMSize - kSoundData)
+			pcm8++;
+	for (sss = 0, size = 0; sss < gSoundCount; sss++)
+		if ((size += gSounds[sss].count * 2) <= kSoundRAMSize - kSoundData)
+			pcm16++;
+
+	printf("soundbench: %d files, %lu samples, %lu B as PCM, %lu B as ADPCM, %.1f dB, %d failed\n",
+		gSoundCount, totalCount, totalPCM, totalSize,
+		totalNoise > 0 ? 10 * log10(totalSignal / totalNoise) : 99.0, failed);
+	printf("soundbench: %.1f Msamples/s decoded\n",
+		totalCount * (double)repeat / decodeSeconds / 1e6);
+
+	/* Into the pretend sound RAM, through sound.c */
+
+	memset(driver, 0, sizeof(driver));
+	header = (SoundHeader *)(driver + kSoundHeader);
+	header->magic = kSoundMagic;
+	header->size = sizeof(driver);
+	if (!SoundInit(&gSound, gRAM, driver))
+	{
+		fprintf(stderr, "soundbench: SoundInit failed\n");
+		return 1;
+	}
+
+	for (sss = 0; sss < gSoundCount; sss++)
+	{
+		sound = &gSounds[sss];
+		memset(&asset, 0, sizeof(asset));
+		asset.type = kPackSound;
+		asset.format = kPackADPCM4;
+		asset.rate = sound->rate;
+		asset.dataOffset = gArchiveSize;
+		asset.dataSize = sound->size;
+
+		memcpy(gArchive + gArchiveSize, sound->adpcm, sound->size);
+		gArchiveSize += sound->size;
+
+		sound->sample = SoundLoad(&gSound, &asset, BenchRead, NULL);
+		if (sound->sample >= 0)
+		{
+			gSampleSound[sound->sample] = sss;
+			fit++;
+		}
+	}
+
+	printf("soundbench: sound RAM holds %lu of them as ADPCM, %lu as 8-bit PCM, %lu as 16-bit PCM\n",
+		fit, pcm8, pcm16);
+
+	/* Random UI sounds through the ring, the mixer and pretend slots */
+
+	MixerInit(&gMixer, gRAM);
+	gSound.shared->magic = kSoundMagic;
+
+	srand(1);
+	checked = 0;
+	bad = 0;
+	played = 0;
+	ticks = 0;
+	mixing = 0;
+	next = 0;
+	output = seconds * kMixerOutputRate;
+
+	for (now = 0; now < output; now++)
+	{
+		if (now % kMixerTick == 0 && now > 0)
+			ticks++;
+
+		if (now == next)
+		{
+			/* A sound every tenth of a second or so; now and then one on a voice */
+			/* of its own, or a loop that's stopped later */
+
+			if (rand() % 16 == 0)
+			{
+				sss = rand() % gSoundCount;
+				if (gSounds[sss].sample >= 0)
+				{
+					iii = rand() % 8;
+					if (SoundPlay(&gSound, gSounds[sss].sample,
+						iii < 6 ? kSoundAnyVoice : iii, 255 - rand() % 64, rand() % 256,
+						iii == 7 ? kSoundLoop : 0))
+						played++;
+				}
+			}
+			if (rand() % 64 == 0)
+				SoundStop(&gSound, kSoundVoices - 1);
+
+			BenchMainLoop(ticks, &mixing);
+			ticks = 0;
+			next = now + 1 + (unsigned long)rand() % loopGap;
+		}
+
+		bad += BenchSlots(&checked);
+	}
+
+	printf("soundbench: %lu s, %lu sounds, %lu ring samples checked, %lu bad, mixer %.1f us a second\n",
+		seconds, played, checked, bad, mixing * 1e6 / seconds);
+
+	return failed != 0 || bad != 0;
+}
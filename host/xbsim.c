@@ -0,0 +1,963 @@
+/*****************************************************************
+*
+* xbsim.c
+*
+* Host stand-in for the XBAND Saturn Game Library.
+*
+* Fills the dispatch table slots that netlink.c calls through and
+* plays two copies of the game against each other: before main()
+* the process forks, the parent becomes the master and the child
+* the slave, and the two talk over an AF_UNIX socketpair that
+* stands in for the phone line.
+*
+* The line is emulated, not just passed through. Every message
+* waits XBSIM_DELAY ticks before the receiver sees it, a line with
+* XBSIM_BAUD set also takes the time to send each byte, XBLineNoise
+* corrupts outgoing packets which the receiver rejects (XBBadPacket)
+* and asks to be resent, and a silent line ends in XBTimeout. Both
+* sides check XBOpenSession parameters against each other.
+*
+* Environment:
+*	XBSIM_FRAMES	exchanges before both players exit (5000, 0 = no limit)
+*	XBSIM_DELAY		one-way line delay in ticks (0)
+*	XBSIM_BAUD		line speed in bits per second of 60 Hz ticks (0 = unlimited)
+*	XBSIM_TIMEOUT	ticks without data before XBTimeout (600)
+*	XBSIM_NOWAIT	1 = return XBNoData instead of waiting for the remote
+*	XBSIM_LOSSY		1 = don't resend bad packets; XBExchangeGameData returns
+*					XBBadPacket with only the local half of that pair
+*	XBSIM_DROPOUT	exchanges before the line goes dead for kXBSimDropTicks,
+*					losing everything sent meanwhile (0 = never)
+*	XBSIM_SEED		random seed reported by XBGetRandomSeed (1996)
+*	XBSIM_HZ		v-blank rate, see yaul.c (0 = a v-blank whenever anything waits)
+*	XBSIM_LOOPBACK	1 = don't fork: a single master plays against its own
+*					packets, with no line in between and no frame limit
+*					(the default in the benchmark build, see bench.c)
+*	XBSIM_TELEMETRY	file netlink.c appends each session's telemetry to
+*	XBSIM_RECORD	netlink.c saves its input recording to this path plus
+*					".master" or ".slave" at exit
+*	XBSIM_REPLAY	netlink.c plays such a recording back headless instead
+*					of a game, prints its speed and checksum, and exits
+*	XBSIM_DESYNC	confirmed frame on which netlink.c knocks the slave's
+*					state out of step, for the sync-sniffer (0 = never)
+*
+* When a player exits it prints its exchange count, exchanges per
+* second of wall time, the wall-clock cost of XBExchangeGameData
+* and the XBInfo counters.
+*
+*****************************************************************/
+
+#include <yaul.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#include "XBand/XBANDLIB.H"
+#include "xbsim.h"
+
+#define	kXBSimTableSize		32
+#define	kXBSimMaxPacket		16
+#define	kXBSimQueueSize		32	/* packets kept for pairing and resending */
+#define	kXBSimLineSize		64	/* messages crossing the line at once */
+#define	kXBSimPings			4
+#define	kXBSimFraming		4	/* bytes on the line around each message */
+#define	kXBSimTickRate		60	/* XBVBLTask calls per second */
+#define	kXBSimDropTicks		30	/* how long XBSIM_DROPOUT lasts */
+
+/* remoteValid[] */
+
+enum
+{
+	kXBSimEmpty = 0,
+	kXBSimArrived,
+	kXBSimLost
+};
+
+unsigned long gXBSimDispatchTable[kXBSimTableSize];
+
+/* Messages on the simulated line */
+
+enum
+{
+	kXBSimData = 1,
+	kXBSimNak,
+	kXBSimOpen,
+	kXBSimClose,
+	kXBSimPing,
+	kXBSimPong
+};
+
+typedef struct
+{
+	unsigned char	type;
+	unsigned char	size;
+	unsigned short	delay;		/* extra ticks on the line (resent packets) */
+	unsigned short	check;
+	unsigned short	rate;
+	unsigned long	epoch;		/* which session this belongs to */
+	unsigned long	seq;
+	unsigned char	data[kXBSimMaxPacket];
+} XBSimMessage;
+
+typedef struct
+{
+	XBSimMessage	msg;
+	unsigned long	readyAt;
+} XBSimInFlight;
+
+typedef struct
+{
+	unsigned char	data[kXBSimMaxPacket];
+} XBSimPacket;
+
+typedef struct
+{
+	int				fd;
+	int				isMaster;
+	pid_t			child;
+	unsigned long	seed;
+	long			frameLimit;
+	long			lineDelay;
+	long			baud;
+	long			timeout;
+	int				noWait;
+	int				lossy;
+	int				loopback;
+	int				noTimer;
+	unsigned long	dropAt;			/* XBSIM_DROPOUT */
+	unsigned long	dropUntil;		/* the line is dead until this tick */
+
+	volatile unsigned long ticks;	/* advanced by XBVBLTask */
+
+	XBErrorCallback	errorCallback;
+	XBInfo			info;
+	XBErr			gameResult;
+	int				gameReported;
+
+	/* line */
+	XBSimInFlight	line[kXBSimLineSize];
+	int				lineHead;
+	int				lineCount;
+	int				hungUp;
+	unsigned long long lineFree;	/* when the line is free, in ticks * baud */
+
+	/* noise from XBLineNoise: packets left, percent, recovery ticks */
+	int				noisePackets;
+	int				noisePercent;
+	int				noiseRecovery;
+	unsigned long	noiseSeed;
+
+	/* session */
+	int				sessionOpen;
+	unsigned long	epoch;
+	int				packetSize;
+	int				ticksPerFrame;
+	unsigned long	lastExchangeTick;
+	int				peerOpen;
+	int				peerOpenSize;
+	int				peerOpenRate;
+	int				peerClosed;
+	unsigned long	peerFlushSeq;	/* pairs the peer handed back before leaving */
+	unsigned long	pongTick;
+	int				pongSeen;
+
+	unsigned long	sendSeq;		/* next local packet */
+	unsigned long	pairSeq;		/* next local/remote pair to hand back */
+	XBSimPacket		sent[kXBSimQueueSize];
+	XBSimPacket		remote[kXBSimQueueSize];
+	unsigned char	remoteValid[kXBSimQueueSize];
+
+	/* measurements */
+	unsigned long	exchanges;
+	double			exchangeTotal;
+	double			exchangeMin;
+	double			exchangeMax;
+	double			runStart;
+} XBSimState;
+
+static XBSimState gSim;
+
+
+/*
+//
+// Small helpers.
+//
+*/
+
+static double XBSimNow(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static unsigned short XBSimCheck(const unsigned char *data, int size)
+{
+	unsigned sum1 = 0, sum2 = 0;
+	int i;
+
+	/* Fletcher-16 */
+	for (i = 0; i < size; i++)
+	{
+		sum1 = (sum1 + data[i]) % 255;
+		sum2 = (sum2 + sum1) % 255;
+	}
+	return (unsigned short)((sum2 << 8) | sum1);
+}
+
+static void XBSimReportError(XBErr err)
+{
+	if (gSim.errorCallback != NULL)
+		gSim.errorCallback(err);
+}
+
+static void XBSimSend(XBSimMessage *msg)
+{
+	ssize_t n;
+
+	if ((long)(gSim.ticks - gSim.dropUntil) < 0)
+		return;
+
+	do
+	{
+		n = send(gSim.fd, msg, sizeof(*msg), MSG_NOSIGNAL);
+	} while (n < 0 && errno == EINTR);
+
+	if (n < 0)
+		gSim.hungUp = 1;
+	else
+		gSim.info.bytesWrittenCount += (msg->type == kXBSimData) ? msg->size : 0;
+}
+
+static void XBSimSendControl(int type, unsigned long seq)
+{
+	XBSimMessage msg;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.type = (unsigned char)type;
+	msg.epoch = gSim.epoch;
+	msg.seq = seq;
+	XBSimSend(&msg);
+}
+
+
+/*
+//
+// This function puts a game data packet on the line, corrupting it
+// if XBLineNoise is still in effect.
+//
+*/
+
+static void XBSimSendData(unsigned long seq, unsigned short delay)
+{
+	XBSimMessage msg;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.type = kXBSimData;
+	msg.size = (unsigned char)gSim.packetSize;
+	msg.delay = delay;
+	msg.epoch = gSim.epoch;
+	msg.seq = seq;
+	memcpy(msg.data, gSim.sent[seq % kXBSimQueueSize].data, gSim.packetSize);
+	msg.check = XBSimCheck(msg.data, gSim.packetSize);
+
+	if (gSim.noisePackets > 0)
+	{
+		gSim.noisePackets--;
+		gSim.noiseSeed = gSim.noiseSeed * 1103515245UL + 12345UL;
+		if ((long)((gSim.noiseSeed >> 16) % 100) < gSim.noisePercent)
+			msg.data[(gSim.noiseSeed >> 8) % gSim.packetSize] ^= 1 << ((gSim.noiseSeed >> 4) & 7);
+	}
+
+	XBSimSend(&msg);
+	gSim.info.packetCount++;
+}
+
+
+/*
+//
+// This function handles a message once it has crossed the line.
+//
+*/
+
+static void XBSimReceive(const XBSimMessage *msg)
+{
+	unsigned long slot;
+
+	switch (msg->type)
+	{
+		case kXBSimData:
+			if (!gSim.sessionOpen || msg->epoch != gSim.epoch)
+				break;	/* left over from an earlier session */
+
+			gSim.info.bytesReadCount += msg->size;
+
+			if (msg->size != gSim.packetSize
+				|| XBSimCheck(msg->data, msg->size) != msg->check)
+			{
+				gSim.info.badPacketCount++;
+				gSim.info.errorRecoveriesCount++;
+				XBSimReportError(XBBadPacket);
+
+				if (!gSim.lossy)
+					XBSimSendControl(kXBSimNak, msg->seq);
+				else if (msg->seq >= gSim.pairSeq && msg->seq < gSim.pairSeq + kXBSimQueueSize)
+					gSim.remoteValid[msg->seq % kXBSimQueueSize] = kXBSimLost;
+				break;
+			}
+
+			if (msg->seq < gSim.pairSeq || msg->seq >= gSim.pairSeq + kXBSimQueueSize)
+				break;	/* duplicate or too far ahead */
+
+			slot = msg->seq % kXBSimQueueSize;
+			memcpy(gSim.remote[slot].data, msg->data, msg->size);
+			gSim.remoteValid[slot] = kXBSimArrived;
+			break;
+
+		case kXBSimNak:
+			/* still owed after a close, until the next session opens */
+			if (msg->epoch == gSim.epoch
+				&& msg->seq < gSim.sendSeq && gSim.sendSeq - msg->seq <= kXBSimQueueSize)
+				XBSimSendData(msg->seq, (unsigned short)gSim.noiseRecovery);
+			break;
+
+		case kXBSimOpen:
+			gSim.peerOpen = 1;
+			gSim.peerOpenSize = msg->size;
+			gSim.peerOpenRate = msg->rate;
+			gSim.peerFlushSeq = (msg->epoch == gSim.epoch + 1) ? msg->seq : 0;
+			break;
+
+		case kXBSimClose:
+			if (gSim.sessionOpen && msg->epoch == gSim.epoch)
+			{
+				gSim.peerClosed = 1;
+				gSim.peerFlushSeq = msg->seq;
+			}
+			break;
+
+		case kXBSimPing:
+			XBSimSendControl(kXBSimPong, msg->seq);
+			break;
+
+		case kXBSimPong:
+			gSim.pongTick = msg->seq;
+			gSim.pongSeen = 1;
+			break;
+
+		default:
+			break;
+	}
+}
+
+
+/*
+//
+// This function works out when a message is through a line of
+// XBSIM_BAUD bits per second. Messages go one after the other, ten
+// bits to the byte.
+//
+*/
+
+static unsigned long XBSimLineTime(const XBSimMessage *msg, unsigned long readyAt)
+{
+	unsigned long long start, bits;
+
+	bits = (unsigned long long)(kXBSimFraming + (msg->type == kXBSimData ? msg->size : 0)) * 10;
+
+	start = (unsigned long long)gSim.ticks * gSim.baud;
+	if (gSim.lineFree > start)
+		start = gSim.lineFree;
+	gSim.lineFree = start + bits * kXBSimTickRate;
+
+	start = (gSim.lineFree + gSim.baud - 1) / gSim.baud;
+	return (start > readyAt) ? (unsigned long)start : readyAt;
+}
+
+
+/*
+//
+// This function moves messages from the socket onto the delay line
+// and hands over the ones that have arrived.
+//
+*/
+
+static void XBSimPump(void)
+{
+	XBSimInFlight *slot;
+	ssize_t n;
+
+	while (!gSim.hungUp && gSim.lineCount < kXBSimLineSize)
+	{
+		slot = &gSim.line[(gSim.lineHead + gSim.lineCount) % kXBSimLineSize];
+		n = recv(gSim.fd, &slot->msg, sizeof(slot->msg), MSG_DONTWAIT);
+		if (n == (ssize_t)sizeof(slot->msg))
+		{
+			slot->readyAt = gSim.ticks + gSim.lineDelay + slot->msg.delay;
+			if (gSim.baud > 0)
+				slot->readyAt = XBSimLineTime(&slot->msg, slot->readyAt);
+			gSim.lineCount++;
+		}
+		else if (n == 0)
+			gSim.hungUp = 1;
+		else if (n < 0 && errno == EINTR)
+			continue;
+		else
+			break;
+	}
+
+	while (gSim.lineCount > 0)
+	{
+		slot = &gSim.line[gSim.lineHead];
+		if ((long)(gSim.ticks - slot->readyAt) < 0)
+			break;
+		gSim.lineHead = (gSim.lineHead + 1) % kXBSimLineSize;
+		gSim.lineCount--;
+		XBSimReceive(&slot->msg);
+	}
+}
+
+
+/*
+//
+// This function sleeps until the next tick or the next message.
+//
+*/
+
+static void XBSimIdle(void)
+{
+	struct pollfd pfd;
+
+	pfd.fd = gSim.fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	poll(&pfd, (gSim.lineCount < kXBSimLineSize && !gSim.hungUp) ? 1 : 0, 1);
+
+	/* Without the v-blank timer, time only moves when we wait */
+
+	if (gSim.noTimer)
+		cpu_instr_sleep();
+}
+
+static int XBSimLineDead(void)
+{
+	return gSim.hungUp && gSim.lineCount == 0;
+}
+
+
+/*
+//
+// Dispatch table entries.
+//
+*/
+
+static int XBSimDebugInit(void)
+{
+	return 0;	/* XOS is "present": we are always a network game */
+}
+
+static void XBSimMakeRole(const char *phoneNumber __unused)
+{
+}
+
+static void XBSimMakeLocalGame(void)
+{
+}
+
+static void XBSimLineNoise(int packets, int percent, int recoveryTicks)
+{
+	gSim.noisePackets = packets;
+	gSim.noisePercent = percent;
+	gSim.noiseRecovery = recoveryTicks;
+}
+
+static XBGameType XBSimInitXBAND(void)
+{
+	return XBNetworkGame;
+}
+
+static void XBSimVBLTask(void)
+{
+	gSim.ticks++;
+}
+
+static void XBSimSetErrorCallback(XBErrorCallback callback)
+{
+	gSim.errorCallback = callback;
+}
+
+static const XBInfo *XBSimGetInfo(void)
+{
+	return &gSim.info;
+}
+
+static const char *XBSimMasterPlayerName(void)
+{
+	return "Sim Master";
+}
+
+static const char *XBSimSlavePlayerName(void)
+{
+	return "Sim Slave";
+}
+
+static const char *XBSimLocalPlayerName(void)
+{
+	return gSim.isMaster ? XBSimMasterPlayerName() : XBSimSlavePlayerName();
+}
+
+static const char *XBSimRemotePlayerName(void)
+{
+	return gSim.isMaster ? XBSimSlavePlayerName() : XBSimMasterPlayerName();
+}
+
+static int XBSimLocalIsMaster(void)
+{
+	return gSim.isMaster;
+}
+
+static unsigned long XBSimGetRandomSeed(void)
+{
+	return gSim.seed;
+}
+
+static int XBSimAllowReturnToXOS(void)
+{
+	return 1;
+}
+
+static void XBSimHangupModem(void)
+{
+	if (gSim.fd >= 0)
+		shutdown(gSim.fd, SHUT_RDWR);
+}
+
+static void XBSimNetworkGameResult(XBGameResults *results __unused, XBErr err)
+{
+	gSim.gameResult = err;
+	gSim.gameReported = 1;
+}
+
+static void XBSimReadyToExit(void)
+{
+}
+
+
+/*
+//
+// On the loopback line there is nobody to agree with and no round
+// trip to measure.
+//
+*/
+
+static XBErr XBSimOpenLoopback(int gameDataSize, int ticksPerFrame)
+{
+	if (gameDataSize < 1 || gameDataSize > kXBSimMaxPacket)
+		return XBMismatchedPacketSizes;
+
+	gSim.epoch++;
+	gSim.packetSize = gameDataSize;
+	gSim.ticksPerFrame = ticksPerFrame;
+	gSim.sessionOpen = 1;
+	gSim.info.roundTripLatency = 0;
+	gSim.info.packetSize = (unsigned short)gameDataSize;
+	gSim.info.gameDataQueueSize = 0;
+
+	return XBNoErr;
+}
+
+
+/*
+//
+// XBOpenSession: agree on packet size and rate with the other side,
+// then measure the round trip.
+//
+*/
+
+static XBErr XBSimOpenSession(int gameDataSize, int ticksPerFrame)
+{
+	XBSimMessage msg;
+	unsigned long start, total;
+	int i;
+
+	gSim.sessionOpen = 0;
+	gSim.peerClosed = 0;
+
+	if (gSim.loopback)
+		return XBSimOpenLoopback(gameDataSize, ticksPerFrame);
+
+	memset(&msg, 0, sizeof(msg));
+	msg.type = kXBSimOpen;
+	msg.size = (unsigned char)gameDataSize;
+	msg.rate = (unsigned short)ticksPerFrame;
+	msg.epoch = gSim.epoch + 1;
+	msg.seq = gSim.pairSeq;
+	XBSimSend(&msg);
+
+	start = gSim.ticks;
+	while (!gSim.peerOpen)
+	{
+		XBSimPump();
+		if (gSim.peerOpen)
+			break;
+		if (XBSimLineDead())
+			return XBConnectionLost;
+		if (gSim.ticks - start > (unsigned long)gSim.timeout)
+			return XBTimeout;
+		XBSimIdle();
+	}
+
+	gSim.peerOpen = 0;
+	gSim.epoch++;
+
+	if (gSim.peerOpenSize != gameDataSize)
+		return XBMismatchedPacketSizes;
+	if (gSim.peerOpenRate != ticksPerFrame)
+		return XBMismatchedExchangeRate;
+	if (gameDataSize < 1 || gameDataSize > kXBSimMaxPacket)
+		return XBMismatchedPacketSizes;
+
+	gSim.packetSize = gameDataSize;
+	gSim.ticksPerFrame = ticksPerFrame;
+	gSim.sendSeq = 0;
+	gSim.pairSeq = 0;
+	memset(gSim.remoteValid, 0, sizeof(gSim.remoteValid));
+	gSim.sessionOpen = 1;
+
+	/* Measure line connection quality */
+
+	total = 0;
+	for (i = 0; i < kXBSimPings; i++)
+	{
+		gSim.pongSeen = 0;
+		XBSimSendControl(kXBSimPing, gSim.ticks);
+		start = gSim.ticks;
+		while (!gSim.pongSeen)
+		{
+			XBSimPump();
+			if (gSim.pongSeen)
+				break;
+			if (XBSimLineDead())
+				return XBConnectionLost;
+			if (gSim.ticks - start > (unsigned long)gSim.timeout)
+				return XBTimeout;
+			XBSimIdle();
+		}
+		total += gSim.ticks - gSim.pongTick;
+	}
+
+	gSim.info.roundTripLatency = (unsigned short)((total + kXBSimPings / 2) / kXBSimPings);
+	gSim.info.packetSize = (unsigned short)gameDataSize;
+	gSim.info.gameDataQueueSize = 0;
+	gSim.lastExchangeTick = gSim.ticks - ticksPerFrame;
+
+	return XBNoErr;
+}
+
+static XBErr XBSimCloseSession(void)
+{
+	if (gSim.sessionOpen && !gSim.loopback)
+		XBSimSendControl(kXBSimClose, gSim.pairSeq);
+	gSim.sessionOpen = 0;
+	return XBNoErr;
+}
+
+
+static void XBSimQueueLocal(const void *local)
+{
+	memcpy(gSim.sent[gSim.sendSeq % kXBSimQueueSize].data, local, gSim.packetSize);
+	XBSimSendData(gSim.sendSeq++, 0);
+	gSim.lastExchangeTick = gSim.ticks;
+}
+
+
+/*
+//
+// Once the peer has closed or reopened, the pairs it already handed
+// back must still be handed back here, then the session is over.
+//
+*/
+
+static int XBSimPeerLeft(void)
+{
+	return gSim.peerOpen || gSim.peerClosed;
+}
+
+static int XBSimSessionDrained(void)
+{
+	return XBSimPeerLeft() && gSim.pairSeq >= gSim.peerFlushSeq;
+}
+
+
+/*
+//
+// XBExchangeGameData: send the local packet and hand back the oldest
+// master/slave pair once the remote half of it has arrived.
+//
+*/
+
+static XBErr XBSimExchange(const void *local, void *master, void *slave)
+{
+	double callStart, elapsed;
+	unsigned long waitStart, slot;
+	int reported, sent, lost;
+	void *localOut, *remoteOut;
+
+	callStart = XBSimNow();
+
+	if (!gSim.sessionOpen)
+		return XBSessionClosed;
+
+	/* The loopback line hands our packet back as both halves at once */
+
+	if (gSim.loopback)
+	{
+		memcpy(master, local, gSim.packetSize);
+		memcpy(slave, local, gSim.packetSize);
+		gSim.info.packetCount++;
+		gSim.info.bytesWrittenCount += gSim.packetSize;
+		gSim.info.bytesReadCount += gSim.packetSize;
+		gSim.exchanges++;
+		return XBNoErr;
+	}
+
+	/* Called too early: wait, as the real library does */
+
+	while (gSim.ticks - gSim.lastExchangeTick < (unsigned long)gSim.ticksPerFrame)
+	{
+		XBSimPump();
+		if (XBSimPeerLeft())
+			break;
+		XBSimIdle();
+	}
+
+	if (XBSimSessionDrained())
+	{
+		gSim.sessionOpen = 0;
+		return XBSessionClosed;
+	}
+
+	/* With the queue full the local packet waits for the oldest pair */
+
+	sent = !XBSimPeerLeft() && (gSim.sendSeq - gSim.pairSeq < kXBSimQueueSize);
+	if (sent)
+		XBSimQueueLocal(local);
+
+	slot = gSim.pairSeq % kXBSimQueueSize;
+	waitStart = gSim.ticks;
+	reported = 0;
+
+	while (1)
+	{
+		XBSimPump();
+
+		if (gSim.remoteValid[slot])
+			break;
+
+		if (XBSimSessionDrained())
+		{
+			gSim.sessionOpen = 0;
+			return XBSessionClosed;
+		}
+
+		if (XBSimLineDead())
+			return XBConnectionLost;
+
+		if (gSim.noWait && sent)
+		{
+			gSim.info.noDataCount++;
+			gSim.info.gameDataQueueSize = (unsigned short)(gSim.sendSeq - gSim.pairSeq);
+			return (gSim.pairSeq == 0) ? XBRemoteDataInTransit : XBNoData;
+		}
+
+		if (!reported && gSim.ticks - waitStart > 1)
+		{
+			reported = 1;
+			gSim.info.noDataCount++;
+			XBSimReportError((gSim.pairSeq == 0) ? XBRemoteDataInTransit : XBNoData);
+		}
+
+		if (gSim.ticks - waitStart > (unsigned long)gSim.timeout)
+			return XBTimeout;
+
+		XBSimIdle();
+	}
+
+	if (gSim.isMaster)
+	{
+		localOut = master;
+		remoteOut = slave;
+	}
+	else
+	{
+		localOut = slave;
+		remoteOut = master;
+	}
+
+	lost = (gSim.remoteValid[slot] == kXBSimLost);
+
+	memcpy(localOut, gSim.sent[slot].data, gSim.packetSize);
+	if (!lost)
+		memcpy(remoteOut, gSim.remote[slot].data, gSim.packetSize);
+	gSim.remoteValid[slot] = kXBSimEmpty;
+	gSim.pairSeq++;
+
+	if (!sent && !XBSimPeerLeft())
+		XBSimQueueLocal(local);
+	gSim.info.gameDataQueueSize = (unsigned short)(gSim.sendSeq - gSim.pairSeq);
+
+	if (reported)
+		XBSimReportError(XBNoErr);
+
+	elapsed = XBSimNow() - callStart;
+	gSim.exchangeTotal += elapsed;
+	if (gSim.exchanges == 0 || elapsed < gSim.exchangeMin)
+		gSim.exchangeMin = elapsed;
+	if (elapsed > gSim.exchangeMax)
+		gSim.exchangeMax = elapsed;
+
+	if (++gSim.exchanges == (unsigned long)gSim.frameLimit)
+		exit(0);
+
+	if (gSim.exchanges == gSim.dropAt)
+		gSim.dropUntil = gSim.ticks + kXBSimDropTicks;
+
+	return lost ? XBBadPacket : XBNoErr;
+}
+
+
+/*
+//
+// This function prints what happened on this side of the line.
+//
+*/
+
+static void XBSimReport(void)
+{
+	struct itimerval off;
+	double wall;
+	int status;
+
+	memset(&off, 0, sizeof(off));
+	setitimer(ITIMER_REAL, &off, NULL);
+
+	wall = XBSimNow() - gSim.runStart;
+
+	printf("[%s] %lu exchanges in %.3f s (%.0f/s), %lu ticks\n",
+		gSim.isMaster ? "master" : "slave ", gSim.exchanges, wall,
+		wall > 0 ? gSim.exchanges / wall : 0.0, gSim.ticks);
+	printf("[%s] XBExchangeGameData avg %.2f us, min %.2f us, max %.2f us\n",
+		gSim.isMaster ? "master" : "slave ",
+		gSim.exchanges ? gSim.exchangeTotal * 1e6 / gSim.exchanges : 0.0,
+		gSim.exchangeMin * 1e6, gSim.exchangeMax * 1e6);
+	printf("[%s] packets %lu, read %lu B, written %lu B, rtt %u ticks, queue %u\n",
+		gSim.isMaster ? "master" : "slave ", gSim.info.packetCount,
+		gSim.info.bytesReadCount, gSim.info.bytesWrittenCount,
+		gSim.info.roundTripLatency, gSim.info.gameDataQueueSize);
+	printf("[%s] bad packets %u, no data %u, recoveries %u",
+		gSim.isMaster ? "master" : "slave ", gSim.info.badPacketCount,
+		gSim.info.noDataCount, gSim.info.errorRecoveriesCount);
+	if (gSim.gameReported)
+		printf(", game %s (%d)", gSim.gameResult == XBNoErr ? "over" : "error", gSim.gameResult);
+	printf("\n");
+	fflush(stdout);
+
+	if (gSim.fd >= 0)
+		close(gSim.fd);
+
+	if (gSim.child > 0)
+		waitpid(gSim.child, &status, 0);
+}
+
+
+/*
+//
+// This function fills the dispatch table and forks the slave.
+//
+*/
+
+static void __attribute__ ((constructor (kXBSimForkPriority))) XBSimStart(void)
+{
+	int fds[2];
+	pid_t pid;
+
+	gXBSimDispatchTable[1] = (unsigned long)XBSimDebugInit;
+	gXBSimDispatchTable[2] = (unsigned long)XBSimMakeRole;
+	gXBSimDispatchTable[4] = (unsigned long)XBSimLineNoise;
+	gXBSimDispatchTable[5] = (unsigned long)XBSimMakeLocalGame;
+	gXBSimDispatchTable[7] = (unsigned long)XBSimExchange;
+	gXBSimDispatchTable[8] = (unsigned long)XBSimGetInfo;
+	gXBSimDispatchTable[9] = (unsigned long)XBSimInitXBAND;
+	gXBSimDispatchTable[10] = (unsigned long)XBSimMasterPlayerName;
+	gXBSimDispatchTable[11] = (unsigned long)XBSimSlavePlayerName;
+	gXBSimDispatchTable[12] = (unsigned long)XBSimLocalPlayerName;
+	gXBSimDispatchTable[13] = (unsigned long)XBSimRemotePlayerName;
+	gXBSimDispatchTable[14] = (unsigned long)XBSimLocalIsMaster;
+	gXBSimDispatchTable[15] = (unsigned long)XBSimCloseSession;
+	gXBSimDispatchTable[16] = (unsigned long)XBSimGetRandomSeed;
+	gXBSimDispatchTable[18] = (unsigned long)XBSimNetworkGameResult;
+	gXBSimDispatchTable[19] = (unsigned long)XBSimSetErrorCallback;
+	gXBSimDispatchTable[23] = (unsigned long)XBSimVBLTask;
+	gXBSimDispatchTable[24] = (unsigned long)XBSimAllowReturnToXOS;
+	gXBSimDispatchTable[28] = (unsigned long)XBSimOpenSession;
+	gXBSimDispatchTable[29] = (unsigned long)XBSimHangupModem;
+	gXBSimDispatchTable[30] = (unsigned long)XBSimReadyToExit;
+
+	gSim.frameLimit = XBSimEnv("XBSIM_FRAMES", 5000);
+	gSim.lineDelay = XBSimEnv("XBSIM_DELAY", 0);
+	gSim.baud = XBSimEnv("XBSIM_BAUD", 0);
+	gSim.timeout = XBSimEnv("XBSIM_TIMEOUT", 600);
+	gSim.noWait = (int)XBSimEnv("XBSIM_NOWAIT", 0);
+	gSim.lossy = (int)XBSimEnv("XBSIM_LOSSY", 0);
+	gSim.dropAt = (unsigned long)XBSimEnv("XBSIM_DROPOUT", 0);
+	gSim.seed = (unsigned long)XBSimEnv("XBSIM_SEED", 1996);
+	gSim.loopback = (int)XBSimEnv("XBSIM_LOOPBACK", kXBSimDefaultLoopback);
+	gSim.noTimer = (XBSimEnv("XBSIM_HZ", kXBSimDefaultHz) <= 0);
+
+	if (gSim.loopback)
+	{
+		gSim.isMaster = 1;
+		gSim.fd = -1;
+		YaulSimSetPadSeed(gSim.seed * 3);
+
+		gSim.runStart = XBSimNow();
+		atexit(XBSimReport);
+		return;
+	}
+
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) != 0)
+	{
+		perror("xbsim: socketpair");
+		exit(1);
+	}
+
+	fflush(stdout);
+	fflush(stderr);
+
+	pid = fork();
+	if (pid < 0)
+	{
+		perror("xbsim: fork");
+		exit(1);
+	}
+
+	gSim.isMaster = (pid != 0);
+	gSim.child = pid;
+	gSim.fd = gSim.isMaster ? fds[0] : fds[1];
+	close(gSim.isMaster ? fds[1] : fds[0]);
+
+	gSim.noiseSeed = gSim.seed ^ (gSim.isMaster ? 0x1234UL : 0x4321UL);
+	gXBSimEchoAllowed = gSim.isMaster;
+	YaulSimSetPadSeed(gSim.seed * (gSim.isMaster ? 3 : 7));
+
+	gSim.runStart = XBSimNow();
+	atexit(XBSimReport);
+}
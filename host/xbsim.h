@@ -0,0 +1,49 @@
+/*****************************************************************
+*
+* xbsim.h
+*
+* Hooks shared by the host stand-ins for the XBAND library
+* (xbsim.c) and libyaul (yaul.c).
+*
+*****************************************************************/
+
+
+#ifndef __XBSIM__
+#define	__XBSIM__
+
+/* Constructor priorities: fork the two players first, then start v-blank */
+
+#define	kXBSimForkPriority		101
+#define	kXBSimVblankPriority	102
+#define	kXBSimBenchPriority		103
+
+/* The benchmark build (NETLINK_BENCH) plays against itself over a */
+/* loopback line and never waits for real time */
+
+#ifdef NETLINK_BENCH
+#define	kXBSimDefaultLoopback	1
+#define	kXBSimDefaultHz			0
+#else
+#define	kXBSimDefaultLoopback	0
+#define	kXBSimDefaultHz			6000
+#endif
+
+/* Reads an integer from the environment, or returns fallback */
+
+long XBSimEnv(const char *name, long fallback);
+
+/* Seeds the scripted joypads; called once per player after the fork */
+
+void YaulSimSetPadSeed(unsigned long seed);
+
+/* Plays pads[] over and over on both ports instead of the random */
+/* script. pads[] must outlive the run. */
+
+void YaulSimSetPadScript(const unsigned short *pads, int count);
+
+/* Non-zero in the process whose dbgio output may be echoed */
+
+extern int gXBSimEchoAllowed;
+
+
+#endif	/* __XBSIM__ */
@@ -0,0 +1,486 @@
+/*****************************************************************
+*
+* yaul.c
+*
+* Host stand-in for libyaul, see yaul.h.
+*
+* V-blank out is a SIGALRM interval timer running at XBSIM_HZ
+* (default 6000, one hundred times real time), so the waits
+* on gTimer in netlink.c behave as they do on the Saturn. With
+* XBSIM_HZ=0 there is no timer: every wait for an interrupt is
+* answered by a v-blank on the spot, so nothing waits for real time.
+* The joypads replay a seeded pseudo-random script limited to the
+* buttons in XBSIM_PADMASK (hex, default A|B), or a fixed script
+* set with YaulSimSetPadScript.
+*
+*****************************************************************/
+
+#include <yaul.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "xbsim.h"
+
+extern void user_init(void);
+
+static void (*gVblankOutCallback)(void *);
+static void *gVblankOutWork;
+static volatile unsigned long gVblankCount;
+
+static unsigned long gPadSeed[2];
+static unsigned gPadMask;
+static const unsigned short *gPadScript;
+static int gPadScriptCount;
+static int gPadScriptIndex;
+static int gNoTimer;
+static int gEcho;
+static unsigned gFrtShift;
+
+int gXBSimEchoAllowed = 1;
+
+
+/*
+//
+// This function reads a number from the environment.
+//
+*/
+
+long XBSimEnv(const char *name, long fallback)
+{
+	const char *value;
+
+	value = getenv(name);
+	if (value == NULL || *value == '\0')
+		return fallback;
+
+	return strtol(value, NULL, 0);
+}
+
+
+/*
+//
+// This function is the v-blank "interrupt".
+//
+*/
+
+static void YaulSimVblank(int sig __unused)
+{
+	gVblankCount++;
+
+	if (gVblankOutCallback != NULL)
+		gVblankOutCallback(gVblankOutWork);
+}
+
+
+/*
+//
+// This function starts v-blank and runs user_init, as the yaul
+// start-up code does before main.
+//
+*/
+
+static void __attribute__ ((constructor (kXBSimVblankPriority))) YaulSimStart(void)
+{
+	struct sigaction action;
+	struct itimerval timer;
+	long hz;
+
+	hz = XBSimEnv("XBSIM_HZ", kXBSimDefaultHz);
+
+	gPadMask = (unsigned)XBSimEnv("XBSIM_PADMASK", (1 << 10) | (1 << 8));
+	gEcho = (int)XBSimEnv("XBSIM_ECHO", 0);
+
+	if (hz <= 0)
+	{
+		gNoTimer = 1;
+		user_init();
+		return;
+	}
+
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = YaulSimVblank;
+	action.sa_flags = SA_RESTART;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGALRM, &action, NULL);
+
+	timer.it_interval.tv_sec = 0;
+	timer.it_interval.tv_usec = 1000000 / hz;
+	if (timer.it_interval.tv_usec == 0)
+		timer.it_interval.tv_usec = 1;
+	timer.it_value = timer.it_interval;
+	setitimer(ITIMER_REAL, &timer, NULL);
+
+	user_init();
+}
+
+
+/* CPU */
+
+/*
+//
+// The interrupt mask blocks SIGALRM for the master thread, which is
+// the only one that takes v-blank.
+//
+*/
+
+static uint8_t gIntcMask;
+
+static void YaulSimMask(uint8_t mask, sigset_t *old)
+{
+	sigset_t block;
+
+	sigemptyset(&block);
+	sigaddset(&block, SIGALRM);
+	pthread_sigmask(mask ? SIG_BLOCK : SIG_UNBLOCK, &block, old);
+}
+
+uint8_t cpu_intc_mask_get(void)
+{
+	return gIntcMask;
+}
+
+void cpu_intc_mask_set(uint8_t mask)
+{
+	gIntcMask = mask;
+	YaulSimMask(mask, NULL);
+}
+
+
+/*
+//
+// SLEEP waits for the next interrupt, which here is any signal, or
+// without the timer, is the v-blank it takes right away.
+//
+*/
+
+void cpu_instr_sleep(void)
+{
+	if (gNoTimer)
+		YaulSimVblank(SIGALRM);
+	else
+		pause();
+}
+
+void YaulSimSleepUnmasking(uint8_t mask)
+{
+	sigset_t masked;
+
+	gIntcMask = mask;
+
+	if (gNoTimer)
+	{
+		YaulSimVblank(SIGALRM);
+		return;
+	}
+
+	/* sigsuspend unblocks and waits in one step */
+
+	YaulSimMask(1, &masked);
+	if (mask == 0)
+		sigdelset(&masked, SIGALRM);
+	sigsuspend(&masked);
+	YaulSimMask(mask, NULL);
+}
+
+
+/*
+//
+// The FRT counts the SH-2 clock (26.8465 MHz) divided by 8, 32 or
+// 128, in real time; with XBSIM_HZ above 60 a frame is shorter in
+// counts, but idle percentages come out the same. The WDT counts the
+// same clock divided by 2, and its interrupt is never taken.
+//
+*/
+
+static uint64_t YaulSimClocks(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 26846500ULL + (uint64_t)now.tv_nsec * 268465ULL / 10000000ULL;
+}
+
+void cpu_frt_init(uint8_t clock_div)
+{
+	gFrtShift = 3 + 2 * (clock_div & 3);
+}
+
+uint16_t cpu_frt_count_get(void)
+{
+	return (uint16_t)(YaulSimClocks() >> gFrtShift);
+}
+
+void cpu_intc_priority_set(uint8_t vector __unused, uint8_t priority __unused)
+{
+}
+
+void cpu_wdt_init(uint8_t clock_div __unused)
+{
+}
+
+void cpu_wdt_timer_mode_set(uint8_t mode __unused, void (*handler)(void) __unused)
+{
+}
+
+void cpu_wdt_enable(void)
+{
+}
+
+uint8_t cpu_wdt_count_get(void)
+{
+	return (uint8_t)(YaulSimClocks() >> 1);
+}
+
+
+/*
+//
+// The slave SH-2 is a thread that waits for a notify and then calls
+// the entry, like yaul's polling mode. It never takes v-blank.
+//
+*/
+
+static pthread_t gSlaveThread;
+static int gSlaveStarted;
+static sem_t gSlaveWake;		/* sem_post is safe in the v-blank handler */
+static void (*volatile gSlaveEntry)(void);
+
+static void *YaulSimSlave(void *arg __unused)
+{
+	int value;
+
+	for (;;)
+	{
+		while (sem_wait(&gSlaveWake) != 0)
+			;
+
+		/* Notifies while busy are one flag, as on the Saturn */
+
+		while (sem_getvalue(&gSlaveWake, &value) == 0 && value > 0)
+			sem_trywait(&gSlaveWake);
+
+		if (gSlaveEntry != NULL)
+			gSlaveEntry();
+	}
+
+	return NULL;
+}
+
+void cpu_cache_purge(void)
+{
+	__sync_synchronize();
+}
+
+void cpu_dual_comm_mode_set(uint8_t mode __unused)
+{
+}
+
+void cpu_dual_slave_set(void (*entry)(void))
+{
+	sigset_t block, old;
+
+	gSlaveEntry = entry;
+	if (gSlaveStarted)
+		return;
+
+	sem_init(&gSlaveWake, 0, 0);
+	sigemptyset(&block);
+	sigaddset(&block, SIGALRM);
+	pthread_sigmask(SIG_BLOCK, &block, &old);
+	gSlaveStarted = (pthread_create(&gSlaveThread, NULL, YaulSimSlave, NULL) == 0);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+}
+
+void cpu_dual_slave_notify(void)
+{
+	__sync_synchronize();
+
+	if (gSlaveStarted)
+		sem_post(&gSlaveWake);
+}
+
+uint8_t cpu_dual_executor_get(void)
+{
+	if (gSlaveStarted && pthread_equal(pthread_self(), gSlaveThread))
+		return CPU_SLAVE;
+
+	return CPU_MASTER;
+}
+
+
+/* VDP */
+
+void vdp_sync_vblank_out_set(void (*callback)(void *), void *work)
+{
+	gVblankOutWork = work;
+	gVblankOutCallback = callback;
+}
+
+void vdp_sync_vblank_in_clear(void)
+{
+}
+
+void vdp_sync_vblank_out_clear(void)
+{
+	gVblankOutCallback = NULL;
+}
+
+void vdp2_tvmd_display_res_set(uint8_t interlace __unused, uint8_t horizontal __unused,
+	uint8_t vertical __unused)
+{
+}
+
+void vdp2_tvmd_display_set(void)
+{
+}
+
+void vdp2_tvmd_display_clear(void)
+{
+}
+
+void vdp2_scrn_back_color_set(uint32_t vram __unused, color_rgb1555_t color __unused)
+{
+}
+
+void vdp2_sync(void)
+{
+}
+
+
+/*
+//
+// The VDP2 commit happens at the next v-blank, so wait for it.
+//
+*/
+
+void vdp2_sync_wait(void)
+{
+	unsigned long now;
+
+	now = gVblankCount;
+
+	while (now == gVblankCount)
+		cpu_instr_sleep();
+}
+
+
+/* SMPC */
+
+void YaulSimSetPadSeed(unsigned long seed)
+{
+	gPadSeed[0] = seed;
+	gPadSeed[1] = seed ^ 0x5A5A5A5AUL;
+}
+
+
+/*
+//
+// This function returns the next scripted pad: nothing held 40% of
+// the time, otherwise one random button from gPadMask.
+//
+*/
+
+static uint16_t YaulSimNextPad(unsigned long *seed)
+{
+	unsigned bit;
+
+	*seed = *seed * 1103515245UL + 12345UL;
+	if (gPadMask == 0 || ((*seed >> 16) & 0xFF) < 102)
+		return 0;
+
+	do
+	{
+		*seed = *seed * 1103515245UL + 12345UL;
+		bit = (*seed >> 16) & 15;
+	} while ((gPadMask & (1U << bit)) == 0);
+
+	return (uint16_t)(1U << bit);
+}
+
+void YaulSimSetPadScript(const unsigned short *pads, int count)
+{
+	gPadScript = pads;
+	gPadScriptCount = count;
+	gPadScriptIndex = 0;
+}
+
+static uint16_t gPads[2];
+
+void smpc_peripheral_init(void)
+{
+}
+
+void smpc_peripheral_intback_issue(void)
+{
+}
+
+void smpc_peripheral_process(void)
+{
+	if (gPadScriptCount > 0)
+	{
+		gPads[0] = gPads[1] = gPadScript[gPadScriptIndex];
+		gPadScriptIndex = (gPadScriptIndex + 1) % gPadScriptCount;
+		return;
+	}
+
+	gPads[0] = YaulSimNextPad(&gPadSeed[0]);
+	gPads[1] = YaulSimNextPad(&gPadSeed[1]);
+}
+
+void smpc_peripheral_digital_port(uint8_t port, smpc_peripheral_digital_t *peripheral)
+{
+	peripheral->pressed.raw = (uint16_t)~gPads[(port - 1) & 1];
+}
+
+
+/* Debug text output */
+
+void dbgio_init(void)
+{
+}
+
+void dbgio_dev_default_init(uint8_t dev __unused)
+{
+}
+
+void dbgio_dev_font_load(void)
+{
+}
+
+
+/*
+//
+// Text is always formatted so the host run pays for it like the
+// Saturn does, but only echoed to stderr on request.
+//
+*/
+
+void dbgio_printf(const char *format, ...)
+{
+	static char buffer[1024];
+	va_list args;
+
+	va_start(args, format);
+	vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+
+	if (gEcho && gXBSimEchoAllowed)
+		fputs(buffer, stderr);
+}
+
+void dbgio_puts(const char *buffer)
+{
+	if (gEcho && gXBSimEchoAllowed)
+		fputs(buffer, stderr);
+}
+
+void dbgio_flush(void)
+{
+}
@@ -0,0 +1,126 @@
+/*****************************************************************
+*
+* yaul.h
+*
+* Host stand-in for the small part of libyaul that netlink.c uses.
+*
+* Only the host simulator build (host/Makefile) puts this directory
+* on the include path; the Saturn build uses the real header from
+* YAUL_INSTALL_ROOT. V-blank is emulated with an interval timer,
+* joypads are scripted and dbgio output is formatted and dropped
+* unless XBSIM_ECHO is set.
+*
+*****************************************************************/
+
+
+#ifndef __YAUL_HOST__
+#define	__YAUL_HOST__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifndef __unused
+#define	__unused	__attribute__ ((unused))
+#endif
+
+/* CPU */
+
+/* A mask above 0 holds off v-blank (SIGALRM) */
+
+uint8_t cpu_intc_mask_get(void);
+void cpu_intc_mask_set(uint8_t mask);
+void cpu_instr_sleep(void);
+
+/* Sets the mask and sleeps as one step, like LDC to SR then SLEEP */
+
+void YaulSimSleepUnmasking(uint8_t mask);
+
+#define	CPU_FRT_CLOCK_DIV_8		0
+#define	CPU_FRT_CLOCK_DIV_32	1
+#define	CPU_FRT_CLOCK_DIV_128	2
+
+void cpu_frt_init(uint8_t clock_div);
+uint16_t cpu_frt_count_get(void);
+
+#define	CPU_INTC_INTERRUPT_WDT_ITI	0x78
+
+void cpu_intc_priority_set(uint8_t vector, uint8_t priority);
+
+#define	CPU_WDT_CLOCK_DIV_2			0
+#define	CPU_WDT_TIMER_MODE_INTERVAL	0
+
+void cpu_wdt_init(uint8_t clock_div);
+void cpu_wdt_timer_mode_set(uint8_t mode, void (*handler)(void));
+void cpu_wdt_enable(void);
+uint8_t cpu_wdt_count_get(void);
+
+/* The slave SH-2 is a thread; the caches are coherent, so the */
+/* cache-through mirror is the address itself. */
+
+#define	CPU_CACHE_THROUGH		0
+
+#define	CPU_MASTER				0
+#define	CPU_SLAVE				1
+
+#define	CPU_DUAL_ENTRY_POLLING	0
+#define	CPU_DUAL_ENTRY_ICI		1
+
+void cpu_cache_purge(void);
+
+void cpu_dual_comm_mode_set(uint8_t mode);
+void cpu_dual_slave_set(void (*entry)(void));
+void cpu_dual_slave_notify(void);
+uint8_t cpu_dual_executor_get(void);
+
+/* VDP1/VDP2 */
+
+typedef uint16_t color_rgb1555_t;
+
+#define	COLOR_RGB1555(t, r, g, b)	((color_rgb1555_t)(((t) << 15) | ((b) << 10) | ((g) << 5) | (r)))
+#define	VDP2_VRAM_ADDR(bank, offset)	(0x25E00000UL + ((bank) << 17) + (offset))
+
+#define	VDP2_TVMD_INTERLACE_NONE	0
+#define	VDP2_TVMD_HORZ_NORMAL_A		0
+#define	VDP2_TVMD_VERT_240			2
+
+void vdp_sync_vblank_out_set(void (*callback)(void *), void *work);
+void vdp_sync_vblank_in_clear(void);
+void vdp_sync_vblank_out_clear(void);
+
+void vdp2_tvmd_display_res_set(uint8_t interlace, uint8_t horizontal, uint8_t vertical);
+void vdp2_tvmd_display_set(void);
+void vdp2_tvmd_display_clear(void);
+void vdp2_scrn_back_color_set(uint32_t vram, color_rgb1555_t color);
+
+void vdp2_sync(void);
+void vdp2_sync_wait(void);
+
+/* SMPC */
+
+typedef struct
+{
+	struct
+	{
+		uint16_t raw;	/* active low, like the hardware */
+	} pressed;
+} smpc_peripheral_digital_t;
+
+void smpc_peripheral_init(void);
+void smpc_peripheral_intback_issue(void);
+void smpc_peripheral_process(void);
+void smpc_peripheral_digital_port(uint8_t port, smpc_peripheral_digital_t *peripheral);
+
+/* Debug text output */
+
+#define	DBGIO_DEV_VDP2_ASYNC	2
+
+void dbgio_init(void);
+void dbgio_dev_default_init(uint8_t dev);
+void dbgio_dev_font_load(void);
+void dbgio_printf(const char *format, ...) __attribute__ ((format (printf, 1, 2)));
+void dbgio_puts(const char *buffer);
+void dbgio_flush(void);
+
+
+#endif	/* __YAUL_HOST__ */
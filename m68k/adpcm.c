@@ -0,0 +1,280 @@
+/*****************************************************************
+*
+* adpcm.c
+*
+* 4-bit IMA ADPCM, see adpcm.h
+*
+*****************************************************************/
+
+#include "adpcm.h"
+
+#define	kAdpcmBlockBytes	(kAdpcmBlockSize - kAdpcmHeaderSize)	/* of nibbles */
+#define	kAdpcmLookahead		2		/* samples the encoder weighs a nibble by */
+
+static const unsigned short kAdpcmStepSizes[kAdpcmSteps] =
+{
+	7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31,
+	34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143,
+	157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658,
+	724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024,
+	3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+	15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const signed char kAdpcmIndexSteps[8] = { -1, -1, -1, -1, 2, 4, 6, 8 };
+
+/* By step index * 16 + nibble: how far the sample moves (away from */
+/* zero when the nibble's top bit is set), and the next step index * 16 */
+
+static unsigned short gAdpcmDelta[kAdpcmSteps * 16];
+static unsigned short gAdpcmNext[kAdpcmSteps * 16];
+
+
+void AdpcmInit(void)
+{
+	unsigned step, delta;
+	int index, next, nibble;
+
+	for (index = 0; index < kAdpcmSteps; index++)
+	{
+		step = kAdpcmStepSizes[index];
+
+		for (nibble = 0; nibble < 16; nibble++)
+		{
+			delta = step >> 3;
+			if (nibble & 4)
+				delta += step;
+			if (nibble & 2)
+				delta += step >> 1;
+			if (nibble & 1)
+				delta += step >> 2;
+
+			next = index + kAdpcmIndexSteps[nibble & 7];
+			if (next < 0)
+				next = 0;
+			else if (next >= kAdpcmSteps)
+				next = kAdpcmSteps - 1;
+
+			gAdpcmDelta[index * 16 + nibble] = (unsigned short)delta;
+			gAdpcmNext[index * 16 + nibble] = (unsigned short)(next * 16);
+		}
+	}
+}
+
+
+unsigned long AdpcmSamples(unsigned long size)
+{
+	unsigned long rest = size % kAdpcmBlockSize;
+
+	return size / kAdpcmBlockSize * kAdpcmBlockSamples
+		+ (rest >= kAdpcmHeaderSize ? 1 + (rest - kAdpcmHeaderSize) * 2 : 0);
+}
+
+
+unsigned long AdpcmBytes(unsigned long count)
+{
+	unsigned long rest = count % kAdpcmBlockSamples;
+
+	return count / kAdpcmBlockSamples * kAdpcmBlockSize
+		+ (rest != 0 ? kAdpcmHeaderSize + rest / 2 : 0);
+}
+
+
+/*
+//
+// This function moves predictor by the nibble at entry in the
+// tables, the way the decoder does, and returns the new sample.
+//
+*/
+
+static int AdpcmMove(int predictor, int entry)
+{
+	if (entry & 8)
+	{
+		predictor -= gAdpcmDelta[entry];
+		if (predictor < -32768)
+			predictor = -32768;
+	}
+	else
+	{
+		predictor += gAdpcmDelta[entry];
+		if (predictor > 32767)
+			predictor = 32767;
+	}
+
+	return predictor;
+}
+
+
+/*
+//
+// This function scores starting the next samples at predictor and
+// row: the squared error of the nibble chosen for the first, plus the
+// best that can then be done for the next depth - 1. Sets *chosen.
+//
+*/
+
+static double AdpcmSearch(const short *samples, int count, int predictor, int row, int depth,
+	int *chosen)
+{
+	double error, best;
+	int moved, nibble, ignored;
+
+	best = 1e30;
+	*chosen = 0;
+
+	for (nibble = 0; nibble < 16; nibble++)
+	{
+		moved = AdpcmMove(predictor, row + nibble);
+		error = (double)(moved - samples[0]) * (moved - samples[0]);
+		if (error >= best)
+			continue;
+
+		if (depth > 1 && count > 1)
+			error += AdpcmSearch(samples + 1, count - 1, moved, gAdpcmNext[row + nibble], depth - 1,
+				&ignored);
+
+		if (error < best)
+		{
+			best = error;
+			*chosen = nibble;
+		}
+	}
+
+	return best;
+}
+
+
+unsigned long AdpcmEncode(const short *samples, unsigned long count, unsigned char *out)
+{
+	unsigned char *start = out;
+	unsigned long at, left, iii;
+	short block[kAdpcmBlockSamples + 1];
+	int predictor, row, best, high;
+
+	row = 0;
+
+	for (at = 0; at < count; at += left)
+	{
+		left = count - at;
+		if (left > kAdpcmBlockSamples)
+			left = kAdpcmBlockSamples;
+
+		/* A block holds an odd number of samples; the last is repeated */
+
+		for (iii = 0; iii < left; iii++)
+			block[iii] = samples[at + iii];
+		block[left] = block[left - 1];
+
+		predictor = block[0];
+		out[0] = (unsigned char)(predictor >> 8);
+		out[1] = (unsigned char)predictor;
+		out[2] = (unsigned char)(row / 16);
+		out[3] = 0;
+		out += kAdpcmHeaderSize;
+
+		high = 1;
+		for (iii = 1; iii < left + !(left & 1); iii++)
+		{
+			AdpcmSearch(block + iii, (int)(left + 1 - iii), predictor, row, kAdpcmLookahead, &best);
+			predictor = AdpcmMove(predictor, row + best);
+			row = gAdpcmNext[row + best];
+
+			if (high)
+				*out = (unsigned char)(best << 4);
+			else
+				*out++ |= (unsigned char)best;
+			high = !high;
+		}
+	}
+
+	return (unsigned long)(out - start);
+}
+
+
+void AdpcmStart(Adpcm *adpcm, const unsigned char *data, unsigned long size)
+{
+	adpcm->in = data;
+	adpcm->end = data + size;
+	adpcm->blockEnd = data;
+	adpcm->predictor = 0;
+	adpcm->row = 0;
+	adpcm->low = 0;
+}
+
+
+unsigned long AdpcmDecode(Adpcm *adpcm, short *out, unsigned long count)
+{
+	const unsigned char *in = adpcm->in;
+	const unsigned char *stop;
+	unsigned long done;
+	int predictor, row, entry, index;
+
+	predictor = adpcm->predictor;
+	row = adpcm->row;
+	done = 0;
+
+	/* The low nibble of a byte half decoded last time */
+
+	if (adpcm->low && count > 0)
+	{
+		entry = row + (in[-1] & 15);
+		predictor = AdpcmMove(predictor, entry);
+		row = gAdpcmNext[entry];
+		out[done++] = (short)predictor;
+		adpcm->low = 0;
+	}
+
+	while (done < count)
+	{
+		if (in == adpcm->blockEnd)
+		{
+			if (adpcm->end - in < kAdpcmHeaderSize)
+				break;
+
+			predictor = (short)(in[0] << 8 | in[1]);
+			index = in[2];
+			row = (index < kAdpcmSteps ? index : kAdpcmSteps - 1) * 16;
+			in += kAdpcmHeaderSize;
+
+			adpcm->blockEnd = (adpcm->end - in > kAdpcmBlockBytes) ? in + kAdpcmBlockBytes : adpcm->end;
+			out[done++] = (short)predictor;
+			continue;
+		}
+
+		/* Whole bytes, two samples each, as far as the block or out goes */
+
+		stop = in + (count - done) / 2;
+		if (stop > adpcm->blockEnd)
+			stop = adpcm->blockEnd;
+
+		while (in < stop)
+		{
+			entry = row + (*in >> 4);
+			predictor = AdpcmMove(predictor, entry);
+			row = gAdpcmNext[entry];
+			out[done++] = (short)predictor;
+
+			entry = row + (*in++ & 15);
+			predictor = AdpcmMove(predictor, entry);
+			row = gAdpcmNext[entry];
+			out[done++] = (short)predictor;
+		}
+
+		/* Room for one more: half a byte */
+
+		if (done + 1 == count && in < adpcm->blockEnd)
+		{
+			entry = row + (*in++ >> 4);
+			predictor = AdpcmMove(predictor, entry);
+			row = gAdpcmNext[entry];
+			out[done++] = (short)predictor;
+			adpcm->low = 1;
+		}
+	}
+
+	adpcm->in = in;
+	adpcm->predictor = predictor;
+	adpcm->row = row;
+	return done;
+}
@@ -0,0 +1,73 @@
+/*****************************************************************
+*
+* adpcm.h
+*
+* 4-bit IMA ADPCM for the sound driver's samples: a quarter of the
+* room 16-bit PCM takes in sound RAM. tools/nlpack encodes the WAVs
+* with it and the 68000 decodes them as they play.
+*
+* The data is a run of kAdpcmBlockSize byte blocks, the last one
+* possibly shorter. A block starts with a 4-byte header, the first
+* sample (16 bits, big-endian) and the step index it goes on from,
+* so every block decodes on its own. Then come the rest of the block's
+* samples, a nibble each, high nibble first.
+*
+* Decoding is two table lookups a sample: AdpcmInit works out, for
+* every step index and nibble, how far the sample moves and what the
+* next step index is, so the 68000 never does the shifts and tests of
+* the textbook decoder. The encoder tries all 16 nibbles against the
+* same tables, each with the best nibble that could follow it, and
+* keeps the pair that comes closest, so what it plans is exactly what
+* the decoder will play.
+*
+* Nothing here touches hardware; the host builds it for nlpack and
+* for host/soundbench.c.
+*
+*****************************************************************/
+
+
+#ifndef __ADPCM__
+#define	__ADPCM__
+
+#define	kAdpcmBlockSize			256
+#define	kAdpcmHeaderSize		4
+#define	kAdpcmBlockSamples		(1 + (kAdpcmBlockSize - kAdpcmHeaderSize) * 2)
+#define	kAdpcmSteps				89
+
+typedef struct
+{
+	const unsigned char	*in;
+	const unsigned char	*end;			/* of the data */
+	const unsigned char	*blockEnd;
+	int					predictor;		/* the last sample */
+	int					row;			/* step index * 16 */
+	int					low;			/* the low nibble of in[-1] is next */
+} Adpcm;
+
+/* Builds the decoding tables; call once before anything else */
+
+void AdpcmInit(void);
+
+/* How many samples size bytes of data hold, and how many bytes */
+/* count samples take */
+
+unsigned long AdpcmSamples(unsigned long size);
+unsigned long AdpcmBytes(unsigned long count);
+
+/* Encodes count samples into out, AdpcmBytes(count) bytes. An even */
+/* count is padded with a copy of the last sample, since a block holds */
+/* an odd number. Returns the bytes written. */
+
+unsigned long AdpcmEncode(const short *samples, unsigned long count, unsigned char *out);
+
+/* Starts decoding size bytes of data from the first sample */
+
+void AdpcmStart(Adpcm *adpcm, const unsigned char *data, unsigned long size);
+
+/* Decodes up to count more samples into out. Returns how many there */
+/* were, fewer than count only at the end of the data. */
+
+unsigned long AdpcmDecode(Adpcm *adpcm, short *out, unsigned long count);
+
+
+#endif	/* __ADPCM__ */
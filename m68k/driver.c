@@ -0,0 +1,179 @@
+/*****************************************************************
+*
+* driver.c
+*
+* The 68000 sound driver: the SH-2 copies it to the start of sound
+* RAM and lets the 68000 out of reset, and it runs from there for
+* good. See source/sound.h for what it shares with the SH-2, and
+* mixer.h for the voices.
+*
+* Timer A interrupts every kMixerTick SCSP samples; crt0.S counts
+* them in gSoundTicks and does nothing else. Everything else is the
+* main loop, which goes round as fast as it can:
+*
+*	commands	off the ring in SoundShared, into MixerPlay and
+*				MixerStop
+*	advance		every voice's reckoning moved on by the ticks since
+*				last time round
+*	key off		the slots of voices that stopped, ended or were
+*				taken for another sound
+*	fill		every voice's ring topped up
+*	key on		the slots of voices whose rings are primed
+*
+* So a command is picked up at most one time round after it's
+* written, and its sound starts once kMixerPrime samples of it have
+* been decoded.
+*
+* The timer is one-shot, so the interrupt starts it again; whatever
+* part of a sample that takes is lost to the reckoning, which is why
+* kMixerGuard leaves some room over a tick.
+*
+*****************************************************************/
+
+#include "mixer.h"
+#include "scsp.h"
+
+volatile unsigned long gSoundTicks;
+
+static Mixer gMixer;
+
+
+/*
+//
+// This function sets the slot of voice up to play its ring, and keys
+// it on.
+//
+*/
+
+static void DriverKeyOn(int slot, const MixerVoice *voice)
+{
+	unsigned long ring = kSoundRings + (unsigned long)slot * kSoundRingSamples * 2;
+
+	ScspSlot(slot, kScspStart) = (unsigned short)ring;
+	ScspSlot(slot, kScspLoopStart) = 0;
+	ScspSlot(slot, kScspLoopEnd) = kSoundRingSamples - 1;
+	ScspSlot(slot, kScspEnvelope) = kScspAttackNow;
+	ScspSlot(slot, kScspRelease) = kScspReleaseNow;
+	ScspSlot(slot, kScspLevel) = voice->level;
+	ScspSlot(slot, kScspModulation) = 0;
+	ScspSlot(slot, kScspPitch) = voice->pitch;
+	ScspSlot(slot, kScspLfo) = 0;
+	ScspSlot(slot, kScspInput) = 0;
+	ScspSlot(slot, kScspOutput) = kScspDirectLevel | voice->pan << 8;
+	ScspSlot(slot, kScspKey) = kScspKeyExecute | kScspKeyOn | kScspLoopNormal | (ring >> 16);
+}
+
+
+static void DriverKeyOff(int slot)
+{
+	unsigned long ring = kSoundRings + (unsigned long)slot * kSoundRingSamples * 2;
+
+	ScspSlot(slot, kScspKey) = kScspKeyExecute | kScspLoopNormal | (ring >> 16);
+}
+
+
+/*
+//
+// This function does what the voices want done to their slots: keys
+// them off, and when on is set, keys them on.
+//
+*/
+
+static void DriverKeys(int on)
+{
+	MixerVoice *voice;
+	int iii;
+
+	for (iii = 0; iii < kSoundVoices; iii++)
+	{
+		voice = &gMixer.voices[iii];
+		if (voice->keyOff)
+		{
+			DriverKeyOff(iii);
+			voice->keyOff = 0;
+		}
+
+		if (on && voice->keyOn)
+		{
+			DriverKeyOn(iii, voice);
+			voice->keyOn = 0;
+		}
+	}
+}
+
+
+static void DriverCommands(volatile SoundShared *shared)
+{
+	volatile SoundCommand *command;
+	unsigned tail;
+
+	for (tail = shared->tail; tail != shared->head; tail = (tail + 1) % kSoundCommands)
+	{
+		command = &shared->commands[tail];
+		if (command->op == kSoundPlay)
+			MixerPlay(&gMixer, command->voice, command->sample, command->volume, command->pan,
+				command->flags);
+		else if (command->op == kSoundStop)
+			MixerStop(&gMixer, command->voice);
+
+		shared->tail = (uint16_t)((tail + 1) % kSoundCommands);
+	}
+}
+
+
+static void DriverInit(void)
+{
+	int iii;
+
+	AdpcmInit();
+	MixerInit(&gMixer, (unsigned char *)0);
+
+	ScspCommon(kScspVolume) = 0x000F;
+
+	for (iii = 0; iii < kScspSlots; iii++)
+	{
+		ScspSlot(iii, kScspOutput) = 0;
+		ScspSlot(iii, kScspKey) = kScspKeyExecute;
+	}
+
+	/* Timer A every kMixerTick samples, at kScspTimerALevel */
+
+	ScspCommon(kScspInterruptEnable) = 0;
+	ScspCommon(kScspInterruptReset) = 0x07FF;
+	ScspCommon(kScspInterruptLevel0) = (kScspTimerALevel & 1) ? kScspTimerAInterrupt : 0;
+	ScspCommon(kScspInterruptLevel1) = (kScspTimerALevel & 2) ? kScspTimerAInterrupt : 0;
+	ScspCommon(kScspInterruptLevel2) = (kScspTimerALevel & 4) ? kScspTimerAInterrupt : 0;
+	ScspCommon(kScspTimerA) = 256 - kMixerTick;
+	ScspCommon(kScspInterruptEnable) = kScspTimerAInterrupt;
+
+	__asm__ volatile ("move.w #0x2000, %sr");
+}
+
+
+int main(void)
+{
+	volatile SoundShared *shared = (volatile SoundShared *)kSoundShared;
+	unsigned long ticks, last;
+
+	DriverInit();
+	shared->magic = kSoundMagic;
+
+	last = gSoundTicks;
+	for (;;)
+	{
+		DriverCommands(shared);
+
+		ticks = gSoundTicks;
+		MixerAdvance(&gMixer, (ticks - last) * kMixerTick);
+		last = ticks;
+
+		DriverKeys(0);
+		MixerFill(&gMixer);
+		DriverKeys(1);
+
+		shared->voices = (uint16_t)MixerVoices(&gMixer);
+		shared->ticks = (uint16_t)ticks;
+	}
+
+	return 0;
+}
@@ -0,0 +1,342 @@
+/*****************************************************************
+*
+* mixer.c
+*
+* The sound driver's voices, see mixer.h.
+*
+*****************************************************************/
+
+#include "mixer.h"
+
+
+void MixerInit(Mixer *mixer, unsigned char *ram)
+{
+	MixerVoice *voice;
+	int iii;
+
+	mixer->ram = ram;
+	mixer->samples = ((volatile SoundShared *)(ram + kSoundShared))->samples;
+	mixer->clock = 0;
+
+	for (iii = 0; iii < kSoundVoices; iii++)
+	{
+		voice = &mixer->voices[iii];
+		voice->state = kMixerFree;
+		voice->keyOn = 0;
+		voice->keyOff = 0;
+		voice->ring = (short *)(ram + kSoundRings + iii * kSoundRingSamples * 2);
+	}
+}
+
+
+unsigned MixerPitch(unsigned long rate, unsigned long *step)
+{
+	unsigned long scaled, fns;
+	int oct;
+
+	/* rate / kMixerOutputRate = 2^oct * (1 + fns / 1024) */
+
+	if (rate == 0)
+		rate = kMixerOutputRate;
+
+	scaled = rate;
+	oct = 0;
+	while (scaled < kMixerOutputRate && oct > -8)
+	{
+		scaled <<= 1;
+		oct--;
+	}
+	while (scaled >= kMixerOutputRate * 2 && oct < 7)
+	{
+		scaled >>= 1;
+		oct++;
+	}
+
+	fns = (scaled - kMixerOutputRate) * 1024 / kMixerOutputRate;
+	if (fns > 1023)
+		fns = 1023;
+
+	/* What the slot will really do, rounding and all */
+
+	*step = (1024 + fns) * 64;
+	*step = (oct >= 0) ? *step << oct : *step >> -oct;
+
+	return (unsigned)((oct & 15) << 11 | fns);
+}
+
+
+int MixerLevel(int volume)
+{
+	int top, fraction, level;
+
+	if (volume <= 0)
+		return 255;
+	if (volume > 255)
+		volume = 255;
+
+	/* 16 steps of TL (0.375 dB) for every halving, by log2 of volume */
+	/* from its top bit and the 7 below it */
+
+	for (top = 7; !(volume >> top); top--)
+		;
+	fraction = (volume << (7 - top)) & 0x7F;
+
+	level = (8 - top) * 16 - (fraction >> 3) - 1;
+	return (level < 0) ? 0 : level;
+}
+
+
+int MixerPan(int pan)
+{
+	int side;
+
+	/* DIPAN 0x01-0x0F turns the right down by 3 dB a step, 0x11-0x1F */
+	/* the left; 0 is the middle */
+
+	if (pan < 128)
+	{
+		side = (128 - pan) >> 3;
+		return (side > 15) ? 15 : side;
+	}
+
+	side = (pan - 128) >> 3;
+	return side ? (0x10 | side) : 0;
+}
+
+
+/*
+//
+// This function starts voice's sound from its first sample again.
+//
+*/
+
+static void MixerRewind(MixerVoice *voice)
+{
+	voice->read = 0;
+	if (voice->format == kPackADPCM4)
+		AdpcmStart(&voice->adpcm, voice->data, voice->size);
+}
+
+
+int MixerPlay(Mixer *mixer, int voice, int sample, int volume, int pan, int flags)
+{
+	volatile SoundSample *entry;
+	MixerVoice *chosen;
+	unsigned long address, size;
+	int format, iii;
+
+	if (sample < 0 || sample >= kSoundSamples)
+		return -1;
+
+	entry = &mixer->samples[sample];
+	address = entry->address;
+	size = entry->size;
+	format = entry->format;
+
+	if (size == 0 || address < kSoundData || address > kSoundRAMSize || size > kSoundRAMSize - address)
+		return -1;
+	if (format != kPackPCM8 && format != kPackPCM16 && format != kPackADPCM4)
+		return -1;
+
+	if (voice == kSoundAnyVoice)
+	{
+		voice = 0;
+		for (iii = 0; iii < kSoundVoices; iii++)
+		{
+			if (mixer->voices[iii].state == kMixerFree)
+			{
+				voice = iii;
+				break;
+			}
+
+			if (mixer->voices[iii].age < mixer->voices[voice].age)
+				voice = iii;
+		}
+	}
+	else if (voice < 0 || voice >= kSoundVoices)
+		return -1;
+
+	chosen = &mixer->voices[voice];
+	if (chosen->state == kMixerPlaying)
+		chosen->keyOff = 1;
+
+	chosen->state = kMixerStarting;
+	chosen->keyOn = 0;
+	chosen->loop = (flags & kSoundLoop) != 0;
+	chosen->age = mixer->clock++;
+
+	chosen->data = mixer->ram + address;
+	chosen->size = size;
+	chosen->format = format;
+	if (format == kPackADPCM4)
+		chosen->length = AdpcmSamples(size);
+	else
+		chosen->length = (format == kPackPCM16) ? size / 2 : size;
+	MixerRewind(chosen);
+	chosen->ended = 0;
+	chosen->end = 0;
+
+	chosen->written = 0;
+	chosen->played = 0;
+	chosen->fraction = 0;
+	chosen->pitch = (unsigned short)MixerPitch(entry->rate, &chosen->step);
+	chosen->level = (unsigned char)MixerLevel(volume);
+	chosen->pan = (unsigned char)MixerPan(pan);
+
+	return voice;
+}
+
+
+void MixerStop(Mixer *mixer, int voice)
+{
+	int iii;
+
+	for (iii = 0; iii < kSoundVoices; iii++)
+	{
+		if (voice != kSoundAllVoices && voice != iii)
+			continue;
+
+		if (mixer->voices[iii].state == kMixerPlaying)
+			mixer->voices[iii].keyOff = 1;
+
+		mixer->voices[iii].state = kMixerFree;
+		mixer->voices[iii].keyOn = 0;
+	}
+}
+
+
+void MixerAdvance(Mixer *mixer, unsigned long elapsed)
+{
+	MixerVoice *voice;
+	int iii;
+
+	/* Longer than this and the rings have run dry anyway */
+
+	if (elapsed > kMixerMaxElapsed)
+		elapsed = kMixerMaxElapsed;
+
+	for (iii = 0; iii < kSoundVoices; iii++)
+	{
+		voice = &mixer->voices[iii];
+		if (voice->state != kMixerPlaying)
+			continue;
+
+		voice->fraction += elapsed * voice->step;
+		voice->played += voice->fraction >> 16;
+		voice->fraction &= 0xFFFF;
+
+		/* Past the end, and the silence after it, for certain */
+
+		if (voice->ended && (long)(voice->played - voice->end) >= kMixerGuard)
+		{
+			voice->state = kMixerFree;
+			voice->keyOff = 1;
+		}
+	}
+}
+
+
+/*
+//
+// This function puts up to count more of voice's samples at out.
+// Returns how many there were.
+//
+*/
+
+static unsigned long MixerSource(MixerVoice *voice, short *out, unsigned long count)
+{
+	const unsigned char *in;
+	unsigned long iii;
+
+	if (voice->format == kPackADPCM4)
+		return AdpcmDecode(&voice->adpcm, out, count);
+
+	if (count > voice->length - voice->read)
+		count = voice->length - voice->read;
+
+	if (voice->format == kPackPCM8)
+	{
+		in = voice->data + voice->read;
+		for (iii = 0; iii < count; iii++)
+			out[iii] = (short)((signed char)in[iii] << 8);
+	}
+	else
+	{
+		in = voice->data + voice->read * 2;
+		for (iii = 0; iii < count; iii++, in += 2)
+			out[iii] = (short)(in[0] << 8 | in[1]);
+	}
+
+	voice->read += count;
+	return count;
+}
+
+
+void MixerFill(Mixer *mixer)
+{
+	MixerVoice *voice;
+	unsigned long limit, at, count, got, iii;
+	int vvv;
+
+	for (vvv = 0; vvv < kSoundVoices; vvv++)
+	{
+		voice = &mixer->voices[vvv];
+		if (voice->state == kMixerFree)
+			continue;
+
+		if (voice->state == kMixerStarting)
+			limit = kMixerPrime;
+		else
+			limit = voice->played + kSoundRingSamples - kMixerGuard;
+
+		while ((long)(limit - voice->written) > 0)
+		{
+			at = voice->written & (kSoundRingSamples - 1);
+			count = limit - voice->written;
+			if (count > kSoundRingSamples - at)
+				count = kSoundRingSamples - at;
+
+			got = voice->ended ? 0 : MixerSource(voice, voice->ring + at, count);
+			if (got < count && !voice->ended)
+			{
+				if (voice->loop && voice->length > 0)
+				{
+					voice->written += got;
+					MixerRewind(voice);
+					continue;
+				}
+
+				voice->ended = 1;
+				voice->end = voice->written + got;
+			}
+
+			for (iii = got; iii < count; iii++)
+				voice->ring[at + iii] = 0;
+			voice->written += count;
+		}
+
+		if (voice->state == kMixerStarting)
+		{
+			voice->state = kMixerPlaying;
+			voice->keyOn = 1;
+			voice->played = 0;
+			voice->fraction = 0;
+		}
+	}
+}
+
+
+unsigned MixerVoices(const Mixer *mixer)
+{
+	unsigned voices;
+	int iii;
+
+	voices = 0;
+	for (iii = 0; iii < kSoundVoices; iii++)
+	{
+		if (mixer->voices[iii].state != kMixerFree)
+			voices |= 1u << iii;
+	}
+
+	return voices;
+}
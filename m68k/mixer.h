@@ -0,0 +1,126 @@
+/*****************************************************************
+*
+* mixer.h
+*
+* The sound driver's voices: which sound each one plays, and keeping
+* its ring in sound RAM filled ahead of the SCSP slot that plays it.
+*
+* A voice's slot loops over its ring of kSoundRingSamples for as long
+* as the voice plays. The mixer can't ask the slot where it is, so it
+* reckons it: the slot moves step ring samples (16.16) for every
+* SCSP output sample, and MixerAdvance is told how many of those have
+* gone by, a timer tick's worth at a time. MixerFill then decodes the
+* sound into the ring up to kMixerGuard short of where the slot has
+* reckoned to be, which leaves room for the reckoning to be a tick
+* behind or ahead of the slot. After the sound's last sample the ring
+* is filled with silence until the slot is past it too, and the voice
+* is keyed off.
+*
+* A voice starts by having only kMixerPrime samples decoded into its
+* ring before it's keyed on, so a sound starts a small part of a frame
+* after its command; MixerFill fills the rest of the ring the next
+* time round. So the driver's main loop has to come round within
+* kMixerPrime ring samples of keying a voice on, and within about
+* half a ring the rest of the time, or a slot plays what isn't there
+* yet; soundbench -l shows where that starts.
+*
+* keyOn and keyOff tell the driver what to do to the slot; it clears
+* them when it has. Nothing here touches the SCSP itself, so the host
+* can run the mixer against a pretend slot (host/soundbench.c).
+*
+*****************************************************************/
+
+
+#ifndef __MIXER__
+#define	__MIXER__
+
+#include "adpcm.h"
+#include "sound.h"
+
+#define	kMixerOutputRate		44100	/* the SCSP's samples a second */
+#define	kMixerTick				256		/* SCSP samples between timer A interrupts */
+#define	kMixerPrime				256		/* ring samples decoded before key on */
+#define	kMixerGuard				(kMixerTick + 32)
+#define	kMixerMaxElapsed		(kMixerTick * 16)
+
+/* Voice states */
+
+enum
+{
+	kMixerFree,
+	kMixerStarting,			/* ring being primed, slot off */
+	kMixerPlaying
+};
+
+typedef struct
+{
+	int					state;
+	int					keyOn;			/* for the driver to do to the slot */
+	int					keyOff;
+	int					loop;
+	unsigned long		age;			/* when it started, to take the oldest */
+
+	/* the sound */
+	const unsigned char	*data;
+	unsigned long		size;			/* bytes */
+	int					format;
+	unsigned long		length;			/* samples */
+	unsigned long		read;			/* next sample, PCM */
+	Adpcm				adpcm;
+	int					ended;			/* every sample is in the ring */
+	unsigned long		end;			/* written when it ended */
+
+	/* the ring and the slot */
+	short				*ring;
+	unsigned long		written;		/* samples put in the ring, all told */
+	unsigned long		played;			/* samples the slot has played, reckoned */
+	unsigned long		fraction;		/* of played, 16 bits */
+	unsigned long		step;			/* ring samples an SCSP sample, 16.16 */
+	unsigned short		pitch;			/* OCT << 11 | FNS */
+	unsigned char		level;			/* TL, attenuation */
+	unsigned char		pan;			/* DIPAN */
+} MixerVoice;
+
+typedef struct
+{
+	unsigned char			*ram;		/* sound RAM */
+	volatile SoundSample	*samples;
+	unsigned long			clock;
+	MixerVoice				voices[kSoundVoices];
+} Mixer;
+
+/* Sound RAM is at ram: 0 on the 68000, a buffer on the host */
+
+void MixerInit(Mixer *mixer, unsigned char *ram);
+
+/* Starts sample on voice, or on kSoundAnyVoice: a free one, else */
+/* the one that started longest ago. Returns the voice, or -1 if */
+/* the sample or voice isn't valid. */
+
+int MixerPlay(Mixer *mixer, int voice, int sample, int volume, int pan, int flags);
+
+/* Stops voice, or kSoundAllVoices */
+
+void MixerStop(Mixer *mixer, int voice);
+
+/* elapsed more SCSP samples have been played */
+
+void MixerAdvance(Mixer *mixer, unsigned long elapsed);
+
+/* Tops up every voice's ring */
+
+void MixerFill(Mixer *mixer);
+
+/* A bit for every voice that isn't free */
+
+unsigned MixerVoices(const Mixer *mixer);
+
+/* Slot settings: OCT and FNS for rate, and the step they make; TL */
+/* for volume 0 to 255; DIPAN for pan 0 (left) to 255 (right) */
+
+unsigned MixerPitch(unsigned long rate, unsigned long *step);
+int MixerLevel(int volume);
+int MixerPan(int pan);
+
+
+#endif	/* __MIXER__ */
@@ -0,0 +1,60 @@
+/*****************************************************************
+*
+* scsp.h
+*
+* The SCSP's registers as the 68000 sees them, the few the sound
+* driver uses. Every slot has kScspSlotSize bytes of 16-bit registers
+* from kScspBase; the common ones follow at kScspCommon.
+*
+*****************************************************************/
+
+
+#ifndef __SCSP__
+#define	__SCSP__
+
+#define	kScspBase				0x100000
+#define	kScspSlots				32
+#define	kScspSlotSize			0x20
+#define	kScspCommon				(kScspBase + 0x400)
+
+#define	ScspSlot(slot, reg)		(*(volatile unsigned short *)(kScspBase + (slot) * kScspSlotSize + (reg)))
+#define	ScspCommon(reg)			(*(volatile unsigned short *)(kScspCommon + (reg)))
+
+/* Slot registers */
+
+#define	kScspKey				0x00	/* KYONEX KYONB SBCTL SSCTL LPCTL PCM8B SA[19:16] */
+#define	kScspStart				0x02	/* SA[15:0] */
+#define	kScspLoopStart			0x04	/* LSA, samples */
+#define	kScspLoopEnd			0x06	/* LEA, the last sample of the loop */
+#define	kScspEnvelope			0x08	/* D2R D1R EGHOLD AR */
+#define	kScspRelease			0x0A	/* LPSLNK KRS DL RR */
+#define	kScspLevel				0x0C	/* STWINH SDIR TL */
+#define	kScspModulation			0x0E	/* MDL MDXSL MDYSL */
+#define	kScspPitch				0x10	/* OCT FNS */
+#define	kScspLfo				0x12
+#define	kScspInput				0x14	/* ISEL IMXL, into the DSP */
+#define	kScspOutput				0x16	/* DISDL DIPAN EFSDL EFPAN */
+
+#define	kScspKeyExecute			0x1000	/* every slot takes its KYONB */
+#define	kScspKeyOn				0x0800
+#define	kScspLoopNormal			0x0020
+#define	kScspAttackNow			0x001F	/* AR 31, no decay */
+#define	kScspReleaseNow			0x3C1F	/* KRS off, RR 31 */
+#define	kScspDirectLevel		0xE000	/* DISDL 7, 0 dB */
+
+/* Common registers */
+
+#define	kScspVolume				0x00	/* MEM4MB DAC18B VER MVOL */
+#define	kScspTimerA				0x18	/* TACTL TIMA */
+#define	kScspInterruptEnable	0x1E	/* SCIEB, to the 68000 */
+#define	kScspInterruptPending	0x20	/* SCIPD */
+#define	kScspInterruptReset		0x22	/* SCIRE */
+#define	kScspInterruptLevel0	0x24	/* SCILV0-2, a bit of the level */
+#define	kScspInterruptLevel1	0x26	/* each interrupt comes in at */
+#define	kScspInterruptLevel2	0x28
+
+#define	kScspTimerAInterrupt	0x0040
+#define	kScspTimerALevel		5		/* 68000 autovector 29 */
+
+
+#endif	/* __SCSP__ */
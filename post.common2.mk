@@ -125,6 +125,31 @@ $2: $1
 		$(SH_CXXFLAGS) $(SH_SYSTEM_INCLUDE_DIRS) $(SH_INCLUDE_DIRS))
 endef
 
+# Romdisks are left to genromfs unless ROMDISK_COMPRESS is 1, which
+# compresses them with tools/nlromfs instead; they can then only be
+# read through source/romdisk.h
+HOST_CC?= cc
+ROMDISK_COMPRESS?= 0
+ROMDISK_BLOCK_SHIFT?= 12
+NLROMFS:= $(SH_BUILD_PATH)/nlromfs$(EXE_EXT)
+NLROMFS_SRCS:= $(THIS_ROOT)/tools/nlromfs/nlromfs.c $(THIS_ROOT)/source/romdisk.c
+
+$(NLROMFS): $(NLROMFS_SRCS) $(THIS_ROOT)/source/romdisk.h
+	@printf -- "$(V_BEGIN_YELLOW)$(@F)$(V_END)\n"
+	$(ECHO)$(HOST_CC) -O2 -I$(THIS_ROOT)/source -o $@ $(NLROMFS_SRCS)
+
+ifeq ($(strip $(ROMDISK_COMPRESS)),1)
+define macro-romdisk-image
+$(NLROMFS) -b $(ROMDISK_BLOCK_SHIFT) -d $1 -f $2 > /dev/null
+endef
+ROMDISK_TOOL:= $(NLROMFS)
+else
+define macro-romdisk-image
+$(YAUL_INSTALL_ROOT)/share/wrap-error $(YAUL_INSTALL_ROOT)/bin/genromfs$(EXE_EXT) $(ROMDISK_FLAGS) -d $1 -f $2
+endef
+ROMDISK_TOOL:=
+endif
+
 # $1 -> Symbol
 # $2 -> Absolute filename build path
 # $3 -> Directory
@@ -139,9 +164,9 @@ $2.d:
 		awk 'BEGIN { print "$2: \\"; } \
              { while (getline == 1) { print "\t" $$$$0 " \\"; } print "\t" $$$$0; }' > $$@
 
-$2: $2.d
+$2: $2.d $(ROMDISK_TOOL)
 	@printf -- "$(V_BEGIN_YELLOW)$(strip $1).romdisk$(V_END)\n"
-	$(ECHO)$(YAUL_INSTALL_ROOT)/share/wrap-error $(YAUL_INSTALL_ROOT)/bin/genromfs$(EXE_EXT) $(ROMDISK_FLAGS) -d $3 -f $2
+	$(ECHO)$(call macro-romdisk-image,$3,$2)
 
 $2.o: $2
 	@printf -- "$(V_BEGIN_YELLOW)$(strip $1).romdisk.o$(V_END)\n"
@@ -150,6 +175,62 @@ $2.o: $2
 -include "$2.d"
 endef
 
+# Asset archive. nlpack is built for the host, so it takes the host's
+# compiler rather than the SH-2 one
+NLPACK:= $(SH_BUILD_PATH)/nlpack$(EXE_EXT)
+NLPACK_SRCS:= $(wildcard $(THIS_ROOT)/tools/nlpack/*.c) $(THIS_ROOT)/source/pack.c \
+	$(THIS_ROOT)/m68k/adpcm.c
+
+$(NLPACK): $(NLPACK_SRCS) $(wildcard $(THIS_ROOT)/tools/nlpack/*.h) $(THIS_ROOT)/source/pack.h \
+	$(THIS_ROOT)/m68k/adpcm.h
+	@printf -- "$(V_BEGIN_YELLOW)$(@F)$(V_END)\n"
+	$(ECHO)$(HOST_CC) -O2 -I$(THIS_ROOT)/source -I$(THIS_ROOT)/m68k -o $@ $(NLPACK_SRCS) -lm
+
+ifneq ($(strip $(ASSET_PACK)),)
+$(ASSET_PACK): $(NLPACK) $(foreach dir,$(ASSET_DIRS),$(wildcard $(dir)/*))
+	@printf -- "$(V_BEGIN_YELLOW)$(@F)$(V_END)\n"
+	$(ECHO)$(NLPACK) -o $@ $(foreach pattern,$(ASSET_CELLS),-c '$(pattern)') $(ASSET_DIRS) > /dev/null
+endif
+
+# Sound driver (m68k/, see source/sound.h). It's built with its own
+# m68k-elf toolchain into a flat image that runs from the start of
+# sound RAM, and linked into the SH program by bin2o as
+# $(M68K_PROGRAM)_m68k, for SoundInit
+ifneq ($(strip $(M68K_PROGRAM)),)
+M68K_PREFIX?= m68k-elf-
+M68K_CC?= $(M68K_PREFIX)gcc
+M68K_OBJCOPY?= $(M68K_PREFIX)objcopy
+M68K_CFLAGS?= -m68000 -Os -Wall -ffreestanding -fno-delete-null-pointer-checks \
+	-fno-tree-loop-distribute-patterns -ffunction-sections -fdata-sections
+M68K_LDFLAGS?= -nostdlib -Wl,--gc-sections
+M68K_BUILD_PATH:= $(SH_BUILD_PATH)/m68k
+M68K_OBJS:= $(addprefix $(M68K_BUILD_PATH)/,$(notdir $(M68K_OBJECTS)))
+M68K_IMAGE:= $(SH_BUILD_PATH)/$(M68K_PROGRAM).m68k
+
+$(M68K_BUILD_PATH)/%.o: $(THIS_ROOT)/m68k/%.c $(wildcard $(THIS_ROOT)/m68k/*.h) $(THIS_ROOT)/source/sound.h
+	@printf -- "$(V_BEGIN_YELLOW)m68k/$(<F)$(V_END)\n"
+	$(ECHO)mkdir -p $(@D)
+	$(ECHO)$(M68K_CC) $(M68K_CFLAGS) -I$(THIS_ROOT)/m68k -I$(THIS_ROOT)/source -c -o $@ $<
+
+$(M68K_BUILD_PATH)/%.o: $(THIS_ROOT)/m68k/%.S
+	@printf -- "$(V_BEGIN_YELLOW)m68k/$(<F)$(V_END)\n"
+	$(ECHO)mkdir -p $(@D)
+	$(ECHO)$(M68K_CC) $(M68K_CFLAGS) -c -o $@ $<
+
+$(M68K_IMAGE).elf: $(M68K_OBJS) $(THIS_ROOT)/m68k/driver.ld
+	@printf -- "$(V_BEGIN_YELLOW)$(@F)$(V_END)\n"
+	$(ECHO)$(M68K_CC) $(M68K_CFLAGS) $(M68K_LDFLAGS) -T $(THIS_ROOT)/m68k/driver.ld -o $@ $(M68K_OBJS) -lgcc
+
+$(M68K_IMAGE).bin: $(M68K_IMAGE).elf
+	$(ECHO)$(M68K_OBJCOPY) -O binary $< $@
+
+$(M68K_IMAGE).o: $(M68K_IMAGE).bin
+	@printf -- "$(V_BEGIN_YELLOW)$(@F)$(V_END)\n"
+	$(ECHO)$(YAUL_INSTALL_ROOT)/bin/bin2o $< "$(M68K_PROGRAM)_m68k" $@
+
+SH_OBJS_UNIQ+= $(M68K_IMAGE).o
+endif
+
 build: $(SH_PROGRAM).cue
 
 $(SH_BUILD_PATH)/$(SH_PROGRAM).bin: $(SH_BUILD_PATH)/$(SH_PROGRAM).elf
@@ -182,7 +263,7 @@ $(foreach SYMBOL_DIR,$(join $(ROMDISK_SYMBOLS),$(addprefix ;,$(SH_SRCS_ROMDISK))
 		$(call macro-convert-build-path,$(call macro-word-split,$(SYMBOL_DIR),2)),\
 		$(basename $(call macro-word-split,$(SYMBOL_DIR),2)))))
 
-$(SH_PROGRAM).iso: $(SH_BUILD_PATH)/$(SH_PROGRAM).bin $(SH_BUILD_PATH)/IP.BIN
+$(SH_PROGRAM).iso: $(SH_BUILD_PATH)/$(SH_PROGRAM).bin $(SH_BUILD_PATH)/IP.BIN $(ASSET_PACK)
 	mv -f $(SH_BUILD_PATH)/IP.BIN $(IMAGE_DIRECTORY)/SAMPLEIP.BIN
 
 	@printf -- "$(V_BEGIN_YELLOW)$@$(V_END)\n"
@@ -256,6 +337,13 @@ clean:
 	    $(SH_BUILD_PATH)/IP.BIN.map \
 	    $(SH_BUILD_PATH)/CART-IP.BIN \
 	    $(SH_BUILD_PATH)/CART-IP.BIN.map \
+	    $(NLPACK) \
+	    $(NLROMFS) \
+	    $(M68K_OBJS) \
+	    $(M68K_IMAGE).elf \
+	    $(M68K_IMAGE).bin \
+	    $(M68K_IMAGE).o \
+	    $(ASSET_PACK) \
 	    $(CDB_FILE) 
 
 list-targets:
@@ -0,0 +1,340 @@
+/*****************************************************************
+*
+* background.c
+*
+* Theme screen background cache, see background.h.
+*
+* A slot holds an image's palette, padded to kPackAlign, and then
+* its pixels, so the palette can go to CRAM and the pixels to VRAM
+* straight out of it. A slot's loaded count runs over both.
+*
+*****************************************************************/
+
+#include <string.h>
+
+#include "background.h"
+
+/* What usually follows what, before the cache has seen for itself */
+
+static const signed char kBackgroundFlow[][2] =
+{
+	{ 31, 25 },		/* Intro -> ServerConnect */
+	{ 9, 10 },		/* XBANDSetup -> Phone Setup */
+	{ 14, 15 },		/* Choose Code Name -> Choose Icon */
+	{ 15, 16 },		/* Choose Icon -> Choose Taunt */
+	{ 25, 27 },		/* ServerConnect -> Matchup */
+	{ 26, 27 },		/* PeerConnection -> Matchup */
+	{ 27, 39 },		/* Matchup -> Post-Game */
+	{ 42, 44 }		/* Direct dial -> Direct Connection Set Up */
+};
+
+
+static unsigned long BackgroundAlign(unsigned long size)
+{
+	return (size + kPackAlign - 1) & ~(unsigned long)(kPackAlign - 1);
+}
+
+
+/*
+//
+// This function parses one line of the list, "ID NAME # comment",
+// into cache. Returns 0 if the image isn't in the archive; lines
+// that aren't entries are skipped.
+//
+*/
+
+static int BackgroundParseLine(BackgroundCache *cache, const char *line, const char *end)
+{
+	char name[kPackNameSize];
+	BackgroundImage *image;
+	int screen, length, iii;
+
+	while (line < end && (*line == ' ' || *line == '\t'))
+		line++;
+
+	if (line == end || *line < '0' || *line > '9')
+		return 1;
+
+	screen = 0;
+	while (line < end && *line >= '0' && *line <= '9')
+		screen = screen * 10 + *line++ - '0';
+
+	while (line < end && (*line == ' ' || *line == '\t'))
+		line++;
+
+	length = 0;
+	while (line < end && *line > ' ' && *line != '#' && length < kPackNameSize - 1)
+		name[length++] = *line++;
+	name[length] = 0;
+
+	if (screen >= kBackgroundScreens || length == 0)
+		return 1;
+
+	for (iii = 0; iii < cache->imageCount; iii++)
+	{
+		if (strcmp(cache->images[iii].asset.name, name) == 0)
+		{
+			cache->screens[screen] = (signed char)iii;
+			return 1;
+		}
+	}
+
+	if (cache->imageCount == kBackgroundImages)
+		return 0;
+
+	image = &cache->images[cache->imageCount];
+	if (!PackFind(cache->pack, name, &image->asset) || image->asset.type != kPackImage)
+		return 0;
+
+	image->size = BackgroundAlign(image->asset.paletteColors * 2) + image->asset.dataSize;
+	image->slot = -1;
+	image->next = -1;
+	cache->screens[screen] = (signed char)cache->imageCount++;
+	return 1;
+}
+
+
+static void BackgroundIdleTask(void *work)
+{
+	BackgroundIdle((BackgroundCache *)work);
+}
+
+
+int BackgroundInit(BackgroundCache *cache, const Pack *pack, BackgroundReadProc read, void *ref,
+	const char *list, unsigned long listSize, void *memory, unsigned long budget)
+{
+	const char *line, *end;
+	int iii, from, to;
+
+	memset(cache, 0, sizeof(*cache));
+	memset(cache->screens, -1, sizeof(cache->screens));
+	cache->pack = pack;
+	cache->read = read;
+	cache->ref = ref;
+	cache->memory = memory;
+	cache->current = -1;
+	cache->ahead = -1;
+
+	end = list + listSize;
+	for (line = list; line < end; line++)
+	{
+		if (!BackgroundParseLine(cache, line, end))
+			return 0;
+
+		while (line < end && *line != '\n')
+			line++;
+	}
+
+	for (iii = 0; iii < cache->imageCount; iii++)
+	{
+		if (cache->images[iii].size > cache->slotSize)
+			cache->slotSize = BackgroundAlign(cache->images[iii].size);
+	}
+
+	for (iii = 0; iii < (int)(sizeof(kBackgroundFlow) / sizeof(kBackgroundFlow[0])); iii++)
+	{
+		from = cache->screens[kBackgroundFlow[iii][0]];
+		to = cache->screens[kBackgroundFlow[iii][1]];
+		if (from >= 0 && to >= 0 && from != to)
+			cache->images[from].next = to;
+	}
+
+	/* One slot for the screen and one to read the next into */
+
+	if (cache->slotSize == 0)
+		return 0;
+
+	cache->slotCount = (int)(budget / cache->slotSize);
+	if (cache->slotCount > kBackgroundSlots)
+		cache->slotCount = kBackgroundSlots;
+
+	for (iii = 0; iii < cache->slotCount; iii++)
+		cache->slots[iii].image = -1;
+
+	if (cache->slotCount < 2)
+		return 0;
+
+	SchedAddTask(&cache->idleTask, BackgroundIdleTask, cache, 1);
+	return 1;
+}
+
+
+/*
+//
+// This function reads up to limit more bytes of the image in slot.
+// Returns 0 if the read fails, and leaves the slot as it was.
+//
+*/
+
+static int BackgroundLoad(BackgroundCache *cache, int slot, unsigned long limit,
+	unsigned long *count)
+{
+	BackgroundSlot *entry = &cache->slots[slot];
+	BackgroundImage *image = &cache->images[entry->image];
+	unsigned char *memory = cache->memory + slot * cache->slotSize;
+	unsigned long paletteSpace, size;
+
+	paletteSpace = BackgroundAlign(image->asset.paletteColors * 2);
+
+	if (entry->loaded < paletteSpace)
+	{
+		size = image->asset.paletteColors * 2;
+		if (!cache->read(image->asset.paletteOffset, memory, size, cache->ref))
+			return 0;
+
+		entry->loaded = paletteSpace;
+		*count += size;
+	}
+
+	size = image->size - entry->loaded;
+	if (size > limit)
+		size = limit;
+
+	if (size > 0)
+	{
+		if (!cache->read(image->asset.dataOffset + entry->loaded - paletteSpace,
+			memory + entry->loaded, size, cache->ref))
+			return 0;
+
+		entry->loaded += size;
+		*count += size;
+	}
+
+	return 1;
+}
+
+
+/*
+//
+// This function gives image a slot, taking the least recently shown
+// one that isn't on screen.
+//
+*/
+
+static int BackgroundTakeSlot(BackgroundCache *cache, int image)
+{
+	BackgroundSlot *entry;
+	int iii, oldest;
+
+	/* A free slot first, then the least recently shown */
+
+	oldest = -1;
+	for (iii = 0; iii < cache->slotCount; iii++)
+	{
+		entry = &cache->slots[iii];
+
+		if (entry->image >= 0 && entry->image == cache->current)
+			continue;
+
+		if (entry->image < 0)
+		{
+			oldest = iii;
+			break;
+		}
+
+		if (oldest < 0 || entry->used < cache->slots[oldest].used)
+			oldest = iii;
+	}
+
+	entry = &cache->slots[oldest];
+	if (entry->image >= 0)
+	{
+		cache->images[entry->image].slot = -1;
+		if (cache->ahead == entry->image)
+			cache->ahead = -1;
+	}
+
+	entry->image = image;
+	entry->used = 0;
+	entry->loaded = 0;
+	cache->images[image].slot = oldest;
+	return oldest;
+}
+
+
+int BackgroundShow(BackgroundCache *cache, int screen, Background *background)
+{
+	BackgroundImage *image;
+	BackgroundSlot *entry;
+	unsigned long count;
+	int index, next;
+
+	if (screen < 0 || screen >= kBackgroundScreens || cache->screens[screen] < 0)
+		return 0;
+
+	index = cache->screens[screen];
+	image = &cache->images[index];
+
+	/* Learn what follows what */
+
+	if (cache->current >= 0 && cache->current != index)
+		cache->images[cache->current].next = index;
+
+	if (image->slot < 0)
+		BackgroundTakeSlot(cache, index);
+
+	entry = &cache->slots[image->slot];
+	count = 0;
+	if (!BackgroundLoad(cache, image->slot, image->size, &count))
+		return 0;
+
+	cache->shown++;
+	if (count == 0)
+		cache->hits++;
+	cache->stallBytes += count;
+
+	if (cache->ahead == index)
+		cache->ahead = -1;
+
+	entry->used = ++cache->clock;
+	cache->current = index;
+
+	background->asset = image->asset;
+	background->palette = (const unsigned short *)(cache->memory + image->slot * cache->slotSize);
+	background->pixels = cache->memory + image->slot * cache->slotSize
+		+ BackgroundAlign(image->asset.paletteColors * 2);
+
+	/* Start on the next one */
+
+	next = image->next;
+	if (next >= 0 && next != index)
+	{
+		if (cache->images[next].slot < 0)
+			BackgroundTakeSlot(cache, next);
+
+		if (cache->slots[cache->images[next].slot].loaded < cache->images[next].size)
+			cache->ahead = next;
+	}
+
+	return 1;
+}
+
+
+void BackgroundIdle(BackgroundCache *cache)
+{
+	BackgroundImage *image;
+	unsigned long count;
+
+	if (cache->ahead < 0)
+		return;
+
+	image = &cache->images[cache->ahead];
+	count = 0;
+
+	if (!BackgroundLoad(cache, image->slot, kBackgroundChunk, &count))
+	{
+		/* BackgroundShow will try again, and wait for it */
+		cache->ahead = -1;
+		return;
+	}
+
+	cache->aheadBytes += count;
+	if (cache->slots[image->slot].loaded == image->size)
+		cache->ahead = -1;
+}
+
+
+void BackgroundEnd(BackgroundCache *cache)
+{
+	SchedRemoveTask(&cache->idleTask);
+}
@@ -0,0 +1,114 @@
+/*****************************************************************
+*
+* background.h
+*
+* Theme screen backgrounds, by the screen IDs of BGLIST00.TXT:
+*
+*	25 STANDARD.BMP		# ServerConnect Screen
+*
+* The images come out of the asset archive (pack.h) already in VDP2
+* form, so "loading" one is only reading its palette and pixels into
+* a slot of the cache. Screens that share an image share its slot.
+* The cache is a fixed number of slots, as many of the largest image
+* as the byte budget holds; the least recently shown image is the one
+* that goes.
+*
+* While a screen is up, the image most likely to follow it is read
+* ahead, kBackgroundChunk bytes each BackgroundIdle, so the CD
+* stays off the path of the transition. The likely one starts as
+* kBackgroundFlow's guess and becomes whatever actually followed
+* last time. BackgroundInit puts BackgroundIdle on the scheduler
+* (sched.h), to run every tick in the frame's idle time.
+*
+*****************************************************************/
+
+
+#ifndef __BACKGROUND__
+#define	__BACKGROUND__
+
+#include "pack.h"
+#include "sched.h"
+
+#define	kBackgroundScreens		64		/* screen IDs 0 to 63 */
+#define	kBackgroundImages		32		/* different images a list can name */
+#define	kBackgroundSlots		8
+#define	kBackgroundChunk		8192	/* bytes BackgroundIdle reads ahead */
+
+/* Reads size bytes of the archive from offset. Returns 0 if it can't. */
+
+typedef int (*BackgroundReadProc)(unsigned long offset, void *buffer, unsigned long size, void *ref);
+
+typedef struct
+{
+	PackAsset				asset;
+	const unsigned short	*palette;	/* asset.paletteColors RGB1555 colors, big-endian */
+	const unsigned char		*pixels;	/* asset.height rows of asset.rate bytes */
+} Background;
+
+typedef struct
+{
+	PackAsset		asset;
+	unsigned long	size;			/* palette and pixels, in a slot */
+	int				slot;			/* -1 if not cached */
+	int				next;			/* image likely shown after this one, -1 if none */
+} BackgroundImage;
+
+typedef struct
+{
+	int				image;			/* -1 if free */
+	unsigned long	used;			/* when last shown */
+	unsigned long	loaded;			/* bytes read so far */
+} BackgroundSlot;
+
+typedef struct
+{
+	const Pack			*pack;
+	BackgroundReadProc	read;
+	void				*ref;
+
+	unsigned char		*memory;
+	unsigned long		slotSize;
+	int					slotCount;
+	BackgroundSlot		slots[kBackgroundSlots];
+	unsigned long		clock;
+
+	signed char			screens[kBackgroundScreens];	/* image of each screen ID, -1 if none */
+	int					imageCount;
+	BackgroundImage		images[kBackgroundImages];
+
+	int					current;		/* image on screen, -1 if none */
+	int					ahead;			/* image being read ahead, -1 if none */
+
+	unsigned long		shown;
+	unsigned long		hits;			/* shown without reading anything */
+	unsigned long		stallBytes;		/* read while a screen waited */
+	unsigned long		aheadBytes;		/* read ahead */
+
+	SchedTask			idleTask;		/* runs BackgroundIdle */
+} BackgroundCache;
+
+/* Parses the list (BGLIST00.TXT) and looks its images up in pack. */
+/* memory holds the cache, budget bytes of it. Returns 0 if an image */
+/* is missing or the budget doesn't hold two images; otherwise the */
+/* cache's idle task is running, until BackgroundEnd. */
+
+int BackgroundInit(BackgroundCache *cache, const Pack *pack, BackgroundReadProc read, void *ref,
+	const char *list, unsigned long listSize, void *memory, unsigned long budget);
+
+/* Gets screen's background, reading whatever of it isn't cached, */
+/* and starts reading the next one ahead. Returns 0 if the screen */
+/* has no background or it can't be read. */
+
+int BackgroundShow(BackgroundCache *cache, int screen, Background *background);
+
+/* Reads ahead a little; the idle task calls it once a tick */
+
+void BackgroundIdle(BackgroundCache *cache);
+
+/* Takes the idle task off the scheduler. Call it before the cache */
+/* goes away or is initialized again. */
+
+void BackgroundEnd(BackgroundCache *cache);
+
+
+#endif	/* __BACKGROUND__ */
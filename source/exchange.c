@@ -0,0 +1,92 @@
+/*****************************************************************
+*
+* exchange.c
+*
+* Split-phase exchange around XBExchangeGameData, see exchange.h.
+*
+*****************************************************************/
+
+#include <stddef.h>
+
+#include "exchange.h"
+
+
+void ExchangeInit(Exchange *exchange, volatile unsigned long *ticks)
+{
+	exchange->ticks = ticks;
+	exchange->ticksPerFrame = 1;
+	exchange->lastExchange = *ticks;
+
+	exchange->state = kExchangeIdle;
+	exchange->err = XBNoErr;
+	exchange->local = NULL;
+
+	exchange->completed = 0;
+	exchange->inTransit = 0;
+	exchange->noData = 0;
+	exchange->failed = 0;
+}
+
+
+void ExchangeOpen(Exchange *exchange, int ticksPerFrame)
+{
+	exchange->ticksPerFrame = ticksPerFrame;
+	exchange->lastExchange = *exchange->ticks;
+	exchange->state = kExchangeIdle;
+	exchange->local = NULL;
+}
+
+
+void ExchangePost(Exchange *exchange, const void *local)
+{
+	exchange->local = local;
+	exchange->state = kExchangePending;
+}
+
+
+unsigned long ExchangeDue(const Exchange *exchange)
+{
+	return exchange->lastExchange + exchange->ticksPerFrame;
+}
+
+
+ExchangeState ExchangePoll(Exchange *exchange, void *master, void *slave)
+{
+	if (exchange->state != kExchangePending)
+		return exchange->state;
+
+	/* Called too early, the library would wait for the rate itself */
+
+	if (*exchange->ticks - exchange->lastExchange < (unsigned long)exchange->ticksPerFrame)
+		return kExchangePending;
+
+	exchange->err = XBExchangeGameData(exchange->local, master, slave);
+	exchange->lastExchange = *exchange->ticks;
+	exchange->local = NULL;
+
+	switch (exchange->err)
+	{
+		case XBNoErr:
+		case XBBadPacket:
+			exchange->state = kExchangeComplete;
+			exchange->completed++;
+			break;
+
+		case XBRemoteDataInTransit:
+			exchange->state = kExchangeInTransit;
+			exchange->inTransit++;
+			break;
+
+		case XBNoData:
+			exchange->state = kExchangeNoData;
+			exchange->noData++;
+			break;
+
+		default:
+			exchange->state = kExchangeFailed;
+			exchange->failed++;
+			break;
+	}
+
+	return exchange->state;
+}
@@ -0,0 +1,83 @@
+/*****************************************************************
+*
+* exchange.h
+*
+* Split-phase exchange: post the local packet, then poll for the
+* master/slave pair, around XBExchangeGameData.
+*
+* XBExchangeGameData waits inside the library when it is called
+* sooner than the session's rate allows, and again until the remote
+* half of the oldest pair arrives. ExchangePoll only goes into the
+* library once the exchange is due, so the game can run its own
+* work (the scheduler's tasks, prediction, drawing) until then
+* rather than spin in there; ExchangeDue says when that is.
+*
+* Each call to the library sends one local packet, so a poll that
+* goes in always completes the post, one way or another:
+*
+*	kExchangeComplete	a pair came back (err is XBNoErr, or
+*						XBBadPacket when only the local half did)
+*	kExchangeInTransit	the packet went out but the session's first
+*						pair hasn't come back yet (XBRemoteDataInTransit)
+*	kExchangeNoData		the packet went out but no pair came back
+*						(XBNoData); it comes with a later exchange
+*	kExchangeFailed		anything else; err says what
+*
+*****************************************************************/
+
+
+#ifndef __EXCHANGE__
+#define	__EXCHANGE__
+
+#include "XBand/XBANDLIB.H"
+
+typedef enum
+{
+	kExchangeIdle,			/* nothing posted */
+	kExchangePending,		/* posted, not due yet */
+	kExchangeComplete,
+	kExchangeInTransit,
+	kExchangeNoData,
+	kExchangeFailed
+} ExchangeState;
+
+typedef struct
+{
+	volatile unsigned long	*ticks;
+	int				ticksPerFrame;
+	unsigned long	lastExchange;	/* tick the library last returned */
+
+	ExchangeState	state;
+	XBErr			err;			/* what the library returned */
+	const void		*local;			/* the posted packet, until it goes out */
+
+	/* how posts finished */
+	unsigned long	completed;
+	unsigned long	inTransit;
+	unsigned long	noData;
+	unsigned long	failed;
+} Exchange;
+
+/* ticks is the counter the v-blank out handler advances */
+
+void ExchangeInit(Exchange *exchange, volatile unsigned long *ticks);
+
+/* Call after XBOpenSession with the session's rate */
+
+void ExchangeOpen(Exchange *exchange, int ticksPerFrame);
+
+/* Posts the local packet, which must stay put until a poll takes it */
+
+void ExchangePost(Exchange *exchange, const void *local);
+
+/* Returns kExchangePending until the exchange is due, then exchanges */
+/* and returns how it finished; the pair goes in master and slave. */
+
+ExchangeState ExchangePoll(Exchange *exchange, void *master, void *slave);
+
+/* The tick the next exchange is due */
+
+unsigned long ExchangeDue(const Exchange *exchange);
+
+
+#endif	/* __EXCHANGE__ */
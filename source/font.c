@@ -0,0 +1,288 @@
+/*****************************************************************
+*
+* font.c
+*
+* Proportional font atlas and text batching, see font.h.
+*
+*****************************************************************/
+
+#include <string.h>
+
+#include "font.h"
+
+#define	kFontNormalSprite		0x0000
+#define	kFontEndCommand			0x8000
+#define	kFontDrawMode			0x0080	/* 16-color bank, end codes off, code 0 transparent */
+
+static const unsigned char kFontPoints[kFontSizes] = { 8, 9, 10, 12, 14, 16, 18 };
+
+
+int FontSizeIndex(int points)
+{
+	int iii;
+
+	for (iii = 0; iii < kFontSizes; iii++)
+	{
+		if (kFontPoints[iii] == points)
+			return iii;
+	}
+
+	return -1;
+}
+
+
+int FontInit(Font *font, const void *wdt, unsigned long wdtSize, int points)
+{
+	const unsigned char *table;
+	int index;
+
+	memset(font, 0, sizeof(*font));
+
+	index = FontSizeIndex(points);
+	if (index < 0 || wdtSize < (unsigned long)(index + 1) * kFontTableSize)
+		return 0;
+
+	table = (const unsigned char *)wdt + index * kFontTableSize;
+	font->ascent = (table[0] + 3) / 4;
+	font->descent = (table[1] + 3) / 4;
+	memcpy(font->advance, table + kFontFirst, kFontGlyphs);
+
+	return 1;
+}
+
+
+static unsigned FontPixel(const unsigned char *sheet, unsigned long rate, int x, int y)
+{
+	unsigned char pair = sheet[y * rate + x / 2];
+
+	return (x & 1) ? (pair & 15) : (pair >> 4);
+}
+
+
+/*
+//
+// This function returns a sheet pixel with the background and color
+// 0 swapped, so the background is what VDP1 leaves transparent.
+//
+*/
+
+static unsigned FontInk(const Font *font, const unsigned char *sheet, unsigned long rate,
+	int x, int y)
+{
+	unsigned value = FontPixel(sheet, rate, x, y);
+
+	if (value == font->background)
+		return 0;
+
+	return (value == 0) ? font->background : value;
+}
+
+
+unsigned long FontUpload(Font *font, const unsigned char *sheet, int width, int height,
+	unsigned long rate, void *vram, unsigned long vramOffset, unsigned long vramSize,
+	unsigned short colorBank)
+{
+	unsigned short *out;
+	unsigned long used, bytes;
+	int cell, glyph, left, ink, spriteWidth, x, y, iii;
+	unsigned word;
+
+	if (width % kFontGlyphs != 0 || height <= 0 || height > 255 || vramOffset % 8 != 0)
+		return 0;
+
+	cell = width / kFontGlyphs;
+	font->height = height;
+	font->colorBank = colorBank;
+
+	/* The space's cell is all background */
+
+	font->background = (unsigned char)FontPixel(sheet, rate, 0, 0);
+
+	used = 0;
+	for (glyph = 0; glyph < kFontGlyphs; glyph++)
+	{
+		left = glyph * cell;
+
+		/* Trim the sprite to the ink, in the 8 pixel steps VDP1 takes */
+
+		ink = 0;
+		for (y = 0; y < height; y++)
+		{
+			for (x = ink; x < cell; x++)
+			{
+				if (FontInk(font, sheet, rate, left + x, y) != 0)
+					ink = x + 1;
+			}
+		}
+
+		if (ink == 0)
+		{
+			font->address[glyph] = 0;
+			font->size[glyph] = 0;
+			continue;
+		}
+
+		spriteWidth = (ink + 7) & ~7;
+		bytes = (unsigned long)spriteWidth / 2 * height;
+		if (((used + bytes + 7) & ~7UL) > vramSize)
+			return 0;
+
+		font->address[glyph] = (unsigned short)((vramOffset + used) / 8);
+		font->size[glyph] = (unsigned short)((spriteWidth / 8) << 8 | height);
+
+		/* VDP1 VRAM is written a word, four pixels, at a time */
+
+		out = (unsigned short *)((unsigned char *)vram + used);
+		for (y = 0; y < height; y++)
+		{
+			for (x = 0; x < spriteWidth; x += 4)
+			{
+				word = 0;
+				for (iii = 0; iii < 4; iii++)
+				{
+					word <<= 4;
+					if (x + iii < cell)
+						word |= FontInk(font, sheet, rate, left + x + iii, y);
+				}
+				*out++ = (unsigned short)word;
+			}
+		}
+
+		used = (used + bytes + 7) & ~7UL;
+	}
+
+	return used;
+}
+
+
+void FontPalette(const Font *font, const unsigned short *sheetPalette, unsigned short *palette)
+{
+	memcpy(palette, sheetPalette, 16 * sizeof(unsigned short));
+	palette[0] = sheetPalette[font->background];
+	palette[font->background] = sheetPalette[0];
+}
+
+
+int FontMeasure(const Font *font, const char *text)
+{
+	const unsigned char *in = (const unsigned char *)text;
+	unsigned long pen = 0;
+
+	for (; *in; in++)
+	{
+		if (*in >= kFontFirst && *in < kFontFirst + kFontGlyphs)
+			pen += font->advance[*in - kFontFirst];
+	}
+
+	return (int)((pen + 3) / 4);
+}
+
+
+/*
+//
+// This function lays text out into run.
+//
+*/
+
+static void FontLayout(FontRun *run, const Font *font, const char *text)
+{
+	const unsigned char *in = (const unsigned char *)run->text;
+	unsigned long pen = 0;
+	int glyph;
+
+	run->font = font;
+	strncpy(run->text, text, kFontRunLength);
+	run->text[kFontRunLength] = 0;
+	run->count = 0;
+
+	for (; *in; in++)
+	{
+		if (*in < kFontFirst || *in >= kFontFirst + kFontGlyphs)
+			continue;
+
+		glyph = *in - kFontFirst;
+		if (font->size[glyph] != 0)
+		{
+			run->x[run->count] = (short)((pen + 2) / 4);
+			run->glyph[run->count] = (unsigned char)glyph;
+			run->count++;
+		}
+
+		pen += font->advance[glyph];
+	}
+
+	run->width = (int)((pen + 3) / 4);
+}
+
+
+const FontRun *FontRunGet(FontRunCache *cache, const Font *font, const char *text)
+{
+	FontRun *run, *oldest;
+	int iii;
+
+	oldest = &cache->runs[0];
+	for (iii = 0; iii < kFontRuns; iii++)
+	{
+		run = &cache->runs[iii];
+
+		if (run->font == font && strncmp(run->text, text, kFontRunLength) == 0)
+		{
+			run->used = ++cache->clock;
+			cache->hits++;
+			return run;
+		}
+
+		if (run->used < oldest->used)
+			oldest = run;
+	}
+
+	FontLayout(oldest, font, text);
+	oldest->used = ++cache->clock;
+	cache->misses++;
+	return oldest;
+}
+
+
+void FontBatchInit(FontBatch *batch, FontCommand *commands, int capacity)
+{
+	batch->commands = commands;
+	batch->capacity = capacity;
+	batch->count = 0;
+}
+
+
+int FontDraw(FontBatch *batch, const FontRun *run, int x, int y)
+{
+	const Font *font = run->font;
+	FontCommand *command;
+	int iii;
+
+	/* Leave room for the end */
+
+	if (batch->count + run->count >= batch->capacity)
+		return 0;
+
+	for (iii = 0; iii < run->count; iii++)
+	{
+		command = &batch->commands[batch->count++];
+		memset(command, 0, sizeof(*command));
+		command->control = kFontNormalSprite;
+		command->drawMode = kFontDrawMode;
+		command->color = font->colorBank;
+		command->address = font->address[run->glyph[iii]];
+		command->size = font->size[run->glyph[iii]];
+		command->xa = (short)(x + run->x[iii]);
+		command->ya = (short)y;
+	}
+
+	return 1;
+}
+
+
+int FontBatchEnd(FontBatch *batch)
+{
+	memset(&batch->commands[batch->count], 0, sizeof(FontCommand));
+	batch->commands[batch->count].control = kFontEndCommand;
+
+	return ++batch->count;
+}
@@ -0,0 +1,130 @@
+/*****************************************************************
+*
+* font.h
+*
+* Proportional text out of the NETLINK font sheets (ARIA10.BMP,
+* LUCI8B.BMP, ...) and their width tables (ARIA.WDT, LUCIB.WDT, ...).
+*
+* A sheet is one row of kFontGlyphs cells, characters kFontFirst on,
+* each glyph at the left of its cell. A WDT has a table for each of
+* the kFontSizes point sizes, kFontTableSize bytes each: the ascent,
+* descent and cell width, and then the advance of every character
+* from kFontFirst on, all in quarter pixels. Characters are placed on
+* quarter pixels too, so the rounding doesn't add up along a string.
+*
+* FontUpload puts a sheet in VDP1 VRAM once, a sprite per glyph
+* trimmed to its ink. Text is then drawn as VDP1 normal sprite
+* commands, a glyph each, batched into the command table. Strings that
+* don't change, labels, are laid out once and kept in a FontRunCache.
+*
+*****************************************************************/
+
+
+#ifndef __FONT__
+#define	__FONT__
+
+#define	kFontFirst				32
+#define	kFontGlyphs				192
+#define	kFontSizes				7		/* 8, 9, 10, 12, 14, 16 and 18 point */
+#define	kFontTableSize			256
+#define	kFontRunLength			48		/* longest run the cache keeps */
+#define	kFontRuns				16
+
+typedef struct
+{
+	unsigned char	advance[kFontGlyphs];	/* quarter pixels */
+	int				ascent;					/* pixels */
+	int				descent;
+	int				height;					/* of the sheet */
+	unsigned char	background;				/* the sheet's background color, which goes to 0 */
+	unsigned short	colorBank;
+	unsigned short	address[kFontGlyphs];	/* VDP1 character address, 8-byte units */
+	unsigned short	size[kFontGlyphs];		/* VDP1 character size, 0 for no ink */
+} Font;
+
+typedef struct
+{
+	const Font		*font;
+	char			text[kFontRunLength + 1];
+	int				count;
+	int				width;					/* pixels */
+	short			x[kFontRunLength];		/* of each glyph, pixels */
+	unsigned char	glyph[kFontRunLength];
+	unsigned long	used;
+} FontRun;
+
+typedef struct
+{
+	FontRun			runs[kFontRuns];
+	unsigned long	clock;
+	unsigned long	hits;
+	unsigned long	misses;
+} FontRunCache;
+
+/* A VDP1 command table entry */
+
+typedef struct
+{
+	unsigned short	control;
+	unsigned short	link;
+	unsigned short	drawMode;
+	unsigned short	color;
+	unsigned short	address;
+	unsigned short	size;
+	short			xa, ya, xb, yb, xc, yc, xd, yd;
+	unsigned short	gouraud;
+	unsigned short	reserved;
+} FontCommand;
+
+typedef struct
+{
+	FontCommand		*commands;
+	int				capacity;
+	int				count;
+} FontBatch;
+
+/* The WDT table of a point size, -1 if there isn't one */
+
+int FontSizeIndex(int points);
+
+/* Reads the widths of a point size out of a WDT. Returns 0 if the */
+/* WDT is too short or has no such size. */
+
+int FontInit(Font *font, const void *wdt, unsigned long wdtSize, int points);
+
+/* Writes the glyphs of a 4-bit sheet of width by height pixels, */
+/* rate bytes a row, to VDP1 VRAM at vram, which is vramOffset bytes */
+/* into it and has vramSize bytes free. colorBank is the CMDCOLR of */
+/* the sheet's palette. Returns the bytes used, 0 if the sheet isn't */
+/* kFontGlyphs cells or doesn't fit. */
+
+unsigned long FontUpload(Font *font, const unsigned char *sheet, int width, int height,
+	unsigned long rate, void *vram, unsigned long vramOffset, unsigned long vramSize,
+	unsigned short colorBank);
+
+/* The sheet's 16 colors for CRAM, rearranged as FontUpload did */
+
+void FontPalette(const Font *font, const unsigned short *sheetPalette, unsigned short *palette);
+
+/* Width of text in pixels */
+
+int FontMeasure(const Font *font, const char *text);
+
+/* Lays text out, or finds it laid out already. Text longer than */
+/* kFontRunLength is cut short. */
+
+const FontRun *FontRunGet(FontRunCache *cache, const Font *font, const char *text);
+
+void FontBatchInit(FontBatch *batch, FontCommand *commands, int capacity);
+
+/* Adds a sprite for each glyph of run, with its top left at x, y. */
+/* Returns 0, having added none, if they don't fit. */
+
+int FontDraw(FontBatch *batch, const FontRun *run, int x, int y);
+
+/* Ends the command table; returns the commands in it */
+
+int FontBatchEnd(FontBatch *batch);
+
+
+#endif	/* __FONT__ */
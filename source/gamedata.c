@@ -0,0 +1,277 @@
+/*****************************************************************
+*
+* gamedata.c
+*
+* Game data packet codec, see gamedata.h for the bit layout.
+*
+* The variable-length fields are placed with shift amounts worked
+* out from the flag bits instead of with if statements, so encoding
+* and decoding cost the same whatever the input does.
+*
+*****************************************************************/
+
+#include <string.h>
+
+#include "gamedata.h"
+
+/* Saturn digital pads only use bits 15-3 */
+
+#define	kJoypadShift	3
+#define	kJoypadBits		13
+#define	kJoypadMask		((1U << kJoypadBits) - 1)
+#define	kFrameBits		8
+#define	kFrameMask		((1U << kFrameBits) - 1)
+
+
+/*
+//
+// This function packs a frame into the 32-bit core word.
+//
+*/
+
+static inline uint32_t GameDataEncodeCore(GameDataStream *stream, const GameData *data)
+{
+	uint32_t word, same, next, changed, width;
+	int pos;
+
+	changed = ((uint32_t)(data->joypad ^ stream->joypad) >> kJoypadShift) & kJoypadMask;
+	same = (changed == 0);
+	next = ((uint32_t)data->frameCount == (uint32_t)stream->frameCount + 1);
+
+	word = ((uint32_t)(unsigned char)data->checksum << 24)
+		| (((uint32_t)data->finished & 1) << 23)
+		| (same << 22);
+	pos = 22;
+
+	width = kJoypadBits & (same - 1);
+	pos -= width;
+	word |= (changed & -(1 - same)) << pos;
+
+	pos -= 1;
+	word |= next << pos;
+
+	width = kFrameBits & (next - 1);
+	pos -= width;
+	word |= ((uint32_t)data->frameCount & kFrameMask & -(1 - next)) << pos;
+
+	stream->joypad = data->joypad;
+	stream->frameCount = data->frameCount;
+
+	return word;
+}
+
+
+/*
+//
+// This function unpacks the 32-bit core word.
+//
+*/
+
+static inline void GameDataDecodeCore(GameDataStream *stream, uint32_t word, GameData *data)
+{
+	uint32_t same, next, changed, width, delta;
+	int pos;
+
+	data->checksum = (char)(word >> 24);
+	data->finished = (short)((word >> 23) & 1);
+	same = (word >> 22) & 1;
+	pos = 22;
+
+	width = kJoypadBits & (same - 1);
+	pos -= width;
+	changed = (word >> pos) & kJoypadMask & -(1 - same);
+
+	pos -= 1;
+	next = (word >> pos) & 1;
+
+	width = kFrameBits & (next - 1);
+	pos -= width;
+	delta = (((word >> pos) & kFrameMask) - (uint32_t)stream->frameCount) & kFrameMask;
+	delta += (1 - delta) & -next;
+
+	data->joypad = (unsigned short)(stream->joypad ^ (changed << kJoypadShift));
+	data->frameCount = (int32_t)((uint32_t)stream->frameCount + delta);
+
+	stream->joypad = data->joypad;
+	stream->frameCount = data->frameCount;
+}
+
+
+/*
+//
+// One encoder/decoder pair per packet size. The core word goes out
+// big-endian; the rest of the packet is padding[].
+//
+*/
+
+#define	GAMEDATA_CODEC(size)	\
+	static void GameDataEncode##size(GameDataStream *stream, const GameData *data, unsigned char *packet)	\
+	{	\
+		uint32_t word = GameDataEncodeCore(stream, data);	\
+		packet[0] = (unsigned char)(word >> 24);	\
+		packet[1] = (unsigned char)(word >> 16);	\
+		packet[2] = (unsigned char)(word >> 8);	\
+		packet[3] = (unsigned char)word;	\
+		memcpy(packet + 4, data->padding, (size) - 4);	\
+	}	\
+	static void GameDataDecode##size(GameDataStream *stream, const unsigned char *packet, GameData *data)	\
+	{	\
+		uint32_t word = ((uint32_t)packet[0] << 24) | ((uint32_t)packet[1] << 16)	\
+			| ((uint32_t)packet[2] << 8) | packet[3];	\
+		GameDataDecodeCore(stream, word, data);	\
+		memcpy(data->padding, packet + 4, (size) - 4);	\
+	}
+
+GAMEDATA_CODEC(4)
+GAMEDATA_CODEC(5)
+GAMEDATA_CODEC(6)
+GAMEDATA_CODEC(7)
+GAMEDATA_CODEC(8)
+GAMEDATA_CODEC(9)
+GAMEDATA_CODEC(10)
+GAMEDATA_CODEC(11)
+GAMEDATA_CODEC(12)
+GAMEDATA_CODEC(13)
+GAMEDATA_CODEC(14)
+
+#define	GAMEDATA_CODEC_ENTRY(size)	{ size, GameDataEncode##size, GameDataDecode##size }
+
+static const GameDataCodec gGameDataCodecs[kGameDataMaxPacket - kGameDataMinPacket + 1] =
+{
+	GAMEDATA_CODEC_ENTRY(4),
+	GAMEDATA_CODEC_ENTRY(5),
+	GAMEDATA_CODEC_ENTRY(6),
+	GAMEDATA_CODEC_ENTRY(7),
+	GAMEDATA_CODEC_ENTRY(8),
+	GAMEDATA_CODEC_ENTRY(9),
+	GAMEDATA_CODEC_ENTRY(10),
+	GAMEDATA_CODEC_ENTRY(11),
+	GAMEDATA_CODEC_ENTRY(12),
+	GAMEDATA_CODEC_ENTRY(13),
+	GAMEDATA_CODEC_ENTRY(14)
+};
+
+
+const GameDataCodec *GameDataCodecForSize(int size)
+{
+	if (size < kGameDataMinPacket)
+		size = kGameDataMinPacket;
+	if (size > kGameDataMaxPacket)
+		size = kGameDataMaxPacket;
+
+	return &gGameDataCodecs[size - kGameDataMinPacket];
+}
+
+
+void GameDataStreamReset(GameDataStream *stream)
+{
+	stream->joypad = 0;
+	stream->frameCount = -1;
+}
+
+
+void GameDataStreamSkip(GameDataStream *stream)
+{
+	stream->frameCount++;
+}
+
+
+/*
+//
+// Input history.
+//
+*/
+
+void GameDataHistoryReset(GameDataHistory *history)
+{
+	memset(history, 0, sizeof(*history));
+}
+
+
+void GameDataHistoryPush(GameDataHistory *history, unsigned short joypad)
+{
+	memmove(&history->joypad[1], &history->joypad[0],
+		kGameDataHistoryFrames * sizeof(history->joypad[0]));
+	history->joypad[0] = joypad;
+}
+
+
+void GameDataPutHistory(const GameDataHistory *history, char *padding, int bytes)
+{
+	unsigned char *out = (unsigned char *)padding;
+	uint32_t changed;
+	int i, bit, width, bits;
+
+	memset(out, 0, bytes);
+	bits = bytes * 8;
+	bit = 0;
+
+	for (i = 0; i < kGameDataHistoryFrames; i++)
+	{
+		changed = ((uint32_t)(history->joypad[i] ^ history->joypad[i + 1]) >> kJoypadShift) & kJoypadMask;
+
+		/* the flag bit, then the mask unless nothing changed */
+
+		width = (changed == 0) ? 1 : 1 + kJoypadBits;
+		if (bit + width > bits)
+			break;
+
+		changed |= (changed == 0);
+
+		while (width-- > 0)
+		{
+			if ((changed >> width) & 1)
+				out[bit >> 3] |= 0x80 >> (bit & 7);
+			bit++;
+		}
+	}
+}
+
+
+int GameDataRecover(GameDataStream *stream, const unsigned char *packet, int size,
+	int lost, unsigned short *joypads)
+{
+	unsigned short changes[kGameDataHistoryFrames];
+	unsigned short joypad;
+	int i, bit, bits, count, j;
+
+	if (lost > kGameDataHistoryFrames)
+		return 0;
+
+	bits = (size - 4) * 8;
+	bit = 0;
+
+	for (count = 0; count < lost; count++)
+	{
+		if (bit >= bits)
+			return 0;
+
+		if (packet[4 + (bit >> 3)] & (0x80 >> (bit & 7)))
+		{
+			changes[count] = 0;
+			bit++;
+			continue;
+		}
+
+		if (bit + 1 + kJoypadBits > bits)
+			return 0;
+
+		bit++;
+		changes[count] = 0;
+		for (j = 0; j < kJoypadBits; j++, bit++)
+			changes[count] = (unsigned short)((changes[count] << 1)
+				| ((packet[4 + (bit >> 3)] >> (7 - (bit & 7))) & 1));
+	}
+
+	/* changes[i] took frame (packet - i - 2) to frame (packet - i - 1) */
+
+	joypad = stream->joypad;
+	for (i = lost - 1; i >= 0; i--)
+	{
+		joypad ^= (unsigned short)(changes[i] << kJoypadShift);
+		joypads[lost - 1 - i] = joypad;
+	}
+	stream->joypad = joypad;
+
+	return 1;
+}
@@ -0,0 +1,104 @@
+/*****************************************************************
+*
+* gamedata.h
+*
+* The game data packet passed to XBExchangeGameData, and the codec
+* that packs it for the wire.
+*
+* A whole frame fits in the first four bytes:
+*
+*	bits 31-24	checksum, a byte of an earlier frame's state hash (statehash.h)
+*	bit  23		finished
+*	bit  22		1 = joypad unchanged, else 13 bits of changed buttons follow
+*	next bit	1 = frameCount is the previous one plus one, else
+*				8 low bits of frameCount follow
+*
+* Joypad and frame count are coded against the previous packet of
+* the same stream, so both ends must see every packet of a session
+* in order (the library guarantees that) and reset their streams
+* when a session opens. Bytes after the fourth carry padding[], or
+* the input history below.
+*
+* There is one encoder/decoder pair per packet size, generated at
+* compile time, so the per-frame path has no size checks.
+*
+*****************************************************************/
+
+
+#ifndef __GAMEDATA__
+#define	__GAMEDATA__
+
+#include <stdint.h>
+
+#define	kGameDataMinPacket		4
+#define	kGameDataMaxPacket		14
+
+/* Game data struct. This is what the game fills in and reads back */
+
+typedef struct
+{
+	unsigned short joypad;
+	short finished;
+	int32_t frameCount;	/* 32 bits, even on LP64 hosts */
+	char checksum;
+	char padding[14];	/* to make room for game data packets up to 14 bytes in length */
+} GameData;
+
+/* What a stream remembers about its previous packet */
+
+typedef struct
+{
+	unsigned short	joypad;
+	int32_t			frameCount;
+} GameDataStream;
+
+typedef struct
+{
+	int		size;
+	void	(*encode)(GameDataStream *stream, const GameData *data, unsigned char *packet);
+	void	(*decode)(GameDataStream *stream, const unsigned char *packet, GameData *data);
+} GameDataCodec;
+
+/* Codec for a packet size, clamped to kGameDataMinPacket..kGameDataMaxPacket */
+
+const GameDataCodec *GameDataCodecForSize(int size);
+
+/* Start of session: the next frameCount expected is 0 */
+
+void GameDataStreamReset(GameDataStream *stream);
+
+/* A packet of this stream was lost: expect the frame after it next */
+
+void GameDataStreamSkip(GameDataStream *stream);
+
+/*
+// Input history (opt-in). The bytes after the core word can carry
+// the joypad changes of the frames before this one, newest first:
+// a 1 bit for "no change", or a 0 bit and the 13-bit change mask.
+// Entries that don't fit are left out. A receiver that lost packets
+// rebuilds their joypads from the next packet that gets through.
+*/
+
+#define	kGameDataHistoryFrames	8
+
+typedef struct
+{
+	unsigned short	joypad[kGameDataHistoryFrames + 1];	/* last frames sent, newest first */
+} GameDataHistory;
+
+void GameDataHistoryReset(GameDataHistory *history);
+void GameDataHistoryPush(GameDataHistory *history, unsigned short joypad);
+
+/* Writes the history into the first bytes of padding[] */
+
+void GameDataPutHistory(const GameDataHistory *history, char *padding, int bytes);
+
+/* Rebuilds the joypads of the lost frames just before packet, oldest first, */
+/* and brings stream up to date so the packet itself can be decoded. */
+/* Returns 0 if the packet doesn't reach back far enough. */
+
+int GameDataRecover(GameDataStream *stream, const unsigned char *packet, int size,
+	int lost, unsigned short *joypads);
+
+
+#endif	/* __GAMEDATA__ */
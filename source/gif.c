@@ -0,0 +1,570 @@
+/*****************************************************************
+*
+* gif.c
+*
+* Streaming GIF decoder, see gif.h.
+*
+* The blocks around the image data are taken a byte at a time, with
+* headers gathered into held[] until they're whole. The image data
+* sub-blocks are handed to the LZW decoder in as big pieces as have
+* arrived, and it keeps its own state in the decoder between them.
+*
+*****************************************************************/
+
+#include <string.h>
+
+#include "gif.h"
+
+/* Decoder states */
+
+enum
+{
+	kGifStateHeader,
+	kGifStatePalette,
+	kGifStateBlock,
+	kGifStateLabel,
+	kGifStateExtensionSize,
+	kGifStateExtension,
+	kGifStateDescriptor,
+	kGifStateLocalPalette,
+	kGifStateCodeSize,
+	kGifStateDataSize,
+	kGifStateData,
+	kGifStateDone,
+	kGifStateFailed
+};
+
+#define	kGifHeaderSize			13
+#define	kGifDescriptorSize		9
+#define	kGifExtension			0x21
+#define	kGifImage				0x2C
+#define	kGifTrailer				0x3B
+#define	kGifControl				0xF9	/* the graphic control extension */
+
+static const unsigned short kGifMasks[13] =
+{
+	0x0000, 0x0001, 0x0003, 0x0007, 0x000F, 0x001F, 0x003F,
+	0x007F, 0x00FF, 0x01FF, 0x03FF, 0x07FF, 0x0FFF
+};
+
+static const unsigned char kGifPassStart[4] = { 0, 4, 2, 1 };
+static const unsigned char kGifPassStep[4] = { 8, 8, 4, 2 };
+
+
+static unsigned GifGet16(const unsigned char *in)
+{
+	return in[0] | (in[1] << 8);
+}
+
+
+void GifInit(GifDecoder *decoder, const GifTarget *target)
+{
+	decoder->target = *target;
+	decoder->state = kGifStateHeader;
+	decoder->heldCount = 0;
+	decoder->need = kGifHeaderSize;
+	decoder->width = 0;
+	decoder->height = 0;
+	decoder->transparent = -1;
+	decoder->colors = 0;
+	decoder->flags = 0;
+	decoder->rows = 0;
+}
+
+
+/*
+//
+// This function gathers up to need bytes into buffer. Returns the
+// bytes it took from in.
+//
+*/
+
+static unsigned long GifGather(GifDecoder *decoder, unsigned char *buffer,
+	const unsigned char *in, unsigned long size)
+{
+	unsigned long count = decoder->need - decoder->heldCount;
+
+	if (count > size)
+		count = size;
+
+	memcpy(buffer + decoder->heldCount, in, count);
+	decoder->heldCount += (int)count;
+	return count;
+}
+
+
+/*
+//
+// This function arranges the frame's colors for the target, as
+// gif.h describes, and gets the LZW decoder ready.
+//
+*/
+
+static int GifStartFrame(GifDecoder *decoder, int tableColors)
+{
+	const unsigned char *rgb;
+	int limit, shift, code, iii;
+
+	if (tableColors == 0 || decoder->frameWidth > kGifMaxWidth || decoder->frameWidth == 0
+		|| decoder->frameHeight == 0)
+		return 0;
+
+	limit = 1 << decoder->target.bits;
+	shift = 0;
+	decoder->flags = 0;
+
+	/* Color 0 only swaps with the transparent color if the target */
+	/* has its code; if not, the colors move up one instead, and the */
+	/* transparent color is one of the rest drawn as code 0 */
+
+	if (decoder->transparent >= 0 && decoder->transparent < tableColors)
+	{
+		decoder->flags = kPackTransparent;
+		if (decoder->transparent >= limit)
+			shift = 1;
+	}
+	else if (tableColors < limit)
+		shift = 1;
+	else
+		decoder->flags = kPackZeroOpaque;
+
+	memset(decoder->map, 0, sizeof(decoder->map));
+	memset(decoder->palette, 0, sizeof(decoder->palette));
+
+	for (iii = 0; iii < tableColors; iii++)
+	{
+		code = iii + shift;
+		if ((decoder->flags & kPackTransparent) && shift == 0)
+		{
+			if (iii == decoder->transparent)
+				code = 0;
+			else if (iii == 0)
+				code = decoder->transparent;
+		}
+
+		if (code >= limit)
+			continue;
+
+		rgb = decoder->rgb + iii * 3;
+		decoder->map[iii] = (unsigned char)code;
+		decoder->palette[code] = (unsigned short)(0x8000 | ((rgb[2] >> 3) << 10)
+			| ((rgb[1] >> 3) << 5) | (rgb[0] >> 3));
+	}
+
+	decoder->colors = (tableColors + shift < limit) ? tableColors + shift : limit;
+
+	decoder->pass = 0;
+	decoder->y = 0;
+	decoder->rows = 0;
+	return 1;
+}
+
+
+static void GifStartCodes(GifDecoder *decoder, int minSize)
+{
+	int clear = 1 << minSize, iii;
+
+	decoder->minSize = minSize;
+	decoder->codeSize = minSize + 1;
+	decoder->next = clear + 2;
+	decoder->previous = -1;
+	decoder->bits = 0;
+	decoder->bitCount = 0;
+	decoder->count = 0;
+
+	for (iii = 0; iii < clear; iii++)
+	{
+		decoder->suffix[iii] = (unsigned char)iii;
+		decoder->length[iii] = 1;
+	}
+}
+
+
+/*
+//
+// This function writes a finished row of the frame to the target,
+// and moves on to the next row, pass by pass if it's interlaced.
+//
+*/
+
+static void GifPutRow(GifDecoder *decoder, const unsigned char *in)
+{
+	const GifTarget *target = &decoder->target;
+	const unsigned char *map = decoder->map;
+	unsigned char *out;
+	unsigned long base, stride;
+	int x, end, y, count;
+
+	y = decoder->top + decoder->y;
+	x = decoder->left;
+	end = decoder->left + decoder->frameWidth;
+	if (end > target->width)
+		end = target->width;
+
+	/* 8 pixels at a time, which are together in rows and cells alike */
+
+	if (y < target->height)
+	{
+		if (target->layout == kPackCells)
+		{
+			stride = 8 * target->bits;
+			base = (unsigned long)(y / 8) * ((target->width + 7) / 8) * stride
+				+ (y & 7) * target->bits;
+		}
+		else
+		{
+			stride = target->bits;
+			base = (unsigned long)y * target->rate;
+		}
+
+		while (x < end)
+		{
+			out = target->pixels + base + (x / 8) * stride;
+			count = 8 - (x & 7);
+			if (count > end - x)
+				count = end - x;
+
+			if (target->bits == 8)
+			{
+				out += x & 7;
+				for (; count > 0; count--, x++)
+					*out++ = map[*in++];
+			}
+			else
+			{
+				for (; count > 0; count--, x++)
+				{
+					if (x & 1)
+						out[(x & 7) / 2] = (out[(x & 7) / 2] & 0xF0) | map[*in++];
+					else
+						out[(x & 7) / 2] = (out[(x & 7) / 2] & 0x0F) | (map[*in++] << 4);
+				}
+			}
+		}
+	}
+
+	decoder->rows++;
+	if (!decoder->interlaced)
+	{
+		decoder->y++;
+		return;
+	}
+
+	decoder->y += kGifPassStep[decoder->pass];
+	while (decoder->y >= decoder->frameHeight && decoder->pass < 3)
+	{
+		decoder->pass++;
+		decoder->y = kGifPassStart[decoder->pass];
+	}
+}
+
+
+/*
+//
+// This function decodes size bytes of LZW data. Returns 0 if a code
+// is out of place.
+//
+*/
+
+static int GifCodes(GifDecoder *decoder, const unsigned char *in, unsigned long size)
+{
+	unsigned char *row = decoder->row;
+	unsigned short *prefix = decoder->prefix;
+	unsigned char *suffix = decoder->suffix;
+	unsigned short *length = decoder->length;
+	unsigned char *out;
+	unsigned long bits = decoder->bits;
+	int bitCount = decoder->bitCount;
+	int codeSize = decoder->codeSize;
+	int next = decoder->next;
+	int previous = decoder->previous;
+	int count = decoder->count;
+	int width = decoder->frameWidth;
+	int clear = 1 << decoder->minSize;
+	int code, string, start;
+
+	while (size-- > 0)
+	{
+		bits |= (unsigned long)*in++ << bitCount;
+		bitCount += 8;
+
+		while (bitCount >= codeSize)
+		{
+			code = bits & kGifMasks[codeSize];
+			bits >>= codeSize;
+			bitCount -= codeSize;
+
+			if (code == clear)
+			{
+				codeSize = decoder->minSize + 1;
+				next = clear + 2;
+				previous = -1;
+				continue;
+			}
+
+			if (code == clear + 1)
+			{
+				decoder->state = kGifStateDone;
+				return 1;
+			}
+
+			if (previous < 0)
+			{
+				if (code > clear)
+					return 0;
+
+				row[count++] = (unsigned char)code;
+				previous = code;
+			}
+			else
+			{
+				/* A code not in the table yet is the previous string */
+				/* and its own first pixel */
+
+				if (code > next)
+					return 0;
+
+				string = (code == next) ? previous : code;
+				out = row + count + length[string] - 1;
+				while (string >= clear)
+				{
+					*out-- = suffix[string];
+					string = prefix[string];
+				}
+				*out = (unsigned char)string;
+
+				if (code == next)
+				{
+					row[count + length[previous]] = (unsigned char)string;
+					count += length[previous] + 1;
+				}
+				else
+					count += length[code];
+
+				if (next < kGifMaxCodes)
+				{
+					prefix[next] = (unsigned short)previous;
+					suffix[next] = (unsigned char)string;
+					length[next] = length[previous] + 1;
+					next++;
+
+					if (next == (1 << codeSize) && codeSize < 12)
+						codeSize++;
+				}
+
+				previous = code;
+			}
+
+			if (count >= width)
+			{
+				start = 0;
+				while (count - start >= width && decoder->state != kGifStateDone)
+				{
+					GifPutRow(decoder, row + start);
+					start += width;
+
+					if (decoder->rows == decoder->frameHeight)
+						decoder->state = kGifStateDone;
+				}
+
+				if (decoder->state == kGifStateDone)
+					return 1;
+
+				count -= start;
+				memmove(row, row + start, count);
+			}
+		}
+	}
+
+	decoder->bits = bits;
+	decoder->bitCount = bitCount;
+	decoder->codeSize = codeSize;
+	decoder->next = next;
+	decoder->previous = previous;
+	decoder->count = count;
+	return 1;
+}
+
+
+int GifFeed(GifDecoder *decoder, const void *data, unsigned long size)
+{
+	const unsigned char *in = (const unsigned char *)data;
+	const unsigned char *end = in + size;
+	unsigned long count;
+	int flags;
+
+	while (in < end)
+	{
+		switch (decoder->state)
+		{
+			case kGifStateHeader:
+				in += GifGather(decoder, decoder->held, in, end - in);
+				if (decoder->heldCount < decoder->need)
+					break;
+
+				if (memcmp(decoder->held, "GIF87a", 6) != 0 && memcmp(decoder->held, "GIF89a", 6) != 0)
+				{
+					decoder->state = kGifStateFailed;
+					return 0;
+				}
+
+				decoder->width = GifGet16(decoder->held + 6);
+				decoder->height = GifGet16(decoder->held + 8);
+				flags = decoder->held[10];
+				decoder->background = decoder->held[11];
+
+				decoder->heldCount = 0;
+				decoder->state = kGifStateBlock;
+				if (flags & 0x80)
+				{
+					decoder->colors = 2 << (flags & 7);
+					decoder->need = decoder->colors * 3;
+					decoder->state = kGifStatePalette;
+				}
+				break;
+
+			case kGifStatePalette:
+			case kGifStateLocalPalette:
+				in += GifGather(decoder, decoder->rgb, in, end - in);
+				if (decoder->heldCount < decoder->need)
+					break;
+
+				decoder->heldCount = 0;
+				if (decoder->state == kGifStatePalette)
+					decoder->state = kGifStateBlock;
+				else if (GifStartFrame(decoder, decoder->need / 3))
+					decoder->state = kGifStateCodeSize;
+				else
+				{
+					decoder->state = kGifStateFailed;
+					return 0;
+				}
+				break;
+
+			case kGifStateBlock:
+				switch (*in++)
+				{
+					case kGifExtension:
+						decoder->state = kGifStateLabel;
+						break;
+
+					case kGifImage:
+						decoder->heldCount = 0;
+						decoder->need = kGifDescriptorSize;
+						decoder->state = kGifStateDescriptor;
+						break;
+
+					default:
+						/* The trailer, with no frame yet, or garbage */
+						decoder->state = kGifStateFailed;
+						return 0;
+				}
+				break;
+
+			case kGifStateLabel:
+				decoder->label = *in++;
+				decoder->blockIndex = 0;
+				decoder->state = kGifStateExtensionSize;
+				break;
+
+			case kGifStateExtensionSize:
+				decoder->blockLeft = *in++;
+				decoder->state = decoder->blockLeft ? kGifStateExtension : kGifStateBlock;
+				break;
+
+			case kGifStateExtension:
+				/* The graphic control extension has the transparent color */
+
+				if (decoder->label == kGifControl)
+				{
+					if (decoder->blockIndex == 0)
+						decoder->held[0] = *in;
+					else if (decoder->blockIndex == 3 && (decoder->held[0] & 1))
+						decoder->transparent = *in;
+				}
+
+				in++;
+				decoder->blockIndex++;
+				if (--decoder->blockLeft == 0)
+					decoder->state = kGifStateExtensionSize;
+				break;
+
+			case kGifStateDescriptor:
+				in += GifGather(decoder, decoder->held, in, end - in);
+				if (decoder->heldCount < decoder->need)
+					break;
+
+				decoder->left = GifGet16(decoder->held);
+				decoder->top = GifGet16(decoder->held + 2);
+				decoder->frameWidth = GifGet16(decoder->held + 4);
+				decoder->frameHeight = GifGet16(decoder->held + 6);
+				flags = decoder->held[8];
+				decoder->interlaced = (flags & 0x40) != 0;
+
+				decoder->heldCount = 0;
+				if (flags & 0x80)
+				{
+					decoder->need = (2 << (flags & 7)) * 3;
+					decoder->state = kGifStateLocalPalette;
+				}
+				else if (GifStartFrame(decoder, decoder->colors))
+					decoder->state = kGifStateCodeSize;
+				else
+				{
+					decoder->state = kGifStateFailed;
+					return 0;
+				}
+				break;
+
+			case kGifStateCodeSize:
+				if (*in < 2 || *in > 8)
+				{
+					decoder->state = kGifStateFailed;
+					return 0;
+				}
+
+				GifStartCodes(decoder, *in++);
+				decoder->state = kGifStateDataSize;
+				break;
+
+			case kGifStateDataSize:
+				decoder->blockLeft = *in++;
+
+				/* Short data: the rows that didn't come stay as they were */
+
+				decoder->state = decoder->blockLeft ? kGifStateData : kGifStateDone;
+				break;
+
+			case kGifStateData:
+				count = end - in;
+				if (count > (unsigned long)decoder->blockLeft)
+					count = decoder->blockLeft;
+
+				if (!GifCodes(decoder, in, count))
+				{
+					decoder->state = kGifStateFailed;
+					return 0;
+				}
+
+				in += count;
+				decoder->blockLeft -= (int)count;
+				if (decoder->blockLeft == 0 && decoder->state == kGifStateData)
+					decoder->state = kGifStateDataSize;
+				break;
+
+			case kGifStateDone:
+				return 1;
+
+			default:
+				return 0;
+		}
+	}
+
+	return decoder->state != kGifStateFailed;
+}
+
+
+int GifDone(const GifDecoder *decoder)
+{
+	return decoder->state == kGifStateDone;
+}
@@ -0,0 +1,115 @@
+/*****************************************************************
+*
+* gif.h
+*
+* Streaming GIF decoder for the NETLINK art (CURSOR.GIF, ICONS.GIF,
+* TILE2.GIF, HOME_B.GIF, ...), straight into VRAM.
+*
+* GifFeed takes the file a piece at a time, a CD sector or whatever
+* has arrived, and carries on from where the last piece stopped, in
+* a block header or in the middle of an LZW code. Rows are written
+* to the target as they are finished, so an image can be shown while
+* it is still coming in; interlaced images fill in a pass at a time.
+*
+* The LZW string table is fixed at the 4096 codes GIF allows, and
+* every string's length is kept with it, so a code's pixels are
+* written back to front, straight into the row being built, without
+* a stack. The row buffer is a row and the longest string long; a
+* string that runs off the end of a row is carried into the next.
+* Codes are cut out of a bit accumulator with a mask table.
+*
+* Pixels go out as 4- or 8-bit codes, in rows (VDP1 sprites, VDP2
+* bitmaps) or 8x8 VDP2 cells, the layouts of pack.h. The colors are
+* arranged the way nlpack arranges them: the transparent color moves
+* to code 0, or else everything moves up one to keep code 0 free if
+* the palette leaves room, or else kPackZeroOpaque is set. A 4-bit
+* target keeps the first 16 codes and draws the rest as code 0; a
+* transparent color past them is one of the rest, and the colors
+* move up one, as color 0 has no code of its own to swap into.
+*
+* Only the first frame is decoded. What it doesn't cover of the
+* target is left as it was.
+*
+*****************************************************************/
+
+
+#ifndef __GIF__
+#define	__GIF__
+
+#include "pack.h"
+
+#define	kGifMaxCodes			4096
+#define	kGifMaxWidth			1024
+#define	kGifMaxColors			256
+
+typedef struct
+{
+	unsigned char	*pixels;
+	int				width;				/* pixels */
+	int				height;
+	unsigned long	rate;				/* bytes a row, for kPackRows */
+	unsigned char	layout;				/* kPackRows or kPackCells */
+	unsigned char	bits;				/* 4 or 8 */
+} GifTarget;
+
+typedef struct
+{
+	GifTarget		target;
+	int				state;
+	unsigned char	held[16];			/* a header being gathered */
+	int				heldCount;
+	int				need;
+	int				label;				/* of the extension being skipped */
+	int				blockLeft;
+	int				blockIndex;
+
+	/* the file, once its header has been read */
+	int				width;				/* logical screen */
+	int				height;
+	int				background;
+	int				transparent;		/* -1 for none */
+
+	/* the frame */
+	int				left;
+	int				top;
+	int				frameWidth;
+	int				frameHeight;
+	int				interlaced;
+	int				pass;
+	int				y;					/* next row of the frame to write */
+	int				rows;				/* rows written so far */
+
+	/* colors, arranged for the target */
+	int				colors;
+	unsigned char	flags;				/* kPackTransparent, kPackZeroOpaque */
+	unsigned char	map[kGifMaxColors];
+	unsigned short	palette[kGifMaxColors];		/* RGB1555 for CRAM */
+	unsigned char	rgb[kGifMaxColors * 3];
+
+	/* LZW */
+	unsigned long	bits;
+	int				bitCount;
+	int				minSize;
+	int				codeSize;
+	int				next;
+	int				previous;			/* -1 after a clear */
+	int				count;				/* pixels in row */
+	unsigned short	prefix[kGifMaxCodes];
+	unsigned char	suffix[kGifMaxCodes];
+	unsigned short	length[kGifMaxCodes];
+	unsigned char	row[kGifMaxWidth + kGifMaxCodes];
+} GifDecoder;
+
+void GifInit(GifDecoder *decoder, const GifTarget *target);
+
+/* Decodes size more bytes of the file. Returns 0 if it isn't a GIF */
+/* or is broken; the decoder then stays failed. */
+
+int GifFeed(GifDecoder *decoder, const void *data, unsigned long size);
+
+/* The first frame is all written */
+
+int GifDone(const GifDecoder *decoder);
+
+
+#endif	/* __GIF__ */
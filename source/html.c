@@ -0,0 +1,978 @@
+/*****************************************************************
+*
+* html.c
+*
+* Streaming HTML tokenizer and layout, see html.h.
+*
+* The tokenizer is a state machine run a byte at a time, so nothing
+* is ever buffered but the token it's in the middle of. The layout
+* keeps the line it's filling in line[], with its text in lineText;
+* finishing the line moves it into the boxes and the arena if it's in
+* the viewport, and drops it if not.
+*
+*****************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "html.h"
+
+/* Tokenizer states */
+
+enum
+{
+	kHtmlStateText,
+	kHtmlStateTagOpen,
+	kHtmlStateTagName,
+	kHtmlStateBeforeAttribute,
+	kHtmlStateAttributeName,
+	kHtmlStateAfterAttributeName,
+	kHtmlStateBeforeValue,
+	kHtmlStateValue,
+	kHtmlStateBang,
+	kHtmlStateComment,
+	kHtmlStateDeclaration,
+	kHtmlStateEntity
+};
+
+#define	kHtmlIndent			16		/* a list or quote level */
+#define	kHtmlMaxIndent		96
+#define	kHtmlRuleHeight		8
+#define	kHtmlDefaultImage	32		/* an image without a WIDTH or HEIGHT */
+
+typedef struct
+{
+	const char		*name;
+	unsigned char	value;
+} HtmlEntity;
+
+static const HtmlEntity kHtmlEntities[] =
+{
+	{ "amp", '&' },
+	{ "lt", '<' },
+	{ "gt", '>' },
+	{ "quot", '"' },
+	{ "nbsp", 160 },
+	{ "copy", 169 },
+	{ "reg", 174 }
+};
+
+
+static int HtmlIsSpace(int c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static int HtmlLower(int c)
+{
+	return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+}
+
+
+/*
+//
+// Tokenizer.
+//
+*/
+
+void HtmlTokenizerInit(HtmlTokenizer *tokenizer, HtmlTokenProc proc, void *ref)
+{
+	memset(tokenizer, 0, sizeof(*tokenizer));
+	tokenizer->state = kHtmlStateText;
+	tokenizer->attribute = -1;
+	tokenizer->proc = proc;
+	tokenizer->ref = ref;
+}
+
+
+static void HtmlFlushText(HtmlTokenizer *tokenizer)
+{
+	HtmlToken *token = &tokenizer->token;
+
+	if (tokenizer->textLength == 0)
+		return;
+
+	token->type = kHtmlText;
+	token->name[0] = 0;
+	token->attributeCount = 0;
+	token->text = tokenizer->text;
+	token->length = tokenizer->textLength;
+	tokenizer->proc(token, tokenizer->ref);
+	tokenizer->textLength = 0;
+}
+
+
+static void HtmlStartTag(HtmlTokenizer *tokenizer, int type)
+{
+	tokenizer->token.type = type;
+	tokenizer->token.name[0] = 0;
+	tokenizer->token.attributeCount = 0;
+	tokenizer->token.text = NULL;
+	tokenizer->token.length = 0;
+	tokenizer->attribute = -1;
+	tokenizer->length = 0;
+}
+
+
+static void HtmlEmitTag(HtmlTokenizer *tokenizer)
+{
+	if (tokenizer->token.name[0] != 0)
+		tokenizer->proc(&tokenizer->token, tokenizer->ref);
+
+	tokenizer->state = kHtmlStateText;
+}
+
+
+static void HtmlStartAttribute(HtmlTokenizer *tokenizer, int c)
+{
+	HtmlToken *token = &tokenizer->token;
+
+	/* Attributes past kHtmlAttributes are read and dropped */
+
+	if (token->attributeCount < kHtmlAttributes)
+	{
+		tokenizer->attribute = token->attributeCount++;
+		token->attributes[tokenizer->attribute].name[0] = (char)HtmlLower(c);
+		token->attributes[tokenizer->attribute].name[1] = 0;
+		token->attributes[tokenizer->attribute].value[0] = 0;
+	}
+	else
+		tokenizer->attribute = -1;
+
+	tokenizer->length = 1;
+	tokenizer->state = kHtmlStateAttributeName;
+}
+
+
+/*
+//
+// This function adds a character to whatever is being read: text,
+// or an attribute's value.
+//
+*/
+
+static void HtmlAppend(HtmlTokenizer *tokenizer, int c)
+{
+	char *value;
+
+	if (tokenizer->state == kHtmlStateText)
+	{
+		if (tokenizer->textLength == kHtmlTextSize)
+			HtmlFlushText(tokenizer);
+
+		tokenizer->text[tokenizer->textLength++] = (char)c;
+	}
+	else if (tokenizer->attribute >= 0 && tokenizer->length < kHtmlValueSize - 1)
+	{
+		value = tokenizer->token.attributes[tokenizer->attribute].value;
+		value[tokenizer->length++] = (char)c;
+		value[tokenizer->length] = 0;
+	}
+}
+
+
+static void HtmlAppendName(char *name, int *length, int c)
+{
+	if (*length < kHtmlNameSize - 1)
+	{
+		name[(*length)++] = (char)HtmlLower(c);
+		name[*length] = 0;
+	}
+}
+
+
+/*
+//
+// This function puts the character an entity stands for where the
+// entity was. One it doesn't know goes in as it was written.
+//
+*/
+
+static void HtmlEndEntity(HtmlTokenizer *tokenizer, int terminated)
+{
+	const char *name = tokenizer->entity;
+	int value, iii;
+
+	tokenizer->state = tokenizer->entityState;
+	tokenizer->entity[tokenizer->entityLength] = 0;
+	value = -1;
+
+	if (name[0] == '#')
+	{
+		value = atoi(name + 1);
+		if (value < ' ' || value > 255)
+			value = -1;
+	}
+	else
+	{
+		for (iii = 0; iii < (int)(sizeof(kHtmlEntities) / sizeof(kHtmlEntities[0])); iii++)
+		{
+			if (strcmp(name, kHtmlEntities[iii].name) == 0)
+				value = kHtmlEntities[iii].value;
+		}
+	}
+
+	if (value >= 0)
+	{
+		HtmlAppend(tokenizer, value);
+		return;
+	}
+
+	HtmlAppend(tokenizer, '&');
+	for (iii = 0; iii < tokenizer->entityLength; iii++)
+		HtmlAppend(tokenizer, name[iii]);
+	if (terminated)
+		HtmlAppend(tokenizer, ';');
+}
+
+
+void HtmlTokenize(HtmlTokenizer *tokenizer, const void *data, unsigned long size)
+{
+	const unsigned char *in = data, *end = in + size;
+	HtmlToken *token = &tokenizer->token;
+	int c;
+
+	while (in < end)
+	{
+		c = *in++;
+
+	again:
+		switch (tokenizer->state)
+		{
+			case kHtmlStateText:
+				if (c == '<')
+				{
+					HtmlFlushText(tokenizer);
+					tokenizer->state = kHtmlStateTagOpen;
+				}
+				else if (c == '&')
+				{
+					tokenizer->entityLength = 0;
+					tokenizer->entityState = kHtmlStateText;
+					tokenizer->state = kHtmlStateEntity;
+				}
+				else
+					HtmlAppend(tokenizer, c);
+				break;
+
+			case kHtmlStateTagOpen:
+				if (c == '/')
+				{
+					HtmlStartTag(tokenizer, kHtmlEndTag);
+					tokenizer->state = kHtmlStateTagName;
+				}
+				else if (c == '!')
+				{
+					tokenizer->dashes = 0;
+					tokenizer->state = kHtmlStateBang;
+				}
+				else if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))
+				{
+					HtmlStartTag(tokenizer, kHtmlStartTag);
+					HtmlAppendName(token->name, &tokenizer->length, c);
+					tokenizer->state = kHtmlStateTagName;
+				}
+				else
+				{
+					/* A '<' that doesn't start a tag is text */
+					tokenizer->state = kHtmlStateText;
+					HtmlAppend(tokenizer, '<');
+					goto again;
+				}
+				break;
+
+			case kHtmlStateTagName:
+				if (c == '>')
+					HtmlEmitTag(tokenizer);
+				else if (HtmlIsSpace(c) || c == '/')
+					tokenizer->state = kHtmlStateBeforeAttribute;
+				else
+					HtmlAppendName(token->name, &tokenizer->length, c);
+				break;
+
+			case kHtmlStateBeforeAttribute:
+				if (c == '>')
+					HtmlEmitTag(tokenizer);
+				else if (!HtmlIsSpace(c) && c != '/')
+					HtmlStartAttribute(tokenizer, c);
+				break;
+
+			case kHtmlStateAttributeName:
+				if (c == '>')
+					HtmlEmitTag(tokenizer);
+				else if (c == '=')
+					tokenizer->state = kHtmlStateBeforeValue;
+				else if (HtmlIsSpace(c))
+					tokenizer->state = kHtmlStateAfterAttributeName;
+				else if (tokenizer->attribute >= 0)
+					HtmlAppendName(token->attributes[tokenizer->attribute].name, &tokenizer->length, c);
+				break;
+
+			case kHtmlStateAfterAttributeName:
+				if (c == '>')
+					HtmlEmitTag(tokenizer);
+				else if (c == '=')
+					tokenizer->state = kHtmlStateBeforeValue;
+				else if (!HtmlIsSpace(c))
+					HtmlStartAttribute(tokenizer, c);
+				break;
+
+			case kHtmlStateBeforeValue:
+				tokenizer->length = 0;
+				if (c == '>')
+					HtmlEmitTag(tokenizer);
+				else if (c == '"' || c == '\'')
+				{
+					tokenizer->quote = (char)c;
+					tokenizer->state = kHtmlStateValue;
+				}
+				else if (!HtmlIsSpace(c))
+				{
+					tokenizer->quote = 0;
+					tokenizer->state = kHtmlStateValue;
+					goto again;
+				}
+				break;
+
+			case kHtmlStateValue:
+				if (tokenizer->quote != 0 ? c == tokenizer->quote : HtmlIsSpace(c))
+					tokenizer->state = kHtmlStateBeforeAttribute;
+				else if (tokenizer->quote == 0 && c == '>')
+					HtmlEmitTag(tokenizer);
+				else if (c == '&')
+				{
+					tokenizer->entityLength = 0;
+					tokenizer->entityState = kHtmlStateValue;
+					tokenizer->state = kHtmlStateEntity;
+				}
+				else
+					HtmlAppend(tokenizer, c);
+				break;
+
+			case kHtmlStateBang:
+				/* "<!--" starts a comment, anything else "<!" is skipped */
+				if (c == '-' && ++tokenizer->dashes == 2)
+				{
+					tokenizer->dashes = 0;
+					tokenizer->state = kHtmlStateComment;
+				}
+				else if (c == '>')
+					tokenizer->state = kHtmlStateText;
+				else if (c != '-')
+					tokenizer->state = kHtmlStateDeclaration;
+				break;
+
+			case kHtmlStateComment:
+				if (c == '>' && tokenizer->dashes >= 2)
+					tokenizer->state = kHtmlStateText;
+				else if (c == '-')
+					tokenizer->dashes++;
+				else
+					tokenizer->dashes = 0;
+				break;
+
+			case kHtmlStateDeclaration:
+				if (c == '>')
+					tokenizer->state = kHtmlStateText;
+				break;
+
+			case kHtmlStateEntity:
+				if (c == ';')
+					HtmlEndEntity(tokenizer, 1);
+				else if (((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+					|| (c == '#' && tokenizer->entityLength == 0))
+					&& tokenizer->entityLength < (int)sizeof(tokenizer->entity) - 1)
+					tokenizer->entity[tokenizer->entityLength++] = (char)c;
+				else
+				{
+					HtmlEndEntity(tokenizer, 0);
+					goto again;
+				}
+				break;
+		}
+	}
+}
+
+
+void HtmlTokenizerFinish(HtmlTokenizer *tokenizer)
+{
+	if (tokenizer->state == kHtmlStateEntity)
+		HtmlEndEntity(tokenizer, 0);
+
+	if (tokenizer->state == kHtmlStateText)
+		HtmlFlushText(tokenizer);
+
+	tokenizer->state = kHtmlStateText;
+}
+
+
+const char *HtmlAttributeValue(const HtmlToken *token, const char *name)
+{
+	int iii;
+
+	for (iii = 0; iii < token->attributeCount; iii++)
+	{
+		if (strcmp(token->attributes[iii].name, name) == 0)
+			return token->attributes[iii].value;
+	}
+
+	return NULL;
+}
+
+
+/*
+//
+// Layout.
+//
+*/
+
+static int HtmlMeasure(HtmlPage *page, const char *text, int length)
+{
+	return page->metrics.measure(text, length, page->style, page->metrics.ref);
+}
+
+static int HtmlLineHeight(HtmlPage *page)
+{
+	return page->metrics.height(page->style, page->metrics.ref);
+}
+
+
+static unsigned long HtmlColor(const char *value, unsigned long color)
+{
+	char *end;
+	unsigned long parsed;
+
+	if (value == NULL)
+		return color;
+	if (*value == '#')
+		value++;
+
+	parsed = strtoul(value, &end, 16);
+	return (end != value && *end == 0) ? parsed : color;
+}
+
+
+/*
+//
+// This function copies size bytes into the arena, returning their
+// offset, or kHtmlNone if they don't fit.
+//
+*/
+
+static unsigned HtmlArenaCopy(HtmlPage *page, const char *data, unsigned size)
+{
+	unsigned offset = page->arenaUsed;
+
+	if (offset + size + 1 > kHtmlArenaSize)
+		return kHtmlNone;
+
+	memcpy(page->arena + offset, data, size);
+	page->arena[offset + size] = 0;
+	page->arenaUsed += size + 1;
+	return offset;
+}
+
+
+/*
+//
+// This function finishes the line being filled: lines it up, keeps
+// its boxes if it's in the viewport, and moves down past it. An empty
+// line is a blank one.
+//
+*/
+
+static void HtmlFinishLine(HtmlPage *page)
+{
+	HtmlBox *item, *box;
+	unsigned link, linkFrom;
+	int height, offset, iii;
+
+	height = 0;
+	for (iii = 0; iii < page->lineCount; iii++)
+	{
+		if (page->line[iii].height > height)
+			height = page->line[iii].height;
+	}
+
+	if (page->lineCount == 0)
+		height = HtmlLineHeight(page);
+
+	offset = 0;
+	if (page->center > 0)
+	{
+		offset = (page->width - page->x) / 2;
+		if (offset < 0)
+			offset = 0;
+	}
+
+	if (page->height + height > page->top && page->height < page->bottom)
+	{
+		link = kHtmlNone;
+		linkFrom = kHtmlNone;
+
+		for (iii = 0; iii < page->lineCount && !page->truncated; iii++)
+		{
+			item = &page->line[iii];
+
+			if (page->count == kHtmlBoxes)
+			{
+				page->truncated = 1;
+				break;
+			}
+
+			box = &page->boxes[page->count];
+			*box = *item;
+			box->x = (short)(item->x + offset);
+			box->y = (short)(page->height + height - item->height);
+			box->text = (unsigned short)HtmlArenaCopy(page, page->lineText + item->text, item->length);
+
+			/* Boxes of the same link share its copy */
+
+			if (item->link != kHtmlNone && item->link != linkFrom)
+			{
+				linkFrom = item->link;
+				link = HtmlArenaCopy(page, page->lineText + item->link,
+					(unsigned)strlen(page->lineText + item->link));
+			}
+			box->link = (unsigned short)(item->link != kHtmlNone ? link : kHtmlNone);
+
+			if (box->text == kHtmlNone || (item->link != kHtmlNone && link == kHtmlNone))
+				page->truncated = 1;
+			else
+				page->count++;
+		}
+	}
+
+	page->height += height;
+	page->x = page->indent;
+	page->lineCount = 0;
+	page->lineTextUsed = 0;
+	page->lineLink = kHtmlNone;
+	page->pendingSpace = 0;
+}
+
+
+/*
+//
+// This function copies text into the line's text, returning its
+// offset, or kHtmlNone if the line is out of room.
+//
+*/
+
+static unsigned HtmlLineCopy(HtmlPage *page, const char *text, int length)
+{
+	unsigned offset = page->lineTextUsed;
+
+	if (offset + length + 1 > kHtmlLineText)
+		return kHtmlNone;
+
+	memcpy(page->lineText + offset, text, length);
+	page->lineText[offset + length] = 0;
+	page->lineTextUsed += length + 1;
+	return offset;
+}
+
+
+/*
+//
+// This function adds an inline box to the line, starting a new line
+// first if it doesn't fit. Words in the same style run together into
+// one box.
+//
+*/
+
+static void HtmlAddInline(HtmlPage *page, int kind, const char *text, int length, int width,
+	int height)
+{
+	HtmlBox *item, *last;
+	int space, fits;
+
+	space = (page->pendingSpace && page->lineCount > 0) ? HtmlMeasure(page, " ", 1) : 0;
+	page->pendingSpace = 0;
+
+	/* Leave room for the text, the link and a space */
+
+	fits = page->lineCount < kHtmlLineItems
+		&& page->lineTextUsed + length + strlen(page->link) + 3 <= kHtmlLineText;
+
+	if (page->lineCount > 0 && (page->x + space + width > page->width || !fits))
+	{
+		HtmlFinishLine(page);
+		space = 0;
+	}
+
+	if ((page->style & kHtmlLink) && page->lineLink == kHtmlNone)
+		page->lineLink = HtmlLineCopy(page, page->link, (int)strlen(page->link));
+
+	last = page->lineCount > 0 ? &page->line[page->lineCount - 1] : NULL;
+
+	if (kind == kHtmlWords && last != NULL && last->kind == kHtmlWords
+		&& last->style == page->style
+		&& last->link == ((page->style & kHtmlLink) ? page->lineLink : kHtmlNone)
+		&& last->text + last->length + 1 == page->lineTextUsed)
+	{
+		/* Runs on from the last box, over its NUL */
+
+		page->lineTextUsed--;
+		if (space > 0)
+			page->lineText[page->lineTextUsed++] = ' ';
+		HtmlLineCopy(page, text, length);
+
+		last->length = (unsigned short)(page->lineTextUsed - 1 - last->text);
+		last->width = (short)(page->x + space + width - last->x);
+		if (height > last->height)
+			last->height = (short)height;
+	}
+	else
+	{
+		item = &page->line[page->lineCount++];
+		memset(item, 0, sizeof(*item));
+		item->x = (short)(page->x + space);
+		item->width = (short)width;
+		item->height = (short)height;
+		item->kind = (unsigned char)kind;
+		item->style = (unsigned char)page->style;
+		item->text = (unsigned short)HtmlLineCopy(page, text, length);
+		item->length = (unsigned short)length;
+		item->link = (unsigned short)((page->style & kHtmlLink) ? page->lineLink : kHtmlNone);
+	}
+
+	page->x += space + width;
+	page->gap = 0;
+}
+
+
+static void HtmlFlushWord(HtmlPage *page)
+{
+	if (page->wordLength == 0)
+		return;
+
+	HtmlAddInline(page, kHtmlWords, page->word, page->wordLength,
+		HtmlMeasure(page, page->word, page->wordLength), HtmlLineHeight(page));
+	page->wordLength = 0;
+}
+
+
+static void HtmlBreak(HtmlPage *page)
+{
+	HtmlFlushWord(page);
+	if (page->lineCount > 0)
+		HtmlFinishLine(page);
+	page->pendingSpace = 0;
+}
+
+
+static void HtmlParagraph(HtmlPage *page)
+{
+	HtmlBreak(page);
+
+	if (!page->gap && page->height > 0)
+	{
+		page->height += HtmlLineHeight(page) / 2;
+		page->gap = 1;
+	}
+}
+
+
+static void HtmlSetIndent(HtmlPage *page, int indent)
+{
+	if (indent < 0)
+		indent = 0;
+	if (indent > kHtmlMaxIndent)
+		indent = kHtmlMaxIndent;
+
+	page->indent = indent;
+	page->x = indent;
+}
+
+
+static int HtmlSize(const char *value, int size)
+{
+	if (value == NULL)
+		return size;
+
+	if (*value == '+' || *value == '-')
+		size += atoi(value);
+	else
+		size = atoi(value);
+
+	return size < 1 ? 1 : size > 7 ? 7 : size;
+}
+
+
+static int HtmlNumber(const HtmlToken *token, const char *name, int number)
+{
+	const char *value = HtmlAttributeValue(token, name);
+
+	return (value != NULL && *value >= '0' && *value <= '9') ? atoi(value) : number;
+}
+
+
+static void HtmlImage(HtmlPage *page, const HtmlToken *token)
+{
+	const char *text;
+	int width, height;
+
+	text = HtmlAttributeValue(token, "src");
+	if (text == NULL)
+		text = HtmlAttributeValue(token, "alt");
+	if (text == NULL)
+		text = "";
+
+	width = HtmlNumber(token, "width", kHtmlDefaultImage);
+	height = HtmlNumber(token, "height", kHtmlDefaultImage);
+
+	HtmlAddInline(page, kHtmlImage, text, (int)strlen(text), width, height);
+}
+
+
+static void HtmlField(HtmlPage *page, const HtmlToken *token)
+{
+	const char *type, *value;
+	int width, height;
+
+	type = HtmlAttributeValue(token, "type");
+	value = HtmlAttributeValue(token, "value");
+	if (value == NULL)
+		value = "";
+	height = HtmlLineHeight(page) + 4;
+
+	if (strcmp(token->name, "textarea") == 0)
+	{
+		width = HtmlNumber(token, "cols", 20) * HtmlMeasure(page, "0", 1);
+		height = HtmlNumber(token, "rows", 1) * HtmlLineHeight(page) + 4;
+	}
+	else if (type == NULL || strcmp(type, "text") == 0 || strcmp(type, "password") == 0)
+		width = HtmlNumber(token, "size", 20) * HtmlMeasure(page, "0", 1);
+	else if (strcmp(type, "checkbox") == 0 || strcmp(type, "radio") == 0)
+		width = height = 12;
+	else if (strcmp(type, "hidden") == 0)
+		return;
+	else
+		width = HtmlMeasure(page, value, (int)strlen(value)) + 16;
+
+	HtmlAddInline(page, kHtmlField, value, (int)strlen(value), width, height);
+}
+
+
+static void HtmlRule(HtmlPage *page)
+{
+	HtmlBox *item;
+
+	HtmlBreak(page);
+
+	item = &page->line[page->lineCount++];
+	memset(item, 0, sizeof(*item));
+	item->x = (short)page->indent;
+	item->width = (short)(page->width - page->indent);
+	item->height = kHtmlRuleHeight;
+	item->kind = kHtmlRule;
+	item->text = (unsigned short)HtmlLineCopy(page, "", 0);
+	item->link = kHtmlNone;
+
+	/* A rule isn't centered, it's the width of the page */
+	page->x = page->width;
+	HtmlFinishLine(page);
+}
+
+
+/*
+//
+// This function is the layout's HtmlTokenProc.
+//
+*/
+
+static void HtmlPageToken(const HtmlToken *token, void *ref)
+{
+	HtmlPage *page = ref;
+	const char *name = token->name, *value;
+	int start = (token->type == kHtmlStartTag), iii, length, c;
+
+	if (token->type == kHtmlText)
+	{
+		if (page->inTitle)
+		{
+			length = (int)strlen(page->title);
+			for (iii = 0; iii < token->length && length < kHtmlTitleSize - 1; iii++)
+			{
+				c = HtmlIsSpace(token->text[iii]) ? ' ' : token->text[iii];
+				if (c != ' ' || (length > 0 && page->title[length - 1] != ' '))
+					page->title[length++] = (char)c;
+			}
+			page->title[length] = 0;
+			return;
+		}
+
+		if (page->skip > 0)
+			return;
+
+		for (iii = 0; iii < token->length; iii++)
+		{
+			if (HtmlIsSpace(token->text[iii]))
+			{
+				HtmlFlushWord(page);
+				page->pendingSpace = 1;
+				continue;
+			}
+
+			if (page->wordLength == kHtmlWordSize)
+				HtmlFlushWord(page);
+			page->word[page->wordLength++] = token->text[iii];
+		}
+		return;
+	}
+
+	/* A tag ends the word, if only because the style changes */
+
+	HtmlFlushWord(page);
+
+	if (strcmp(name, "title") == 0)
+	{
+		page->inTitle = start;
+		if (!start)
+		{
+			length = (int)strlen(page->title);
+			if (length > 0 && page->title[length - 1] == ' ')
+				page->title[length - 1] = 0;
+		}
+	}
+	else if (strcmp(name, "head") == 0 || strcmp(name, "map") == 0
+		|| strcmp(name, "script") == 0 || strcmp(name, "style") == 0
+		|| (strcmp(name, "textarea") == 0 && !start))
+		page->skip += start ? 1 : (page->skip > 0 ? -1 : 0);
+	else if (page->skip > 0)
+		return;
+	else if (strcmp(name, "body") == 0 && start)
+	{
+		page->background = HtmlColor(HtmlAttributeValue(token, "bgcolor"), page->background);
+		page->foreground = HtmlColor(HtmlAttributeValue(token, "text"), page->foreground);
+		page->linkColor = HtmlColor(HtmlAttributeValue(token, "link"), page->linkColor);
+	}
+	else if ((strcmp(name, "base") == 0 || strcmp(name, "basefont") == 0) && start)
+	{
+		value = HtmlAttributeValue(token, "font");
+		page->baseSize = HtmlSize(value != NULL ? value : HtmlAttributeValue(token, "size"), page->baseSize);
+		page->style = (page->style & ~kHtmlSizeMask) | page->baseSize;
+	}
+	else if (strcmp(name, "br") == 0)
+	{
+		HtmlFinishLine(page);
+		page->gap = 0;
+	}
+	else if (strcmp(name, "p") == 0 || strcmp(name, "div") == 0)
+	{
+		HtmlParagraph(page);
+
+		if (page->blockCenter)
+		{
+			page->center--;
+			page->blockCenter = 0;
+		}
+
+		value = HtmlAttributeValue(token, "align");
+		if (start && value != NULL && strcmp(value, "center") == 0)
+		{
+			page->center++;
+			page->blockCenter = 1;
+		}
+	}
+	else if (strcmp(name, "hr") == 0)
+		HtmlRule(page);
+	else if (strcmp(name, "center") == 0)
+	{
+		HtmlBreak(page);
+		page->center += start ? 1 : (page->center > 0 ? -1 : 0);
+	}
+	else if (strcmp(name, "ul") == 0 || strcmp(name, "ol") == 0 || strcmp(name, "blockquote") == 0)
+	{
+		HtmlParagraph(page);
+		HtmlSetIndent(page, page->indent + (start ? kHtmlIndent : -kHtmlIndent));
+	}
+	else if (strcmp(name, "li") == 0 && start)
+	{
+		HtmlBreak(page);
+		HtmlAddInline(page, kHtmlWords, "*", 1, HtmlMeasure(page, "*", 1), HtmlLineHeight(page));
+		page->pendingSpace = 1;
+	}
+	else if (strcmp(name, "table") == 0 || strcmp(name, "tr") == 0 || strcmp(name, "td") == 0
+		|| strcmp(name, "th") == 0 || strcmp(name, "address") == 0 || strcmp(name, "form") == 0)
+		HtmlBreak(page);
+	else if (strcmp(name, "b") == 0 || strcmp(name, "strong") == 0)
+		page->style = start ? (page->style | kHtmlBold) : (page->style & ~kHtmlBold);
+	else if (strcmp(name, "i") == 0 || strcmp(name, "em") == 0)
+		page->style = start ? (page->style | kHtmlItalic) : (page->style & ~kHtmlItalic);
+	else if (strcmp(name, "u") == 0)
+		page->style = start ? (page->style | kHtmlUnderline) : (page->style & ~kHtmlUnderline);
+	else if (strcmp(name, "font") == 0)
+	{
+		if (start && page->fontDepth < kHtmlFontDepth)
+		{
+			page->fontSizes[page->fontDepth++] = (unsigned char)(page->style & kHtmlSizeMask);
+			value = HtmlAttributeValue(token, "size");
+			if (value != NULL && (*value == '+' || *value == '-'))
+				page->style = (page->style & ~kHtmlSizeMask) | HtmlSize(value, page->baseSize);
+			else
+				page->style = (page->style & ~kHtmlSizeMask) | HtmlSize(value, page->style & kHtmlSizeMask);
+		}
+		else if (!start && page->fontDepth > 0)
+			page->style = (page->style & ~kHtmlSizeMask) | page->fontSizes[--page->fontDepth];
+	}
+	else if (strcmp(name, "a") == 0)
+	{
+		value = HtmlAttributeValue(token, "href");
+		if (start && value != NULL)
+		{
+			strcpy(page->link, value);
+			page->lineLink = kHtmlNone;
+			page->style |= kHtmlLink;
+		}
+		else if (!start)
+		{
+			page->link[0] = 0;
+			page->style &= ~kHtmlLink;
+		}
+	}
+	else if (strcmp(name, "img") == 0 && start)
+		HtmlImage(page, token);
+	else if (strcmp(name, "input") == 0 && start)
+		HtmlField(page, token);
+	else if (strcmp(name, "textarea") == 0 && start)
+	{
+		/* Its text is the field's, not the page's */
+
+		HtmlField(page, token);
+		page->skip++;
+	}
+}
+
+
+void HtmlInit(HtmlPage *page, const HtmlMetrics *metrics, int width, int top, int height)
+{
+	memset(page, 0, sizeof(*page));
+
+	page->metrics = *metrics;
+	page->width = width;
+	page->top = top;
+	page->bottom = top + height;
+	page->background = 0xFFFFFF;
+	page->foreground = 0x000000;
+	page->linkColor = 0x0000FF;
+	page->baseSize = 3;
+	page->style = page->baseSize;
+	page->lineLink = kHtmlNone;
+
+	HtmlTokenizerInit(&page->tokenizer, HtmlPageToken, page);
+}
+
+
+void HtmlFeed(HtmlPage *page, const void *data, unsigned long size)
+{
+	HtmlTokenize(&page->tokenizer, data, size);
+}
+
+
+void HtmlFinish(HtmlPage *page)
+{
+	HtmlTokenizerFinish(&page->tokenizer);
+	HtmlBreak(page);
+}
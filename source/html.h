@@ -0,0 +1,194 @@
+/*****************************************************************
+*
+* html.h
+*
+* Streaming HTML for the NETLINK pages (NL_B.HTM, BOOKMARK.HTM, ...).
+*
+* HtmlFeed takes a page a piece at a time, a CD sector or whatever
+* has arrived, and the tokenizer picks up where the last piece left
+* off, even in the middle of a tag or an entity. Each token goes
+* straight on to the layout, which flows words into lines as wide as
+* the page and, as each line is finished, keeps its boxes if it falls
+* in the viewport and only counts its height if not. So the top of a
+* page can be drawn while the rest is still coming off the CD, and an
+* HtmlPage is the same size for a page of any length: boxes and their
+* text come from a fixed arena, and what doesn't fit sets truncated.
+*
+* The layout is blocks and inline boxes, the HTML 2 the pages are
+* written in: paragraphs, breaks, rules, lists, centering, bold,
+* italic, underline, font sizes, links, images and form fields.
+* Tables are laid out a cell at a time, one under another.
+*
+* Text is measured with the caller's HtmlMetrics, so it can come from
+* the font atlas (font.h) or the fixed dbgio grid.
+*
+*****************************************************************/
+
+
+#ifndef __HTML__
+#define	__HTML__
+
+#define	kHtmlNameSize			12
+#define	kHtmlValueSize			128
+#define	kHtmlAttributes			8
+#define	kHtmlTextSize			128		/* text tokens are at most this long */
+#define	kHtmlWordSize			64
+#define	kHtmlLineItems			32
+#define	kHtmlLineText			256
+#define	kHtmlBoxes				128
+#define	kHtmlArenaSize			4096
+#define	kHtmlTitleSize			64
+#define	kHtmlFontDepth			8		/* FONT tags inside each other */
+#define	kHtmlNone				0xFFFF	/* no link */
+
+/* Token types */
+
+enum
+{
+	kHtmlText,
+	kHtmlStartTag,
+	kHtmlEndTag
+};
+
+/* Style bits; the font size, 1 to 7, is in the low bits */
+
+#define	kHtmlSizeMask			0x07
+#define	kHtmlBold				0x08
+#define	kHtmlItalic				0x10
+#define	kHtmlUnderline			0x20
+#define	kHtmlLink				0x40
+
+/* Box kinds */
+
+enum
+{
+	kHtmlWords,
+	kHtmlImage,					/* text is the SRC, or the ALT if there's no SRC */
+	kHtmlRule,
+	kHtmlField					/* a form field; text is its VALUE */
+};
+
+typedef struct
+{
+	char			name[kHtmlNameSize];
+	char			value[kHtmlValueSize];
+} HtmlAttribute;
+
+typedef struct
+{
+	int				type;
+	char			name[kHtmlNameSize];	/* lowercase */
+	int				attributeCount;
+	HtmlAttribute	attributes[kHtmlAttributes];
+	const char		*text;
+	int				length;
+} HtmlToken;
+
+typedef void (*HtmlTokenProc)(const HtmlToken *token, void *ref);
+
+typedef struct
+{
+	int				state;
+	HtmlToken		token;
+	char			text[kHtmlTextSize];
+	int				textLength;
+	int				attribute;			/* being read, -1 if it's dropped */
+	int				length;				/* of the name or value being read */
+	char			entity[10];
+	int				entityLength;
+	int				entityState;		/* the state an entity returns to */
+	int				dashes;				/* in a comment */
+	char			quote;
+	HtmlTokenProc	proc;
+	void			*ref;
+} HtmlTokenizer;
+
+typedef struct
+{
+	int				(*measure)(const char *text, int length, int style, void *ref);
+	int				(*height)(int style, void *ref);
+	void			*ref;
+} HtmlMetrics;
+
+typedef struct
+{
+	short			x;
+	short			y;					/* from the top of the page */
+	short			width;
+	short			height;
+	unsigned char	kind;
+	unsigned char	style;
+	unsigned short	text;				/* in the arena */
+	unsigned short	length;
+	unsigned short	link;				/* in the arena, kHtmlNone if none */
+} HtmlBox;
+
+typedef struct
+{
+	HtmlTokenizer	tokenizer;
+	HtmlMetrics		metrics;
+
+	/* viewport */
+	int				width;
+	int				top;
+	int				bottom;
+
+	/* what's been laid out */
+	char			title[kHtmlTitleSize];
+	unsigned long	background;			/* colors as 0xRRGGBB */
+	unsigned long	foreground;
+	unsigned long	linkColor;
+	int				count;
+	HtmlBox			boxes[kHtmlBoxes];
+	unsigned		arenaUsed;
+	char			arena[kHtmlArenaSize];
+	int				height;				/* laid out so far */
+	int				truncated;			/* ran out of boxes or arena */
+
+	/* layout */
+	int				style;
+	int				baseSize;
+	int				center;
+	int				blockCenter;		/* a P or DIV is centered */
+	int				indent;
+	int				skip;				/* inside HEAD, a MAP or a TEXTAREA */
+	int				inTitle;
+	int				gap;				/* a paragraph gap is already there */
+	int				pendingSpace;
+	int				fontDepth;
+	unsigned char	fontSizes[kHtmlFontDepth];
+	char			link[kHtmlValueSize];
+	unsigned		lineLink;			/* in lineText, kHtmlNone if not copied yet */
+	char			word[kHtmlWordSize];
+	int				wordLength;
+	int				x;
+	int				lineCount;
+	HtmlBox			line[kHtmlLineItems];
+	int				lineTextUsed;
+	char			lineText[kHtmlLineText];
+} HtmlPage;
+
+/* The tokenizer by itself */
+
+void HtmlTokenizerInit(HtmlTokenizer *tokenizer, HtmlTokenProc proc, void *ref);
+void HtmlTokenize(HtmlTokenizer *tokenizer, const void *data, unsigned long size);
+void HtmlTokenizerFinish(HtmlTokenizer *tokenizer);
+
+/* The value of an attribute, NULL if the token doesn't have it */
+
+const char *HtmlAttributeValue(const HtmlToken *token, const char *name);
+
+/* Starts a page width pixels wide, keeping boxes for the height */
+/* pixels from top down */
+
+void HtmlInit(HtmlPage *page, const HtmlMetrics *metrics, int width, int top, int height);
+void HtmlFeed(HtmlPage *page, const void *data, unsigned long size);
+
+/* Lays out what's left at the end of the page */
+
+void HtmlFinish(HtmlPage *page);
+
+#define	HtmlBoxText(page, box)	((page)->arena + (box)->text)
+
+
+#endif	/* __HTML__ */
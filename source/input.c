@@ -0,0 +1,68 @@
+/*****************************************************************
+*
+* input.c
+*
+* Joypad snapshots captured in v-blank, see input.h.
+*
+*****************************************************************/
+
+#include <string.h>
+
+#include "input.h"
+
+
+void InputInit(Input *input)
+{
+	memset(input, 0, sizeof(*input));
+}
+
+
+void InputCapture(Input *input, unsigned long tick, unsigned short pad1, unsigned short pad2)
+{
+	const InputSnapshot *last = &input->buffers[input->front];
+	InputSnapshot *next = &input->buffers[input->front ^ 1];
+	unsigned short pad;
+	int port, button;
+
+	next->tick = tick;
+	next->pads[0] = pad1;
+	next->pads[1] = pad2;
+
+	for (port = 0; port < kInputPorts; port++)
+	{
+		pad = next->pads[port];
+		next->pressed[port] = pad & ~last->pads[port];
+		next->released[port] = ~pad & last->pads[port];
+
+		for (button = 0; button < kInputButtons; button++)
+		{
+			if (!(pad & (1 << button)))
+				next->held[port][button] = 0;
+			else if (last->held[port][button] < kInputHeldMax)
+				next->held[port][button] = last->held[port][button] + 1;
+			else
+				next->held[port][button] = kInputHeldMax;
+		}
+	}
+
+	/* The sequence goes last, so a reader that saw the old one retries */
+
+	next->sequence = last->sequence + 1;
+	input->front ^= 1;
+}
+
+
+void InputRead(const Input *input, InputSnapshot *snapshot)
+{
+	const volatile InputSnapshot *front;
+	unsigned long sequence;
+	int which;
+
+	do
+	{
+		which = input->front;
+		front = &input->buffers[which];
+		sequence = front->sequence;
+		memcpy(snapshot, (const void *)front, sizeof(*snapshot));
+	} while (input->front != which || front->sequence != sequence);
+}
@@ -0,0 +1,57 @@
+/*****************************************************************
+*
+* input.h
+*
+* Joypad snapshots captured in v-blank.
+*
+* The v-blank out handler reads both ports once a tick and writes
+* a snapshot, stamped with the tick, into the back half of a double
+* buffer, then flips it to the front. The press and release edges
+* against the previous capture, and how many captures each button
+* has been held, are worked out there, once.
+*
+* Readers copy the front snapshot without locking: a capture that
+* lands during the copy flips the buffer or bumps its sequence, and
+* the copy is taken again. Only the v-blank handler writes.
+*
+* Edges are from one capture to the next; a reader that reads less
+* often than every tick should compare pads itself.
+*
+*****************************************************************/
+
+
+#ifndef __INPUT__
+#define	__INPUT__
+
+#define	kInputPorts			2
+#define	kInputButtons		16
+#define	kInputHeldMax		0xFFFF		/* held counts stop here */
+
+typedef struct
+{
+	unsigned long	tick;			/* the tick it was captured on */
+	unsigned long	sequence;		/* captures so far, this one included */
+	unsigned short	pads[kInputPorts];
+	unsigned short	pressed[kInputPorts];	/* went down at this capture */
+	unsigned short	released[kInputPorts];	/* went up at this capture */
+	unsigned short	held[kInputPorts][kInputButtons];	/* captures down in a row */
+} InputSnapshot;
+
+typedef struct
+{
+	InputSnapshot	buffers[2];
+	volatile int	front;
+} Input;
+
+void InputInit(Input *input);
+
+/* Call from the v-blank out handler with the ports just read */
+
+void InputCapture(Input *input, unsigned long tick, unsigned short pad1, unsigned short pad2);
+
+/* Copies the latest snapshot */
+
+void InputRead(const Input *input, InputSnapshot *snapshot);
+
+
+#endif	/* __INPUT__ */
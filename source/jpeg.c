@@ -0,0 +1,1191 @@
+/*****************************************************************
+*
+* jpeg.c
+*
+* Streaming baseline JPEG decoder, see jpeg.h.
+*
+* The marker segments are taken a byte at a time, with the ones the
+* decoder needs gathered into held[] until they're whole and the
+* rest stepped over. The scan is decoded straight out of the piece
+* that was fed when it can be; the bytes of an MCU that didn't all
+* arrive go to carry[], and the next piece is added to them there
+* until the MCU is whole.
+*
+* The bit reader pads with zeros when it runs out, so nothing has to
+* check for the end while a block is decoded. Past a marker the zeros
+* are what the data ends with; past the end of the piece they are
+* fake, and an MCU that used any is put back.
+*
+*****************************************************************/
+
+#include <string.h>
+
+#include "jpeg.h"
+
+/* Decoder states */
+
+enum
+{
+	kJpegStateStart,
+	kJpegStateMarker,
+	kJpegStateMarkerType,
+	kJpegStateLength,
+	kJpegStateSegment,
+	kJpegStateSkip,
+	kJpegStateScan,
+	kJpegStateDone,
+	kJpegStateFailed
+};
+
+/* Markers */
+
+#define	kJpegSOF0				0xC0
+#define	kJpegSOF1				0xC1
+#define	kJpegDHT				0xC4
+#define	kJpegRST0				0xD0
+#define	kJpegSOI				0xD8
+#define	kJpegEOI				0xD9
+#define	kJpegSOS				0xDA
+#define	kJpegDQT				0xDB
+#define	kJpegDRI				0xDD
+
+/* AAN IDCT constants, 8 bits of fraction */
+
+#define	kJpegFixBits			8
+#define	kJpegFix1_082392200		277
+#define	kJpegFix1_414213562		362
+#define	kJpegFix1_847759065		473
+#define	kJpegFix2_613125930		669
+#define	kJpegPassBits			2		/* of fraction the folded quant tables carry */
+
+/* The 4x4 IDCT's constants, 13 bits of fraction */
+
+#define	kJpegReducedBits		13
+#define	kJpegCos1				7568	/* cos(pi / 8) */
+#define	kJpegCos2				5793	/* cos(pi / 4) */
+#define	kJpegCos3				3135	/* cos(3 pi / 8) */
+
+#define	JpegMultiply(value, fix)	(((value) * (fix)) >> kJpegFixBits)
+
+static const unsigned char kJpegZigzag[64] =
+{
+	 0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+	12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+	35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+	58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+};
+
+/* cos(k pi / 16) * sqrt(2), 14 bits of fraction; a coefficient's */
+/* AAN scale is its row's times its column's */
+
+static const unsigned short kJpegAanScales[8] =
+{
+	16384, 22725, 21407, 19266, 16384, 12873, 8867, 4520
+};
+
+/* What a coefficient of size bits is with its sign extended */
+
+static const int kJpegExtendTest[16] =
+{
+	0, 0x0001, 0x0002, 0x0004, 0x0008, 0x0010, 0x0020, 0x0040,
+	0x0080, 0x0100, 0x0200, 0x0400, 0x0800, 0x1000, 0x2000, 0x4000
+};
+
+static const int kJpegExtendOffset[16] =
+{
+	0, -1, -3, -7, -15, -31, -63, -127,
+	-255, -511, -1023, -2047, -4095, -8191, -16383, -32767
+};
+
+
+static unsigned JpegGet16(const unsigned char *in)
+{
+	return (in[0] << 8) | in[1];
+}
+
+
+static int JpegClamp(int value)
+{
+	return (value < 0) ? 0 : (value > 255) ? 255 : value;
+}
+
+
+/* Dequantized coefficients are kept in 16 bits, which real ones */
+/* fit, so broken data can't overflow the IDCT */
+
+static int JpegCoefficient(long value)
+{
+	return (value < -32768) ? -32768 : (value > 32767) ? 32767 : (int)value;
+}
+
+
+void JpegInit(JpegDecoder *decoder, const JpegTarget *target, int scale)
+{
+	decoder->target = *target;
+	decoder->scale = (scale < 0) ? 0 : (scale > 3) ? 3 : scale;
+	decoder->state = kJpegStateStart;
+	decoder->need = 2;
+	decoder->heldCount = 0;
+	decoder->width = 0;
+	decoder->height = 0;
+	decoder->componentCount = 0;
+	decoder->restartInterval = 0;
+	decoder->rows = 0;
+	memset(decoder->quant, 0, sizeof(decoder->quant));
+	memset(decoder->huffman, 0, sizeof(decoder->huffman));
+}
+
+
+/*
+//
+// This function gathers up to need bytes into held. Returns the
+// bytes it took from in.
+//
+*/
+
+static unsigned long JpegGather(JpegDecoder *decoder, const unsigned char *in, unsigned long size)
+{
+	unsigned long count = decoder->need - decoder->heldCount;
+
+	if (count > size)
+		count = size;
+
+	memcpy(decoder->held + decoder->heldCount, in, count);
+	decoder->heldCount += (unsigned)count;
+	return count;
+}
+
+
+/*
+//
+// This function builds a Huffman table's lookup from its counts
+// of codes of each length and its values.
+//
+*/
+
+static int JpegBuildHuffman(JpegHuffman *table, const unsigned char *counts,
+	const unsigned char *values)
+{
+	long code;
+	int length, index, fill, iii;
+
+	memset(table->look, 0, sizeof(table->look));
+	code = 0;
+	index = 0;
+
+	for (length = 1; length <= 16; length++)
+	{
+		table->valueOffset[length] = index - (int)code;
+
+		/* Codes of a length can't run past its bits */
+
+		if (code + counts[length - 1] > (1L << length))
+			return 0;
+
+		for (iii = 0; iii < counts[length - 1]; iii++, index++, code++)
+		{
+			table->values[index] = values[index];
+
+			if (length <= kJpegLookBits)
+			{
+				for (fill = 0; fill < (1 << (kJpegLookBits - length)); fill++)
+				{
+					table->look[(code << (kJpegLookBits - length)) | fill]
+						= (unsigned short)(length << 8 | values[index]);
+				}
+			}
+		}
+
+		table->maxCode[length] = counts[length - 1] ? code - 1 : -1;
+		code <<= 1;
+	}
+
+	table->maxCode[17] = 0x7FFFFFFFL;
+	return 1;
+}
+
+
+/*
+//
+// This function reads the frame header: the size and the components,
+// and where each component's MCU row goes in planes.
+//
+*/
+
+static int JpegFrame(JpegDecoder *decoder, const unsigned char *segment, unsigned length)
+{
+	JpegComponent *component;
+	unsigned long offset;
+	int blockSize, iii;
+
+	if (length < 6 || segment[0] != 8)
+		return 0;
+
+	decoder->height = JpegGet16(segment + 1);
+	decoder->width = JpegGet16(segment + 3);
+	decoder->componentCount = segment[5];
+
+	if ((decoder->componentCount != 1 && decoder->componentCount != kJpegMaxComponents)
+		|| length < 6 + 3 * (unsigned)decoder->componentCount
+		|| decoder->width == 0 || decoder->height == 0)
+		return 0;
+
+	decoder->maxH = 1;
+	decoder->maxV = 1;
+
+	for (iii = 0; iii < decoder->componentCount; iii++)
+	{
+		component = &decoder->components[iii];
+		component->id = segment[6 + iii * 3];
+		component->h = segment[7 + iii * 3] >> 4;
+		component->v = segment[7 + iii * 3] & 15;
+		component->quant = segment[8 + iii * 3] & 3;
+
+		if (component->h < 1 || component->h > 2 || component->v < 1 || component->v > 2)
+			return 0;
+
+		/* A scan of one component is a block at a time, however */
+		/* it's sampled */
+
+		if (decoder->componentCount == 1)
+			component->h = component->v = 1;
+
+		if (component->h > decoder->maxH)
+			decoder->maxH = component->h;
+		if (component->v > decoder->maxV)
+			decoder->maxV = component->v;
+	}
+
+	/* The luma has to be the most finely sampled */
+
+	if (decoder->components[0].h != decoder->maxH || decoder->components[0].v != decoder->maxV)
+		return 0;
+
+	decoder->mcusAcross = (decoder->width + 8 * decoder->maxH - 1) / (8 * decoder->maxH);
+	decoder->mcusDown = (decoder->height + 8 * decoder->maxV - 1) / (8 * decoder->maxV);
+	if (decoder->mcusAcross * 8 * decoder->maxH > kJpegMaxWidth)
+		return 0;
+
+	decoder->outWidth = (decoder->width + (1 << decoder->scale) - 1) >> decoder->scale;
+	decoder->outHeight = (decoder->height + (1 << decoder->scale) - 1) >> decoder->scale;
+
+	blockSize = 8 >> decoder->scale;
+	offset = 0;
+	for (iii = 0; iii < decoder->componentCount; iii++)
+	{
+		component = &decoder->components[iii];
+		component->stride = decoder->mcusAcross * component->h * blockSize;
+		component->plane = decoder->planes + offset;
+		offset += (unsigned long)component->stride * component->v * blockSize;
+	}
+
+	return offset <= kJpegPlaneSize;
+}
+
+
+static int JpegHuffmanTables(JpegDecoder *decoder, const unsigned char *segment, unsigned length)
+{
+	unsigned offset, count;
+	int iii;
+
+	for (offset = 0; offset < length; offset += 17 + count)
+	{
+		if (offset + 17 > length)
+			return 0;
+
+		count = 0;
+		for (iii = 1; iii <= 16; iii++)
+			count += segment[offset + iii];
+
+		if (count > 256 || offset + 17 + count > length
+			|| !JpegBuildHuffman(&decoder->huffman[(segment[offset] >> 4) & 1][segment[offset] & 3],
+				segment + offset + 1, segment + offset + 17))
+			return 0;
+	}
+
+	return 1;
+}
+
+
+/*
+//
+// This function reads quantization tables. At full size each one is
+// folded in with the AAN scales, keeping kJpegPassBits of fraction.
+//
+*/
+
+static int JpegQuantTables(JpegDecoder *decoder, const unsigned char *segment, unsigned length)
+{
+	unsigned long value, scale;
+	unsigned offset, size, natural;
+	int *quant, iii;
+
+	for (offset = 0; offset < length; offset += 1 + size)
+	{
+		size = (segment[offset] >> 4) ? 128 : 64;
+		if (offset + 1 + size > length)
+			return 0;
+
+		quant = decoder->quant[segment[offset] & 3];
+		for (iii = 0; iii < 64; iii++)
+		{
+			value = (size == 128) ? JpegGet16(segment + offset + 1 + iii * 2)
+				: segment[offset + 1 + iii];
+
+			if (decoder->scale == 0)
+			{
+				natural = kJpegZigzag[iii];
+				scale = ((unsigned long)kJpegAanScales[natural >> 3] * kJpegAanScales[natural & 7]
+					+ (1 << 13)) >> 14;
+				value = (unsigned)((value * scale + (1UL << (13 - kJpegPassBits)))
+					>> (14 - kJpegPassBits));
+			}
+
+			quant[iii] = (int)value;
+		}
+	}
+
+	return 1;
+}
+
+
+static int JpegScanHeader(JpegDecoder *decoder, const unsigned char *segment, unsigned length)
+{
+	JpegComponent *component;
+	int iii, jjj, found;
+
+	if (decoder->componentCount == 0 || length < 1 || segment[0] != decoder->componentCount
+		|| length < 1 + 2 * (unsigned)segment[0])
+		return 0;
+
+	for (iii = 0; iii < segment[0]; iii++)
+	{
+		found = 0;
+		for (jjj = 0; jjj < decoder->componentCount; jjj++)
+		{
+			component = &decoder->components[jjj];
+			if (component->id == segment[1 + iii * 2])
+			{
+				component->dcTable = segment[2 + iii * 2] >> 4 & 3;
+				component->acTable = segment[2 + iii * 2] & 3;
+				component->dc = 0;
+				found = 1;
+			}
+		}
+
+		if (!found)
+			return 0;
+	}
+
+	decoder->bits = 0;
+	decoder->bitCount = 0;
+	decoder->fake = 0;
+	decoder->atMarker = 0;
+	decoder->mcu = 0;
+	decoder->rows = 0;
+	decoder->carryCount = 0;
+	return 1;
+}
+
+
+static int JpegSegment(JpegDecoder *decoder)
+{
+	unsigned length = decoder->heldCount;
+
+	switch (decoder->marker)
+	{
+		case kJpegSOF0:
+		case kJpegSOF1:
+			return JpegFrame(decoder, decoder->held, length);
+
+		case kJpegDHT:
+			return JpegHuffmanTables(decoder, decoder->held, length);
+
+		case kJpegDQT:
+			return JpegQuantTables(decoder, decoder->held, length);
+
+		case kJpegDRI:
+			if (length < 2)
+				return 0;
+			decoder->restartInterval = JpegGet16(decoder->held);
+			return 1;
+
+		case kJpegSOS:
+			return JpegScanHeader(decoder, decoder->held, length);
+	}
+
+	return 1;
+}
+
+
+/*
+//
+// This function tops the bit reader up past 24 bits, with zeros if
+// it runs into a marker or the end of the data.
+//
+*/
+
+static void JpegFill(JpegDecoder *decoder)
+{
+	const unsigned char *in = decoder->in;
+	unsigned byte;
+
+	while (decoder->bitCount <= 24)
+	{
+		byte = 0;
+
+		if (decoder->atMarker)
+			;
+		else if (in >= decoder->end || (*in == 0xFF && in + 1 >= decoder->end))
+			decoder->fake += 8;
+		else if (*in != 0xFF)
+			byte = *in++;
+		else if (in[1] == 0)
+		{
+			byte = 0xFF;
+			in += 2;
+		}
+		else
+			decoder->atMarker = 1;
+
+		decoder->bits = (decoder->bits << 8) | byte;
+		decoder->bitCount += 8;
+	}
+
+	decoder->in = in;
+}
+
+
+static void JpegSkipBits(JpegDecoder *decoder, int count)
+{
+	decoder->bitCount -= count;
+	if (decoder->bitCount < decoder->fake)
+		decoder->starved = 1;
+}
+
+
+static int JpegGetBits(JpegDecoder *decoder, int count)
+{
+	int value;
+
+	JpegFill(decoder);
+	value = (int)(decoder->bits >> (decoder->bitCount - count)) & ((1 << count) - 1);
+	JpegSkipBits(decoder, count);
+	return value;
+}
+
+
+/*
+//
+// This function decodes a Huffman symbol: looked up if its code is
+// kJpegLookBits long or less, and a bit at a time after that.
+// Returns -1 for a code that isn't in the table.
+//
+*/
+
+static int JpegSymbol(JpegDecoder *decoder, const JpegHuffman *table)
+{
+	unsigned entry;
+	long code;
+	int length, index;
+
+	JpegFill(decoder);
+
+	entry = table->look[(decoder->bits >> (decoder->bitCount - kJpegLookBits))
+		& ((1 << kJpegLookBits) - 1)];
+	if (entry != 0)
+	{
+		JpegSkipBits(decoder, entry >> 8);
+		return entry & 0xFF;
+	}
+
+	for (length = kJpegLookBits + 1; length <= 16; length++)
+	{
+		code = (long)(decoder->bits >> (decoder->bitCount - length)) & ((1L << length) - 1);
+		if (code <= table->maxCode[length])
+		{
+			index = (int)code + table->valueOffset[length];
+			if (index < 0 || index > 255)
+				return -1;
+
+			JpegSkipBits(decoder, length);
+			return table->values[index];
+		}
+	}
+
+	/* It may only be short of data */
+
+	if (decoder->fake > 0)
+		decoder->starved = 1;
+
+	return -1;
+}
+
+
+/*
+//
+// This function is the full-size IDCT: AAN down the columns and then
+// along the rows, into an 8x8 block of out.
+//
+*/
+
+static void JpegIdct8(const int *in, unsigned char *out, int stride)
+{
+	int work[64];
+	int *w;
+	int tmp0, tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, tmp7;
+	int tmp10, tmp11, tmp12, tmp13, z5, z10, z11, z12, z13;
+	int iii;
+
+	for (iii = 0; iii < 8; iii++)
+	{
+		w = work + iii;
+
+		/* A column of nothing but DC is common, and flat */
+
+		if ((in[8 + iii] | in[16 + iii] | in[24 + iii] | in[32 + iii] | in[40 + iii]
+			| in[48 + iii] | in[56 + iii]) == 0)
+		{
+			w[0] = w[8] = w[16] = w[24] = w[32] = w[40] = w[48] = w[56] = in[iii];
+			continue;
+		}
+
+		tmp10 = in[iii] + in[32 + iii];
+		tmp11 = in[iii] - in[32 + iii];
+		tmp13 = in[16 + iii] + in[48 + iii];
+		tmp12 = JpegMultiply(in[16 + iii] - in[48 + iii], kJpegFix1_414213562) - tmp13;
+
+		tmp0 = tmp10 + tmp13;
+		tmp3 = tmp10 - tmp13;
+		tmp1 = tmp11 + tmp12;
+		tmp2 = tmp11 - tmp12;
+
+		z13 = in[40 + iii] + in[24 + iii];
+		z10 = in[40 + iii] - in[24 + iii];
+		z11 = in[8 + iii] + in[56 + iii];
+		z12 = in[8 + iii] - in[56 + iii];
+
+		tmp7 = z11 + z13;
+		tmp11 = JpegMultiply(z11 - z13, kJpegFix1_414213562);
+		z5 = JpegMultiply(z10 + z12, kJpegFix1_847759065);
+		tmp10 = JpegMultiply(z12, kJpegFix1_082392200) - z5;
+		tmp12 = JpegMultiply(z10, -kJpegFix2_613125930) + z5;
+
+		tmp6 = tmp12 - tmp7;
+		tmp5 = tmp11 - tmp6;
+		tmp4 = tmp10 + tmp5;
+
+		w[0] = tmp0 + tmp7;
+		w[56] = tmp0 - tmp7;
+		w[8] = tmp1 + tmp6;
+		w[48] = tmp1 - tmp6;
+		w[16] = tmp2 + tmp5;
+		w[40] = tmp2 - tmp5;
+		w[32] = tmp3 + tmp4;
+		w[24] = tmp3 - tmp4;
+	}
+
+	/* The rows, back to pixels, centered on 128 */
+
+	for (iii = 0; iii < 8; iii++, out += stride)
+	{
+		w = work + iii * 8;
+		w[0] += (128 << (kJpegPassBits + 3)) + (1 << (kJpegPassBits + 2));
+
+		tmp10 = w[0] + w[4];
+		tmp11 = w[0] - w[4];
+		tmp13 = w[2] + w[6];
+		tmp12 = JpegMultiply(w[2] - w[6], kJpegFix1_414213562) - tmp13;
+
+		tmp0 = tmp10 + tmp13;
+		tmp3 = tmp10 - tmp13;
+		tmp1 = tmp11 + tmp12;
+		tmp2 = tmp11 - tmp12;
+
+		z13 = w[5] + w[3];
+		z10 = w[5] - w[3];
+		z11 = w[1] + w[7];
+		z12 = w[1] - w[7];
+
+		tmp7 = z11 + z13;
+		tmp11 = JpegMultiply(z11 - z13, kJpegFix1_414213562);
+		z5 = JpegMultiply(z10 + z12, kJpegFix1_847759065);
+		tmp10 = JpegMultiply(z12, kJpegFix1_082392200) - z5;
+		tmp12 = JpegMultiply(z10, -kJpegFix2_613125930) + z5;
+
+		tmp6 = tmp12 - tmp7;
+		tmp5 = tmp11 - tmp6;
+		tmp4 = tmp10 + tmp5;
+
+		out[0] = (unsigned char)JpegClamp((tmp0 + tmp7) >> (kJpegPassBits + 3));
+		out[7] = (unsigned char)JpegClamp((tmp0 - tmp7) >> (kJpegPassBits + 3));
+		out[1] = (unsigned char)JpegClamp((tmp1 + tmp6) >> (kJpegPassBits + 3));
+		out[6] = (unsigned char)JpegClamp((tmp1 - tmp6) >> (kJpegPassBits + 3));
+		out[2] = (unsigned char)JpegClamp((tmp2 + tmp5) >> (kJpegPassBits + 3));
+		out[5] = (unsigned char)JpegClamp((tmp2 - tmp5) >> (kJpegPassBits + 3));
+		out[4] = (unsigned char)JpegClamp((tmp3 + tmp4) >> (kJpegPassBits + 3));
+		out[3] = (unsigned char)JpegClamp((tmp3 - tmp4) >> (kJpegPassBits + 3));
+	}
+}
+
+
+/*
+//
+// This function is the half-size IDCT: a 4-point IDCT of the 4x4
+// corner of the coefficients, down and then across.
+//
+*/
+
+static void JpegIdct4(const int *in, unsigned char *out, int stride)
+{
+	int work[16];
+	const int *w;
+	int even0, even1, odd0, odd1, iii;
+
+	for (iii = 0; iii < 4; iii++)
+	{
+		even0 = (in[iii] + in[16 + iii]) * kJpegCos2;
+		even1 = (in[iii] - in[16 + iii]) * kJpegCos2;
+		odd0 = in[8 + iii] * kJpegCos1 + in[24 + iii] * kJpegCos3;
+		odd1 = in[8 + iii] * kJpegCos3 - in[24 + iii] * kJpegCos1;
+
+		work[iii] = (even0 + odd0) >> (kJpegReducedBits - 2);
+		work[12 + iii] = (even0 - odd0) >> (kJpegReducedBits - 2);
+		work[4 + iii] = (even1 + odd1) >> (kJpegReducedBits - 2);
+		work[8 + iii] = (even1 - odd1) >> (kJpegReducedBits - 2);
+	}
+
+	/* Each pass halves, and the first kept 2 bits of fraction */
+
+	for (iii = 0; iii < 4; iii++, out += stride)
+	{
+		w = work + iii * 4;
+		even0 = (w[0] + w[2]) * kJpegCos2 + (128 << (kJpegReducedBits + 4)) + (1 << (kJpegReducedBits + 3));
+		even1 = (w[0] - w[2]) * kJpegCos2 + (128 << (kJpegReducedBits + 4)) + (1 << (kJpegReducedBits + 3));
+		odd0 = w[1] * kJpegCos1 + w[3] * kJpegCos3;
+		odd1 = w[1] * kJpegCos3 - w[3] * kJpegCos1;
+
+		out[0] = (unsigned char)JpegClamp((even0 + odd0) >> (kJpegReducedBits + 4));
+		out[3] = (unsigned char)JpegClamp((even0 - odd0) >> (kJpegReducedBits + 4));
+		out[1] = (unsigned char)JpegClamp((even1 + odd1) >> (kJpegReducedBits + 4));
+		out[2] = (unsigned char)JpegClamp((even1 - odd1) >> (kJpegReducedBits + 4));
+	}
+}
+
+
+/*
+//
+// This function is the quarter-size IDCT, a 2x2 of sums and
+// differences, and the eighth, the DC.
+//
+*/
+
+static void JpegIdct2(const int *in, unsigned char *out, int stride, int scale)
+{
+	int even0, even1, odd0, odd1;
+
+	if (scale == 3)
+	{
+		out[0] = (unsigned char)JpegClamp((in[0] + (128 << 3) + 4) >> 3);
+		return;
+	}
+
+	even0 = in[0] + in[8] + (128 << 3) + 4;
+	even1 = in[0] - in[8] + (128 << 3) + 4;
+	odd0 = in[1] + in[9];
+	odd1 = in[1] - in[9];
+
+	out[0] = (unsigned char)JpegClamp((even0 + odd0) >> 3);
+	out[1] = (unsigned char)JpegClamp((even0 - odd0) >> 3);
+	out[stride] = (unsigned char)JpegClamp((even1 + odd1) >> 3);
+	out[stride + 1] = (unsigned char)JpegClamp((even1 - odd1) >> 3);
+}
+
+
+/*
+//
+// This function decodes a block and puts its pixels in out. Only
+// the coefficients the scale's IDCT uses are kept. Returns 0 for
+// bad data.
+//
+*/
+
+static int JpegBlock(JpegDecoder *decoder, JpegComponent *component, unsigned char *out)
+{
+	const JpegHuffman *ac = &decoder->huffman[1][component->acTable];
+	const int *quant = decoder->quant[component->quant];
+	int *block = decoder->block;
+	int size = 8 >> decoder->scale;
+	int symbol, count, index, natural;
+
+	memset(block, 0, size * 8 * sizeof(int));
+
+	symbol = JpegSymbol(decoder, &decoder->huffman[0][component->dcTable]);
+	if (symbol < 0 || symbol > 15)
+		return 0;
+
+	if (symbol != 0)
+	{
+		count = JpegGetBits(decoder, symbol);
+		component->dc += (count < kJpegExtendTest[symbol]) ? count + kJpegExtendOffset[symbol] : count;
+	}
+	block[0] = JpegCoefficient((long)component->dc * quant[0]);
+
+	for (index = 1; index < 64; index++)
+	{
+		symbol = JpegSymbol(decoder, ac);
+		if (symbol < 0)
+			return 0;
+
+		count = symbol & 15;
+		if (count == 0)
+		{
+			if (symbol != 0xF0)
+				break;
+
+			index += 15;
+			continue;
+		}
+
+		index += symbol >> 4;
+		if (index > 63)
+			return 0;
+
+		symbol = JpegGetBits(decoder, count);
+		natural = kJpegZigzag[index];
+		if ((natural & 7) < size && (natural >> 3) < size)
+		{
+			if (symbol < kJpegExtendTest[count])
+				symbol += kJpegExtendOffset[count];
+			block[natural] = JpegCoefficient((long)symbol * quant[index]);
+		}
+	}
+
+	switch (decoder->scale)
+	{
+		case 0:
+			JpegIdct8(block, out, component->stride);
+			break;
+
+		case 1:
+			JpegIdct4(block, out, component->stride);
+			break;
+
+		default:
+			JpegIdct2(block, out, component->stride, decoder->scale);
+			break;
+	}
+
+	return 1;
+}
+
+
+/*
+//
+// This function converts an MCU row of planes to RGB1555 and writes
+// it to the target.
+//
+*/
+
+static void JpegPutRows(JpegDecoder *decoder, int mcuRow)
+{
+	const JpegTarget *target = &decoder->target;
+	const JpegComponent *components = decoder->components;
+	const unsigned char *luma, *cb, *cr;
+	unsigned short *out;
+	int rowHeight, top, count, width, y, x, shift1, shift2, value, r, g, b;
+
+	rowHeight = (8 * decoder->maxV) >> decoder->scale;
+	top = mcuRow * rowHeight;
+	count = decoder->outHeight - top;
+	if (count > rowHeight)
+		count = rowHeight;
+
+	width = decoder->outWidth;
+	if (width > target->width)
+		width = target->width;
+
+	/* Chroma is half-size across when the luma is 2 wide */
+
+	shift1 = (decoder->componentCount == kJpegMaxComponents && components[1].h < decoder->maxH);
+	shift2 = (decoder->componentCount == kJpegMaxComponents && components[2].h < decoder->maxH);
+
+	for (y = 0; y < count && top + y < target->height; y++)
+	{
+		out = (unsigned short *)(target->pixels + (unsigned long)(top + y) * target->rate);
+		luma = components[0].plane
+			+ (y * components[0].v / decoder->maxV) * components[0].stride;
+
+		if (decoder->componentCount == 1)
+		{
+			for (x = 0; x < width; x++)
+			{
+				value = luma[x] >> 3;
+				out[x] = (unsigned short)(0x8000 | (value << 10) | (value << 5) | value);
+			}
+			continue;
+		}
+
+		cb = components[1].plane + (y * components[1].v / decoder->maxV) * components[1].stride;
+		cr = components[2].plane + (y * components[2].v / decoder->maxV) * components[2].stride;
+
+		for (x = 0; x < width; x++)
+		{
+			value = luma[x];
+			b = cb[x >> shift1] - 128;
+			r = cr[x >> shift2] - 128;
+
+			/* 1.402, 0.344136, 0.714136 and 1.772, 16 bits of fraction */
+
+			g = value - ((22554 * b + 46802 * r - 32768) >> 16);
+			r = value + ((91881 * r + 32768) >> 16);
+			b = value + ((116130 * b + 32768) >> 16);
+
+			out[x] = (unsigned short)(0x8000 | (JpegClamp(b) >> 3 << 10)
+				| (JpegClamp(g) >> 3 << 5) | (JpegClamp(r) >> 3));
+		}
+	}
+
+	decoder->rows = top + count;
+}
+
+
+/*
+//
+// This function decodes the next MCU, after its restart marker if
+// it has one. Returns 0 for bad data, unless it's only that the
+// data ran out first, when starved is set.
+//
+*/
+
+static int JpegMcu(JpegDecoder *decoder)
+{
+	JpegComponent *component;
+	int blockSize, across, bx, by, iii;
+
+	if (decoder->restartInterval && decoder->mcu > 0 && decoder->mcu % decoder->restartInterval == 0)
+	{
+		/* What's left in the reader is padding */
+
+		decoder->bits = 0;
+		decoder->bitCount = 0;
+		decoder->fake = 0;
+		decoder->atMarker = 0;
+
+		if (decoder->end - decoder->in < 2)
+		{
+			decoder->starved = 1;
+			return 1;
+		}
+
+		if (decoder->in[0] != 0xFF || (decoder->in[1] & 0xF8) != kJpegRST0)
+			return 0;
+
+		decoder->in += 2;
+		for (iii = 0; iii < decoder->componentCount; iii++)
+			decoder->components[iii].dc = 0;
+	}
+
+	blockSize = 8 >> decoder->scale;
+	across = decoder->mcu % decoder->mcusAcross;
+
+	for (iii = 0; iii < decoder->componentCount; iii++)
+	{
+		component = &decoder->components[iii];
+
+		for (by = 0; by < component->v; by++)
+		{
+			for (bx = 0; bx < component->h; bx++)
+			{
+				if (!JpegBlock(decoder, component, component->plane
+					+ by * blockSize * component->stride
+					+ (across * component->h + bx) * blockSize))
+					return 0;
+			}
+		}
+	}
+
+	return 1;
+}
+
+
+/*
+//
+// This function decodes as many whole MCUs as are in the data from
+// in to end. Returns where the next MCU's data starts, with the bit
+// reader as it was there, or NULL for bad data.
+//
+*/
+
+static const unsigned char *JpegMcus(JpegDecoder *decoder, const unsigned char *in,
+	const unsigned char *end)
+{
+	const unsigned char *savedIn;
+	unsigned long savedBits;
+	int savedBitCount, savedMarker, savedDc[kJpegMaxComponents], total, iii;
+
+	decoder->in = in;
+	decoder->end = end;
+	total = decoder->mcusAcross * decoder->mcusDown;
+
+	while (decoder->mcu < total)
+	{
+		savedIn = decoder->in;
+		savedBits = decoder->bits;
+		savedBitCount = decoder->bitCount;
+		savedMarker = decoder->atMarker;
+		for (iii = 0; iii < decoder->componentCount; iii++)
+			savedDc[iii] = decoder->components[iii].dc;
+
+		decoder->starved = 0;
+		if (!JpegMcu(decoder) && !decoder->starved)
+			return NULL;
+
+		if (decoder->starved)
+		{
+			decoder->in = savedIn;
+			decoder->bits = savedBits;
+			decoder->bitCount = savedBitCount;
+			decoder->fake = 0;
+			decoder->atMarker = savedMarker;
+			for (iii = 0; iii < decoder->componentCount; iii++)
+				decoder->components[iii].dc = savedDc[iii];
+			break;
+		}
+
+		/* Fake zeros read ahead but not used come out again */
+
+		decoder->bits >>= decoder->fake;
+		decoder->bitCount -= decoder->fake;
+		decoder->fake = 0;
+
+		decoder->mcu++;
+		if (decoder->mcu % decoder->mcusAcross == 0)
+			JpegPutRows(decoder, decoder->mcu / decoder->mcusAcross - 1);
+	}
+
+	if (decoder->mcu == total)
+		decoder->state = kJpegStateDone;
+
+	return decoder->in;
+}
+
+
+/*
+//
+// This function decodes scan data. Returns the bytes it took from
+// in, or -1 for bad data.
+//
+*/
+
+static long JpegScan(JpegDecoder *decoder, const unsigned char *in, unsigned long size)
+{
+	const unsigned char *next;
+	unsigned long count, carried;
+
+	if (decoder->carryCount == 0)
+	{
+		next = JpegMcus(decoder, in, in + size);
+		if (next == NULL)
+			return -1;
+
+		count = (in + size) - next;
+		if (decoder->state == kJpegStateScan)
+		{
+			if (count > kJpegCarrySize)
+				return -1;
+
+			memcpy(decoder->carry, next, count);
+			decoder->carryCount = (unsigned)count;
+		}
+
+		return (long)size;
+	}
+
+	/* Add to what's carried until there's an MCU in it, and go */
+	/* back to the piece once the MCUs are into what was added */
+
+	carried = decoder->carryCount;
+	count = kJpegCarrySize - carried;
+	if (count > size)
+		count = size;
+	if (count == 0)
+		return -1;
+
+	memcpy(decoder->carry + carried, in, count);
+	decoder->carryCount += (unsigned)count;
+
+	next = JpegMcus(decoder, decoder->carry, decoder->carry + decoder->carryCount);
+	if (next == NULL)
+		return -1;
+
+	if (next >= decoder->carry + carried)
+	{
+		decoder->carryCount = 0;
+		return (long)(next - (decoder->carry + carried));
+	}
+
+	decoder->carryCount -= (unsigned)(next - decoder->carry);
+	memmove(decoder->carry, next, decoder->carryCount);
+	return (long)count;
+}
+
+
+int JpegFeed(JpegDecoder *decoder, const void *data, unsigned long size)
+{
+	const unsigned char *in = (const unsigned char *)data;
+	const unsigned char *end = in + size;
+	unsigned long count;
+	long taken;
+	unsigned length;
+
+	while (in < end)
+	{
+		switch (decoder->state)
+		{
+			case kJpegStateStart:
+				in += JpegGather(decoder, in, end - in);
+				if (decoder->heldCount < decoder->need)
+					break;
+
+				if (decoder->held[0] != 0xFF || decoder->held[1] != kJpegSOI)
+				{
+					decoder->state = kJpegStateFailed;
+					return 0;
+				}
+
+				decoder->state = kJpegStateMarker;
+				break;
+
+			case kJpegStateMarker:
+				if (*in++ != 0xFF)
+				{
+					decoder->state = kJpegStateFailed;
+					return 0;
+				}
+
+				decoder->state = kJpegStateMarkerType;
+				break;
+
+			case kJpegStateMarkerType:
+				decoder->marker = *in++;
+
+				/* Fill bytes, and markers without a segment */
+
+				if (decoder->marker == 0xFF)
+					break;
+
+				if (decoder->marker == 0x01 || (decoder->marker & 0xF8) == kJpegRST0)
+				{
+					decoder->state = kJpegStateMarker;
+					break;
+				}
+
+				/* Only baseline and extended Huffman frames */
+
+				if (decoder->marker == kJpegEOI || (decoder->marker >= 0xC2 && decoder->marker <= 0xCF
+					&& decoder->marker != kJpegDHT && decoder->marker != 0xC8 && decoder->marker != 0xCC))
+				{
+					decoder->state = kJpegStateFailed;
+					return 0;
+				}
+
+				decoder->heldCount = 0;
+				decoder->need = 2;
+				decoder->state = kJpegStateLength;
+				break;
+
+			case kJpegStateLength:
+				in += JpegGather(decoder, in, end - in);
+				if (decoder->heldCount < decoder->need)
+					break;
+
+				length = JpegGet16(decoder->held);
+				if (length < 2)
+				{
+					decoder->state = kJpegStateFailed;
+					return 0;
+				}
+
+				decoder->heldCount = 0;
+				decoder->need = length - 2;
+
+				switch (decoder->marker)
+				{
+					case kJpegSOF0:
+					case kJpegSOF1:
+					case kJpegDHT:
+					case kJpegDQT:
+					case kJpegDRI:
+					case kJpegSOS:
+						if (decoder->need > kJpegSegmentSize)
+						{
+							decoder->state = kJpegStateFailed;
+							return 0;
+						}
+						decoder->state = kJpegStateSegment;
+						break;
+
+					default:		/* APPn, COM and the rest */
+						decoder->state = kJpegStateSkip;
+						break;
+				}
+
+				/* An empty segment is whole already */
+
+				if (decoder->need == 0 && decoder->state == kJpegStateSkip)
+					decoder->state = kJpegStateMarker;
+				break;
+
+			case kJpegStateSegment:
+				in += JpegGather(decoder, in, end - in);
+				if (decoder->heldCount < decoder->need)
+					break;
+
+				if (!JpegSegment(decoder))
+				{
+					decoder->state = kJpegStateFailed;
+					return 0;
+				}
+
+				decoder->state = (decoder->marker == kJpegSOS) ? kJpegStateScan : kJpegStateMarker;
+				break;
+
+			case kJpegStateSkip:
+				count = end - in;
+				if (count > decoder->need)
+					count = decoder->need;
+
+				in += count;
+				decoder->need -= (unsigned)count;
+				if (decoder->need == 0)
+					decoder->state = kJpegStateMarker;
+				break;
+
+			case kJpegStateScan:
+				taken = JpegScan(decoder, in, end - in);
+				if (taken < 0)
+				{
+					decoder->state = kJpegStateFailed;
+					return 0;
+				}
+
+				in += taken;
+				break;
+
+			case kJpegStateDone:
+				return 1;
+
+			default:
+				return 0;
+		}
+	}
+
+	return decoder->state != kJpegStateFailed;
+}
+
+
+int JpegDone(const JpegDecoder *decoder)
+{
+	return decoder->state == kJpegStateDone;
+}
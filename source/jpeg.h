@@ -0,0 +1,136 @@
+/*****************************************************************
+*
+* jpeg.h
+*
+* Streaming baseline JPEG decoder for the NETLINK pictures
+* (GENOPT.JPE, MAINSCRN.JPE, ...), straight into a VDP2 RGB1555
+* bitmap.
+*
+* JpegFeed takes the file a piece at a time, a CD sector or whatever
+* has arrived. The headers are gathered a segment at a time, and the
+* scan is decoded an MCU at a time: an MCU that runs off the end of
+* what has arrived is put back, and its bytes kept until the next
+* piece comes. Blocks are turned into pixels as they're decoded and
+* kept only until their MCU row is done, when the row is converted to
+* RGB1555 and written to the target. So the decoder holds a row of
+* MCUs, 16 lines at most, and never the whole picture.
+*
+* Everything is fixed-point:
+*
+*	Huffman		codes up to kJpegLookBits long are looked up in a
+*				table, a symbol and its length at once; longer ones
+*				are walked a bit at a time
+*	IDCT		AAN (Arai, Agui and Nakajima): five multiplies a row
+*				or column, by 8-bit constants, with the dequantizing
+*				and the AAN scale factors folded into one table
+*	color		YCbCr to RGB by multiplies too, chroma upsampled by
+*				repeating it
+*
+* A decode can be scaled by 1/2, 1/4 or 1/8 for thumbnails. The
+* smaller IDCTs use only the coefficients they need: 4x4 and 2x2
+* IDCTs of the block's corner, and the DC alone at 1/8, so a smaller
+* picture is quicker as well.
+*
+* Baseline only: Huffman, 8-bit, one interleaved scan, 1 or 3
+* components sampled up to 2x2, restart markers.
+*
+*****************************************************************/
+
+
+#ifndef __JPEG__
+#define	__JPEG__
+
+#define	kJpegMaxWidth			512		/* of the picture, padded to MCUs */
+#define	kJpegMaxComponents		3
+#define	kJpegPlaneSize			(kJpegMaxWidth * 32)	/* an MCU row of every component */
+#define	kJpegSegmentSize		1280	/* largest DQT or DHT segment */
+#define	kJpegCarrySize			2048	/* largest MCU, kept between pieces */
+#define	kJpegLookBits			9
+
+typedef struct
+{
+	unsigned char	*pixels;			/* RGB1555 */
+	int				width;				/* pixels */
+	int				height;
+	unsigned long	rate;				/* bytes a row */
+} JpegTarget;
+
+typedef struct
+{
+	unsigned short	look[1 << kJpegLookBits];	/* length << 8 | symbol, 0 if longer */
+	long			maxCode[18];
+	int				valueOffset[17];
+	unsigned char	values[256];
+} JpegHuffman;
+
+typedef struct
+{
+	int				id;
+	int				h;
+	int				v;
+	int				quant;
+	int				dcTable;
+	int				acTable;
+	int				dc;					/* predictor */
+	int				stride;				/* of the plane, in pixels */
+	unsigned char	*plane;
+} JpegComponent;
+
+typedef struct
+{
+	JpegTarget		target;
+	int				scale;				/* a 1 << scale smaller picture */
+	int				state;
+	int				marker;
+	unsigned		need;
+	unsigned		heldCount;
+	unsigned char	held[kJpegSegmentSize];
+
+	/* the picture, once its frame header has been read */
+	int				width;
+	int				height;
+	int				outWidth;			/* scaled */
+	int				outHeight;
+	int				componentCount;
+	JpegComponent	components[kJpegMaxComponents];
+	int				maxH;
+	int				maxV;
+	int				mcusAcross;
+	int				mcusDown;
+	int				restartInterval;
+
+	/* tables, in zigzag order */
+	int				quant[4][64];		/* dequantizing, and the AAN scales at full size */
+	JpegHuffman		huffman[2][4];		/* DC, AC */
+
+	/* the scan */
+	const unsigned char	*in;
+	const unsigned char	*end;
+	unsigned long	bits;
+	int				bitCount;
+	int				fake;				/* zero bits standing in for data not here yet */
+	int				atMarker;			/* the data ran into a marker */
+	int				starved;			/* an MCU ran off the end of the data */
+	int				mcu;				/* next in the scan */
+	int				rows;				/* of the target written so far */
+	unsigned		carryCount;
+	unsigned char	carry[kJpegCarrySize];
+	int				block[64];
+	unsigned char	planes[kJpegPlaneSize];
+} JpegDecoder;
+
+/* Decodes into target, 1 << scale times smaller, scale 0 to 3 */
+
+void JpegInit(JpegDecoder *decoder, const JpegTarget *target, int scale);
+
+/* Decodes size more bytes of the file. Returns 0 if it isn't a */
+/* JPEG this can decode, or is broken; the decoder then stays failed. */
+
+int JpegFeed(JpegDecoder *decoder, const void *data, unsigned long size);
+
+/* Every row is written */
+
+int JpegDone(const JpegDecoder *decoder);
+
+
+#endif	/* __JPEG__ */
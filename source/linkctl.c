@@ -0,0 +1,205 @@
+/*****************************************************************
+*
+* linkctl.c
+*
+* Exchange rate and packet size controller, see linkctl.h.
+*
+*****************************************************************/
+
+#include <string.h>
+
+#include "linkctl.h"
+
+/* Percent of a window's exchanges */
+
+#define	kLinkSlowerNoData	10		/* XBNoData above this: slow down */
+#define	kLinkFasterNoData	2		/* below this (and no bad packets): speed up */
+#define	kLinkBadPackets		3		/* bad packets above this: change the size */
+
+#define	kLinkQueueSlack		4		/* queued packets the round trip doesn't explain */
+#define	kLinkMinBackoff		4		/* windows */
+#define	kLinkMaxBackoff		32
+
+
+void LinkControlInit(LinkControl *lc, int minRate, int maxRate, int minSize, int maxSize,
+	int growOnLoss, int leader)
+{
+	memset(lc, 0, sizeof(*lc));
+	lc->minRate = minRate;
+	lc->maxRate = maxRate;
+	lc->minSize = minSize;
+	lc->maxSize = maxSize;
+	lc->growOnLoss = growOnLoss;
+	lc->leader = leader;
+	lc->ceiling = maxRate;
+	lc->backoffLength = kLinkMinBackoff;
+}
+
+
+/*
+//
+// This function starts measuring a new session. A faster rate that
+// is given up before it has held for a window is marked as failed,
+// whichever side asked for the change. After a slower step the next
+// window checks that it helped, on both sides.
+//
+*/
+
+void LinkControlReset(LinkControl *lc, const XBInfo *info, int rate, int size)
+{
+	if (info->roundTripLatency > lc->roundTrip + 1 + lc->roundTrip / 4
+		|| info->roundTripLatency + 1 + lc->roundTrip / 4 < lc->roundTrip)
+	{
+		/* a different line: what was learned about the old one is void */
+		lc->roundTrip = info->roundTripLatency;
+		lc->ceiling = lc->maxRate;
+	}
+
+	lc->checking = (lc->rate != 0 && rate > lc->rate);
+
+	if (lc->probing && rate > lc->rate)
+	{
+		lc->failedRate = lc->rate;
+		lc->backoff = lc->backoffLength;
+		if (lc->backoffLength < kLinkMaxBackoff)
+			lc->backoffLength *= 2;
+	}
+
+	if (lc->rate != 0 && (rate != lc->rate || size != lc->size))
+		lc->changes++;
+
+	lc->probing = (lc->rate != 0 && rate < lc->rate);
+	lc->rate = rate;
+	lc->size = size;
+	lc->settling = 1;
+	lc->waiting = 0;
+	lc->exchanges = 0;
+	lc->noData = 0;
+	lc->badPackets = 0;
+	lc->queueTotal = 0;
+	lc->lastNoData = info->noDataCount;
+	lc->lastBadPackets = info->badPacketCount;
+}
+
+
+/*
+//
+// This function decides what a full window asks for.
+//
+*/
+
+static LinkAction LinkControlDecide(LinkControl *lc, unsigned roundTrip)
+{
+	unsigned noDataPercent, badPercent, queue, queueExpected;
+
+	noDataPercent = lc->noData * 100 / lc->exchanges;
+	badPercent = lc->badPackets * 100 / lc->exchanges;
+	queue = lc->queueTotal / lc->exchanges;
+	queueExpected = (roundTrip + lc->rate - 1) / lc->rate;
+
+	if (lc->backoff > 0)
+		lc->backoff--;
+
+	/* Slowing down didn't halve the XBNoData waits: the line's delay */
+	/* causes them, not its speed. Go back and stay at most that slow. */
+
+	if (lc->checking)
+	{
+		lc->checking = 0;
+		if (noDataPercent * 2 > lc->lastNoDataPercent && queue <= queueExpected + kLinkQueueSlack)
+		{
+			lc->ceiling = lc->rate - 1;
+			return lc->leader ? kLinkFaster : kLinkHold;
+		}
+	}
+
+	lc->lastNoDataPercent = noDataPercent;
+
+	/* The line can't keep up */
+
+	if (noDataPercent > kLinkSlowerNoData || queue > queueExpected + kLinkQueueSlack)
+	{
+		if (lc->rate < lc->ceiling)
+			return kLinkSlower;
+		return kLinkHold;
+	}
+
+	/* Losing packets: more history, or less to lose */
+
+	if (badPercent > kLinkBadPackets)
+	{
+		if (lc->growOnLoss && lc->size < lc->maxSize)
+			return kLinkBigger;
+		if (!lc->growOnLoss && lc->size > lc->minSize && lc->leader)
+			return kLinkSmaller;
+		return kLinkHold;
+	}
+
+	/* Clean window: hardly any waits, nothing lost, nothing piling up */
+
+	if (noDataPercent >= kLinkFasterNoData || lc->badPackets != 0
+		|| queue > queueExpected + 1 || !lc->leader)
+		return kLinkHold;
+
+	if (lc->rate > lc->minRate && (lc->rate - 1 != lc->failedRate || lc->backoff == 0))
+		return kLinkFaster;
+
+	if (lc->size > lc->minSize)
+		return kLinkSmaller;
+
+	return kLinkHold;
+}
+
+
+LinkAction LinkControlUpdate(LinkControl *lc, const XBInfo *info)
+{
+	LinkAction action;
+
+	lc->noData += (unsigned short)(info->noDataCount - lc->lastNoData);
+	lc->badPackets += (unsigned short)(info->badPacketCount - lc->lastBadPackets);
+	lc->lastNoData = info->noDataCount;
+	lc->lastBadPackets = info->badPacketCount;
+
+	lc->queueTotal += info->gameDataQueueSize;
+
+	/* An action that never turned into a new session was dropped */
+
+	if (lc->waiting)
+	{
+		if (++lc->exchanges < 2 * kLinkWindow)
+			return kLinkHold;
+		lc->waiting = 0;
+		lc->settling = 1;
+	}
+	else if (++lc->exchanges < kLinkWindow)
+		return kLinkHold;
+
+	action = kLinkHold;
+	if (!lc->settling)
+	{
+		action = LinkControlDecide(lc, info->roundTripLatency);
+
+		/* a faster rate that lasted a whole window holds */
+
+		if (lc->probing && action != kLinkSlower)
+		{
+			lc->probing = 0;
+			if (lc->rate == lc->failedRate)
+			{
+				lc->failedRate = 0;
+				lc->backoffLength = kLinkMinBackoff;
+			}
+		}
+	}
+
+	lc->settling = 0;
+	lc->exchanges = 0;
+	lc->noData = 0;
+	lc->badPackets = 0;
+	lc->queueTotal = 0;
+
+	if (action != kLinkHold)
+		lc->waiting = 1;
+
+	return action;
+}
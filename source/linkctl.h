@@ -0,0 +1,95 @@
+/*****************************************************************
+*
+* linkctl.h
+*
+* Picks the exchange rate and game data packet size from the
+* statistics in XBGetInfo().
+*
+* The controller looks at one window of exchanges at a time. A
+* window with many XBNoData waits or a game data queue that is on
+* average longer than the round trip explains asks for a slower rate. A clean window
+* asks for a faster one. Bad packets ask for a different packet
+* size. The two thresholds are far apart, and a faster rate that
+* failed is not tried again until a back-off runs out, so a line
+* on the edge doesn't flip back and forth. A slower rate that
+* doesn't cut the XBNoData waits (they come from the line's delay,
+* not its speed) is undone and not asked for again on that line.
+*
+* The controller only suggests a change. Both sides must open the
+* new session with the same settings, so the game has to agree on
+* the change first (netlink.c sends it as a button press). Either
+* side may ask for a slower rate or a bigger packet, but only the
+* leader asks for a faster rate or a smaller packet, so the two
+* never pull opposite ways.
+*
+*****************************************************************/
+
+
+#ifndef __LINKCTL__
+#define	__LINKCTL__
+
+#include "XBand/XBANDLIB.H"
+
+#define	kLinkWindow			120		/* exchanges per measurement */
+
+typedef enum
+{
+	kLinkHold,
+	kLinkSlower,		/* one more tick per exchange */
+	kLinkFaster,
+	kLinkBigger,		/* one more byte per packet */
+	kLinkSmaller
+} LinkAction;
+
+typedef struct
+{
+	/* limits, from LinkControlInit */
+	int				minRate;
+	int				maxRate;
+	int				minSize;
+	int				maxSize;
+	int				growOnLoss;		/* bigger packets help against loss (input history) */
+	int				leader;
+
+	/* the session being measured */
+	int				rate;
+	int				size;
+	int				settling;		/* the first window after a change is not counted */
+	int				probing;		/* rate just went down and hasn't held a window yet */
+	int				checking;		/* rate just went up: see if it helped */
+	unsigned		lastNoDataPercent;	/* of the last window measured */
+	int				ceiling;		/* slowest rate worth using on this line */
+	unsigned short	roundTrip;
+	int				waiting;		/* an action is out; wait for the new session */
+
+	/* this window */
+	int				exchanges;
+	unsigned		noData;
+	unsigned		badPackets;
+	unsigned long	queueTotal;		/* gameDataQueueSize summed over the window */
+	unsigned short	lastNoData;
+	unsigned short	lastBadPackets;
+
+	/* back-off for faster rates that didn't hold */
+	int				failedRate;
+	int				backoff;		/* windows before failedRate may be tried again */
+	int				backoffLength;
+
+	/* statistics */
+	unsigned long	changes;
+} LinkControl;
+
+void LinkControlInit(LinkControl *lc, int minRate, int maxRate, int minSize, int maxSize,
+	int growOnLoss, int leader);
+
+/* Call when a session opens with the settings both sides agreed on */
+
+void LinkControlReset(LinkControl *lc, const XBInfo *info, int rate, int size);
+
+/* Call after every exchange. Returns the change to ask for, if any. */
+/* After an action other than kLinkHold it waits for the next reset. */
+
+LinkAction LinkControlUpdate(LinkControl *lc, const XBInfo *info);
+
+
+#endif	/* __LINKCTL__ */
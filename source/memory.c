@@ -0,0 +1,148 @@
+/*****************************************************************
+*
+* memory.c
+*
+* Arenas and pools, see memory.h.
+*
+*****************************************************************/
+
+#include <stddef.h>
+
+#include "memory.h"
+
+#ifdef XB_HOST_SIM
+
+/* What GNU ld gives every Linux program, and the size in yaul.x */
+
+extern char __executable_start[];
+extern char _end[];
+
+#define	kMemoryRamStart		((unsigned long)__executable_start)
+#define	kMemoryRamSize		0x000F7D00UL
+
+#else
+
+/* From yaul.x */
+
+extern char __ram_start[];
+extern char __ram_end[];
+extern char _end[];
+
+#define	kMemoryRamStart		((unsigned long)__ram_start)
+#define	kMemoryRamSize		((unsigned long)(__ram_end - __ram_start))
+
+#endif
+
+
+void ArenaInit(Arena *arena, void *base, unsigned long size)
+{
+	arena->base = base;
+	arena->size = size & ~(kMemoryAlign - 1);
+	arena->used = 0;
+	arena->high = 0;
+	arena->failures = 0;
+}
+
+
+void *ArenaAlloc(Arena *arena, unsigned long size)
+{
+	void *block;
+
+	size = MemoryRound(size);
+	if (size > arena->size - arena->used)
+	{
+		arena->failures++;
+		return NULL;
+	}
+
+	block = arena->base + arena->used;
+	arena->used += size;
+	if (arena->used > arena->high)
+		arena->high = arena->used;
+
+	return block;
+}
+
+
+unsigned long ArenaMark(const Arena *arena)
+{
+	return arena->used;
+}
+
+
+void ArenaRelease(Arena *arena, unsigned long mark)
+{
+	if (mark < arena->used)
+		arena->used = mark;
+}
+
+
+void ArenaReset(Arena *arena)
+{
+	arena->used = 0;
+}
+
+
+void PoolInit(Pool *pool, void *base, unsigned long blockSize, unsigned count)
+{
+	unsigned char *block;
+	unsigned iii;
+
+	if (blockSize < sizeof(void *))
+		blockSize = sizeof(void *);
+
+	pool->base = base;
+	pool->blockSize = MemoryRound(blockSize);
+	pool->count = count;
+	pool->free = NULL;
+	pool->used = 0;
+	pool->high = 0;
+	pool->failures = 0;
+
+	/* Linked from the top down, so the first PoolGet gets the first block */
+
+	for (iii = count; iii > 0; iii--)
+	{
+		block = pool->base + (iii - 1) * pool->blockSize;
+		*(void **)block = pool->free;
+		pool->free = block;
+	}
+}
+
+
+void *PoolGet(Pool *pool)
+{
+	void *block = pool->free;
+
+	if (block == NULL)
+	{
+		pool->failures++;
+		return NULL;
+	}
+
+	pool->free = *(void **)block;
+	pool->used++;
+	if (pool->used > pool->high)
+		pool->high = pool->used;
+
+	return block;
+}
+
+
+void PoolPut(Pool *pool, void *block)
+{
+	if (block == NULL)
+		return;
+
+	*(void **)block = pool->free;
+	pool->free = block;
+	pool->used--;
+}
+
+
+void MemoryGetRam(MemoryRam *ram)
+{
+	ram->start = kMemoryRamStart;
+	ram->used = (unsigned long)_end - kMemoryRamStart;
+	ram->size = kMemoryRamSize;
+}
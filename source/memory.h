@@ -0,0 +1,97 @@
+/*****************************************************************
+*
+* memory.h
+*
+* Fixed memory for the main loop: arenas, pools, and how much of
+* the ram region in yaul.x the program leaves.
+*
+* Once MainLoop is running nothing calls malloc; the benchmark build
+* counts calls and fails if there are any. What the loop needs comes
+* out of buffers in .bss, handed out by:
+*
+*	Arena	bump allocation, all of it freed at once by ArenaReset.
+*			ArenaMark and ArenaRelease free back to a mark, for
+*			scratch that doesn't outlive a call.
+*	Pool	blocks of one size, taken and put back one at a time
+*
+* Both keep a high-water mark and count the requests they couldn't
+* meet. Those fail with NULL instead of going to the heap, and the
+* overlay shows how close each one came.
+*
+* Neither locks: an arena or pool belongs to one SH-2.
+*
+*****************************************************************/
+
+
+#ifndef __MEMORY__
+#define	__MEMORY__
+
+/* Everything handed out is aligned for a long or a pointer */
+
+#define	kMemoryAlign		sizeof(long)
+#define	MemoryRound(size)	(((size) + kMemoryAlign - 1) & ~(kMemoryAlign - 1))
+
+/* A buffer for an arena of size bytes, or a pool of count blocks */
+
+#define	MEMORY_BUFFER(name, size)	long name[MemoryRound(size) / sizeof(long)]
+#define	PoolSize(blockSize, count)	(MemoryRound((blockSize) < sizeof(void *) ? sizeof(void *) : (blockSize)) * (count))
+
+typedef struct
+{
+	unsigned char	*base;
+	unsigned long	size;
+	unsigned long	used;
+	unsigned long	high;			/* most used at once since ArenaInit */
+	unsigned long	failures;		/* allocations that didn't fit */
+} Arena;
+
+typedef struct
+{
+	unsigned char	*base;
+	unsigned long	blockSize;		/* rounded up */
+	unsigned		count;
+	void			*free;			/* linked through the blocks' first word */
+	unsigned		used;
+	unsigned		high;
+	unsigned long	failures;		/* PoolGet with every block out */
+} Pool;
+
+typedef struct
+{
+	unsigned long	start;			/* of the ram region */
+	unsigned long	used;			/* program, data, .bss and .uncached */
+	unsigned long	size;			/* of the ram region */
+} MemoryRam;
+
+/* base must be aligned to kMemoryAlign; MEMORY_BUFFER makes one that is */
+
+void ArenaInit(Arena *arena, void *base, unsigned long size);
+
+/* Returns size bytes, or NULL if there isn't room */
+
+void *ArenaAlloc(Arena *arena, unsigned long size);
+
+/* Frees everything allocated since ArenaMark returned mark */
+
+unsigned long ArenaMark(const Arena *arena);
+void ArenaRelease(Arena *arena, unsigned long mark);
+
+void ArenaReset(Arena *arena);
+
+/* base holds PoolSize(blockSize, count) bytes */
+
+void PoolInit(Pool *pool, void *base, unsigned long blockSize, unsigned count);
+
+/* Returns a block, or NULL if they're all out */
+
+void *PoolGet(Pool *pool);
+void PoolPut(Pool *pool, void *block);
+
+/* How much of the ram region the program takes, from the linker. */
+/* The host build's image is x86 code with 8-byte longs and pointers, */
+/* so there it is only a rough guide. */
+
+void MemoryGetRam(MemoryRam *ram);
+
+
+#endif	/* __MEMORY__ */
@@ -20,11 +20,38 @@
 #include <yaul.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#ifdef XB_HOST_SIM
+#include <time.h>
+#endif
 #include "XBand/XBANDLIB.H"
+#include "rollback.h"
+#include "gamedata.h"
+#include "linkctl.h"
+#include "sched.h"
+#include "pipeline.h"
+#include "textlayer.h"
+#include "telemetry.h"
+#include "replay.h"
+#include "statehash.h"
+#include "exchange.h"
+#include "input.h"
+#include "memory.h"
+#include "resync.h"
+#include "perf.h"
+
+/* The benchmark build (host/Makefile bench) stops MainLoop after the */
+/* frames host/bench.c asks for, and reports perf.c's timers */
+
+#ifdef NETLINK_BENCH
+#include "bench.h"
+#endif
 
 
 
 void NetGame(void);
+static int DrawFrame(void *data);
 
 void main() { NetGame(); }
 
@@ -36,6 +63,37 @@ const char phoneNumber[32] = "2\0phone number here";
 
 volatile unsigned long gTimer;
 
+/* The joypads, as v-blank out last read them */
+
+static Input gInput;
+
+/* Rollback: gSpeculative is set while advancing the on-screen */
+/* (predicted) state, which must not talk to XBAND or exit. */
+/* gDrawEnabled is cleared for frames that never reach the screen. */
+/* With the pipeline, the slave SH-2 advances the predicted state */
+/* while the master advances the confirmed one, so each CPU keeps */
+/* its own pair of flags. */
+
+typedef struct
+{
+	int		speculative;
+	int		drawEnabled;
+} AdvanceContext;
+
+static Rollback gRollback;
+static int gRollbackActive;
+static AdvanceContext gAdvanceContext[2] = { { 0, 1 }, { 0, 1 } };
+
+#define	gSpeculative	(gAdvanceContext[PipelineCpu()].speculative)
+#define	gDrawEnabled	(gAdvanceContext[PipelineCpu()].drawEnabled)
+
+/* All text goes through gText, which only sends dbgio what changed. */
+/* It belongs to whichever CPU draws. */
+
+static TextLayer gText;
+
+#define	DBG_Printf(...)	do { if (gDrawEnabled) TextPrintf(&gText, __VA_ARGS__); } while (0)
+
 /* Sega Saturn controller buttons */
 
 const unsigned kRIGHT = 1<<15;
@@ -89,6 +147,12 @@ typedef struct
 	int				gameDataSize;
 	unsigned int	ticksPerFrame;
 	int				needToOpenSession;
+	int				useRollback;		/* predict the remote joypad instead of waiting */
+	int				useInputHistory;	/* repeat recent joypads in the spare packet bytes */
+	int				useAutoRate;		/* let linkctl.c pick the rate and packet size */
+	int				usePipeline;		/* predict and draw on the slave SH-2 */
+	int				localIsMaster;		/* XBAND's answers, kept for the slave SH-2 */
+	int				allowReturnToXOS;	/* (see Initialize) */
 	char			p1Name[XBMaxNameSize];
 	char			p2Name[XBMaxNameSize];
 } NetworkInfo;
@@ -132,25 +196,212 @@ typedef struct
 	joypad_state	bothPadsDown;
 	joypad_state	oldP1Pad;
 	joypad_state	oldP2Pad;
+	/* sync-sniffer hash of the fields in gHashFields, see statehash.h */
+	uint32_t		stateHash;
+	uint32_t		hashChanged;	/* fields the last frame changed */
 } GameState;
 
 
+/* The fields both sides must agree on. The names, session requests */
+/* and game results are each side's own business. */
+
+enum
+{
+	kHashGameMode,
+	kHashModeTimeout,
+	kHashP1Score,
+	kHashP2Score,
+	kHashP1Wins,
+	kHashP2Wins,
+	kHashMasterChoice,
+	kHashSlaveChoice,
+	kHashP1Pad,
+	kHashP2Pad,
+	kHashBothPads,
+	kHashP1PadDown,
+	kHashP2PadDown,
+	kHashBothPadsDown,
+	kHashOldP1Pad,
+	kHashOldP2Pad,
+	kHashTicksPerFrame,
+	kHashGameDataSize,
+	kHashFields
+};
+
+static const StateHashField gHashFields[kHashFields] =
+{
+	STATEHASH_FIELD(GameState, gameMode),
+	STATEHASH_FIELD(GameState, modeTimeout),
+	STATEHASH_FIELD(GameState, p1Score),
+	STATEHASH_FIELD(GameState, p2Score),
+	STATEHASH_FIELD(GameState, p1Wins),
+	STATEHASH_FIELD(GameState, p2Wins),
+	STATEHASH_FIELD(GameState, masterChoice),
+	STATEHASH_FIELD(GameState, slaveChoice),
+	STATEHASH_FIELD(GameState, p1Pad),
+	STATEHASH_FIELD(GameState, p2Pad),
+	STATEHASH_FIELD(GameState, bothPads),
+	STATEHASH_FIELD(GameState, p1PadDown),
+	STATEHASH_FIELD(GameState, p2PadDown),
+	STATEHASH_FIELD(GameState, bothPadsDown),
+	STATEHASH_FIELD(GameState, oldP1Pad),
+	STATEHASH_FIELD(GameState, oldP2Pad),
+	STATEHASH_FIELD(GameState, netInfo.ticksPerFrame),
+	STATEHASH_FIELD(GameState, netInfo.gameDataSize)
+};
+
+#define	HashBit(field)		(1UL << (field))
+
+/* The fields each game mode's Advance function (and the Init */
+/* functions it calls) can change; every frame changes the pads */
+
+#define	kHashPadFields	(HashBit(kHashP1Pad) | HashBit(kHashP2Pad) | HashBit(kHashBothPads) \
+	| HashBit(kHashP1PadDown) | HashBit(kHashP2PadDown) | HashBit(kHashBothPadsDown) \
+	| HashBit(kHashOldP1Pad) | HashBit(kHashOldP2Pad))
+
+#define	kHashPlayFields	(HashBit(kHashGameMode) | HashBit(kHashModeTimeout) \
+	| HashBit(kHashP1Score) | HashBit(kHashP2Score) | HashBit(kHashP1Wins) | HashBit(kHashP2Wins))
+
+static const uint32_t gModeHashFields[] =
+{
+	kHashPlayFields,												/* kDemoMode */
+	kHashPlayFields | HashBit(kHashTicksPerFrame) | HashBit(kHashGameDataSize),	/* kGameMode */
+	HashBit(kHashGameMode) | HashBit(kHashModeTimeout)					/* kGameEnding */
+		| HashBit(kHashMasterChoice) | HashBit(kHashSlaveChoice),
+	kHashPlayFields | HashBit(kHashMasterChoice) | HashBit(kHashSlaveChoice)	/* kPlayAgain */
+};
+
+
 /* During a network game, the users can change the game data */
 /* packet size. This is for testing only. */
 
-const int kMinGameDataSize = 4;
-const int kMaxGameDataSize = 14;
+const int kMinGameDataSize = kGameDataMinPacket;
+const int kMaxGameDataSize = kGameDataMaxPacket;
+const int kMaxTicksPerFrame = 30;
+
+/* Tune the exchange rate and packet size to the line. The controller */
+/* asks for a change by pressing L/R/X/Y like a tester would, so both */
+/* sides make the change on the same confirmed frame. */
+
+const int kUseAutoRate = 1;
+
+/* Show local input right away and roll back on wrong guesses */
+
+const int kUseRollback = 1;
+
+/* With rollback, the slave SH-2 runs the prediction and draws the */
+/* screen from the frames the master hands it, so a slow exchange */
+/* on the master never holds up drawing. The benchmark build keeps */
+/* all of a frame's work on one CPU, so it is all timed. */
+
+#ifdef NETLINK_BENCH
+const int kUsePipeline = 0;
+#else
+const int kUsePipeline = 1;
+#endif
+
+/* Opt-in: repeat the last frames' joypad changes in the spare packet */
+/* bytes, so the input of a lost packet can be rebuilt from the next */
+/* one. This only pays off if the library hands back XBBadPacket for */
+/* the pair instead of resending it (see XBSIM_LOSSY in host/xbsim.c). */
+
+#ifndef NETLINK_INPUT_HISTORY
+#define	NETLINK_INPUT_HISTORY	0
+#endif
+
+const int kUseInputHistory = NETLINK_INPUT_HISTORY;
+const int kInputHistoryBytes = 8;	/* 8 idle frames, or 4 with buttons changing */
+const int kInputHistoryTail = 3;	/* history-only exchanges before a session closes */
+
+/* With the pipeline running, the master hands the slave a frame for */
+/* every frame it would have predicted: the rollback calls it would */
+/* have made and the text it printed since the last one. */
+
+#define	kFramePairs			(kGameDataHistoryFrames + 1)	/* a packet and the lost ones it rebuilt */
+#define	kFrameStatusSize	512
+
+typedef struct
+{
+	long			frame;
+	joypad_state	masterPad;
+	joypad_state	slavePad;
+} FramePair;
+
+typedef struct
+{
+	int				reset;			/* a session opened at resetFrame */
+	long			resetFrame;
+	int				pairCount;
+	FramePair		pairs[kFramePairs];
+	GameState		confirmed;		/* after the pairs */
+	joypad_state	localPad;
+	int				statusLength;
+	char			status[kFrameStatusSize];
+} PipelineFrame;
+
+/* Network statistics, sampled by the master after every exchange */
+
+static Telemetry gTelemetry;
+
+/* Every confirmed frame's pads, to play a match again. Simulator */
+/* builds can save it (XBSIM_RECORD) and play it back (XBSIM_REPLAY). */
+
+static ReplayRecorder gRecorder;
+
+/* Hashes of the confirmed frames of this session, for the sync-sniffer */
+
+static StateHashHistory gStateHashes;
+
+/* Snapshots of the confirmed state to go back to after an error, */
+/* see resync.h */
+
+#define	kResyncAttempts		3		/* sessions tried before giving up */
+
+static ResyncHistory gResync;
+static MEMORY_BUFFER(gResyncMemory, kResyncSnapshots * sizeof(GameState));
+
+static Pipeline gPipeline;
+static PipelineFrame gPipelineFrames[kPipelineFrames];
+static PipelineFrame *gPendingFrame;	/* the master is filling it */
+static unsigned long gLastSyncTime;		/* the slave's last vdp2_sync */
+static int gFrameDrawn;					/* the slave's frame waits for v-blank */
+
+/* The main loop's memory, see memory.h. The frame arena is scratch */
+/* for one time round the loop, and keeps it off the master's 8 KB */
+/* stack; the session arena is emptied whenever a session opens or */
+/* closes. The pools hold the exchange's packets and copies of the */
+/* game state. All of it belongs to the master. */
+
+#define	kFrameArenaSize		1024
+#define	kSessionArenaSize	512
+#define	kStatusLineSize		128
+#define	kPacketBlocks		3		/* local, master and slave halves */
+#define	kSnapshotBlocks		2		/* the predicted state, or PlayRecording's two */
+
+static Arena gFrameArena;
+static Arena gSessionArena;
+static Pool gPacketPool;
+static Pool gSnapshotPool;
+
+static MEMORY_BUFFER(gFrameMemory, kFrameArenaSize);
+static MEMORY_BUFFER(gSessionMemory, kSessionArenaSize);
+static MEMORY_BUFFER(gPacketMemory, PoolSize(kGameDataMaxPacket, kPacketBlocks));
+static MEMORY_BUFFER(gSnapshotMemory, PoolSize(sizeof(GameState), kSnapshotBlocks));
 
-/* Game data struct. This is the packet that is passed into XBExchangeGameData */
+/* What starts over with each session, in the session arena: the codec */
+/* streams and the input history */
 
 typedef struct
 {
-	joypad_state joypad;
-	short finished;
-	long frameCount;
-	char checksum;
-	char padding[14];	/* to make room for game data packets up to 14 bytes in length */
-} GameData;
+	GameDataStream	sendStream;
+	GameDataStream	masterStream;
+	GameDataStream	slaveStream;
+	GameDataHistory	history;
+} SessionData;
+
+typedef char SessionDataCheck[sizeof(SessionData) <= kSessionArenaSize ? 1 : -1];
+
+/* The GameData packet and its wire codec live in gamedata.h */
 static void DBG_ClearScreen()
 {
 	//dbgio_printf("[2J");
@@ -158,702 +409,1650 @@ static void DBG_ClearScreen()
 
 static void DBG_SetCursol(int x, int y)
 {
-	dbgio_printf("[%d;%dH",y,x);
+	if (gDrawEnabled)
+		TextSetCursor(&gText, x, y);
 }
 
 
 /*
 //
-// This function is called in v-blank out.
+// These functions put the text that changed on screen, and show how
+// much that took.
 //
 */
 
-static void GameVblankOut(void *work __unused)
+static void ShowText(void)
 {
-	smpc_peripheral_intback_issue();
-	gTimer++;
-	XBVBLTask();	/* we should call XBDebugInit before calling XBVBLTask! */
-}
+	PERF_BEGIN(kPerfText);
+	TextFlush(&gText);
+	PERF_END(kPerfText);
 
+	PERF_BEGIN(kPerfDbgioFlush);
+	dbgio_flush();
+	PERF_END(kPerfDbgioFlush);
 
-/*
-//
-// Wait for v-blank out.
-//
-*/
+	PERF_BEGIN(kPerfVdp2Sync);
+	vdp2_sync();
+	PERF_END(kPerfVdp2Sync);
+}
 
-static void WaitForVBLOut(void)
+static void ShowTextStats(void)
 {
-	unsigned long now;
-
-	now = gTimer;
-
-	while (now == gTimer)
-	{
-	};
+	TextSetCursor(&gText, 1, 21);
+	TextPrintf(&gText, "Text %4u bytes  %3u cells   ", gText.lastBytes, gText.lastCells);
 }
 
 
 /*
 //
-// This function turns on VBL-out routines and starts reading the joypads.
+// This function ends the telemetry session. Simulator builds append
+// its summary to the file XBSIM_TELEMETRY names, if it is set. The
+// next session starts right away, so a copy of this one is written
+// in idle time, as deferred work.
 //
 */
 
-static void TurnOnVBLs(void)
+#ifdef XB_HOST_SIM
+static Telemetry gTelemetrySaved;
+static int gTelemetryPending;
+
+static void WriteTelemetryLine(const char *line, void *ref)
 {
-	gTimer = 0;
-	
-        vdp_sync_vblank_out_set(GameVblankOut, NULL);
-	
-	WaitForVBLOut();
-	smpc_peripheral_init();
+	fprintf((FILE *)ref, "[%s] %s\n", XBLocalIsMaster() ? "master" : "slave ", line);
 }
 
+static void WriteTelemetry(void *work __unused)
+{
+	const char *name;
+	FILE *file;
 
-/*
-//
-// This function reads the physical joypads.
-//
-// WARNING: This code appears to work, but
-//	should NOT be used as a good example
-//	of how to read the joypads. It is kept small
-//	and simple because the focus of this sample code is
-//	to be an example of how to use the game library --
-//	NOT how to read and deal with the many different
-//	kinds of Sega peripherals.
-//
-*/
+	if (!gTelemetryPending)
+		return;
+	gTelemetryPending = 0;
 
-static void GetJoypads(joypad_state *pad1, joypad_state *pad2)
+	name = getenv("XBSIM_TELEMETRY");
+	if (name == NULL || *name == '\0' || (file = fopen(name, "a")) == NULL)
+		return;
+
+	TelemetryDump(&gTelemetrySaved, WriteTelemetryLine, file);
+	fclose(file);
+}
+#endif
+
+static void SaveTelemetry(void)
 {
-	static smpc_peripheral_digital_t _digital;
-	smpc_peripheral_process();
+	if (!TelemetryEndSession(&gTelemetry, gTimer))
+		return;
 
-    	smpc_peripheral_digital_port(1, &_digital);
-	*pad1 = 0xffff ^ _digital.pressed.raw;
-	
-	smpc_peripheral_digital_port(2, &_digital);
-	*pad2 = 0xffff ^ _digital.pressed.raw;
+#ifdef XB_HOST_SIM
+	WriteTelemetry(NULL);	/* the one before, if it's still waiting */
+
+	gTelemetrySaved = gTelemetry;
+	gTelemetryPending = 1;
+	if (!SchedDefer(WriteTelemetry, NULL))
+		WriteTelemetry(NULL);
+#endif
 }
 
 
 /*
 //
-// This function builds XBAND game results out of the current game state.
+// This function sets up the main loop's arenas and pools.
 //
 */
 
-static void BuildGameResults(GameState *theState, XBGameResults *theResults)
+static void InitMemory(void)
 {
-	int i;
-
-	theResults->masterScore = theState->p1Score;
-	theResults->slaveScore = theState->p2Score;
-
-	/* userData can be used for anything the game developer desires */
-	/* It will be uploaded to the Catapult server */
-	/* We'll just fill it with the values 0 through 31 */
-
-	for (i = 0; i<32; i++)
-		theResults->userData[i] = i;
+	ArenaInit(&gFrameArena, gFrameMemory, sizeof(gFrameMemory));
+	ArenaInit(&gSessionArena, gSessionMemory, sizeof(gSessionMemory));
+	PoolInit(&gPacketPool, gPacketMemory, kGameDataMaxPacket, kPacketBlocks);
+	PoolInit(&gSnapshotPool, gSnapshotMemory, sizeof(GameState), kSnapshotBlocks);
 }
 
 
 /*
 //
-// This function checks XBAND library calls for errors and does a reasonable thing
-// if an error is returned -- namely, aborts the current game.
+// This function returns the frame the master is filling, starting
+// a new one if needed.
 //
 */
 
-static void HandleXBErr(GameState *theState, XBErr inErr)
+static PipelineFrame *PendingFrame(void)
 {
-	XBGameResults gameResults;
-	unsigned long waitUntil;
-
-	if (inErr==XBNoErr)
-		return;
-
-	BuildGameResults(theState, &gameResults);
-
-	DBG_ClearScreen();
-
-	DBG_SetCursol(1,2);
-	dbgio_printf("Sorry, your game could not be\n");
-	dbgio_printf("  completed because we lost the\n");
-	dbgio_printf("  connection to your opponent.\n\n");
-	dbgio_printf("          Error code = %d.\n", inErr);
-
-	XBNetworkGameError(&gameResults, inErr);
-
-	waitUntil = gTimer + 300; /* 300 ticks = 5 seconds */
-
-	/* wait at least five seconds before exiting */
-	/* so the user can read the onscreen message */
-
-	while (gTimer < waitUntil)
+	if (gPendingFrame == NULL)
 	{
-	};
+		gPendingFrame = PipelineBegin(&gPipeline);
+		gPendingFrame->reset = 0;
+		gPendingFrame->pairCount = 0;
+		gPendingFrame->statusLength = 0;
+		gPendingFrame->status[0] = '\0';
+	}
 
-	exit(0);	/* never returns -- reboots to XBAND OS */
+	return gPendingFrame;
 }
 
 
 /*
 //
-// This function asks the user whether to try master, slave, or local game.
+// These functions print the main loop's status text. With the
+// pipeline running, only the slave may use dbgio, so the text goes
+// with the next frame and the slave prints it. The line is formatted
+// in the frame arena, and given back straight after.
 //
 */
 
-static void DetermineXBANDRole(void)
+static void StatusPrintf(const char *format, ...)
 {
-	joypad_state pad1, pad2, bothPads;
+	PipelineFrame *frame;
+	unsigned long mark;
+	char *buffer;
+	va_list args;
+	int length;
+
+	mark = ArenaMark(&gFrameArena);
+	if ((buffer = ArenaAlloc(&gFrameArena, kStatusLineSize)) == NULL)
+		return;
 
-	DBG_ClearScreen();
+	va_start(args, format);
+	length = vsnprintf(buffer, kStatusLineSize, format, args);
+	va_end(args);
 
-	DBG_SetCursol(1,2);
-	dbgio_printf("Type one of start, A, B, C\n\n");
-	dbgio_printf(" start: pretend no XBAND installed\n A: be master, dial %s\n B: be slave\n C: local game\n", phoneNumber);
+	if (length >= kStatusLineSize)
+		length = kStatusLineSize - 1;
 
-	do
+	if (!gPipeline.running)
+		TextPuts(&gText, buffer);
+	else
 	{
-		/* wait for vertical blank */
-		WaitForVBLOut();
-
-		GetJoypads(&pad1, &pad2);
-		bothPads = pad1 | pad2;
-
-		if (bothPads & kButtonStart)
-		{
-			break;	/* no XBAND whatsoever */
-		}
-
-		if (bothPads & kButtonA)
-		{
-			dbgio_printf("\n\n Dialing %s, hang on...\n", phoneNumber);
-			XBMakeMaster(phoneNumber);
-			break;
-		}
-		if (bothPads & kButtonB)
-		{
-			dbgio_printf("\n\n Waiting for call...\n");
-			XBMakeSlave();
-			break;
-		}
-		if (bothPads & kButtonC)
+		frame = PendingFrame();
+		if (frame->statusLength + length < kFrameStatusSize)
 		{
-			XBMakeLocalGame();
-			break;
+			memcpy(frame->status + frame->statusLength, buffer, length + 1);
+			frame->statusLength += length;
 		}
-	} while (1);
-
-
-	/* Wait for users to release pad buttons */
+	}
 
-	do
-	{
-		WaitForVBLOut();
-		GetJoypads(&pad1, &pad2);
-		bothPads = pad1 | pad2;
-	} while ((bothPads & (kButtonA | kButtonB | kButtonC | kButtonStart)) != 0);
+	ArenaRelease(&gFrameArena, mark);
+}
 
-	DBG_ClearScreen();
+static void StatusSetCursol(int x, int y)
+{
+	StatusPrintf("\033[%d;%dH", y, x);
 }
 
 
 /*
 //
-// This function prints an error message on the screen, if it seems warranted.
+// This function shows the sync-sniffer: how many frames were checked,
+// or where the two sides first went apart and the fields to suspect.
+// Both are hints (see statehash.h), and say so: a check is a byte,
+// and the suspects can miss the field. Once a resync session has
+// compared the fields, the ones that differ are shown instead.
 //
 */
 
-static void PrintErrorMessage(XBErr inErr)
+static void ShowSyncSniffer(void)
 {
-	if (inErr == XBRemoteDataInTransit)
-		return;
-
-	DBG_SetCursol(2, 20);
-	if (inErr != XBNoErr)
-		dbgio_printf("Error code %d: trying to recover...", inErr);
-	else
-		dbgio_printf("                                        ");
+	const int kFieldsSize = 64;
+	char *fields;
+	int length, iii;
 
-	DBG_SetCursol(2, 7);
+	StatusSetCursol(1, 24);
 
-	switch (inErr)
+	if (!gStateHashes.diverged)
 	{
-		/* This may take a long time! */
-		case XBConnectionLost:
-			if (XBLocalIsMaster())
-				dbgio_printf("Redialing...               \n");
-			else
-				dbgio_printf("Waiting for call...        \n");
-			break;
-
-		/* This may take a second or two. */
-		case XBBadPacket:
-			dbgio_printf("Line noise, hang on...     \n");
-			break;
+		StatusPrintf("Sync-sniffer OK  checked %lu (8-bit)  ", gStateHashes.checked);
+		return;
+	}
 
-		/* You may wish to just ignore this error. */
-		case XBNoData:
-			dbgio_printf("Waiting for data...        \n");
-			break;
+	if ((fields = ArenaAlloc(&gFrameArena, kFieldsSize)) == NULL)
+		return;
 
-		/* It's probably best to simply ignore this error. */
-		case XBRemoteDataInTransit:
-			dbgio_printf("Waiting for initial data...\n");
-			break;
+	length = 0;
+	fields[0] = '\0';
+	for (iii = 0; iii < kHashFields && length < kFieldsSize - 1; iii++)
+	{
+		if (gStateHashes.badFields & HashBit(iii))
+			length += snprintf(fields + length, kFieldsSize - length, " %s", gHashFields[iii].name);
+	}
 
-		default:
-		case XBNoErr:
-			dbgio_printf("                             ");
-	};
+	if (gStateHashes.named)
+		StatusPrintf("BAD, differ at %ld:%.22s", gStateHashes.namedFrame, fields);
+	else if (gStateHashes.firstBadFrame == gStateHashes.badFrame)
+		StatusPrintf("BAD frame %ld, suspect:%.18s", gStateHashes.badFrame, fields);
+	else
+		StatusPrintf("BAD frame %ld-%ld, suspect:%.12s", gStateHashes.firstBadFrame,
+			gStateHashes.badFrame, fields);
 }
 
 
 /*
 //
-// This function is called when the remote user decided he doesn't want
-// to play another network game.
+// This function shows the telemetry overlay: this session's round
+// trip and bad packet rate, and its latency and jitter histograms.
 //
 */
 
-static void RemoteChoseNo(void)
+static void ShowTelemetry(void)
 {
-	unsigned long waitUntil;
+	const TelemetrySession *session = &gTelemetry.session;
+	char latency[kTelemetryBuckets + 1], jitter[kTelemetryBuckets + 1];
+	unsigned long average, variation;
+	unsigned bad;
 
-	DBG_ClearScreen();
-	DBG_SetCursol(1, 10);
-	dbgio_printf("'%s' didn't want to play again.\n", XBRemotePlayerName());
-
-	waitUntil = gTimer + 300; /* 300 ticks = 5 seconds */
+	average = TelemetryAverage(session->roundTripTotal, session->exchanges);
+	variation = TelemetryAverage(session->jitterTotal, session->exchanges);
+	bad = TelemetryPermille(session->counters[kTelemetryBadPackets], session->exchanges);
 
-	XBCloseSession(); /* XBCloseSession may take a few seconds */
-
-	/* wait at least five seconds before exiting */
-	/* so the user can read the onscreen message */
+	StatusSetCursol(1, 1);
+	StatusPrintf("RTT %2u avg %lu.%02lu jit %lu.%02lu bad %u.%u%%   ",
+		gTelemetry.lastRoundTrip, average / 100, average % 100,
+		variation / 100, variation % 100, bad / 10, bad % 10);
 
-	while (gTimer < waitUntil)
-	{
-	};
+	TelemetryHistogram(session->latency, latency);
+	TelemetryHistogram(session->jitter, jitter);
 
-	XBReadyToExit();
-	exit(0);
+	StatusSetCursol(1, 18);
+	StatusPrintf("Lat %s  Jit %s", latency, jitter);
 }
 
 
 /*
 //
-// This function is called when the local user decided he doesn't want
-// to play another network game.
+// This function shows the main loop's memory: the most each arena
+// and pool has had out, in bytes or blocks, and what's left of ram.
+// A '!' means something asked for more than there was. It goes on
+// the top row, which no screen of the game writes to.
 //
 */
 
-static void LocalChoseNo(void)
+static void ShowMemory(void)
 {
-	XBCloseSession();
-	XBReadyToExit();
-	exit(0);
+	MemoryRam ram;
+	unsigned long failures;
+
+	MemoryGetRam(&ram);
+	failures = gFrameArena.failures + gSessionArena.failures
+		+ gPacketPool.failures + gSnapshotPool.failures;
+
+	StatusSetCursol(1, 0);
+	StatusPrintf("Mem f%lu s%lu p%u/%u k%u/%u free %luK%s   ",
+		gFrameArena.high, gSessionArena.high, gPacketPool.high, gPacketPool.count,
+		gSnapshotPool.high, gSnapshotPool.count,
+		ram.used < ram.size ? (ram.size - ram.used) / 1024 : 0, failures ? " !" : "");
 }
 
 
 /*
 //
-// This function sets up the game state for demo mode.
+// This function shows the frames the input recorder holds, or that
+// it has stopped. "Play again?" wraps its last line onto the row, so
+// there it only clears what is left of the row past the wrap.
 //
 */
 
-static void InitDemoMode(GameState *theState)
+static void ShowRecording(const GameState *theState)
 {
-	DBG_ClearScreen();
-	theState->gameMode = kDemoMode;
-	theState->modeTimeout = 0;
+	if (theState->gameMode == kPlayAgain)
+	{
+		StatusSetCursol(5, 8);
+		StatusPrintf("%*s", kTextColumns - 5, "");
+		return;
+	}
+
+	StatusSetCursol(1, 8);
+
+	if (!gRecorder.full)
+		StatusPrintf("REC %ld-%ld  %u bytes   ", ReplayFirstFrame(&gRecorder), gRecorder.frames,
+			gRecorder.length);
+	else if (gRecorder.stateSize > kReplayStateSize)
+		StatusPrintf("REC failed: state %u > %u bytes", gRecorder.stateSize, kReplayStateSize);
+	else
+		StatusPrintf("REC full at frame %ld          ", gRecorder.frames);
 }
 
 
+#if NETLINK_PERF
 /*
 //
-// This function sets up the game state for a "new game".
+// This function draws the profiler over AdvanceGame's help rows, once
+// a second: each section's average and worst microseconds a frame,
+// on the CPU that spent longer in it ('s' for the slave).
 //
 */
 
-static void InitPlayGame(GameState *theState)
+static void ShowPerf(void)
 {
-	DBG_ClearScreen();
-	theState->gameMode = kGameMode;
-	theState->p1Score = 0;
-	theState->p2Score = 0;
-	theState->p1Wins = 0;
-	theState->p2Wins = 0;
-	theState->modeTimeout = 0;
-}
+	static unsigned long lastSecond;
+	PerfStats master, slave, *stats;
+	int section, iii;
+
+	if (PerfSeconds(kPerfMaster) == lastSecond)
+		return;
+	lastSecond = PerfSeconds(kPerfMaster);
+
+	for (iii = 0; iii <= kPerfSections; iii++)
+	{
+		section = (iii < kPerfSections) ? iii : -1;
+
+		PerfGetStats(kPerfMaster, section, &master);
+		PerfGetStats(kPerfSlave, section, &slave);
+		stats = (section >= 0 && slave.avg * slave.frames > master.avg * master.frames) ? &slave : &master;
 
+		if (!(iii & 1))
+			StatusSetCursol(1, 10 + iii / 2);
+		StatusPrintf("%-6s%c%5lu%7lu ", PerfSectionName(section), (stats == &slave) ? 's' : ' ',
+			PerfMicroseconds(stats->avg), PerfMicroseconds(stats->max));
+	}
+}
+#endif
 
 
 /*
 //
-// This function sets up the game state for "game over" mode.
+// This function reads the physical joypads, in v-blank out.
+//
+// WARNING: This code appears to work, but
+//	should NOT be used as a good example
+//	of how to read the joypads. It is kept small
+//	and simple because the focus of this sample code is
+//	to be an example of how to use the game library --
+//	NOT how to read and deal with the many different
+//	kinds of Sega peripherals.
 //
 */
 
-static void InitGameEnding(GameState *theState)
+static void ReadPorts(joypad_state *pad1, joypad_state *pad2)
 {
-	theState->gameMode = kGameEnding;
-	theState->modeTimeout = kGameEndingTimeout;
+	static smpc_peripheral_digital_t _digital;
+	smpc_peripheral_process();
+
+    	smpc_peripheral_digital_port(1, &_digital);
+	*pad1 = 0xffff ^ _digital.pressed.raw;
+	
+	smpc_peripheral_digital_port(2, &_digital);
+	*pad2 = 0xffff ^ _digital.pressed.raw;
 }
 
 
+/*
+//
+// This function returns the joypads v-blank out last read.
+//
+*/
+
+static void GetJoypads(joypad_state *pad1, joypad_state *pad2)
+{
+	InputSnapshot snapshot;
+
+	InputRead(&gInput, &snapshot);
+	*pad1 = snapshot.pads[0];
+	*pad2 = snapshot.pads[1];
+}
+
 
 /*
 //
-// This function sets up the game state for "Play again?" mode.
+// This function is called in v-blank out.
 //
 */
 
-static void InitPlayAgain(GameState *theState)
+static void GameVblankOut(void *work __unused)
 {
-	DBG_ClearScreen();
+	joypad_state pad1, pad2;
 
-	theState->gameMode = kPlayAgain;
-	theState->modeTimeout = kPlayAgainTimeout;
+	/* The INTBACK issued last time is done by now */
 
-	theState->masterChoice = kChoosingNo;
-	theState->slaveChoice = kChoosingNo;
+	ReadPorts(&pad1, &pad2);
+	smpc_peripheral_intback_issue();
+
+	gTimer++;
+	InputCapture(&gInput, gTimer, pad1, pad2);
+
+	XBVBLTask();	/* we should call XBDebugInit before calling XBVBLTask! */
+	SchedVblank();
+	PipelineVblank(&gPipeline);
 }
 
 
+/*
+//
+// Wait for v-blank out.
+//
+*/
+
+static void WaitForVBLOut(void)
+{
+	SchedWaitVblank();
+}
+
 
 /*
 //
-// This function actually advances the game state "one frame" during demo mode.
+// This function turns on VBL-out routines and starts reading the joypads.
 //
 */
 
-static void AdvanceDemoMode(GameState *theState)
+static void TurnOnVBLs(void)
 {
-	DBG_SetCursol(4, 2);
-	dbgio_printf("Press <start> to begin game");
+	gTimer = 0;
+	SchedInit(&gTimer);
+	InputInit(&gInput);
+	smpc_peripheral_init();
+	
+        vdp_sync_vblank_out_set(GameVblankOut, NULL);
+	
+	WaitForVBLOut();
+}
 
-	DBG_SetCursol(12, 5);
 
-	/* make it blink */
+/*
+//
+// This function builds XBAND game results out of the current game state.
+//
+*/
 
-	if (gTimer & 0x20)
-		dbgio_printf("DEMO MODE");
-	else
-		dbgio_printf("         ");
+static void BuildGameResults(GameState *theState, XBGameResults *theResults)
+{
+	int i;
 
-	if (XBAllowReturnToXOS())
-	{
-		DBG_SetCursol(2,9);
-		dbgio_printf("Press L & R to return to XBAND");
-		if (((theState->p1Pad & (kButtonL | kButtonR)) == (kButtonL | kButtonR)) 
-			|| ((theState->p2Pad & (kButtonL | kButtonR)) == (kButtonL | kButtonR)))
-		{
-			/* Give the game library a chance to do clean up */
-			XBReadyToExit();
+	theResults->masterScore = theState->p1Score;
+	theResults->slaveScore = theState->p2Score;
 
-			/* Return to XBAND */
-			exit(0);
-		}
-	}
+	/* userData can be used for anything the game developer desires */
+	/* It will be uploaded to the Catapult server */
+	/* We'll just fill it with the values 0 through 31 */
 
-	if ((theState->bothPads) & kButtonStart)
-		InitPlayGame(theState); /* switch to game play */
+	for (i = 0; i<32; i++)
+		theResults->userData[i] = i;
 }
 
 
 /*
 //
-// This function actually advances the game state "one frame" during game play.
-// The game presented here isn't very fun.
+// This function tries to get a network game back after inErr instead
+// of ending it. Over a session of its own it agrees with the other
+// side on a snapshot both have, and goes back to it. Returns 1 if it
+// did, and a new game session needs opening; 0 if it couldn't.
+//
+// If the two sides' snapshots differ, the game has gone apart: the
+// sync-sniffer asks for the session on its first mismatch for just
+// that. The fields that differ are named, and both sides still go
+// back to the frame, so they stay in step, and play on apart as they
+// did before.
+//
+// The talk takes seconds, so the master stops the pipeline and draws
+// while it goes on, and hands drawing back once it is done. The frame
+// it was filling is dropped: the new session starts the prediction
+// over from the frame gone back to.
 //
 */
 
-static void AdvanceGame(GameState *theState)
+static int RecoverSession(GameState *theState, XBErr inErr)
 {
-	XBGameResults results;
-	XBErr theErr;
+	unsigned char localPacket[kResyncPacketSize];
+	unsigned char masterPacket[kResyncPacketSize];
+	unsigned char slavePacket[kResyncPacketSize];
+	unsigned char *localHalf, *remoteHalf;
+	ResyncTalk talk;
+	Exchange exchange;
+	ExchangeState state;
+	XBErr err;
+	long lost;
+	int attempt, tail, pipelined;
 
-	if (theState->p1PadDown & kButtonA)
-	{
-		theState->p1Score++;
-	}
+	localHalf = XBLocalIsMaster() ? masterPacket : slavePacket;
+	remoteHalf = XBLocalIsMaster() ? slavePacket : masterPacket;
 
-	if (theState->p1PadDown & kButtonB)
-	{
-		if (--theState->p1Score < 0)
-			theState->p1Score = 0;
-	}
+	pipelined = gPipeline.running;
+	PipelineStop(&gPipeline);
+	gPendingFrame = NULL;
 
-	if (theState->p2PadDown & kButtonA)
+	DBG_SetCursol(2, 20);
+	TextPrintf(&gText, "Error code %d: resyncing...        ", inErr);
+	ShowText();
+
+	ResyncBegin(&talk);
+	ExchangeInit(&exchange, &gTimer);
+	err = inErr;
+
+	for (attempt = 0; attempt < kResyncAttempts && talk.status == kResyncTalking; attempt++)
 	{
-		theState->p2Score++;
+		XBCloseSession();
+		ArenaReset(&gSessionArena);
+
+		/* Settings of our own, so a mismatch can't happen again */
+
+		err = XBOpenSession(kResyncPacketSize, kResyncTicksPerFrame);
+		if (err != XBNoErr)
+			continue;
+
+		ResyncBegin(&talk);
+		ExchangeOpen(&exchange, kResyncTicksPerFrame);
+		tail = 0;
+
+		while (tail < kResyncTail)
+		{
+			ResyncPut(&gResync, &talk, localPacket);
+			ExchangePost(&exchange, localPacket);
+
+			while ((state = ExchangePoll(&exchange, masterPacket, slavePacket)) == kExchangePending)
+				SchedSleepUntil(ExchangeDue(&exchange));
+
+			err = exchange.err;
+			if (state == kExchangeInTransit || state == kExchangeNoData)
+				continue;
+
+			/* The other side may have closed once it was done */
+
+			if (err != XBNoErr && err != XBBadPacket)
+				break;
+
+			if (talk.status != kResyncTalking)
+				tail++;
+			else
+				ResyncTake(&gResync, &talk, localHalf, (err == XBBadPacket) ? NULL : remoteHalf);
+		}
 	}
 
-	if (theState->p2PadDown & kButtonB)
+	XBCloseSession();
+	ArenaReset(&gSessionArena);
+
+	if (talk.status == kResyncDiffers)
 	{
-		if (--theState->p2Score < 0)
-			theState->p2Score = 0;
+		gStateHashes.diverged = 1;
+		gStateHashes.named = 1;
+		gStateHashes.namedFrame = talk.frame;
+		gStateHashes.badFields = talk.badFields;
 	}
 
-	if ((theState->p1Score >= 5) || (theState->p2Score >= 5))
+	lost = gResync.frames - talk.frame;
+	if ((talk.status != kResyncAgreed && talk.status != kResyncDiffers)
+		|| !ResyncRewind(&gResync, talk.frame, theState))
+		return 0;
+
+	ReplayTruncate(&gRecorder, talk.frame);
+	theState->netInfo.needToOpenSession = 1;
+
+	DBG_SetCursol(2, 20);
+	TextPrintf(&gText, "Resynced at frame %ld, %ld lost       ", talk.frame, lost);
+	ShowText();
+
+	if (pipelined)
+		PipelineStart(&gPipeline, gPipelineFrames, sizeof(PipelineFrame), DrawFrame);
+
+#ifdef XB_HOST_SIM
+	printf("[%s] resync after error %d at frame %ld, %ld frames lost\n",
+		XBLocalIsMaster() ? "master" : "slave ", inErr, talk.frame, lost);
+	if (talk.status == kResyncDiffers)
 	{
-		if (theState->p1Score >= 5)
-			theState->p1Wins++;
-		else
-			theState->p2Wins++;
-		theState->p1Score = 0;
-		theState->p2Score = 0;
-		if ((theState->p1Wins > 3) || (theState->p2Wins > 3))
+		int iii;
+
+		printf("[%s] sides differ at frame %ld in", XBLocalIsMaster() ? "master" : "slave ", talk.frame);
+		for (iii = 0; iii < kHashFields; iii++)
 		{
-			if (theState->netInfo.gameType == XBNetworkGame)
-			{
-				/* Commit game results */
-				BuildGameResults(theState, &results);
-				XBNetworkGameOver(&results);
-			}
-			/* transfer control to "game over" */
-			InitGameEnding(theState);
+			if (talk.badFields & HashBit(iii))
+				printf(" %s", gHashFields[iii].name);
 		}
+		printf("\n");
 	}
+#endif
 
-	theState->bothPadsDown = theState->p1PadDown | theState->p2PadDown;
+	return 1;
+}
 
-	if (theState->netInfo.gameType == XBNetworkGame)
+
+/*
+//
+// This function checks XBAND library calls for errors and does a reasonable thing
+// if an error is returned. In a network game an error the session can be
+// recovered from is; anything else aborts the current game. Returns 1 if
+// the game was recovered and a new session needs opening.
+//
+*/
+
+static int HandleXBErr(GameState *theState, XBErr inErr)
+{
+	XBGameResults gameResults;
+	unsigned long waitUntil;
+
+	if (inErr==XBNoErr)
+		return 0;
+
+	if (theState->netInfo.gameType == XBNetworkGame && !gSpeculative)
 	{
-		if (XBLocalIsMaster())
-		{
-			if (theState->p1PadDown & kButtonC)
-			{
-				XBLineNoise(20, 18, 5);
-				/* simulate line errors on the master */
-			}
-			if (theState->p1PadDown & kButtonStart)
-			{
-				theState->netInfo.needToOpenSession = 1;
-				/* open a new session */
-			}
-		}
-		else
+		switch (inErr)
 		{
-			if (theState->p2PadDown & kButtonC)
-			{
-				XBLineNoise(20, 18, 5);
-				/* simulate line errors on the slave*/
-			}
+			case XBTimeout:
+			case XBOutOfSync:
+			case XBMismatchedExchangeRate:
+			case XBMismatchedPacketSizes:
+			case XBSessionClosed:
+				if (RecoverSession(theState, inErr))
+					return 1;
+				break;
+
+			default:
+				break;
 		}
+	}
 
-		if (theState->bothPadsDown & kButtonZ)
+	BuildGameResults(theState, &gameResults);
+
+	SaveTelemetry();
+	PipelineStop(&gPipeline);	/* the master draws from here on */
+	DBG_ClearScreen();
+
+	DBG_SetCursol(1,2);
+	TextPrintf(&gText, "Sorry, your game could not be\n");
+	TextPrintf(&gText, "  completed because we lost the\n");
+	TextPrintf(&gText, "  connection to your opponent.\n\n");
+	TextPrintf(&gText, "          Error code = %d.\n", inErr);
+	ShowText();
+
+	XBNetworkGameError(&gameResults, inErr);
+
+	waitUntil = gTimer + 300; /* 300 ticks = 5 seconds */
+
+	/* wait at least five seconds before exiting */
+	/* so the user can read the onscreen message */
+
+	SchedSleepUntil(waitUntil);
+
+	exit(0);	/* never returns -- reboots to XBAND OS */
+}
+
+
+/*
+//
+// This function asks the user whether to try master, slave, or local game.
+//
+*/
+
+static void DetermineXBANDRole(void)
+{
+	joypad_state pad1, pad2, bothPads;
+
+	DBG_ClearScreen();
+
+	DBG_SetCursol(1,2);
+	TextPrintf(&gText, "Type one of start, A, B, C\n\n");
+	TextPrintf(&gText, " start: pretend no XBAND installed\n A: be master, dial %s\n B: be slave\n C: local game\n", phoneNumber);
+
+	do
+	{
+		/* wait for vertical blank */
+		WaitForVBLOut();
+
+		GetJoypads(&pad1, &pad2);
+		bothPads = pad1 | pad2;
+
+		if (bothPads & kButtonStart)
 		{
-			/* flush data request */
-			theErr = XBCloseSession();
-			if (theErr != XBNoErr)
-				return;
-			HandleXBErr(theState, theErr);
-			theState->netInfo.needToOpenSession = 1;
+			break;	/* no XBAND whatsoever */
 		}
 
-		if (theState->bothPadsDown & kButtonL)
+		if (bothPads & kButtonA)
 		{
-			if (--theState->netInfo.ticksPerFrame <= 0)
-				theState->netInfo.ticksPerFrame = 1;
+			TextPrintf(&gText, "\n\n Dialing %s, hang on...\n", phoneNumber);
+			XBMakeMaster(phoneNumber);
+			break;
+		}
+		if (bothPads & kButtonB)
+		{
+			TextPrintf(&gText, "\n\n Waiting for call...\n");
+			XBMakeSlave();
+			break;
+		}
+		if (bothPads & kButtonC)
+		{
+			XBMakeLocalGame();
+			break;
+		}
+	} while (1);
+
+
+	/* Wait for users to release pad buttons */
+
+	do
+	{
+		WaitForVBLOut();
+		GetJoypads(&pad1, &pad2);
+		bothPads = pad1 | pad2;
+	} while ((bothPads & (kButtonA | kButtonB | kButtonC | kButtonStart)) != 0);
+
+	DBG_ClearScreen();
+}
+
+
+/*
+//
+// This function prints an error message on the screen, if it seems warranted.
+//
+*/
+
+static void PrintErrorMessage(XBErr inErr)
+{
+	if (inErr == XBRemoteDataInTransit)
+		return;
+
+	/* With rollback the game keeps running on predicted input */
+
+	if (gRollbackActive && inErr == XBNoData)
+		return;
+
+	StatusSetCursol(2, 20);
+	if (inErr != XBNoErr)
+		StatusPrintf("Error code %d: trying to recover...", inErr);
+	else
+		StatusPrintf("                                        ");
+
+	StatusSetCursol(2, 7);
+
+	switch (inErr)
+	{
+		/* This may take a long time! */
+		case XBConnectionLost:
+			if (XBLocalIsMaster())
+				StatusPrintf("Redialing...               \n");
+			else
+				StatusPrintf("Waiting for call...        \n");
+			break;
+
+		/* This may take a second or two. */
+		case XBBadPacket:
+			StatusPrintf("Line noise, hang on...     \n");
+			break;
+
+		/* You may wish to just ignore this error. */
+		case XBNoData:
+			StatusPrintf("Waiting for data...        \n");
+			break;
+
+		/* It's probably best to simply ignore this error. */
+		case XBRemoteDataInTransit:
+			StatusPrintf("Waiting for initial data...\n");
+			break;
+
+		default:
+		case XBNoErr:
+			StatusPrintf("                             ");
+	};
+}
+
+
+/*
+//
+// This function is called when the remote user decided he doesn't want
+// to play another network game.
+//
+*/
+
+static void RemoteChoseNo(void)
+{
+	unsigned long waitUntil;
+
+	SaveTelemetry();
+	PipelineStop(&gPipeline);
+	DBG_ClearScreen();
+	DBG_SetCursol(1, 10);
+	TextPrintf(&gText, "'%s' didn't want to play again.\n", XBRemotePlayerName());
+	ShowText();
+
+	waitUntil = gTimer + 300; /* 300 ticks = 5 seconds */
+
+	XBCloseSession(); /* XBCloseSession may take a few seconds */
+	ArenaReset(&gSessionArena);
+
+	/* wait at least five seconds before exiting */
+	/* so the user can read the onscreen message */
+
+	SchedSleepUntil(waitUntil);
+
+	XBReadyToExit();
+	exit(0);
+}
+
+
+/*
+//
+// This function is called when the local user decided he doesn't want
+// to play another network game.
+//
+*/
+
+static void LocalChoseNo(void)
+{
+	SaveTelemetry();
+	XBCloseSession();
+	ArenaReset(&gSessionArena);
+	XBReadyToExit();
+	exit(0);
+}
+
+
+/*
+//
+// This function sets up the game state for demo mode.
+//
+*/
+
+static void InitDemoMode(GameState *theState)
+{
+	DBG_ClearScreen();
+	theState->gameMode = kDemoMode;
+	theState->modeTimeout = 0;
+}
+
+
+/*
+//
+// This function sets up the game state for a "new game".
+//
+*/
+
+static void InitPlayGame(GameState *theState)
+{
+	DBG_ClearScreen();
+	theState->gameMode = kGameMode;
+	theState->p1Score = 0;
+	theState->p2Score = 0;
+	theState->p1Wins = 0;
+	theState->p2Wins = 0;
+	theState->modeTimeout = 0;
+}
+
+
+
+/*
+//
+// This function sets up the game state for "game over" mode.
+//
+*/
+
+static void InitGameEnding(GameState *theState)
+{
+	theState->gameMode = kGameEnding;
+	theState->modeTimeout = kGameEndingTimeout;
+}
+
+
+
+/*
+//
+// This function sets up the game state for "Play again?" mode.
+//
+*/
+
+static void InitPlayAgain(GameState *theState)
+{
+	DBG_ClearScreen();
+
+	theState->gameMode = kPlayAgain;
+	theState->modeTimeout = kPlayAgainTimeout;
+
+	theState->masterChoice = kChoosingNo;
+	theState->slaveChoice = kChoosingNo;
+}
+
+
+
+/*
+//
+// This function actually advances the game state "one frame" during demo mode.
+//
+*/
+
+static void AdvanceDemoMode(GameState *theState)
+{
+	DBG_SetCursol(4, 2);
+	DBG_Printf("Press <start> to begin game");
+
+	DBG_SetCursol(12, 5);
+
+	/* make it blink */
+
+	if (gTimer & 0x20)
+		DBG_Printf("DEMO MODE");
+	else
+		DBG_Printf("         ");
+
+	if (theState->netInfo.allowReturnToXOS)
+	{
+		DBG_SetCursol(2,9);
+		DBG_Printf("Press L & R to return to XBAND");
+		if (!gSpeculative
+			&& (((theState->p1Pad & (kButtonL | kButtonR)) == (kButtonL | kButtonR)) 
+			|| ((theState->p2Pad & (kButtonL | kButtonR)) == (kButtonL | kButtonR))))
+		{
+			/* Give the game library a chance to do clean up */
+			XBReadyToExit();
+
+			/* Return to XBAND */
+			exit(0);
+		}
+	}
+
+	if ((theState->bothPads) & kButtonStart)
+		InitPlayGame(theState); /* switch to game play */
+}
+
+
+/*
+//
+// This function actually advances the game state "one frame" during game play.
+// The game presented here isn't very fun.
+//
+*/
+
+static void AdvanceGame(GameState *theState)
+{
+	XBGameResults results;
+	XBErr theErr;
+
+	if (theState->p1PadDown & kButtonA)
+	{
+		theState->p1Score++;
+	}
+
+	if (theState->p1PadDown & kButtonB)
+	{
+		if (--theState->p1Score < 0)
+			theState->p1Score = 0;
+	}
+
+	if (theState->p2PadDown & kButtonA)
+	{
+		theState->p2Score++;
+	}
+
+	if (theState->p2PadDown & kButtonB)
+	{
+		if (--theState->p2Score < 0)
+			theState->p2Score = 0;
+	}
+
+	if ((theState->p1Score >= 5) || (theState->p2Score >= 5))
+	{
+		if (theState->p1Score >= 5)
+			theState->p1Wins++;
+		else
+			theState->p2Wins++;
+		theState->p1Score = 0;
+		theState->p2Score = 0;
+		if ((theState->p1Wins > 3) || (theState->p2Wins > 3))
+		{
+			if (theState->netInfo.gameType == XBNetworkGame && !gSpeculative)
+			{
+				/* Commit game results */
+				BuildGameResults(theState, &results);
+				XBNetworkGameOver(&results);
+			}
+			/* transfer control to "game over" */
+			InitGameEnding(theState);
+		}
+	}
+
+	if (theState->netInfo.gameType == XBNetworkGame)
+	{
+		if (theState->netInfo.localIsMaster)
+		{
+			if ((theState->p1PadDown & kButtonC) && !gSpeculative)
+			{
+				XBLineNoise(20, 18, 5);
+				/* simulate line errors on the master */
+			}
+		}
+		else
+		{
+			if ((theState->p2PadDown & kButtonC) && !gSpeculative)
+			{
+				XBLineNoise(20, 18, 5);
+				/* simulate line errors on the slave*/
+			}
+		}
+
+		if (theState->p1PadDown & kButtonStart)
+		{
+			theState->netInfo.needToOpenSession = 1;
+			/* open a new session; the slave sees the master's press on the */
+			/* same frame, so both sides stop exchanging at the same point */
+		}
+
+		if (theState->bothPadsDown & kButtonZ)
+		{
+			/* flush data request. With input history the new session */
+			/* flushes it instead, after the history-only exchanges. */
+			if (!gSpeculative && !theState->netInfo.useInputHistory)
+			{
+				theErr = XBCloseSession();
+				ArenaReset(&gSessionArena);
+				if (theErr != XBNoErr)
+					return;
+				HandleXBErr(theState, theErr);
+			}
+			theState->netInfo.needToOpenSession = 1;
+		}
+
+		if (theState->bothPadsDown & kButtonL)
+		{
+			if (--theState->netInfo.ticksPerFrame <= 0)
+				theState->netInfo.ticksPerFrame = 1;
+			theState->netInfo.needToOpenSession = 1;
+		}
+
+		if (theState->bothPadsDown & kButtonR)
+		{
+			if (++theState->netInfo.ticksPerFrame > kMaxTicksPerFrame)
+				theState->netInfo.ticksPerFrame = kMaxTicksPerFrame;
+			theState->netInfo.needToOpenSession = 1;
+		}
+
+		if (theState->bothPadsDown & kButtonX)
+		{
+			if (--theState->netInfo.gameDataSize < kMinGameDataSize)
+				theState->netInfo.gameDataSize = kMinGameDataSize;
+			theState->netInfo.needToOpenSession = 1;
+		}
+
+		if (theState->bothPadsDown & kButtonY)
+		{
+			if (++theState->netInfo.gameDataSize > kMaxGameDataSize)
+				theState->netInfo.gameDataSize = kMaxGameDataSize;
 			theState->netInfo.needToOpenSession = 1;
 		}
+	}
+
+	/* Update screen */
+
+	DBG_SetCursol(2, 3);
+	DBG_Printf("%s", theState->netInfo.p1Name);
+
+	DBG_SetCursol(22, 3);
+	DBG_Printf("%s", theState->netInfo.p2Name);
+
+	DBG_SetCursol(2, 4);
+	DBG_Printf("Score : %d", theState->p1Score);
+
+	DBG_SetCursol(22, 4);
+	DBG_Printf("Score : %d", theState->p2Score);
+
+	DBG_SetCursol(3, 5);
+	DBG_Printf("Wins : %d", theState->p1Wins);
+
+	DBG_SetCursol(23, 5);
+	DBG_Printf("Wins : %d", theState->p2Wins);
+
+	/* The profiler's overlay uses these rows */
+
+#if !NETLINK_PERF
+	DBG_SetCursol(0, 10);
+	DBG_Printf("  A: add a point    B: subtract a point\n");
+
+	/* Display network game specific stuff */
+
+	if (theState->netInfo.gameType == XBNetworkGame)
+	{
+		DBG_Printf("  C: sim line error Z: flush data\n\n");
+		DBG_Printf("  L: -- exch rate    R: ++ exch rate\n");
+		DBG_Printf("         Current rate: %d %s\n\n", theState->netInfo.ticksPerFrame,
+			theState->netInfo.useAutoRate ? "(auto)" : "");
+		DBG_Printf("  X: -- packet size  Y: ++ packet size\n");
+		DBG_Printf("         Current size: %d \n", theState->netInfo.gameDataSize);
+	}
+#endif
+}
+
+
+/*
+//
+// This function actually advances the game state "one frame" during the flashing
+// "game over".
+//
+*/
+
+static void AdvanceGameEnding(GameState *theState)
+{
+	DBG_SetCursol( 16, 19 );
+	if (gTimer & 0x20)
+		DBG_Printf("Game over");
+	else
+		DBG_Printf("         ");
+
+	if (--theState->modeTimeout == 0)
+	{
+		theState->gameMode = kDemoMode;
+		if (theState->netInfo.gameType == XBNetworkGame)
+		{
+			InitPlayAgain(theState);
+		}
+		DBG_ClearScreen();
+	}
+}
+
+
+/*
+//
+// This function actually advances the game state "one frame" during the 
+// "play again?" screen.
+//
+*/
+
+static void AdvancePlayAgain(GameState *theState)
+{
+	YesNoChoice localChoice, remoteChoice;
+	int drawNo, drawYes;
+
+	DBG_SetCursol(1, 5);
+	DBG_Printf("Do you wish to play\n  '%s' again?\n This game will not count towards your stats.\n",
+		theState->netInfo.localIsMaster ? theState->netInfo.p2Name : theState->netInfo.p1Name);
+
+	/* only display local selection */
+
+	if (theState->netInfo.localIsMaster)
+	{
+		localChoice = theState->masterChoice;
+		remoteChoice = theState->slaveChoice;
+	}
+	else
+	{
+		remoteChoice = theState->masterChoice;
+		localChoice = theState->slaveChoice;
+	}
+
+	/* Blink the currently selected word. If selection has already */
+	/* been made, only draw the chosen work. */
+
+	drawNo = 1;
+	drawYes = 1;
+
+	if ((localChoice == kChoosingNo) && (gTimer & 0x20)) /* blink No if selected*/
+		drawNo = 0;
+
+	if (localChoice == kChosenYes)
+		drawNo = 0;
+
+	if ((localChoice == kChoosingYes) && (gTimer & 0x20)) /* blink Yes if selected */
+		drawYes = 0;
+
+	if (localChoice == kChosenNo)
+		drawYes = 0;
+
+	DBG_SetCursol(8, 9);
+	if (drawNo)
+		DBG_Printf("No ");
+	else
+		DBG_Printf("   ");
+
+	DBG_SetCursol(28, 9);
+	if (drawYes)
+		DBG_Printf("Yes");
+	else
+		DBG_Printf("   ");
+
+	/* update master selection */
+
+	if ((theState->masterChoice == kChoosingYes) && (theState->p1PadDown == kLEFT))
+		theState->masterChoice = kChoosingNo;
+
+	if ((theState->masterChoice == kChoosingNo) && (theState->p1PadDown == kRIGHT))
+		theState->masterChoice = kChoosingYes;
+
+	if ((theState->masterChoice == kChoosingYes) && (theState->p1PadDown == kButtonStart))
+		theState->masterChoice = kChosenYes;
+
+	if ((theState->masterChoice == kChoosingNo) && (theState->p1PadDown == kButtonStart))
+		theState->masterChoice = kChosenNo;
+
+	/* update slave selection */
+
+	if ((theState->slaveChoice == kChoosingYes) && (theState->p2PadDown == kLEFT))
+		theState->slaveChoice = kChoosingNo;
+
+	if ((theState->slaveChoice == kChoosingNo) && (theState->p2PadDown == kRIGHT))
+		theState->slaveChoice = kChoosingYes;
+
+	if ((theState->slaveChoice == kChoosingYes) && (theState->p2PadDown == kButtonStart))
+		theState->slaveChoice = kChosenYes;
+
+	if ((theState->slaveChoice == kChoosingNo) && (theState->p2PadDown == kButtonStart))
+		theState->slaveChoice = kChosenNo;
+
+	if (--theState->modeTimeout == 0)
+	{
+		if ((theState->masterChoice == kChoosingYes) || (theState->masterChoice == kChoosingNo))
+			theState->masterChoice = kChosenNo;
+
+		if ((theState->slaveChoice == kChoosingYes) || (theState->slaveChoice == kChoosingNo))
+			theState->slaveChoice = kChosenNo;
+	}
+
+	/* Leaving is only done on confirmed input */
+
+	if (!gSpeculative)
+	{
+		if (remoteChoice == kChosenNo)
+			RemoteChoseNo();
+
+		if (localChoice == kChosenNo)
+			LocalChoseNo();
+	}
+
+	if ((localChoice == kChosenYes) && (remoteChoice == kChosenYes))
+		InitPlayGame(theState);
+}
+
+
+/*
+//
+// This function updates the joypad fields from this frame's pads
+// and advances the game state "one frame".
+//
+*/
+
+static void AdvanceFrame(GameState *theState, joypad_state masterPad, joypad_state slavePad)
+{
+	GameState before;
+
+	before = *theState;
+
+	/* Update all the joypad fields */
+
+	theState->oldP1Pad = theState->p1Pad;
+	theState->oldP2Pad = theState->p2Pad;
+
+	theState->p1Pad = masterPad;
+	theState->p2Pad = slavePad;
+	theState->bothPads = masterPad | slavePad;
+
+	theState->p1PadDown = theState->p1Pad & (~theState->oldP1Pad);
+	theState->p2PadDown = theState->p2Pad & (~theState->oldP2Pad);
+	theState->bothPadsDown = theState->p1PadDown | theState->p2PadDown;
+
+	/* Advance the game a frame */
+
+	switch (theState->gameMode)
+	{
+		case kDemoMode:
+			PERF_BEGIN(kPerfAdvanceDemo);
+			AdvanceDemoMode(theState);
+			PERF_END(kPerfAdvanceDemo);
+			break;
+
+		case kGameMode:
+			PERF_BEGIN(kPerfAdvanceGame);
+			AdvanceGame(theState);
+			PERF_END(kPerfAdvanceGame);
+			break;
+
+		case kGameEnding:
+			PERF_BEGIN(kPerfAdvanceEnding);
+			AdvanceGameEnding(theState);
+			PERF_END(kPerfAdvanceEnding);
+			break;
+
+		case kPlayAgain:
+			PERF_BEGIN(kPerfAdvancePlayAgain);
+			AdvancePlayAgain(theState);
+			PERF_END(kPerfAdvancePlayAgain);
+			break;
+
+		default:
+			break;
+	}
+
+	theState->stateHash = StateHashUpdate(theState->stateHash, &before, theState, gHashFields,
+		kHashPadFields | gModeHashFields[before.gameMode], &theState->hashChanged);
+}
+
+
+/*
+//
+// This function shows how far the prediction runs ahead.
+//
+*/
+
+static void ShowRollbackStats(void)
+{
+	DBG_SetCursol(1, 25);
+	TextPrintf(&gText, "Ahead %2ld  misses %lu  resim %lu   ",
+		gRollback.nextFrame - gRollback.confirmedFrame,
+		gRollback.mispredictCount, gRollback.resimulatedCount);
+}
+
+
+/*
+//
+// These functions make the rollback calls for the main loop, or with
+// the pipeline running, note them in the frame for the slave.
+//
+*/
+
+static void FrameReset(const GameState *confirmed, long frame)
+{
+	PipelineFrame *pending;
+
+	if (!gPipeline.running)
+	{
+		RollbackReset(&gRollback, confirmed, frame);
+		return;
+	}
+
+	/* The slave starts over from the state FramePredict hands it, */
+	/* which is the same unless pairs came in first; then the */
+	/* prediction has to start over from it anyway. */
+
+	pending = PendingFrame();
+	pending->reset = 1;
+	pending->resetFrame = frame;
+	pending->pairCount = 0;
+}
+
+static void FrameConfirm(long frame, joypad_state masterPad, joypad_state slavePad)
+{
+	PipelineFrame *pending;
+	FramePair *pair;
+
+	if (!gPipeline.running)
+	{
+		RollbackConfirm(&gRollback, frame, masterPad, slavePad);
+		return;
+	}
+
+	pending = PendingFrame();
+	if (pending->pairCount == kFramePairs)
+		return;		/* can't happen: a frame never carries more */
+
+	pair = &pending->pairs[pending->pairCount++];
+	pair->frame = frame;
+	pair->masterPad = masterPad;
+	pair->slavePad = slavePad;
+}
+
+static void FramePredict(const GameState *confirmed, joypad_state localPad)
+{
+	PipelineFrame *pending;
+
+	if (!gPipeline.running)
+	{
+		RollbackPredict(&gRollback, confirmed, localPad);
+		ShowRollbackStats();
+		return;
+	}
+
+	pending = PendingFrame();
+	pending->confirmed = *confirmed;
+	pending->localPad = localPad;
+
+	gPendingFrame = NULL;
+	PipelinePost(&gPipeline);
+}
+
+
+/*
+//
+// This function runs on the slave SH-2 for each frame the master
+// posts: it brings the prediction up to date, draws it and hands
+// the screen to VDP2. Until the last screen is committed it returns
+// 0, and is called on the frame again after the next v-blank.
+//
+*/
+
+static int DrawFrame(void *data)
+{
+	PipelineFrame *frame = data;
+	int iii;
+
+	if (!gFrameDrawn)
+	{
+		PERF_BEGIN(kPerfPredict);
 
-		if (theState->bothPadsDown & kButtonR)
-		{
-			if (++theState->netInfo.ticksPerFrame > 30)
-				theState->netInfo.ticksPerFrame = 30;
-			theState->netInfo.needToOpenSession = 1;
-		}
+		if (frame->reset)
+			RollbackReset(&gRollback, &frame->confirmed, frame->resetFrame);
 
-		if (theState->bothPadsDown & kButtonX)
-		{
-			if (--theState->netInfo.gameDataSize > kMaxGameDataSize)
-				theState->netInfo.gameDataSize = kMaxGameDataSize;
-			theState->netInfo.needToOpenSession = 1;
-		}
+		for (iii = 0; iii < frame->pairCount; iii++)
+			RollbackConfirm(&gRollback, frame->pairs[iii].frame,
+				frame->pairs[iii].masterPad, frame->pairs[iii].slavePad);
 
-		if (theState->bothPadsDown & kButtonY)
-		{
-			if (++theState->netInfo.gameDataSize < kMinGameDataSize)
-				theState->netInfo.gameDataSize = kMinGameDataSize;
-			theState->netInfo.needToOpenSession = 1;
-		}
+		RollbackPredict(&gRollback, &frame->confirmed, frame->localPad);
+		PERF_END(kPerfPredict);
+
+		ShowRollbackStats();
+		TextPuts(&gText, frame->status);
+		ShowTextStats();
+		gFrameDrawn = 1;
 	}
 
-	/* Update screen */
+	/* The last vdp2_sync is committed by the v-blank after it */
 
-	DBG_SetCursol(2, 3);
-	dbgio_printf("%s", theState->netInfo.p1Name);
+	if (PipelineShared(&gTimer) == gLastSyncTime)
+		return 0;
 
-	DBG_SetCursol(22, 3);
-	dbgio_printf("%s", theState->netInfo.p2Name);
+	ShowText();
+	gLastSyncTime = PipelineShared(&gTimer);
+	gFrameDrawn = 0;
 
-	DBG_SetCursol(2, 4);
-	dbgio_printf("Score : %d", theState->p1Score);
+	PERF_FRAME();
+	return 1;
+}
 
-	DBG_SetCursol(22, 4);
-	dbgio_printf("Score : %d", theState->p2Score);
 
-	DBG_SetCursol(3, 5);
-	dbgio_printf("Wins : %d", theState->p1Wins);
+#ifdef XB_HOST_SIM
 
-	DBG_SetCursol(23, 5);
-	dbgio_printf("Wins : %d", theState->p2Wins);
+/*
+//
+// This function knocks the slave's confirmed state out of step once,
+// on the frame XBSIM_DESYNC names, to try the sync-sniffer with. It
+// bumps p2Wins behind the game code's back, so it's never a suspect.
+//
+*/
 
-	DBG_SetCursol(0, 10);
-	dbgio_printf("  A: add a point    B: subtract a point\n");
+static void SimDesync(GameState *theState)
+{
+	static long desyncFrame = -1;
+	const char *value;
+	GameState before;
+	uint32_t changed;
 
-	/* Display network game specific stuff */
+	if (desyncFrame < 0)
+		desyncFrame = ((value = getenv("XBSIM_DESYNC")) != NULL) ? atol(value) : 0;
 
-	if (theState->netInfo.gameType == XBNetworkGame)
-	{
-		dbgio_printf("  C: sim line error Z: flush data\n\n");
-		dbgio_printf("  L: -- exch rate    R: ++ exch rate\n");
-		dbgio_printf("         Current rate: %d \n\n", theState->netInfo.ticksPerFrame);
-		dbgio_printf("  X: -- packet size  Y: ++ packet size\n");
-		dbgio_printf("         Current size: %d \n", theState->netInfo.gameDataSize);
-	}
+	if (desyncFrame <= 0 || gResync.frames != desyncFrame || theState->netInfo.localIsMaster)
+		return;
+	desyncFrame = 0;
+
+	before = *theState;
+	theState->p2Wins++;
+	theState->stateHash = StateHashUpdate(theState->stateHash, &before, theState, gHashFields,
+		HashBit(kHashP2Wins), &changed);
 }
+#endif
 
 
 /*
 //
-// This function actually advances the game state "one frame" during the flashing
-// "game over".
+// This function advances theState over a frame whose pads both sides
+// agree on. With rollback it is not drawn; the predicted state is.
 //
 */
 
-static void AdvanceGameEnding(GameState *theState)
+static void AdvanceConfirmed(GameState *theState, joypad_state masterPad, joypad_state slavePad,
+	long localFrame)
 {
-	DBG_SetCursol( 16, 19 );
-	if (gTimer & 0x20)
-		dbgio_printf("Game over");
-	else
-		dbgio_printf("         ");
+#ifdef XB_HOST_SIM
+	SimDesync(theState);
+#endif
+	ReplayRecord(&gRecorder, theState, masterPad, slavePad);
+	ResyncRecord(&gResync, theState, theState->stateHash);
 
-	if (--theState->modeTimeout == 0)
+	if (!gRollbackActive)
 	{
-		theState->gameMode = kDemoMode;
-		if (theState->netInfo.gameType == XBNetworkGame)
-		{
-			InitPlayAgain(theState);
-		}
-		DBG_ClearScreen();
+		AdvanceFrame(theState, masterPad, slavePad);
+		StateHashRecord(&gStateHashes, localFrame, theState->stateHash, theState->hashChanged);
+		return;
 	}
+
+	gDrawEnabled = 0;
+	AdvanceFrame(theState, masterPad, slavePad);
+	gDrawEnabled = 1;
+
+	StateHashRecord(&gStateHashes, localFrame, theState->stateHash, theState->hashChanged);
+	FrameConfirm(localFrame, masterPad, slavePad);
 }
 
 
 /*
 //
-// This function actually advances the game state "one frame" during the 
-// "play again?" screen.
+// This function advances the predicted state for the rollback code.
+// Nothing it does may reach XBAND, and only the newest frame is drawn.
 //
 */
 
-static void AdvancePlayAgain(GameState *theState)
+static void AdvancePredicted(void *state, unsigned short masterPad, unsigned short slavePad, int draw)
 {
-	YesNoChoice localChoice, remoteChoice;
-	int drawNo, drawYes;
+	gSpeculative = 1;
+	gDrawEnabled = draw;
 
-	DBG_SetCursol(1, 5);
-	dbgio_printf("Do you wish to play\n  '%s' again?\n This game will not count towards your stats.\n",
-		XBRemotePlayerName());
+	AdvanceFrame((GameState *)state, masterPad, slavePad);
 
-	/* only display local selection */
+	gDrawEnabled = 1;
+	gSpeculative = 0;
+}
 
-	if (XBLocalIsMaster())
-	{
-		localChoice = theState->masterChoice;
-		remoteChoice = theState->slaveChoice;
-	}
-	else
-	{
-		remoteChoice = theState->masterChoice;
-		localChoice = theState->slaveChoice;
-	}
 
-	/* Blink the currently selected word. If selection has already */
-	/* been made, only draw the chosen work. */
+/*
+//
+// This function advances a state being played back from gRecorder.
+// Like a predicted one, it doesn't talk to XBAND or draw.
+//
+*/
 
-	drawNo = 1;
-	drawYes = 1;
+static void AdvanceReplay(void *state, unsigned short masterPad, unsigned short slavePad)
+{
+	gSpeculative = 1;
+	gDrawEnabled = 0;
 
-	if ((localChoice == kChoosingNo) && (gTimer & 0x20)) /* blink No if selected*/
-		drawNo = 0;
+	AdvanceFrame((GameState *)state, masterPad, slavePad);
 
-	if (localChoice == kChosenYes)
-		drawNo = 0;
+	/* MainLoop would open the session it asks for before the next frame */
 
-	if ((localChoice == kChoosingYes) && (gTimer & 0x20)) /* blink Yes if selected */
-		drawYes = 0;
+	((GameState *)state)->netInfo.needToOpenSession = 0;
 
-	if (localChoice == kChosenNo)
-		drawYes = 0;
+	gDrawEnabled = 1;
+	gSpeculative = 0;
+}
 
-	DBG_SetCursol(8, 9);
-	if (drawNo)
-		dbgio_printf("No ");
-	else
-		dbgio_printf("   ");
 
-	DBG_SetCursol(28, 9);
-	if (drawYes)
-		dbgio_printf("Yes");
-	else
-		dbgio_printf("   ");
+#ifdef XB_HOST_SIM
 
-	/* update master selection */
+/*
+//
+// This function writes gRecorder to the file XBSIM_RECORD names, with
+// ".master" or ".slave" added. It runs at exit, since the simulator
+// can end the game from inside XBExchangeGameData.
+//
+*/
 
-	if ((theState->masterChoice == kChoosingYes) && (theState->p1PadDown == kLEFT))
-		theState->masterChoice = kChoosingNo;
+static void WriteReplayBytes(const void *data, unsigned size, void *ref)
+{
+	fwrite(data, 1, size, (FILE *)ref);
+}
 
-	if ((theState->masterChoice == kChoosingNo) && (theState->p1PadDown == kRIGHT))
-		theState->masterChoice = kChoosingYes;
+static void SaveRecording(void)
+{
+	const char *name;
+	char path[256];
+	FILE *file;
 
-	if ((theState->masterChoice == kChoosingYes) && (theState->p1PadDown == kButtonStart))
-		theState->masterChoice = kChosenYes;
+	name = getenv("XBSIM_RECORD");
+	if (name == NULL || *name == '\0' || gRecorder.frames == 0)
+		return;
 
-	if ((theState->masterChoice == kChoosingNo) && (theState->p1PadDown == kButtonStart))
-		theState->masterChoice = kChosenNo;
+	snprintf(path, sizeof(path), "%s.%s", name, XBLocalIsMaster() ? "master" : "slave");
+	if ((file = fopen(path, "wb")) == NULL)
+		return;
 
-	/* update slave selection */
+	ReplaySave(&gRecorder, WriteReplayBytes, file);
+	fclose(file);
+}
 
-	if ((theState->slaveChoice == kChoosingYes) && (theState->p2PadDown == kLEFT))
-		theState->slaveChoice = kChoosingNo;
 
-	if ((theState->slaveChoice == kChoosingNo) && (theState->p2PadDown == kRIGHT))
-		theState->slaveChoice = kChoosingYes;
+/*
+//
+// This function plays back the recording XBSIM_REPLAY names (with
+// ".master" or ".slave" added) as fast as it can, checks that seeking
+// to the middle ends in the same state, and exits. It returns if
+// XBSIM_REPLAY isn't set.
+//
+*/
 
-	if ((theState->slaveChoice == kChoosingYes) && (theState->p2PadDown == kButtonStart))
-		theState->slaveChoice = kChosenYes;
+static void PlayRecording(void)
+{
+	static ReplayRecorder recording;
+	static unsigned char data[sizeof(ReplayRecorder)];
+	const char *name, *role;
+	char path[256];
+	FILE *file;
+	unsigned size;
+	ReplayPlayer player;
+	GameState *state, *seekState;
+	unsigned long checksum;
+	long first, frames;
+	clock_t start;
+	double seconds;
+
+	name = getenv("XBSIM_REPLAY");
+	if (name == NULL || *name == '\0')
+		return;
 
-	if ((theState->slaveChoice == kChoosingNo) && (theState->p2PadDown == kButtonStart))
-		theState->slaveChoice = kChosenNo;
+	role = XBLocalIsMaster() ? "master" : "slave ";
+	snprintf(path, sizeof(path), "%s.%s", name, XBLocalIsMaster() ? "master" : "slave");
 
-	if (--theState->modeTimeout == 0)
+	if ((file = fopen(path, "rb")) == NULL)
 	{
-		if ((theState->masterChoice == kChoosingYes) || (theState->masterChoice == kChoosingNo))
-			theState->masterChoice = kChosenNo;
+		fprintf(stderr, "[%s] can't open %s\n", role, path);
+		exit(1);
+	}
+	size = (unsigned)fread(data, 1, sizeof(data), file);
+	fclose(file);
 
-		if ((theState->slaveChoice == kChoosingYes) || (theState->slaveChoice == kChoosingNo))
-			theState->slaveChoice = kChosenNo;
+	if (!ReplayLoad(&recording, data, size) || recording.stateSize != sizeof(GameState))
+	{
+		fprintf(stderr, "[%s] %s isn't a recording of this game\n", role, path);
+		exit(1);
 	}
 
-	if (remoteChoice == kChosenNo)
-		RemoteChoseNo();
+	ReplayPlayerInit(&player, &recording, AdvanceReplay);
+	state = PoolGet(&gSnapshotPool);
+	seekState = PoolGet(&gSnapshotPool);
 
-	if (localChoice == kChosenNo)
-		LocalChoseNo();
+	/* A long match only kept its last part */
 
-	if ((localChoice == kChosenYes) && (remoteChoice == kChosenYes))
-		InitPlayGame(theState);
+	first = ReplayFirstFrame(&recording);
+
+	start = clock();
+	ReplaySeek(&player, first, state);
+	while (ReplayStep(&player, state))
+		;
+	seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	frames = player.frame - first;
+	checksum = ReplayChecksum(state, sizeof(*state));
+
+	ReplaySeek(&player, first + frames / 2, seekState);
+	while (ReplayStep(&player, seekState))
+		;
+
+	printf("[%s] replay %ld frames from %ld in %.3f s (%.0f/s) checksum %08lx, seek %s\n",
+		role, frames, first, seconds, seconds > 0 ? frames / seconds : 0.0, checksum,
+		ReplayChecksum(seekState, sizeof(*seekState)) == checksum ? "matches" : "DIFFERS");
+	fflush(stdout);
+
+	exit(player.frame == recording.frames ? 0 : 1);
 }
 
+#endif
+
 
 /*
 //
@@ -866,8 +2065,10 @@ static void AdvancePlayAgain(GameState *theState)
 static void Initialize(GameState *theState)
 {
 	const int	kInitialSwapRate = 2;
-	const int	kInitialGameDataSize = 12;
+	const int	kInitialGameDataSize = kGameDataMinPacket	/* the codec fits a frame in 4 bytes */
+		+ (kUseInputHistory ? kInputHistoryBytes : 0);
 	int			XOSIsAbsent;
+	GameState	*predictedState;
 	int			iii;
 
 	const char *player1Name, *player2Name;
@@ -877,10 +2078,9 @@ static void Initialize(GameState *theState)
 	DBG_ClearScreen();
 	DBG_SetCursol ( 1, 2 );
 
-	dbgio_printf("Sample game: NetGame");
-	vdp2_sync();
-        vdp2_sync_wait();
-        dbgio_flush();
+	TextPrintf(&gText, "Sample game: NetGame");
+	ShowText();
+	vdp2_sync_wait();
 		
 	XOSIsAbsent = !gGameDispatchTable[1] || XBDebugInit();
 
@@ -893,6 +2093,16 @@ static void Initialize(GameState *theState)
 	theState->netInfo.gameDataSize = kInitialGameDataSize;
 	theState->netInfo.ticksPerFrame = kInitialSwapRate;
 	theState->netInfo.needToOpenSession = 1;	/* we need to initialize a new session */
+	theState->netInfo.useRollback = kUseRollback;
+	theState->netInfo.useInputHistory = kUseInputHistory;
+	theState->netInfo.useAutoRate = kUseAutoRate;
+	theState->netInfo.usePipeline = kUsePipeline;
+
+	/* The Advance functions also run on the slave SH-2, where they */
+	/* mustn't call the library, so they use these copies */
+
+	theState->netInfo.localIsMaster = (theState->netInfo.gameType == XBNetworkGame && XBLocalIsMaster());
+	theState->netInfo.allowReturnToXOS = XBAllowReturnToXOS();
 
 	theState->p1Pad = 0;
 	theState->p2Pad = 0;
@@ -927,26 +2137,57 @@ static void Initialize(GameState *theState)
 		InitPlayGame(theState);		/* skip demo mode in a network game */
 
 		DBG_SetCursol(2, 8);
-		dbgio_printf("Random number seed is %d\n\n", XBGetRandomSeed());
-		dbgio_printf("   I am the ");
+		TextPrintf(&gText, "Random number seed is %lu\n\n", XBGetRandomSeed());
+		TextPrintf(&gText, "   I am the ");
 		if (XBLocalIsMaster())
-			dbgio_printf("master\n");
+			TextPrintf(&gText, "master\n");
 		else
-			dbgio_printf("slave\n");
+			TextPrintf(&gText, "slave\n");
 
-		dbgio_printf("\n  Get ready to play '%s'!\n", XBRemotePlayerName());
+		TextPrintf(&gText, "\n  Get ready to play '%s'!\n", XBRemotePlayerName());
 
 		for (iii = 0; iii<kReadyToPlayTimeout; iii++)
 			WaitForVBLOut();		/* wait a bit before clearing screen */
 
 		DBG_ClearScreen();
+
+		if (theState->netInfo.useRollback)
+		{
+			predictedState = PoolGet(&gSnapshotPool);
+			memset(predictedState, 0, sizeof(GameState));
+
+			RollbackInit(&gRollback, predictedState, sizeof(GameState),
+				AdvancePredicted, XBLocalIsMaster());
+			gRollbackActive = 1;
+		}
+	}
+}
+
+
+/*
+//
+// This function turns a controller suggestion into the button a
+// tester would press for it in AdvanceGame.
+//
+*/
+
+static joypad_state LinkActionButton(LinkAction action)
+{
+	switch (action)
+	{
+		case kLinkSlower:	return kButtonR;
+		case kLinkFaster:	return kButtonL;
+		case kLinkBigger:	return kButtonY;
+		case kLinkSmaller:	return kButtonX;
+		default:			return 0;
 	}
 }
 
 
 /*
 //
-// This function is the game's main loop. It never exits.
+// This function is the game's main loop. It never exits, except in
+// the benchmark build.
 //
 */
 
@@ -957,97 +2198,364 @@ static void MainLoop(GameState *theState)
 	joypad_state localJoypad1, localJoypad2;
 	joypad_state masterPad, slavePad;
 	GameData localGameData, masterGameData, slaveGameData;
+	unsigned char *localPacket, *masterPacket, *slavePacket;
+	const GameDataCodec *codec;
+	SessionData *session;
+	GameDataStream *localStream, *remoteStream;
+	GameData *localData, *remoteData;
+	unsigned char *localHalf, *remoteHalf;
+	joypad_state lostPads[kGameDataHistoryFrames];		/* local pads of pairs lost on the line */
+	long lostFrames[kGameDataHistoryFrames];
+	joypad_state rebuiltPads[kGameDataHistoryFrames];	/* remote pads recovered for them */
+	int lostCount;
+	unsigned long rebuiltCount;
+	long localFrame;
+	int closing;
+	int sniffed;
+	LinkControl linkControl;
+	joypad_state linkButton;
+	Exchange exchange;
 	int counter;
+	int haveData;
+	int iii;
 
 	counter = 0;
+	codec = GameDataCodecForSize(theState->netInfo.gameDataSize);
+	session = NULL;
+	localStream = NULL;
+	remoteStream = NULL;
+	memset(&localGameData, 0, sizeof(localGameData));
+	lostCount = 0;
+	rebuiltCount = 0;
+	localFrame = 0;
+	closing = kInputHistoryTail;	/* no session to close yet */
+	linkButton = 0;
+	ExchangeInit(&exchange, &gTimer);
+	TelemetryInit(&gTelemetry);
+	if (!ReplayInit(&gRecorder, sizeof(GameState)))
+	{
+		/* The game goes on without a recording; ShowRecording says why */
+
+#ifdef XB_HOST_SIM
+		fprintf(stderr, "netlink: GameState is too big to record (%u bytes)\n",
+			(unsigned)sizeof(GameState));
+#endif
+	}
+	ResyncInit(&gResync, gResyncMemory, sizeof(GameState), gHashFields, kHashFields);
+	memset(&gStateHashes, 0, sizeof(gStateHashes));
+	StateHashReset(&gStateHashes);
+
+	/* The packets stay put for the whole game, since ExchangePost */
+	/* holds on to the local one */
+
+	localPacket = PoolGet(&gPacketPool);
+	masterPacket = PoolGet(&gPacketPool);
+	slavePacket = PoolGet(&gPacketPool);
+#ifdef XB_HOST_SIM
+	atexit(SaveRecording);
+	atexit(SchedRunDeferred);	/* telemetry not written yet */
+#endif
+
+	/* never below the size the game started with: that much is needed */
+	/* for the input history */
+
+	LinkControlInit(&linkControl, 1, kMaxTicksPerFrame,
+		theState->netInfo.gameDataSize, kMaxGameDataSize, theState->netInfo.useInputHistory,
+		theState->netInfo.gameType == XBNetworkGame && XBLocalIsMaster());
+
+	if (theState->netInfo.gameType == XBNetworkGame && XBLocalIsMaster())
+	{
+		localData = &masterGameData;
+		localHalf = masterPacket;
+		remoteHalf = slavePacket;
+	}
+	else
+	{
+		localData = &slaveGameData;
+		localHalf = slavePacket;
+		remoteHalf = masterPacket;
+	}
 
 	lastSwapTime = gTimer;
 	for (uint32_t i = 0; i < 1000; i++)
 	{
-		dbgio_flush();
-		vdp2_sync();
-		vdp2_sync_wait();
+		ShowText();
+		SchedWaitVblank();
 	}
 	XBSetErrorCallback(PrintErrorMessage);
+	SchedResetStats();
+
+	/* From here on the slave draws, if it can */
+
+	if (gRollbackActive && theState->netInfo.usePipeline)
+		PipelineStart(&gPipeline, gPipelineFrames, sizeof(PipelineFrame), DrawFrame);
 
 	while (1)
 	{
-		dbgio_flush();
-		vdp2_sync();
-		vdp2_sync_wait();
+#ifdef NETLINK_BENCH
+		if (!BenchFrame(theState, sizeof(*theState), theState->gameMode == kPlayAgain))
+			break;
+#endif
+
+		/* Nothing from the frame arena lasts past here */
+
+		ArenaReset(&gFrameArena);
+
+		PERF_FRAME();
+#if NETLINK_PERF
+		ShowPerf();
+#endif
+		ShowMemory();
+		ShowRecording(theState);
+
+		if (!gPipeline.running)
+		{
+			ShowTextStats();
+			ShowText();
+
+			/* The VDP2 commit is done by v-blank out, so sleep until then */
+			/* instead of spinning in vdp2_sync_wait */
+
+			PERF_BEGIN(kPerfVblankWait);
+			SchedWaitVblank();
+			PERF_END(kPerfVblankWait);
+		}
+
 		/* Wait, as we don't want to call XBExchangeData too quickly */
 		/* However, even if we do, XBExchangeData will automatically */
 		/* wait enough time, so really these lines aren't necessary. */
 		/* It simply reduces the incidence of "XBNoData" errors. */
 
-		while (gTimer - lastSwapTime < theState->netInfo.ticksPerFrame)
-		{
-		};
+		SchedSleepUntil(lastSwapTime + theState->netInfo.ticksPerFrame);
 
 		/* read the hardware joypads */
 
+		PERF_BEGIN(kPerfJoypads);
 		GetJoypads(&localJoypad1, &localJoypad2);
+		PERF_END(kPerfJoypads);
+
+		/* Buttons only change the link during the game itself */
+
+		if (theState->gameMode == kGameMode)
+			localJoypad1 |= linkButton;
+		linkButton = 0;
+
+		haveData = 1;
 
 		/* If we're in a network game, we've got to do some communications */
 
 		if (theState->netInfo.gameType == XBNetworkGame)
 		{
-			localGameData.joypad = localJoypad1;
-			localGameData.finished = 0;
-			localGameData.frameCount = counter++;
-
-			localGameData.checksum = (theState->p1Score * 64 + theState->p2Score * 16
-				+ theState->p1Wins * 4 + theState->p2Wins);
-
 			/* Open the session if necessary */
 
-			if (theState->netInfo.needToOpenSession)
+			/* With input history, the old session first carries on for */
+			/* a few exchanges that only send history and are never */
+			/* advanced, so the last frames before it can be rebuilt */
+
+			if (theState->netInfo.needToOpenSession
+				&& theState->netInfo.useInputHistory && closing < kInputHistoryTail)
+			{
+				closing++;
+			}
+			else if (theState->netInfo.needToOpenSession)
 			{
 				theState->netInfo.needToOpenSession = 0;
+				closing = 0;
 
-				DBG_SetCursol(2, 7);
-				dbgio_printf("Measuring line connection quality...");
+				StatusSetCursol(2, 7);
+				StatusPrintf("Measuring line connection quality...");
 
+				PERF_BEGIN(kPerfOpenSession);
 				err = XBOpenSession(theState->netInfo.gameDataSize, theState->netInfo.ticksPerFrame);
-				if (err == XBOutOfSync)
+				PERF_END(kPerfOpenSession);
+				if (HandleXBErr(theState, err))
+				{
+					closing = kInputHistoryTail;
 					continue;
-				HandleXBErr(theState, err);
+				}
+				ExchangeOpen(&exchange, theState->netInfo.ticksPerFrame);
+
+				/* Lost pairs at the end of the old session that nothing */
+				/* came after to rebuild them from: we're out of step */
+
+				if (lostCount > 0)
+					HandleXBErr(theState, XBBadPacket);
+
+				/* Frames still in flight were flushed with the old session, */
+				/* and the codec streams start over with frame 0 */
 
-				DBG_SetCursol(2, 7);
-				dbgio_printf("                                    ");
+				counter = 0;
+				codec = GameDataCodecForSize(theState->netInfo.gameDataSize);
+				ArenaReset(&gSessionArena);
+				session = ArenaAlloc(&gSessionArena, sizeof(SessionData));
+				GameDataStreamReset(&session->sendStream);
+				GameDataStreamReset(&session->masterStream);
+				GameDataStreamReset(&session->slaveStream);
+				GameDataHistoryReset(&session->history);
+				StateHashReset(&gStateHashes);
+
+				localStream = XBLocalIsMaster() ? &session->masterStream : &session->slaveStream;
+				remoteStream = XBLocalIsMaster() ? &session->slaveStream : &session->masterStream;
+
+				if (gRollbackActive)
+					FrameReset(theState, counter);
+
+				if (theState->netInfo.useAutoRate)
+					LinkControlReset(&linkControl, XBGetInfo(),
+						theState->netInfo.ticksPerFrame, theState->netInfo.gameDataSize);
+
+				SaveTelemetry();
+				TelemetryBeginSession(&gTelemetry, XBGetInfo(), gTimer,
+					theState->netInfo.ticksPerFrame, theState->netInfo.gameDataSize);
+
+				StatusSetCursol(2, 7);
+				StatusPrintf("                                    ");
 			}
 
-			err = XBExchangeGameData(&localGameData, &masterGameData, &slaveGameData);
-			if (err == XBSessionClosed)
+			PERF_BEGIN(kPerfPacket);
+			localGameData.joypad = closing ? session->history.joypad[0] : localJoypad1;
+			localGameData.finished = 0;
+			localGameData.frameCount = counter;
+
+			localGameData.checksum = (char)StateHashCheckByte(&gStateHashes, counter - kStateHashLag);
+
+			if (theState->netInfo.useInputHistory)
 			{
-				/* this error means one side closed and the other did not */
-				theState->netInfo.needToOpenSession = 1;
-				continue;
+				GameDataPutHistory(&session->history, localGameData.padding, codec->size - kGameDataMinPacket);
+				GameDataHistoryPush(&session->history, localGameData.joypad);
 			}
-			HandleXBErr(theState, err);
 
-			/* During development, send a checksum of game state */
-			/* (like sum of object X & Y positions) */
-			/* to remote and ensure that they are the same. */
-			/* This way, you can halt early if the two worlds diverge. */
+			codec->encode(&session->sendStream, &localGameData, localPacket);
+			PERF_END(kPerfPacket);
 
-			/* Sync-sniffer check, for development */
+			/* The library only gets the packet once the exchange is due, */
+			/* so the scheduler runs rather than the library spinning */
 
-			DBG_SetCursol(1, 22);
-			dbgio_printf("Master : %d       Slave : %d   ", masterGameData.frameCount, slaveGameData.frameCount);
+			ExchangePost(&exchange, localPacket);
 
-			DBG_SetCursol(10, 23);
-			dbgio_printf("Master - slave = %d    ", masterGameData.frameCount - slaveGameData.frameCount);
+			PERF_BEGIN(kPerfExchange);
+			while (ExchangePoll(&exchange, masterPacket, slavePacket) == kExchangePending)
+				SchedSleepUntil(ExchangeDue(&exchange));
+			PERF_END(kPerfExchange);
 
-			DBG_SetCursol(10, 24);
-			dbgio_printf("Sync-sniffer?");
-			if (masterGameData.checksum == slaveGameData.checksum)
+			err = exchange.err;
+			TelemetrySampleInfo(&gTelemetry, XBGetInfo(), err, gTimer);
+			ShowTelemetry();
+
+			if (err == XBSessionClosed && theState->netInfo.needToOpenSession)
 			{
-				dbgio_printf(" OK ");
+				/* this error means one side closed and the other did not. */
+				/* Unasked for, it means the other side is recovering. */
+				theState->netInfo.needToOpenSession = 1;
+				closing = kInputHistoryTail;
+				continue;
 			}
-			else
+
+			counter++;
+
+			if (err == XBBadPacket && theState->netInfo.useInputHistory)
+			{
+				/* Only our half of the pair came back. The remote joypad */
+				/* is rebuilt from the history in the next packet. */
+
+				codec->decode(localStream, localHalf, localData);
+				GameDataStreamSkip(remoteStream);
+				haveData = 0;
+
+				if (!theState->netInfo.needToOpenSession)
+				{
+					if (lostCount == kGameDataHistoryFrames)
+						HandleXBErr(theState, err);
+
+					lostPads[lostCount] = localData->joypad;
+					lostFrames[lostCount] = localData->frameCount;
+					lostCount++;
+				}
+			}
+			else if (gRollbackActive && (err == XBNoData || err == XBRemoteDataInTransit))
+			{
+				/* Nothing came back yet; keep going on predicted input */
+
+				haveData = 0;
+			}
+			else if (HandleXBErr(theState, err))
+			{
+				/* Pairs lost before the error are gone with the frames */
+				/* after the snapshot */
+
+				lostCount = 0;
+				closing = kInputHistoryTail;
+				continue;
+			}
+
+			if (theState->netInfo.useAutoRate && !closing && theState->gameMode == kGameMode)
+				linkButton = LinkActionButton(LinkControlUpdate(&linkControl, XBGetInfo()));
+
+			if (haveData)
 			{
-				dbgio_printf(" **** BAD **** ");
+				if (lostCount > 0)
+				{
+					if (!GameDataRecover(remoteStream, remoteHalf, codec->size, lostCount, rebuiltPads))
+						HandleXBErr(theState, XBBadPacket);
+
+					for (iii = 0; iii < lostCount; iii++)
+					{
+						if (XBLocalIsMaster())
+							AdvanceConfirmed(theState, lostPads[iii], rebuiltPads[iii], lostFrames[iii]);
+						else
+							AdvanceConfirmed(theState, rebuiltPads[iii], lostPads[iii], lostFrames[iii]);
+					}
+
+					rebuiltCount += lostCount;
+					lostCount = 0;
+				}
+
+				PERF_BEGIN(kPerfDecode);
+				codec->decode(&session->masterStream, masterPacket, &masterGameData);
+				codec->decode(&session->slaveStream, slavePacket, &slaveGameData);
+				localFrame = localData->frameCount;
+
+				/* Each packet carries a byte of the state hash of an */
+				/* earlier frame, so both sides can check they still agree. */
+				/* It costs next to nothing, so it stays on. The first */
+				/* mismatch opens a resync session to name the fields. */
+
+				remoteData = (localData == &masterGameData) ? &slaveGameData : &masterGameData;
+				gStateHashes.remoteOffset = remoteData->frameCount - localData->frameCount;
+				sniffed = !StateHashCheck(&gStateHashes, remoteData->frameCount - kStateHashLag,
+					(unsigned char)remoteData->checksum) && gStateHashes.mismatches == 1;
+				PERF_END(kPerfDecode);
+
+				if (sniffed && HandleXBErr(theState, XBOutOfSync))
+				{
+					closing = kInputHistoryTail;
+					continue;
+				}
+
+				StatusSetCursol(1, 22);
+				StatusPrintf("Master : %d       Slave : %d   ", masterGameData.frameCount, slaveGameData.frameCount);
+
+				StatusSetCursol(10, 23);
+				StatusPrintf("Master - slave = %d    ", masterGameData.frameCount - slaveGameData.frameCount);
+
+				ShowSyncSniffer();
+
+				if (theState->netInfo.useInputHistory)
+				{
+					StatusSetCursol(1, 26);
+					StatusPrintf("Bad packets %u  rebuilt %lu   ",
+						XBGetInfo()->badPacketCount, rebuiltCount);
+				}
+
+				StatusSetCursol(1, 27);
+				StatusPrintf("Idle %3u%%  min %3u%%  stalls %lu   ",
+					SchedGetStats()->headroom, SchedGetStats()->minHeadroom, gPipeline.stalls);
+
+				/* Pairs after the frame that asked for a new session */
+				/* are left alone, on both sides */
+
+				if (theState->netInfo.needToOpenSession)
+					haveData = 0;
 			}
 
 			masterPad = masterGameData.joypad;
@@ -1061,56 +2569,56 @@ static void MainLoop(GameState *theState)
 
 		/* We now have joypad values in masterPad and slavePad. */
 
-		/* Update all the joypad fields */
-
-		theState->oldP1Pad = theState->p1Pad;
-		theState->oldP2Pad = theState->p2Pad;
-
-		theState->p1Pad = masterPad;
-		theState->p2Pad = slavePad;
-		theState->bothPads = masterPad | slavePad;
-
-		theState->p1PadDown = theState->p1Pad & (~theState->oldP1Pad);
-		theState->p2PadDown = theState->p2Pad & (~theState->oldP2Pad);
-		theState->bothPadsDown = theState->p1PadDown | theState->p2PadDown;
-
 		/* Now make a note of the current time. This is done after XBExchangeGameData */
 		/* rather than before since XBExchangeGameData may take a long time */
 
 		lastSwapTime = gTimer;
 
-		/* Advance the game a frame */
+		/* Advance the game a frame. With rollback, theState only ever */
+		/* sees confirmed pads and is what talks to XBAND; the predicted */
+		/* state is what gets drawn. */
 
-		switch (theState->gameMode)
+		if (haveData)
 		{
-			case kDemoMode:
-				AdvanceDemoMode(theState);
-				break;
-
-			case kGameMode:
-				AdvanceGame(theState);
-				break;
-
-			case kGameEnding:
-				AdvanceGameEnding(theState);
-				break;
-
-			case kPlayAgain:
-				AdvancePlayAgain(theState);
-				break;
+			PERF_BEGIN(kPerfAdvance);
+			AdvanceConfirmed(theState, masterPad, slavePad, localFrame);
+			PERF_END(kPerfAdvance);
+		}
 
-			default:
-				break;
+		if (gRollbackActive)
+		{
+			PERF_BEGIN(kPerfPredict);
+			FramePredict(theState, localJoypad1);
+			PERF_END(kPerfPredict);
 		}
 	};
+
+#ifdef NETLINK_BENCH
+	PipelineStop(&gPipeline);
+	BenchMemory("frame", gFrameArena.high, gFrameArena.size, gFrameArena.failures);
+	BenchMemory("session", gSessionArena.high, gSessionArena.size, gSessionArena.failures);
+	BenchMemory("packets", gPacketPool.high, gPacketPool.count, gPacketPool.failures);
+	BenchMemory("snapshots", gSnapshotPool.high, gSnapshotPool.count, gSnapshotPool.failures);
+	exit(BenchReport());
+#endif
 }
 
 void NetGame(void)
 {
 	GameState theState;
+
+	/* zeroed, so states compare byte for byte */
+
+	memset(&theState, 0, sizeof(theState));
+	InitMemory();
+
+#ifdef XB_HOST_SIM
+	PlayRecording();
+#endif
+
 	Initialize(&theState);
-        dbgio_flush();
-	vdp2_sync();
+	theState.stateHash = StateHashAll(&theState, gHashFields, kHashFields);
+	ShowText();
 	vdp2_sync_wait();
 	MainLoop(&theState);
 }
@@ -1130,4 +2638,5 @@ void user_init(void)
 	dbgio_init();
         dbgio_dev_default_init(DBGIO_DEV_VDP2_ASYNC);
         dbgio_dev_font_load();
+	TextInit(&gText);
 }
\ No newline at end of file
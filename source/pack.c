@@ -0,0 +1,117 @@
+/*****************************************************************
+*
+* pack.c
+*
+* Asset archive index reader, see pack.h.
+*
+*****************************************************************/
+
+#include <string.h>
+
+#include "pack.h"
+
+
+static unsigned short PackGet16(const unsigned char *in)
+{
+	return (unsigned short)((in[0] << 8) | in[1]);
+}
+
+static unsigned long PackGet32(const unsigned char *in)
+{
+	return ((unsigned long)in[0] << 24) | ((unsigned long)in[1] << 16)
+		| ((unsigned long)in[2] << 8) | in[3];
+}
+
+
+unsigned long PackIndexSize(const void *header)
+{
+	const unsigned char *in = header;
+
+	if (memcmp(in, kPackMagic, 4) != 0 || PackGet16(in + 4) != kPackVersion)
+		return 0;
+
+	return kPackHeaderSize + (unsigned long)PackGet16(in + 6) * kPackEntrySize;
+}
+
+
+int PackOpen(Pack *pack, const void *index, unsigned long size)
+{
+	const unsigned char *in = index;
+	unsigned long need;
+
+	if (size < kPackHeaderSize)
+		return 0;
+
+	need = PackIndexSize(in);
+	if (need == 0 || size < need)
+		return 0;
+
+	pack->index = in;
+	pack->count = PackGet16(in + 6);
+	pack->size = PackGet32(in + 8);
+
+	return 1;
+}
+
+
+void PackGet(const Pack *pack, unsigned iii, PackAsset *asset)
+{
+	const unsigned char *in = pack->index + kPackHeaderSize + iii * kPackEntrySize;
+
+	memcpy(asset->name, in, kPackNameSize);
+	asset->name[kPackNameSize - 1] = 0;
+	asset->type = in[16];
+	asset->format = in[17];
+	asset->layout = in[18];
+	asset->flags = in[19];
+	asset->width = PackGet16(in + 20);
+	asset->height = PackGet16(in + 22);
+	asset->rate = PackGet32(in + 24);
+	asset->paletteOffset = PackGet32(in + 28);
+	asset->paletteColors = PackGet16(in + 32);
+	asset->dataOffset = PackGet32(in + 36);
+	asset->dataSize = PackGet32(in + 40);
+	asset->checksum = PackGet32(in + 44);
+}
+
+
+int PackFind(const Pack *pack, const char *name, PackAsset *asset)
+{
+	const unsigned char *entry;
+	int low, high, middle, order;
+
+	low = 0;
+	high = (int)pack->count - 1;
+
+	while (low <= high)
+	{
+		middle = (low + high) / 2;
+		entry = pack->index + kPackHeaderSize + middle * kPackEntrySize;
+		order = strncmp(name, (const char *)entry, kPackNameSize);
+
+		if (order == 0)
+		{
+			PackGet(pack, middle, asset);
+			return 1;
+		}
+
+		if (order < 0)
+			high = middle - 1;
+		else
+			low = middle + 1;
+	}
+
+	return 0;
+}
+
+
+unsigned long PackChecksum(const void *data, unsigned long size)
+{
+	const unsigned char *bytes = data;
+	unsigned long hash = 2166136261UL;
+
+	while (size-- > 0)
+		hash = ((hash ^ *bytes++) * 16777619UL) & 0xFFFFFFFFUL;
+
+	return hash;
+}
@@ -0,0 +1,122 @@
+/*****************************************************************
+*
+* pack.h
+*
+* The asset archive tools/nlpack builds out of cd/NETLINK, and the
+* index reader the game uses to find things in it.
+*
+* Everything in the archive is already in the form the hardware
+* takes, so an asset goes from the CD (or memory) to VRAM, CRAM or
+* sound RAM with a DMA and nothing else:
+*
+*	images		4- or 8-bit palette indices, or RGB1555; either rows
+*				for VDP1 sprites and VDP2 bitmaps (the width padded
+*				to 8 pixels) or 8x8 VDP2 cells, a row of cells at a
+*				time. Palettes are RGB1555 for CRAM. Pixel code 0 is
+*				left for transparency, unless kPackZeroOpaque says
+*				the image needed all the colors.
+*	sounds		4-bit ADPCM for the sound driver (m68k/adpcm.h), or
+*				signed PCM, 8 bits or 16 bits big-endian, for the SCSP
+*	raw			copied as they are (font width tables, pages)
+*
+* The archive starts with a header (magic, version, entry count,
+* archive size, alignment) and an index of kPackEntrySize byte
+* entries, sorted by name. Palettes and data each start on a
+* kPackAlign boundary. All numbers are big-endian.
+*
+*****************************************************************/
+
+
+#ifndef __PACK__
+#define	__PACK__
+
+#define	kPackMagic			"NLPK"
+#define	kPackVersion		1
+#define	kPackHeaderSize		16
+#define	kPackEntrySize		48
+#define	kPackNameSize		16		/* "8.3" names, NUL-padded */
+#define	kPackAlign			32		/* SH-2 cache line and DMA friendly */
+
+/* Entry types */
+
+enum
+{
+	kPackRaw,
+	kPackImage,
+	kPackSound
+};
+
+/* Formats */
+
+enum
+{
+	kPackBytes,				/* raw */
+
+	kPackIndexed4,			/* images */
+	kPackIndexed8,
+	kPackRGB1555,
+
+	kPackPCM8,				/* sounds */
+	kPackPCM16,
+	kPackADPCM4
+};
+
+/* Image layouts */
+
+enum
+{
+	kPackRows,				/* VDP1 sprite / VDP2 bitmap */
+	kPackCells				/* 8x8 VDP2 cells */
+};
+
+/* Flags */
+
+#define	kPackTransparent	0x01	/* pixel code 0 is the image's transparent color */
+#define	kPackZeroOpaque		0x02	/* pixel code 0 is a real color: draw without transparency */
+
+typedef struct
+{
+	char			name[kPackNameSize];
+	unsigned char	type;
+	unsigned char	format;
+	unsigned char	layout;
+	unsigned char	flags;
+	unsigned short	width;			/* images: pixels, before padding */
+	unsigned short	height;
+	unsigned long	rate;			/* sounds: samples a second; images: bytes a row */
+	unsigned long	paletteOffset;	/* from the start of the archive */
+	unsigned short	paletteColors;
+	unsigned long	dataOffset;
+	unsigned long	dataSize;
+	unsigned long	checksum;		/* FNV-1a of the data */
+} PackAsset;
+
+typedef struct
+{
+	const unsigned char	*index;
+	unsigned			count;
+	unsigned long		size;		/* of the whole archive */
+} Pack;
+
+/* Given the first kPackHeaderSize bytes, how many bytes the header */
+/* and index take, so that much can be read; 0 if it isn't an archive */
+
+unsigned long PackIndexSize(const void *header);
+
+/* Opens an archive whose header and index are at index; it must */
+/* stay there. Returns 0 if they aren't a valid archive. */
+
+int PackOpen(Pack *pack, const void *index, unsigned long size);
+
+/* Looks name up; returns 0 if it isn't there */
+
+int PackFind(const Pack *pack, const char *name, PackAsset *asset);
+
+/* The iii'th asset, in name order */
+
+void PackGet(const Pack *pack, unsigned iii, PackAsset *asset);
+
+unsigned long PackChecksum(const void *data, unsigned long size);
+
+
+#endif	/* __PACK__ */
@@ -0,0 +1,285 @@
+/*****************************************************************
+*
+* perf.c
+*
+* Hot-path profiler, see perf.h.
+*
+* Each CPU keeps its own timers and only ever writes its own; the
+* other CPU reads the published seconds through the cache-through
+* mirror. A CPU sets up its FRT and WDT the first time it times
+* anything. On the master that starts the FRT over, which costs the
+* scheduler one frame's idle sample.
+*
+*****************************************************************/
+
+#include "perf.h"
+
+#if NETLINK_PERF
+
+#include <yaul.h>
+#include <string.h>
+
+#define	kPerfCycleMask		0x7FFFFF	/* 2^23 cycles, the FRT's range */
+#define	kPerfFrtShift		7			/* FRT at clock / 128 */
+#define	kPerfWdtPeriod		511			/* the WDT wraps every 512 cycles */
+#define	kPerfSlack			128			/* cycles the FRT may be behind the WDT */
+#define	kPerfReadWindow		32			/* WDT counts a read may take */
+
+#define	PerfUncached(p)		((__typeof__(p))((uintptr_t)(p) | CPU_CACHE_THROUGH))
+
+typedef struct
+{
+	uint32_t		start;
+
+	/* the frame in progress */
+	uint32_t		frameCycles;
+	unsigned		frameCalls;
+
+	/* the second in progress */
+	uint32_t		min;
+	uint32_t		max;
+	uint32_t		total;
+	unsigned		frames;
+	unsigned		calls;
+
+	PerfTotals		totals;
+} PerfTimer;
+
+typedef struct
+{
+	int				ready;
+	uint32_t		frameStart;
+	unsigned		frames;
+	unsigned long	seconds;
+
+	PerfTimer		timers[kPerfSections + 1];	/* the last one is the frame */
+	PerfStats		stats[kPerfSections + 1];	/* the last second */
+} PerfCpu;
+
+static PerfCpu gPerf[kPerfCpus];
+
+static const char *gSectionNames[kPerfSections + 1] =
+{
+	"Joypad", "Packet", "Exchg", "Open", "Decode", "Advnce", "Predct",
+	"Demo", "Game", "Ending", "Again", "Text", "Dbgio", "Vdp2", "Vblank",
+	"Frame"
+};
+
+
+/*
+//
+// This function reads the cycle clock. The FRT gives the time to
+// 128 cycles, and the WDT gives it to 2 cycles modulo 512; the time
+// is the one that agrees with the WDT in the 512 cycles from just
+// before the FRT's count. An interrupt between the reads would put
+// them too far apart to agree, so the FRT is read between two WDT
+// reads, again if they're far apart.
+//
+*/
+
+static inline uint32_t PerfCycles(void)
+{
+	uint32_t coarse, fine;
+	uint8_t before;
+
+	do
+	{
+		before = cpu_wdt_count_get();
+		coarse = ((uint32_t)cpu_frt_count_get() << kPerfFrtShift) - kPerfSlack;
+		fine = cpu_wdt_count_get();
+	} while ((uint8_t)(fine - before) > kPerfReadWindow);
+
+	fine <<= 1;
+
+	return (coarse + ((fine - coarse) & kPerfWdtPeriod)) & kPerfCycleMask;
+}
+
+
+static inline PerfCpu *PerfThisCpu(void)
+{
+	return &gPerf[(cpu_dual_executor_get() == CPU_SLAVE) ? kPerfSlave : kPerfMaster];
+}
+
+
+/*
+//
+// This function starts both counters, back to back so they start
+// within a few cycles of each other. The WDT's interrupt stays off;
+// it only counts.
+//
+*/
+
+static void PerfInitCpu(PerfCpu *cpu)
+{
+	cpu_intc_priority_set(CPU_INTC_INTERRUPT_WDT_ITI, 0);
+	cpu_frt_init(CPU_FRT_CLOCK_DIV_128);
+	cpu_wdt_init(CPU_WDT_CLOCK_DIV_2);
+	cpu_wdt_timer_mode_set(CPU_WDT_TIMER_MODE_INTERVAL, NULL);
+	cpu_wdt_enable();
+
+	cpu->frameStart = PerfCycles();
+	cpu->ready = 1;
+}
+
+
+void PerfBegin(int section)
+{
+	PerfCpu *cpu = PerfThisCpu();
+
+	if (!cpu->ready)
+		PerfInitCpu(cpu);
+
+	cpu->timers[section].start = PerfCycles();
+}
+
+
+static void PerfAddCall(PerfTimer *timer, uint32_t elapsed)
+{
+	PerfTotals *totals = &timer->totals;
+
+	if (totals->calls == 0 || elapsed < totals->min)
+		totals->min = elapsed;
+	if (elapsed > totals->max)
+		totals->max = elapsed;
+	totals->cycles += elapsed;
+	totals->calls++;
+}
+
+
+void PerfEnd(int section)
+{
+	PerfTimer *timer = &PerfThisCpu()->timers[section];
+	uint32_t elapsed;
+
+	elapsed = (PerfCycles() - timer->start) & kPerfCycleMask;
+
+	timer->frameCycles += elapsed;
+	timer->frameCalls++;
+	PerfAddCall(timer, elapsed);
+}
+
+
+/*
+//
+// These functions fold a frame into the second, and publish the
+// second.
+//
+*/
+
+static void PerfAddFrame(PerfTimer *timer)
+{
+	if (timer->frameCalls == 0)
+		return;
+
+	if (timer->frames == 0 || timer->frameCycles < timer->min)
+		timer->min = timer->frameCycles;
+	if (timer->frameCycles > timer->max)
+		timer->max = timer->frameCycles;
+	timer->total += timer->frameCycles;
+	timer->frames++;
+	timer->calls += timer->frameCalls;
+
+	timer->frameCycles = 0;
+	timer->frameCalls = 0;
+}
+
+
+static void PerfPublish(PerfTimer *timer, PerfStats *stats)
+{
+	stats->min = timer->min;
+	stats->avg = timer->frames ? timer->total / timer->frames : 0;
+	stats->max = timer->max;
+	stats->frames = timer->frames;
+	stats->calls = timer->calls;
+
+	timer->min = 0;
+	timer->max = 0;
+	timer->total = 0;
+	timer->frames = 0;
+	timer->calls = 0;
+}
+
+
+void PerfFrame(void)
+{
+	PerfCpu *cpu = PerfThisCpu();
+	PerfTimer *frame;
+	uint32_t now;
+	int iii;
+
+	if (!cpu->ready)
+		PerfInitCpu(cpu);
+
+	now = PerfCycles();
+	frame = &cpu->timers[kPerfSections];
+	frame->frameCycles = (now - cpu->frameStart) & kPerfCycleMask;
+	frame->frameCalls = 1;
+	cpu->frameStart = now;
+
+	for (iii = 0; iii <= kPerfSections; iii++)
+		PerfAddFrame(&cpu->timers[iii]);
+
+	if (++cpu->frames < kPerfFrames)
+		return;
+
+	for (iii = 0; iii <= kPerfSections; iii++)
+		PerfPublish(&cpu->timers[iii], &cpu->stats[iii]);
+
+	cpu->frames = 0;
+	cpu->seconds++;
+}
+
+
+void PerfReset(void)
+{
+	PerfCpu *cpu;
+	int iii, jjj;
+
+	for (iii = 0; iii < kPerfCpus; iii++)
+	{
+		cpu = &gPerf[iii];
+		cpu->frames = 0;
+
+		for (jjj = 0; jjj <= kPerfSections; jjj++)
+		{
+			memset(&cpu->timers[jjj].totals, 0, sizeof(PerfTotals));
+			cpu->timers[jjj].frameCycles = 0;
+			cpu->timers[jjj].frameCalls = 0;
+			cpu->timers[jjj].frames = 0;
+			cpu->timers[jjj].calls = 0;
+			cpu->timers[jjj].total = 0;
+		}
+	}
+}
+
+
+unsigned long PerfSeconds(int cpu)
+{
+	return *PerfUncached(&gPerf[cpu].seconds);
+}
+
+
+void PerfGetStats(int cpu, int section, PerfStats *stats)
+{
+	if (section < 0)
+		section = kPerfSections;
+
+	*stats = *PerfUncached(&gPerf[cpu].stats[section]);
+}
+
+
+void PerfGetTotals(int cpu, int section, PerfTotals *totals)
+{
+	if (section < 0)
+		section = kPerfSections;
+
+	*totals = *PerfUncached(&gPerf[cpu].timers[section].totals);
+}
+
+
+const char *PerfSectionName(int section)
+{
+	return gSectionNames[section < 0 ? kPerfSections : section];
+}
+
+#endif	/* NETLINK_PERF */
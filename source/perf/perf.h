@@ -0,0 +1,121 @@
+/*****************************************************************
+*
+* perf.h
+*
+* Hot-path profiler: scoped cycle timers on each SH-2.
+*
+* The clock is the free-running timer (FRT) at the SH-2 clock / 128
+* for the range, with the watchdog timer (WDT) in interval mode at
+* clock / 2 filling in the low bits: the FRT says which 128 cycles
+* it is, and the WDT's 8-bit count, which wraps every 512 cycles,
+* says where in them. Together they give a 2-cycle clock that wraps
+* after 2^23 cycles (312 ms), so a section must be shorter than that.
+*
+* Every section adds its cycles and calls into the current frame,
+* per CPU. PerfFrame, called once a frame on each CPU, folds the
+* frame into the second's min/avg/max and publishes a second every
+* kPerfFrames frames, for an overlay to draw.
+*
+* Built with NETLINK_PERF (0 by default); without it PERF_BEGIN,
+* PERF_END and PERF_FRAME are empty and perf.c is empty too.
+*
+*****************************************************************/
+
+
+#ifndef __PERF__
+#define	__PERF__
+
+#include <stdint.h>
+
+#ifndef NETLINK_PERF
+#define	NETLINK_PERF	0
+#endif
+
+#define	kPerfMaster			0
+#define	kPerfSlave			1
+#define	kPerfCpus			2
+#define	kPerfFrames			60			/* frames in a second */
+#define	kPerfClock			26846500UL	/* SH-2 cycles a second (NTSC) */
+
+/* The timed sections */
+
+enum
+{
+	kPerfJoypads,		/* GetJoypads */
+	kPerfPacket,		/* fill in and encode the local packet */
+	kPerfExchange,		/* XBExchangeGameData, through exchange.c */
+	kPerfOpenSession,	/* XBOpenSession */
+	kPerfDecode,		/* decode the pair and check the state hash */
+	kPerfAdvance,		/* everything for the confirmed frame */
+	kPerfPredict,		/* the rollback prediction */
+	kPerfAdvanceDemo,
+	kPerfAdvanceGame,
+	kPerfAdvanceEnding,
+	kPerfAdvancePlayAgain,
+	kPerfText,			/* TextFlush */
+	kPerfDbgioFlush,	/* dbgio_flush */
+	kPerfVdp2Sync,		/* vdp2_sync */
+	kPerfVblankWait,	/* waiting for v-blank, which was vdp2_sync_wait */
+	kPerfSections
+};
+
+/* A section's second: cycles per frame, over the frames it ran in */
+
+typedef struct
+{
+	uint32_t		min;
+	uint32_t		avg;
+	uint32_t		max;
+	unsigned		frames;			/* frames it ran in */
+	unsigned		calls;
+} PerfStats;
+
+/* A section's totals since PerfReset: cycles per call */
+
+typedef struct
+{
+	uint64_t		cycles;
+	unsigned long	calls;
+	uint32_t		min;
+	uint32_t		max;
+} PerfTotals;
+
+#if NETLINK_PERF
+#define	PERF_BEGIN(section)		PerfBegin(section)
+#define	PERF_END(section)		PerfEnd(section)
+#define	PERF_FRAME()			PerfFrame()
+#else
+#define	PERF_BEGIN(section)		do { } while (0)
+#define	PERF_END(section)		do { } while (0)
+#define	PERF_FRAME()			do { } while (0)
+#endif
+
+void PerfBegin(int section);
+void PerfEnd(int section);
+
+/* Call once a frame on each CPU that has sections */
+
+void PerfFrame(void);
+
+/* Clears the totals and the second in progress on every CPU */
+
+void PerfReset(void);
+
+/* The number of seconds cpu has published; changes when there's a new one */
+
+unsigned long PerfSeconds(int cpu);
+
+/* cpu's last second of section, and the frame itself (section -1) */
+
+void PerfGetStats(int cpu, int section, PerfStats *stats);
+
+void PerfGetTotals(int cpu, int section, PerfTotals *totals);
+
+const char *PerfSectionName(int section);
+
+/* Cycles to microseconds, to within 0.3% */
+
+#define	PerfMicroseconds(cycles)	((unsigned long)(((uint32_t)(cycles) * 153U) >> 12))
+
+
+#endif	/* __PERF__ */
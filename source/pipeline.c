@@ -0,0 +1,126 @@
+/*****************************************************************
+*
+* pipeline.c
+*
+* Two-stage frame pipeline across the two SH-2s, see pipeline.h.
+*
+* The slave runs in yaul's polling mode: it waits for a notify and
+* then calls PipelineSlaveEntry, which works through every frame
+* posted so far. A notify that comes in while it is busy makes it
+* look again, so no frame is missed.
+*
+*****************************************************************/
+
+#include <yaul.h>
+#include <stdint.h>
+
+#include "pipeline.h"
+#include "sched.h"
+
+#define	PipelineUncached(p)		((__typeof__(p))((uintptr_t)(p) | CPU_CACHE_THROUGH))
+
+/* Keeps the compiler from moving memory accesses across it. The */
+/* SH-2 caches are write-through, so stores reach memory in order. */
+
+#define	PipelineBarrier()		__asm__ __volatile__ ("" : : : "memory")
+
+static Pipeline *gPipeline;
+
+
+/*
+//
+// This function runs on the slave for every notify.
+//
+*/
+
+static void PipelineSlaveEntry(void)
+{
+	Pipeline *pipe;
+	unsigned long done;
+
+	cpu_cache_purge();
+	pipe = gPipeline;
+
+	while (pipe != NULL && (done = pipe->done) != pipe->posted)
+	{
+		if (!pipe->proc(pipe->frames + (done % kPipelineFrames) * pipe->frameSize))
+			break;
+
+		PipelineBarrier();
+		pipe->done = done + 1;
+
+		cpu_cache_purge();
+	}
+}
+
+
+void PipelineStart(Pipeline *pipe, void *frames, unsigned frameSize, PipelineProc proc)
+{
+	pipe->frames = frames;
+	pipe->frameSize = frameSize;
+	pipe->proc = proc;
+	pipe->posted = 0;
+	pipe->done = 0;
+	pipe->stalls = 0;
+	pipe->running = 1;
+
+	gPipeline = pipe;
+
+	cpu_dual_comm_mode_set(CPU_DUAL_ENTRY_POLLING);
+	cpu_dual_slave_set(PipelineSlaveEntry);
+}
+
+
+void PipelineStop(Pipeline *pipe)
+{
+	if (!pipe->running)
+		return;
+
+	while (PipelineShared(&pipe->done) != pipe->posted)
+		SchedWaitVblank();
+
+	/* what the slave wrote may be stale in our cache */
+
+	cpu_cache_purge();
+	pipe->running = 0;
+}
+
+
+void *PipelineBegin(Pipeline *pipe)
+{
+	while (pipe->posted - PipelineShared(&pipe->done) >= kPipelineFrames)
+	{
+		pipe->stalls++;
+		SchedWaitVblank();
+	}
+
+	return pipe->frames + (pipe->posted % kPipelineFrames) * pipe->frameSize;
+}
+
+
+void PipelinePost(Pipeline *pipe)
+{
+	PipelineBarrier();
+	pipe->posted++;
+
+	cpu_dual_slave_notify();
+}
+
+
+void PipelineVblank(Pipeline *pipe)
+{
+	if (pipe->running && PipelineShared(&pipe->done) != pipe->posted)
+		cpu_dual_slave_notify();
+}
+
+
+int PipelineCpu(void)
+{
+	return cpu_dual_executor_get() == CPU_SLAVE;
+}
+
+
+unsigned long PipelineShared(volatile unsigned long *value)
+{
+	return *PipelineUncached(value);
+}
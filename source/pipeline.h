@@ -0,0 +1,75 @@
+/*****************************************************************
+*
+* pipeline.h
+*
+* Two-stage frame pipeline across the two SH-2s.
+*
+* The master fills in a frame and posts it; the slave runs the
+* pipeline's proc on each posted frame, in order. There are two
+* frame buffers, so the master fills one while the slave works on
+* the other. The master only writes the posted count and the slave
+* only writes the done count, so neither side ever takes a lock.
+* The master waits only when the slave still has both frames.
+*
+* A frame that has to wait for the next v-blank returns 0 from the
+* proc, and the slave goes back to waiting for a notify instead of
+* spinning; PipelineVblank, in the master's v-blank handler, sends
+* one. The proc is then called on the same frame again.
+*
+* Shared counters are read through the cache-through mirror, and
+* the slave purges its cache before each frame, since the SH-2
+* caches don't see each other's writes.
+*
+*****************************************************************/
+
+
+#ifndef __PIPELINE__
+#define	__PIPELINE__
+
+#define	kPipelineFrames		2
+
+/* Returns 0 to be called on the frame again after the next v-blank */
+
+typedef int (*PipelineProc)(void *frame);
+
+typedef struct
+{
+	unsigned char			*frames;		/* kPipelineFrames of frameSize bytes */
+	unsigned				frameSize;
+	PipelineProc			proc;
+	volatile int			running;
+
+	volatile unsigned long	posted;			/* written by the master only */
+	volatile unsigned long	done;			/* written by the slave only */
+
+	/* statistics */
+	unsigned long			stalls;			/* frames the master waited for the slave */
+} Pipeline;
+
+/* Hands the slave proc to run on each posted frame */
+
+void PipelineStart(Pipeline *pipe, void *frames, unsigned frameSize, PipelineProc proc);
+
+/* Waits for the slave to finish every posted frame, then stops */
+
+void PipelineStop(Pipeline *pipe);
+
+/* The frame to fill next. Waits while the slave has both frames. */
+
+void *PipelineBegin(Pipeline *pipe);
+void PipelinePost(Pipeline *pipe);
+
+/* Call from the v-blank out handler */
+
+void PipelineVblank(Pipeline *pipe);
+
+/* 0 on the master SH-2, 1 on the slave */
+
+int PipelineCpu(void);
+
+/* Reads a counter the other SH-2 writes */
+
+unsigned long PipelineShared(volatile unsigned long *value);
+
+
+#endif	/* __PIPELINE__ */
@@ -0,0 +1,492 @@
+/*****************************************************************
+*
+* replay.c
+*
+* Input recorder and replay engine, see replay.h.
+*
+* ReplaySave writes the header and pad stream big-endian, so they
+* read the same anywhere. Keyframe states are copied as they are in
+* memory, though, so a recording only replays on a build of the game
+* with the same GameState layout.
+*
+*****************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "replay.h"
+
+#define	kReplayRunMax		0x7F
+#define	kReplayChange		0x80
+#define	kReplayMasterBit	0x02
+#define	kReplaySlaveBit		0x01
+
+#define	kReplayMagic		"NLRP"
+#define	kReplayVersion		1
+
+
+/*
+//
+// The keyframe table is a ring: keyframe index 0 is the oldest.
+//
+*/
+
+#define	ReplaySlot(rec, index)	(((rec)->keyframeHead + (index)) % kReplayKeyframes)
+
+static ReplayKeyframe *ReplayKeyframeAt(const ReplayRecorder *rec, int index)
+{
+	return (ReplayKeyframe *)&rec->keyframes[ReplaySlot(rec, index)];
+}
+
+
+/*
+//
+// This function forgets the oldest keyframe and the part of the
+// stream before the next one.
+//
+*/
+
+static void ReplayDropOldest(ReplayRecorder *rec)
+{
+	unsigned cut;
+	int iii;
+
+	rec->keyframeHead = ReplaySlot(rec, 1);
+	rec->keyframeCount--;
+
+	cut = ReplayKeyframeAt(rec, 0)->offset;
+	memmove(rec->stream, rec->stream + cut, rec->length - cut);
+	rec->length -= cut;
+
+	for (iii = 0; iii < rec->keyframeCount; iii++)
+		ReplayKeyframeAt(rec, iii)->offset -= cut;
+	if (rec->lastRun >= 0)
+		rec->lastRun -= (int)cut;
+
+	rec->droppedFrames = ReplayKeyframeAt(rec, 0)->frame;
+}
+
+
+/*
+//
+// This function makes room for need more bytes of stream, dropping
+// old keyframes if it has to. Returns 0 if even the frames since the
+// newest one don't leave room.
+//
+*/
+
+static int ReplayRoom(ReplayRecorder *rec, unsigned need)
+{
+	while (rec->length + need > kReplayStreamSize && rec->keyframeCount > 1)
+		ReplayDropOldest(rec);
+
+	if (rec->length + need > kReplayStreamSize)
+	{
+		rec->full = 1;
+		return 0;
+	}
+
+	return 1;
+}
+
+
+int ReplayInit(ReplayRecorder *rec, unsigned stateSize)
+{
+	memset(rec, 0, sizeof(*rec));
+	rec->stateSize = stateSize;
+	rec->lastRun = -1;
+
+	if (stateSize > kReplayStateSize)
+	{
+		rec->full = 1;
+		return 0;
+	}
+
+	return 1;
+}
+
+
+int ReplayRecord(ReplayRecorder *rec, const void *state, unsigned short masterPad,
+	unsigned short slavePad)
+{
+	ReplayKeyframe *keyframe;
+	unsigned short masterChange, slaveChange;
+	unsigned need;
+
+	if (rec->full)
+		return 0;
+
+	if (rec->frames % kReplayKeyframeFrames == 0 || rec->keyframeCount == 0)
+	{
+		if (rec->keyframeCount == kReplayKeyframes)
+			ReplayDropOldest(rec);
+
+		keyframe = ReplayKeyframeAt(rec, rec->keyframeCount);
+		keyframe->frame = rec->frames;
+		keyframe->offset = rec->length;
+		keyframe->masterPad = rec->masterPad;
+		keyframe->slavePad = rec->slavePad;
+		memcpy(rec->keyframeStates[ReplaySlot(rec, rec->keyframeCount)], state, rec->stateSize);
+
+		rec->keyframeCount++;
+		rec->lastRun = -1;
+	}
+
+	masterChange = masterPad ^ rec->masterPad;
+	slaveChange = slavePad ^ rec->slavePad;
+
+	if (masterChange == 0 && slaveChange == 0)
+	{
+		if (rec->lastRun >= 0 && rec->stream[rec->lastRun] < kReplayRunMax)
+			rec->stream[rec->lastRun]++;
+		else
+		{
+			if (!ReplayRoom(rec, 1))
+				return 0;
+
+			rec->lastRun = rec->length;
+			rec->stream[rec->length++] = 0;
+		}
+	}
+	else
+	{
+		need = 1 + (masterChange ? 2 : 0) + (slaveChange ? 2 : 0);
+		if (!ReplayRoom(rec, need))
+			return 0;
+
+		rec->stream[rec->length++] = kReplayChange
+			| (masterChange ? kReplayMasterBit : 0) | (slaveChange ? kReplaySlaveBit : 0);
+
+		if (masterChange)
+		{
+			rec->stream[rec->length++] = (unsigned char)(masterChange >> 8);
+			rec->stream[rec->length++] = (unsigned char)masterChange;
+		}
+		if (slaveChange)
+		{
+			rec->stream[rec->length++] = (unsigned char)(slaveChange >> 8);
+			rec->stream[rec->length++] = (unsigned char)slaveChange;
+		}
+
+		rec->lastRun = -1;
+	}
+
+	rec->masterPad = masterPad;
+	rec->slavePad = slavePad;
+	rec->frames++;
+
+	return 1;
+}
+
+
+/*
+//
+// This function cuts the recording back to its first frames frames.
+// It walks the tokens from the keyframe before the cut, shortening a
+// run that crosses it, so recording carries on just as if the frames
+// after had never been recorded.
+//
+*/
+
+void ReplayTruncate(ReplayRecorder *rec, long frames)
+{
+	const ReplayKeyframe *keyframe;
+	unsigned char token;
+	unsigned short masterPad, slavePad;
+	unsigned offset;
+	long frame, run;
+	int lastRun, cut;
+
+	if (frames < 0 || frames >= rec->frames || rec->keyframeCount == 0)
+		return;
+
+	/* A keyframe right on the cut goes too: ReplayRecord takes it again */
+
+	for (cut = 0; cut < rec->keyframeCount && ReplayKeyframeAt(rec, cut)->frame < frames; cut++)
+		;
+
+	keyframe = ReplayKeyframeAt(rec, cut > 0 ? cut - 1 : 0);
+	frame = keyframe->frame;
+	offset = keyframe->offset;
+	masterPad = keyframe->masterPad;
+	slavePad = keyframe->slavePad;
+	lastRun = -1;
+
+	while (frame < frames)
+	{
+		token = rec->stream[offset];
+
+		if (!(token & kReplayChange))
+		{
+			run = token + 1;
+			if (frame + run > frames)
+			{
+				run = frames - frame;
+				rec->stream[offset] = (unsigned char)(run - 1);
+			}
+
+			lastRun = (int)offset++;
+			frame += run;
+			continue;
+		}
+
+		offset++;
+		if (token & kReplayMasterBit)
+		{
+			masterPad ^= (unsigned short)((rec->stream[offset] << 8) | rec->stream[offset + 1]);
+			offset += 2;
+		}
+		if (token & kReplaySlaveBit)
+		{
+			slavePad ^= (unsigned short)((rec->stream[offset] << 8) | rec->stream[offset + 1]);
+			offset += 2;
+		}
+
+		lastRun = -1;
+		frame++;
+	}
+
+	/* Cut before the oldest keyframe, nothing is left */
+
+	if (cut == 0)
+	{
+		rec->keyframeHead = 0;
+		rec->droppedFrames = frames;
+	}
+
+	rec->keyframeCount = cut;
+	rec->length = offset;
+	rec->masterPad = masterPad;
+	rec->slavePad = slavePad;
+	rec->lastRun = lastRun;
+	rec->frames = frames;
+	rec->full = (rec->stateSize > kReplayStateSize);
+}
+
+
+/*
+//
+// Saving and loading.
+//
+*/
+
+static void ReplayPut32(unsigned char *out, unsigned long value)
+{
+	out[0] = (unsigned char)(value >> 24);
+	out[1] = (unsigned char)(value >> 16);
+	out[2] = (unsigned char)(value >> 8);
+	out[3] = (unsigned char)value;
+}
+
+static unsigned long ReplayGet32(const unsigned char *in)
+{
+	return ((unsigned long)in[0] << 24) | ((unsigned long)in[1] << 16)
+		| ((unsigned long)in[2] << 8) | in[3];
+}
+
+
+void ReplaySave(const ReplayRecorder *rec, ReplayWriteProc write, void *ref)
+{
+	const ReplayKeyframe *keyframe;
+	unsigned char header[24], entry[12];
+	int iii;
+
+	memcpy(header, kReplayMagic, 4);
+	ReplayPut32(header + 4, kReplayVersion);
+	ReplayPut32(header + 8, rec->stateSize);
+	ReplayPut32(header + 12, (unsigned long)rec->frames);
+	ReplayPut32(header + 16, rec->length);
+	ReplayPut32(header + 20, (unsigned long)rec->keyframeCount);
+	write(header, sizeof(header), ref);
+
+	for (iii = 0; iii < rec->keyframeCount; iii++)
+	{
+		keyframe = ReplayKeyframeAt(rec, iii);
+		ReplayPut32(entry, (unsigned long)keyframe->frame);
+		ReplayPut32(entry + 4, keyframe->offset);
+		ReplayPut32(entry + 8, ((unsigned long)keyframe->masterPad << 16) | keyframe->slavePad);
+		write(entry, sizeof(entry), ref);
+		write(rec->keyframeStates[ReplaySlot(rec, iii)], rec->stateSize, ref);
+	}
+
+	write(rec->stream, rec->length, ref);
+}
+
+
+int ReplayLoad(ReplayRecorder *rec, const void *data, unsigned size)
+{
+	const unsigned char *in = data;
+	unsigned stateSize, length, count, need;
+	unsigned long pads;
+	int iii;
+
+	if (size < 24 || memcmp(in, kReplayMagic, 4) != 0 || ReplayGet32(in + 4) != kReplayVersion)
+		return 0;
+
+	stateSize = (unsigned)ReplayGet32(in + 8);
+	length = (unsigned)ReplayGet32(in + 16);
+	count = (unsigned)ReplayGet32(in + 20);
+
+	if (stateSize > kReplayStateSize || length > kReplayStreamSize || count > kReplayKeyframes)
+		return 0;
+
+	need = 24 + count * (12 + stateSize) + length;
+	if (size < need)
+		return 0;
+
+	ReplayInit(rec, stateSize);
+	rec->frames = (long)ReplayGet32(in + 12);
+	rec->length = length;
+	rec->keyframeCount = (int)count;
+	rec->full = 1;	/* not for recording into */
+
+	in += 24;
+	for (iii = 0; iii < (int)count; iii++)
+	{
+		rec->keyframes[iii].frame = (long)ReplayGet32(in);
+		rec->keyframes[iii].offset = (unsigned)ReplayGet32(in + 4);
+		pads = ReplayGet32(in + 8);
+		rec->keyframes[iii].masterPad = (unsigned short)(pads >> 16);
+		rec->keyframes[iii].slavePad = (unsigned short)pads;
+		memcpy(rec->keyframeStates[iii], in + 12, stateSize);
+		in += 12 + stateSize;
+
+		if (rec->keyframes[iii].offset > length)
+			return 0;
+	}
+
+	memcpy(rec->stream, in, length);
+	rec->droppedFrames = (count > 0) ? rec->keyframes[0].frame : 0;
+
+	return 1;
+}
+
+
+/*
+//
+// Playing back.
+//
+*/
+
+void ReplayPlayerInit(ReplayPlayer *player, const ReplayRecorder *rec, ReplayAdvanceProc advance)
+{
+	memset(player, 0, sizeof(*player));
+	player->rec = rec;
+	player->advance = advance;
+}
+
+
+/*
+//
+// This function reads the pads of the next frame.
+//
+*/
+
+static int ReplayDecode(ReplayPlayer *player)
+{
+	const ReplayRecorder *rec = player->rec;
+	unsigned char token;
+	unsigned need;
+
+	if (player->run > 0)
+	{
+		player->run--;
+		return 1;
+	}
+
+	if (player->offset >= rec->length)
+		return 0;
+
+	token = rec->stream[player->offset++];
+
+	if (!(token & kReplayChange))
+	{
+		player->run = token;
+		return 1;
+	}
+
+	need = ((token & kReplayMasterBit) ? 2 : 0) + ((token & kReplaySlaveBit) ? 2 : 0);
+	if (player->offset + need > rec->length)
+		return 0;
+
+	if (token & kReplayMasterBit)
+	{
+		player->masterPad ^= (unsigned short)((rec->stream[player->offset] << 8)
+			| rec->stream[player->offset + 1]);
+		player->offset += 2;
+	}
+	if (token & kReplaySlaveBit)
+	{
+		player->slavePad ^= (unsigned short)((rec->stream[player->offset] << 8)
+			| rec->stream[player->offset + 1]);
+		player->offset += 2;
+	}
+
+	return 1;
+}
+
+
+int ReplayStep(ReplayPlayer *player, void *state)
+{
+	if (player->frame >= player->rec->frames || !ReplayDecode(player))
+		return 0;
+
+	player->advance(state, player->masterPad, player->slavePad);
+	player->frame++;
+
+	return 1;
+}
+
+
+long ReplayFirstFrame(const ReplayRecorder *rec)
+{
+	return rec->droppedFrames;
+}
+
+
+int ReplaySeek(ReplayPlayer *player, long frame, void *state)
+{
+	const ReplayRecorder *rec = player->rec;
+	const ReplayKeyframe *keyframe;
+	int iii;
+
+	if (frame < ReplayFirstFrame(rec) || frame > rec->frames || rec->keyframeCount == 0)
+		return 0;
+
+	for (iii = rec->keyframeCount - 1; iii > 0 && ReplayKeyframeAt(rec, iii)->frame > frame; iii--)
+		;
+
+	keyframe = ReplayKeyframeAt(rec, iii);
+	memcpy(state, rec->keyframeStates[ReplaySlot(rec, iii)], rec->stateSize);
+	player->frame = keyframe->frame;
+	player->offset = keyframe->offset;
+	player->run = 0;
+	player->masterPad = keyframe->masterPad;
+	player->slavePad = keyframe->slavePad;
+
+	while (player->frame < frame)
+	{
+		if (!ReplayStep(player, state))
+			return 0;
+	}
+
+	return 1;
+}
+
+
+/*
+//
+// FNV-1a over the state's bytes.
+//
+*/
+
+unsigned long ReplayChecksum(const void *state, unsigned size)
+{
+	const unsigned char *bytes = state;
+	uint32_t hash = 2166136261U;
+
+	while (size-- > 0)
+		hash = (hash ^ *bytes++) * 16777619U;
+
+	return hash;
+}
@@ -0,0 +1,123 @@
+/*****************************************************************
+*
+* replay.h
+*
+* Input recorder and replay engine.
+*
+* The game state only ever changes through the pair of joypads a
+* frame is advanced with, so a match can be played again from its
+* first state and the pads of every frame. The recorder keeps the
+* pads as a delta/run-length stream and, every kReplayKeyframeFrames
+* frames, a copy of the state, so the player can seek to any frame
+* by starting at the keyframe before it.
+*
+* The keyframes are a ring. When it or the stream runs out, the
+* oldest keyframe goes, with the stream up to the next one, so the
+* recorder always holds the latest part of a match, however long:
+* desyncs tend to come late. ReplayFirstFrame says where it starts.
+*
+* Stream tokens, one per change:
+*
+*	0nnnnnnn				n + 1 frames with the same pads as before
+*	100000ms [m] [s]		the master and/or slave pad changed; the
+*							change follows, big-endian, XORed with the
+*							old pad
+*
+* A keyframe always starts a new token, so decoding can start there.
+*
+*****************************************************************/
+
+
+#ifndef __REPLAY__
+#define	__REPLAY__
+
+#define	kReplayStreamSize		16384	/* bytes of pad stream */
+#define	kReplayKeyframes		32
+#define	kReplayKeyframeFrames	300		/* frames between keyframes */
+#define	kReplayStateSize		256		/* largest state a keyframe holds */
+
+typedef void (*ReplayAdvanceProc)(void *state, unsigned short masterPad,
+	unsigned short slavePad);
+
+typedef void (*ReplayWriteProc)(const void *data, unsigned size, void *ref);
+
+typedef struct
+{
+	long			frame;
+	unsigned		offset;			/* in the stream */
+	unsigned short	masterPad;		/* pads of the frame before */
+	unsigned short	slavePad;
+} ReplayKeyframe;
+
+typedef struct
+{
+	unsigned		stateSize;
+	long			frames;			/* recorded so far */
+	long			droppedFrames;	/* the oldest ones, no longer held */
+	int				full;			/* stopped: the state is too big, or the */
+									/* frames of one keyframe fill the stream */
+
+	unsigned		length;
+	unsigned char	stream[kReplayStreamSize];
+
+	int				keyframeHead;	/* slot of the oldest keyframe */
+	int				keyframeCount;
+	ReplayKeyframe	keyframes[kReplayKeyframes];
+	unsigned char	keyframeStates[kReplayKeyframes][kReplayStateSize];
+
+	/* encoder */
+	unsigned short	masterPad;
+	unsigned short	slavePad;
+	int				lastRun;		/* offset of a run token that can grow, or -1 */
+} ReplayRecorder;
+
+typedef struct
+{
+	const ReplayRecorder	*rec;
+	ReplayAdvanceProc		advance;
+	long					frame;		/* next frame to play */
+	unsigned				offset;
+	unsigned				run;		/* frames left in the current run token */
+	unsigned short			masterPad;
+	unsigned short			slavePad;
+} ReplayPlayer;
+
+/* Returns 0 if the state is too big for a keyframe */
+
+int ReplayInit(ReplayRecorder *rec, unsigned stateSize);
+
+/* Call with the state before the frame is advanced. Returns 0 if it */
+/* has stopped recording. */
+
+int ReplayRecord(ReplayRecorder *rec, const void *state, unsigned short masterPad,
+	unsigned short slavePad);
+
+/* Forgets every frame from frames on, as if they were never recorded */
+
+void ReplayTruncate(ReplayRecorder *rec, long frames);
+
+/* A recording as bytes, and back. ReplayLoad returns 0 if it's bad. */
+
+void ReplaySave(const ReplayRecorder *rec, ReplayWriteProc write, void *ref);
+int ReplayLoad(ReplayRecorder *rec, const void *data, unsigned size);
+
+/* The oldest frame the recording still holds */
+
+long ReplayFirstFrame(const ReplayRecorder *rec);
+
+void ReplayPlayerInit(ReplayPlayer *player, const ReplayRecorder *rec, ReplayAdvanceProc advance);
+
+/* Sets state to the one before frame. Returns 0 if frame wasn't recorded. */
+
+int ReplaySeek(ReplayPlayer *player, long frame, void *state);
+
+/* Advances state one frame. Returns 0 at the end of the recording. */
+
+int ReplayStep(ReplayPlayer *player, void *state);
+
+/* To compare states across machines */
+
+unsigned long ReplayChecksum(const void *state, unsigned size);
+
+
+#endif	/* __REPLAY__ */
@@ -0,0 +1,243 @@
+/*****************************************************************
+*
+* resync.c
+*
+* Snapshots of the confirmed state, and agreeing which one to go
+* back to, see resync.h.
+*
+*****************************************************************/
+
+#include <string.h>
+
+#include "resync.h"
+
+
+static void ResyncPut32(unsigned char *out, long value)
+{
+	out[0] = (unsigned char)(value >> 24);
+	out[1] = (unsigned char)(value >> 16);
+	out[2] = (unsigned char)(value >> 8);
+	out[3] = (unsigned char)value;
+}
+
+static long ResyncGet32(const unsigned char *in)
+{
+	return (long)(int32_t)((uint32_t)in[0] << 24 | (uint32_t)in[1] << 16
+		| (uint32_t)in[2] << 8 | in[3]);
+}
+
+
+static long ResyncOldest(const ResyncHistory *history)
+{
+	return history->newest - (long)(history->count - 1) * kResyncInterval;
+}
+
+
+/*
+//
+// This function returns the slot of the snapshot of frame, or -1 if
+// there isn't one.
+//
+*/
+
+static int ResyncSlot(const ResyncHistory *history, long frame)
+{
+	if (history->count == 0 || frame % kResyncInterval != 0
+		|| frame > history->newest || frame < ResyncOldest(history))
+		return -1;
+
+	return (int)((frame / kResyncInterval) & (kResyncSnapshots - 1));
+}
+
+
+void ResyncInit(ResyncHistory *history, void *states, unsigned stateSize,
+	const StateHashField *fields, int fieldCount)
+{
+	memset(history, 0, sizeof(*history));
+	history->states = states;
+	history->stateSize = stateSize;
+	history->fields = fields;
+	history->fieldCount = fieldCount;
+	history->newest = -1;
+}
+
+
+void ResyncRecord(ResyncHistory *history, const void *state, uint32_t hash)
+{
+	int slot;
+
+	if (history->frames % kResyncInterval == 0)
+	{
+		slot = (int)((history->frames / kResyncInterval) & (kResyncSnapshots - 1));
+		memcpy(history->states + slot * history->stateSize, state, history->stateSize);
+		history->hashes[slot] = hash;
+		history->newest = history->frames;
+
+		if (history->count < kResyncSnapshots)
+			history->count++;
+	}
+
+	history->frames++;
+}
+
+
+/*
+//
+// This function returns the hash of a field of our snapshot of the
+// frame talk agreed on.
+//
+*/
+
+static uint32_t ResyncFieldHash(const ResyncHistory *history, const ResyncTalk *talk, int field)
+{
+	const unsigned char *state;
+
+	state = history->states + ResyncSlot(history, talk->frame) * history->stateSize;
+	return StateHashOne(state, history->fields, field);
+}
+
+
+void ResyncBegin(ResyncTalk *talk)
+{
+	talk->status = kResyncTalking;
+	talk->frame = -1;
+	talk->hash = 0;
+
+	talk->walking = 0;
+	talk->field = 0;
+	talk->heard = 0;
+	talk->badFields = 0;
+}
+
+
+void ResyncPut(const ResyncHistory *history, const ResyncTalk *talk, unsigned char *packet)
+{
+	memset(packet, 0, kResyncPacketSize);
+	packet[0] = kResyncTag | (talk->frame >= 0 ? kResyncHashBit : 0);
+
+	if (talk->walking)
+	{
+		packet[0] |= kResyncFieldBit;
+		packet[1] = (unsigned char)talk->field;
+		ResyncPut32(packet + 2, (long)ResyncFieldHash(history, talk, talk->field));
+	}
+	else
+	{
+		ResyncPut32(packet + 1, history->count > 0 ? history->newest : -1);
+		ResyncPut32(packet + 5, history->count > 0 ? ResyncOldest(history) : -1);
+	}
+
+	ResyncPut32(packet + 9, (long)talk->hash);
+}
+
+
+/*
+//
+// This function takes a field's hash from the remote's walk, and
+// returns the status once every field has been heard.
+//
+*/
+
+static int ResyncTakeField(const ResyncHistory *history, ResyncTalk *talk, const unsigned char *remote)
+{
+	int field = remote[1];
+	uint32_t bit;
+
+	if (field >= history->fieldCount)
+	{
+		talk->status = kResyncFailed;
+		return talk->status;
+	}
+
+	bit = 1UL << field;
+	talk->heard |= bit;
+	if ((uint32_t)ResyncGet32(remote + 2) != ResyncFieldHash(history, talk, field))
+		talk->badFields |= bit;
+
+	if (talk->heard == (uint32_t)((2UL << (history->fieldCount - 1)) - 1))
+		talk->status = kResyncDiffers;
+
+	return talk->status;
+}
+
+
+int ResyncTake(const ResyncHistory *history, ResyncTalk *talk, const unsigned char *local,
+	const unsigned char *remote)
+{
+	long remoteNewest, remoteOldest, frame;
+	int slot;
+
+	/* Each packet of the walk sends the next field, lost or not */
+
+	if (talk->status == kResyncTalking && (local[0] & kResyncFieldBit))
+		talk->field = (talk->field + 1) % history->fieldCount;
+
+	if (talk->status != kResyncTalking || remote == NULL
+		|| (remote[0] & ~(kResyncHashBit | kResyncFieldBit)) != kResyncTag)
+		return talk->status;
+
+	/* A walk only starts once both sides have the frame */
+
+	if (remote[0] & kResyncFieldBit)
+	{
+		if (talk->frame < 0)
+		{
+			talk->status = kResyncFailed;
+			return talk->status;
+		}
+
+		talk->walking = 1;
+		return ResyncTakeField(history, talk, remote);
+	}
+
+	/* The newest snapshot both sides have */
+
+	if (talk->frame < 0)
+	{
+		remoteNewest = ResyncGet32(remote + 1);
+		remoteOldest = ResyncGet32(remote + 5);
+
+		frame = (remoteNewest < history->newest) ? remoteNewest : history->newest;
+		slot = ResyncSlot(history, frame);
+		if (slot < 0 || remoteNewest < 0 || frame < remoteOldest)
+		{
+			talk->status = kResyncFailed;
+			return talk->status;
+		}
+
+		talk->frame = frame;
+		talk->hash = history->hashes[slot];
+	}
+
+	if ((local[0] & kResyncHashBit) && (remote[0] & kResyncHashBit))
+	{
+		if ((uint32_t)ResyncGet32(remote + 9) == talk->hash)
+			talk->status = kResyncAgreed;
+		else
+			talk->walking = 1;
+	}
+
+	return talk->status;
+}
+
+
+int ResyncRewind(ResyncHistory *history, long frame, void *state)
+{
+	int slot = ResyncSlot(history, frame);
+
+	if (slot < 0)
+		return 0;
+
+	memcpy(state, history->states + slot * history->stateSize, history->stateSize);
+
+	history->resyncs++;
+	history->framesLost += history->frames - frame;
+
+	/* The next ResyncRecord takes the snapshot of frame again */
+
+	history->count -= (int)((history->newest - frame) / kResyncInterval) + 1;
+	history->newest = frame - kResyncInterval;
+	history->frames = frame;
+
+	return 1;
+}
@@ -0,0 +1,130 @@
+/*****************************************************************
+*
+* resync.h
+*
+* Getting a network game back after a recoverable error, instead of
+* ending it.
+*
+* Both sides advance their confirmed state over the same pairs, in
+* the same order, so up to an error they went through the same
+* states. An error can leave one side ahead of the other, but only
+* by the few pairs the library had in flight. So the game keeps a
+* snapshot of its confirmed state every kResyncInterval frames,
+* reaching back well past that (128 frames). After an
+* error both sides open a session of their own, with settings that
+* can't be mismatched, and swap which snapshots they have. The
+* newest one both have is where the game goes back to, once the two
+* sides' hashes of it agree.
+*
+* Both sides take their snapshots on the same frames, so the newest
+* one both have is just the older of the two newest.
+*
+* Packet (kResyncPacketSize bytes, big-endian):
+*
+*	0		kResyncTag, plus kResyncHashBit once 9-12 are filled in
+*	1-4		frame of the newest snapshot
+*	5-8		frame of the oldest snapshot
+*	9-12	state hash of the snapshot both sides have
+*
+* If the hashes differ, the sides have gone apart (statehash.h) and
+* both walk the fields of that snapshot, one a packet, to name the
+* ones that differ. Bytes 1-8 are done with by then, so a packet of
+* the walk carries kResyncFieldBit and:
+*
+*	1		the field
+*	2-5		its hash in our snapshot
+*
+* A side is done when a pair carries the hash in both halves, or
+* when it has heard every field: the other side gets the same pairs,
+* so it's done then too, unless its copy was lost. So a side that's
+* done keeps exchanging for kResyncTail more pairs before it closes
+* the session.
+*
+*****************************************************************/
+
+
+#ifndef __RESYNC__
+#define	__RESYNC__
+
+#include <stdint.h>
+
+#include "statehash.h"
+
+#define	kResyncSnapshots		16		/* a power of two */
+#define	kResyncInterval			8		/* frames between snapshots */
+#define	kResyncPacketSize		13
+#define	kResyncTicksPerFrame	2
+#define	kResyncTail				3
+
+#define	kResyncTag				0xA0
+#define	kResyncHashBit			0x01
+#define	kResyncFieldBit			0x02
+
+enum
+{
+	kResyncTalking,
+	kResyncAgreed,
+	kResyncDiffers,			/* the hashes differ; badFields are why */
+	kResyncFailed			/* nothing in common */
+};
+
+typedef struct
+{
+	unsigned char	*states;		/* kResyncSnapshots of stateSize bytes */
+	unsigned		stateSize;
+	long			frames;			/* confirmed so far */
+	long			newest;			/* frame of the newest snapshot */
+	int				count;			/* snapshots back from newest */
+	uint32_t		hashes[kResyncSnapshots];
+	const StateHashField *fields;	/* what the hashes are of */
+	int				fieldCount;
+
+	unsigned long	resyncs;		/* statistics */
+	unsigned long	framesLost;
+} ResyncHistory;
+
+typedef struct
+{
+	int				status;
+	long			frame;			/* the one both have, or -1 */
+	uint32_t		hash;			/* of our snapshot of it */
+
+	/* the walk of the fields, once the hashes differ */
+	int				walking;
+	int				field;			/* the one to send next */
+	uint32_t		heard;			/* bit per field the remote sent */
+	uint32_t		badFields;		/* bit per field whose hashes differ */
+} ResyncTalk;
+
+/* states holds kResyncSnapshots states of stateSize bytes, whose */
+/* hashes are of fields */
+
+void ResyncInit(ResyncHistory *history, void *states, unsigned stateSize,
+	const StateHashField *fields, int fieldCount);
+
+/* Call with the state before each confirmed frame is advanced, and */
+/* its state hash */
+
+void ResyncRecord(ResyncHistory *history, const void *state, uint32_t hash);
+
+/* Starts talking over a new session */
+
+void ResyncBegin(ResyncTalk *talk);
+
+/* Fills in the packet to send next */
+
+void ResyncPut(const ResyncHistory *history, const ResyncTalk *talk, unsigned char *packet);
+
+/* Reads the pair the library handed back: local is what was sent */
+/* in it, remote is NULL if that half was lost. Returns the status. */
+
+int ResyncTake(const ResyncHistory *history, ResyncTalk *talk, const unsigned char *local,
+	const unsigned char *remote);
+
+/* Goes back to the snapshot of frame: copies it into state and */
+/* forgets the frames after it. Returns 0 if there's no such snapshot. */
+
+int ResyncRewind(ResyncHistory *history, long frame, void *state);
+
+
+#endif	/* __RESYNC__ */
@@ -0,0 +1,151 @@
+/*****************************************************************
+*
+* rollback.c
+*
+* Rollback prediction on top of XBExchangeGameData, see rollback.h.
+*
+* The confirmed state is the only snapshot that is ever restored.
+* Every frame before it has been checked against the real remote
+* joypad, so rewinding to it and replaying the unconfirmed frames
+* is never more work than rewinding to the first wrong guess.
+*
+*****************************************************************/
+
+#include <string.h>
+
+#include "rollback.h"
+
+
+/*
+//
+// This function splits a frame's pads into master and slave order.
+//
+*/
+
+static void RollbackAdvanceFrame(Rollback *rb, long frame, int draw)
+{
+	unsigned short localPad, remotePad;
+
+	localPad = rb->localPad[frame % kRollbackWindow];
+	remotePad = rb->remoteGuess[frame % kRollbackWindow];
+
+	if (rb->localIsMaster)
+		rb->advance(rb->predicted, localPad, remotePad, draw);
+	else
+		rb->advance(rb->predicted, remotePad, localPad, draw);
+}
+
+
+void RollbackInit(Rollback *rb, void *predicted, unsigned stateSize,
+	RollbackAdvanceProc advance, int localIsMaster)
+{
+	memset(rb, 0, sizeof(*rb));
+	rb->predicted = predicted;
+	rb->stateSize = stateSize;
+	rb->advance = advance;
+	rb->localIsMaster = localIsMaster;
+}
+
+
+void RollbackReset(Rollback *rb, const void *confirmed, long frame)
+{
+	memcpy(rb->predicted, confirmed, rb->stateSize);
+	rb->nextFrame = frame;
+	rb->confirmedFrame = frame;
+	rb->lastRemotePad = 0;
+	rb->mispredicted = 0;
+}
+
+
+/*
+//
+// This function checks a confirmed frame against what was guessed.
+// A frame number out of order means the confirmed state no longer
+// lines up with the prediction, so it is rebuilt from scratch.
+//
+*/
+
+void RollbackConfirm(Rollback *rb, long frame, unsigned short masterPad,
+	unsigned short slavePad)
+{
+	unsigned short localPad, remotePad;
+	int slot;
+
+	rb->confirmedCount++;
+
+	if (frame < rb->confirmedFrame || frame >= rb->nextFrame)
+	{
+		rb->mispredicted = 1;
+		if (frame >= rb->nextFrame)
+			rb->confirmedFrame = rb->nextFrame;
+		return;
+	}
+
+	rb->confirmedFrame = frame;
+
+	if (rb->localIsMaster)
+	{
+		localPad = masterPad;
+		remotePad = slavePad;
+	}
+	else
+	{
+		localPad = slavePad;
+		remotePad = masterPad;
+	}
+
+	slot = frame % kRollbackWindow;
+
+	if (remotePad != rb->remoteGuess[slot] || localPad != rb->localPad[slot])
+	{
+		rb->mispredicted = 1;
+		rb->localPad[slot] = localPad;
+	}
+
+	rb->lastRemotePad = remotePad;
+	rb->confirmedFrame++;
+}
+
+
+/*
+//
+// This function brings the predicted state up to date. After a wrong
+// guess it starts over from the confirmed state and replays the
+// frames still in flight with the newest remote joypad as the guess.
+//
+*/
+
+void RollbackPredict(Rollback *rb, const void *confirmed, unsigned short localPad)
+{
+	long frame;
+	unsigned depth;
+
+	if (rb->mispredicted)
+	{
+		rb->mispredicted = 0;
+		rb->mispredictCount++;
+
+		memcpy(rb->predicted, confirmed, rb->stateSize);
+
+		for (frame = rb->confirmedFrame; frame < rb->nextFrame; frame++)
+		{
+			rb->remoteGuess[frame % kRollbackWindow] = rb->lastRemotePad;
+			RollbackAdvanceFrame(rb, frame, 0);
+			rb->resimulatedCount++;
+		}
+	}
+
+	/* Lost track of the oldest frames: stop expecting them */
+
+	if (rb->nextFrame - rb->confirmedFrame >= kRollbackWindow)
+		rb->confirmedFrame = rb->nextFrame - kRollbackWindow + 1;
+
+	frame = rb->nextFrame++;
+	rb->localPad[frame % kRollbackWindow] = localPad;
+	rb->remoteGuess[frame % kRollbackWindow] = rb->lastRemotePad;
+	RollbackAdvanceFrame(rb, frame, 1);
+
+	depth = (unsigned)(rb->nextFrame - rb->confirmedFrame);
+	if (depth > rb->maxDepth)
+		rb->maxDepth = depth;
+}
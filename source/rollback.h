@@ -0,0 +1,72 @@
+/*****************************************************************
+*
+* rollback.h
+*
+* Rollback prediction on top of XBExchangeGameData.
+*
+* XBExchangeGameData hands back each master/slave pair some frames
+* after the local input went out. Instead of waiting for it, the
+* game keeps two states: the confirmed state, advanced once per
+* pair the library returns (this is the one that talks to XBAND),
+* and a predicted state that is shown on screen. The predicted state
+* runs ahead on the local joypad right away, guessing that the
+* remote joypad has not changed. When a confirmed remote joypad
+* differs from the guess, the predicted state is rewound to the
+* confirmed one and the unconfirmed frames are simulated again.
+*
+*****************************************************************/
+
+
+#ifndef __ROLLBACK__
+#define	__ROLLBACK__
+
+/* Frames that may be in flight; must cover the library's queue */
+
+#define	kRollbackWindow		64
+
+/* Advances a state one frame. draw is non-zero for the frame that ends up on screen. */
+
+typedef void (*RollbackAdvanceProc)(void *state, unsigned short masterPad,
+	unsigned short slavePad, int draw);
+
+typedef struct
+{
+	void				*predicted;			/* state shown on screen */
+	unsigned			stateSize;
+	RollbackAdvanceProc	advance;
+	int					localIsMaster;
+
+	long				nextFrame;			/* next local frame to simulate */
+	long				confirmedFrame;		/* frames before this are confirmed */
+	unsigned short		localPad[kRollbackWindow];
+	unsigned short		remoteGuess[kRollbackWindow];
+	unsigned short		lastRemotePad;
+	int					mispredicted;
+
+	/* statistics */
+	unsigned long		confirmedCount;
+	unsigned long		mispredictCount;
+	unsigned long		resimulatedCount;
+	unsigned			maxDepth;
+} Rollback;
+
+void RollbackInit(Rollback *rb, void *predicted, unsigned stateSize,
+	RollbackAdvanceProc advance, int localIsMaster);
+
+/* Throws away all predictions: the predicted state becomes a copy of confirmed */
+
+void RollbackReset(Rollback *rb, const void *confirmed, long frame);
+
+/* Records the pads the library returned for a local frame. */
+/* The caller advances its confirmed state with the same pads. */
+
+void RollbackConfirm(Rollback *rb, long frame, unsigned short masterPad,
+	unsigned short slavePad);
+
+/* Rewinds if needed, then predicts the next frame from localPad. */
+/* confirmed must already include every frame passed to RollbackConfirm. */
+
+void RollbackPredict(Rollback *rb, const void *confirmed, unsigned short localPad);
+
+
+#endif	/* __ROLLBACK__ */
@@ -0,0 +1,289 @@
+/*****************************************************************
+*
+* romdisk.c
+*
+* Compressed romdisk reader, see romdisk.h.
+*
+*****************************************************************/
+
+#include <string.h>
+
+#include "romdisk.h"
+
+
+static unsigned RomdiskGet16(const unsigned char *in)
+{
+	return (in[0] << 8) | in[1];
+}
+
+static unsigned long RomdiskGet32(const unsigned char *in)
+{
+	return ((unsigned long)in[0] << 24) | ((unsigned long)in[1] << 16)
+		| ((unsigned long)in[2] << 8) | in[3];
+}
+
+
+/*
+//
+// This function reads the rest of a length whose nibble was 15.
+// Returns 0 if it runs off the end of the block.
+//
+*/
+
+static int RomdiskLength(const unsigned char **in, const unsigned char *end, unsigned long *length)
+{
+	unsigned byte;
+
+	do
+	{
+		if (*in >= end)
+			return 0;
+
+		byte = *(*in)++;
+		*length += byte;
+	} while (byte == 255);
+
+	return 1;
+}
+
+
+unsigned long RomdiskDecode(const void *in, unsigned long inSize, void *out, unsigned long outSize)
+{
+	const unsigned char *src = in, *end = src + inSize, *match;
+	unsigned char *dst = out, *dstEnd = dst + outSize;
+	unsigned long literals, length, offset;
+	unsigned token;
+
+	while (src < end)
+	{
+		token = *src++;
+
+		literals = token >> 4;
+		if (literals == 15 && !RomdiskLength(&src, end, &literals))
+			break;
+
+		if (literals > (unsigned long)(end - src) || literals > (unsigned long)(dstEnd - dst))
+			break;
+
+		memcpy(dst, src, literals);
+		src += literals;
+		dst += literals;
+
+		if (end - src < 2)
+			break;		/* the last sequence, or a corrupt one */
+
+		offset = RomdiskGet16(src);
+		src += 2;
+
+		length = token & 15;
+		if (length == 15 && !RomdiskLength(&src, end, &length))
+			break;
+		length += kRomdiskMinMatch;
+
+		if (offset == 0 || offset > (unsigned long)(dst - (unsigned char *)out)
+			|| length > (unsigned long)(dstEnd - dst))
+			break;
+
+		/* Matches closer than their length repeat themselves and */
+		/* have to go a byte at a time */
+
+		match = dst - offset;
+		if (offset >= length)
+		{
+			memcpy(dst, match, length);
+			dst += length;
+		}
+		else
+		{
+			while (length-- > 0)
+				*dst++ = *match++;
+		}
+	}
+
+	return dst - (unsigned char *)out;
+}
+
+
+int RomdiskOpen(Romdisk *romdisk, const void *image, void *cache, unsigned long cacheSize)
+{
+	const unsigned char *in = image;
+	int iii;
+
+	memset(romdisk, 0, sizeof(*romdisk));
+
+	if (memcmp(in, kRomdiskMagic, 4) != 0 || RomdiskGet16(in + 4) != kRomdiskVersion)
+		return 0;
+
+	romdisk->image = in;
+	romdisk->count = RomdiskGet16(in + 6);
+	romdisk->blockCount = RomdiskGet32(in + 8);
+	romdisk->blockShift = RomdiskGet16(in + 12);
+	romdisk->files = in + kRomdiskHeaderSize;
+	romdisk->offsets = romdisk->files + romdisk->count * kRomdiskEntrySize;
+
+	romdisk->cache = cache;
+	romdisk->cacheSlots = (int)(cacheSize >> romdisk->blockShift);
+	if (romdisk->cacheSlots > kRomdiskCacheBlocks)
+		romdisk->cacheSlots = kRomdiskCacheBlocks;
+
+	for (iii = 0; iii < romdisk->cacheSlots; iii++)
+		romdisk->cacheBlock[iii] = -1;
+
+	return romdisk->cacheSlots > 0;
+}
+
+
+int RomdiskFind(const Romdisk *romdisk, const char *path, RomdiskFile *file)
+{
+	const unsigned char *entry;
+	int low, high, middle, order;
+
+	if (*path == '/')
+		path++;
+
+	low = 0;
+	high = (int)romdisk->count - 1;
+
+	while (low <= high)
+	{
+		middle = (low + high) / 2;
+		entry = romdisk->files + middle * kRomdiskEntrySize;
+		order = strncmp(path, (const char *)entry, kRomdiskPathSize);
+
+		if (order == 0)
+		{
+			file->size = RomdiskGet32(entry + kRomdiskPathSize);
+			file->firstBlock = RomdiskGet32(entry + kRomdiskPathSize + 4);
+			return 1;
+		}
+
+		if (order < 0)
+			high = middle - 1;
+		else
+			low = middle + 1;
+	}
+
+	return 0;
+}
+
+
+/*
+//
+// This function decodes block into out, which has room for length
+// bytes, the block's size once decoded. Returns 0 if it's corrupt.
+//
+*/
+
+static int RomdiskDecodeBlock(Romdisk *romdisk, unsigned long block, unsigned char *out,
+	unsigned long length)
+{
+	unsigned long start, end;
+
+	if (block >= romdisk->blockCount)
+		return 0;
+
+	start = RomdiskGet32(romdisk->offsets + block * 4);
+	end = RomdiskGet32(romdisk->offsets + block * 4 + 4);
+	romdisk->decoded++;
+
+	if (end - start == length)
+	{
+		memcpy(out, romdisk->image + start, length);
+		return 1;
+	}
+
+	return RomdiskDecode(romdisk->image + start, end - start, out, length) == length;
+}
+
+
+/*
+//
+// This function returns the cached copy of block, decoding it over
+// the least recently used one if it isn't there. Returns NULL if the
+// block is corrupt.
+//
+*/
+
+static const unsigned char *RomdiskCacheBlock(Romdisk *romdisk, unsigned long block,
+	unsigned long length)
+{
+	unsigned char *slot;
+	int iii, oldest;
+
+	oldest = 0;
+	for (iii = 0; iii < romdisk->cacheSlots; iii++)
+	{
+		if (romdisk->cacheBlock[iii] == (long)block)
+		{
+			romdisk->cacheUsed[iii] = ++romdisk->clock;
+			romdisk->hits++;
+			return romdisk->cache + ((unsigned long)iii << romdisk->blockShift);
+		}
+
+		if (romdisk->cacheUsed[iii] < romdisk->cacheUsed[oldest])
+			oldest = iii;
+	}
+
+	slot = romdisk->cache + ((unsigned long)oldest << romdisk->blockShift);
+	if (!RomdiskDecodeBlock(romdisk, block, slot, length))
+	{
+		romdisk->cacheBlock[oldest] = -1;
+		romdisk->cacheUsed[oldest] = 0;
+		return NULL;
+	}
+
+	romdisk->cacheBlock[oldest] = (long)block;
+	romdisk->cacheUsed[oldest] = ++romdisk->clock;
+	return slot;
+}
+
+
+long RomdiskRead(Romdisk *romdisk, const RomdiskFile *file, unsigned long offset,
+	void *buffer, unsigned long size)
+{
+	const unsigned char *decoded;
+	unsigned char *out = buffer;
+	unsigned long blockSize, block, skip, length, copy, done;
+
+	if (offset >= file->size)
+		return 0;
+	if (size > file->size - offset)
+		size = file->size - offset;
+
+	blockSize = 1UL << romdisk->blockShift;
+	done = 0;
+
+	while (done < size)
+	{
+		block = (offset + done) >> romdisk->blockShift;
+		skip = (offset + done) & (blockSize - 1);
+		length = file->size - (block << romdisk->blockShift);
+		if (length > blockSize)
+			length = blockSize;
+
+		copy = length - skip;
+		if (copy > size - done)
+			copy = size - done;
+
+		/* A whole block goes straight into the buffer, past the */
+		/* cache, since it won't be read again soon */
+
+		if (skip == 0 && copy == length)
+		{
+			if (!RomdiskDecodeBlock(romdisk, file->firstBlock + block, out + done, length))
+				return -1;
+		}
+		else
+		{
+			decoded = RomdiskCacheBlock(romdisk, file->firstBlock + block, length);
+			if (decoded == NULL)
+				return -1;
+
+			memcpy(out + done, decoded + skip, copy);
+		}
+
+		done += copy;
+	}
+
+	return (long)done;
+}
@@ -0,0 +1,94 @@
+/*****************************************************************
+*
+* romdisk.h
+*
+* Compressed romdisk, the image tools/nlromfs builds out of
+* ROMDISK_DIRS in place of genromfs's. Files are cut into blocks of
+* 1 << blockShift bytes, each compressed on its own, so a read only
+* decodes the blocks it touches, and only when it touches them. A
+* few decoded blocks are kept in a cache the caller gives
+* RomdiskOpen, least recently used out first.
+*
+* The image is a header, a file table of kRomdiskEntrySize byte
+* entries sorted by path, and blockCount + 1 block offsets; block iii
+* is the bytes between offsets iii and iii + 1. A file's blocks are
+* consecutive and it starts on a new one. A block that didn't get
+* smaller is stored as it is. All numbers are big-endian.
+*
+* Blocks are LZ77 sequences, byte-aligned so the SH-2 never shifts
+* more than a nibble out of a token:
+*
+*	token			high nibble: literals, low nibble: match length - 4;
+*					15 means more follows, as bytes added on until one
+*					isn't 255
+*	literals
+*	offset			2 bytes, 1 to the block size back
+*
+* The last sequence of a block is only a token and literals.
+*
+*****************************************************************/
+
+
+#ifndef __ROMDISK__
+#define	__ROMDISK__
+
+#define	kRomdiskMagic			"NLRD"
+#define	kRomdiskVersion			1
+#define	kRomdiskHeaderSize		16
+#define	kRomdiskEntrySize		64
+#define	kRomdiskPathSize		56		/* no leading '/', NUL-padded */
+#define	kRomdiskBlockShift		12		/* nlromfs's default, 4 KB blocks */
+#define	kRomdiskMinMatch		4
+#define	kRomdiskCacheBlocks		8		/* most blocks a cache holds */
+
+typedef struct
+{
+	unsigned long	size;
+	unsigned long	firstBlock;
+} RomdiskFile;
+
+typedef struct
+{
+	const unsigned char	*image;
+	const unsigned char	*files;
+	const unsigned char	*offsets;
+	unsigned			count;
+	unsigned long		blockCount;
+	unsigned			blockShift;
+
+	/* cache */
+	unsigned char		*cache;
+	int					cacheSlots;
+	long				cacheBlock[kRomdiskCacheBlocks];	/* -1 if empty */
+	unsigned long		cacheUsed[kRomdiskCacheBlocks];
+	unsigned long		clock;
+
+	unsigned long		decoded;		/* blocks decoded */
+	unsigned long		hits;			/* blocks found in the cache */
+} Romdisk;
+
+/* Opens the image at image. cache holds the decoded blocks and must */
+/* have room for one at least. Returns 0 if the image is bad or the */
+/* cache too small. */
+
+int RomdiskOpen(Romdisk *romdisk, const void *image, void *cache, unsigned long cacheSize);
+
+/* Looks path up, with or without a leading '/'; returns 0 if it */
+/* isn't there */
+
+int RomdiskFind(const Romdisk *romdisk, const char *path, RomdiskFile *file);
+
+/* Copies size bytes of file from offset into buffer, decoding the */
+/* blocks that aren't cached. Returns the bytes copied, which are */
+/* fewer past the end of the file, or -1 if a block is corrupt. */
+
+long RomdiskRead(Romdisk *romdisk, const RomdiskFile *file, unsigned long offset,
+	void *buffer, unsigned long size);
+
+/* Decodes one block. Returns the bytes written, which are outSize */
+/* unless the block is corrupt. */
+
+unsigned long RomdiskDecode(const void *in, unsigned long inSize, void *out, unsigned long outSize);
+
+
+#endif	/* __ROMDISK__ */
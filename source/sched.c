@@ -0,0 +1,335 @@
+/*****************************************************************
+*
+* sched.c
+*
+* Cooperative frame scheduler, see sched.h.
+*
+* Idle time is measured with the free-running timer (FRT): the time
+* between SLEEP and the interrupt that ends it, against the length
+* of the frame. The v-blank handler closes the books on each frame.
+* Main code and the handler share a few counters without masking
+* interrupts, so a frame's headroom can be off by the few cycles
+* between two instructions, which doesn't matter for a percentage.
+*
+*****************************************************************/
+
+#include <yaul.h>
+#include <string.h>
+
+#include "sched.h"
+
+typedef struct
+{
+	SchedProc	proc;
+	void		*work;
+} SchedDeferred;
+
+typedef struct
+{
+	volatile unsigned long	*ticks;
+	SchedTask				*tasks;
+
+	SchedDeferred			deferred[kSchedDeferSize];
+	unsigned				deferHead;
+	unsigned				deferCount;
+
+	/* FRT counts */
+	volatile uint16_t		frameStart;
+	volatile uint16_t		frameLength;	/* of the last frame */
+	volatile uint16_t		sleepStart;
+	volatile int			sleeping;
+	volatile uint32_t		idle;			/* asleep so far this frame */
+
+	SchedStats				stats;
+} Sched;
+
+static Sched gSched;
+
+
+void SchedInit(volatile unsigned long *ticks)
+{
+	memset(&gSched, 0, sizeof(gSched));
+	gSched.ticks = ticks;
+	gSched.stats.minHeadroom = 100;
+
+	cpu_frt_init(CPU_FRT_CLOCK_DIV_128);	/* about 3500 counts a frame */
+	gSched.frameStart = cpu_frt_count_get();
+}
+
+
+/*
+//
+// This function is called in v-blank out. It ends the frame's idle
+// count, carrying over the part of a sleep that is still going on.
+//
+*/
+
+void SchedVblank(void)
+{
+	uint16_t now, length;
+	uint32_t idle;
+	unsigned headroom;
+
+	now = cpu_frt_count_get();
+	length = (uint16_t)(now - gSched.frameStart);
+
+	idle = gSched.idle;
+	if (gSched.sleeping)
+	{
+		idle += (uint16_t)(now - gSched.sleepStart);
+		gSched.sleepStart = now;
+	}
+
+	gSched.idle = 0;
+	gSched.frameStart = now;
+	gSched.frameLength = length;
+
+	if (length == 0)
+		return;
+
+	headroom = (unsigned)(idle * 100 / length);
+	if (headroom > 100)
+		headroom = 100;
+
+	gSched.stats.headroom = headroom;
+	if (headroom < gSched.stats.minHeadroom)
+		gSched.stats.minHeadroom = headroom;
+	gSched.stats.frames++;
+}
+
+
+/*
+//
+// Small helpers.
+//
+*/
+
+static int SchedInBudget(void)
+{
+	uint32_t elapsed, length;
+
+	length = gSched.frameLength;
+	elapsed = (uint16_t)(cpu_frt_count_get() - gSched.frameStart);
+
+	return length == 0 || elapsed * 100 < length * kSchedBudget;
+}
+
+/*
+//
+// This function unmasks interrupts down to mask and sleeps, as one
+// step: the SH-2 takes no interrupt between LDC to SR and the
+// instruction after it.
+//
+*/
+
+static void SchedSleepUnmasking(uint8_t mask)
+{
+#ifdef XB_HOST_SIM
+	YaulSimSleepUnmasking(mask);
+#else
+	uint32_t sr;
+
+	__asm__ volatile ("stc sr, %0" : "=r" (sr));
+	sr = (sr & ~0xF0UL) | ((uint32_t)mask << 4);
+	__asm__ volatile ("ldc %0, sr\n\tsleep" : : "r" (sr) : "memory");
+#endif
+}
+
+
+/*
+//
+// This function sleeps until the next interrupt, unless tick has
+// come. The check is made with interrupts masked, so a v-blank can't
+// land between it and SLEEP and leave us asleep for a whole frame.
+//
+*/
+
+static void SchedSleep(unsigned long tick)
+{
+	uint8_t mask;
+
+	mask = cpu_intc_mask_get();
+	cpu_intc_mask_set(15);
+
+	if ((long)(*gSched.ticks - tick) >= 0)
+	{
+		cpu_intc_mask_set(mask);
+		return;
+	}
+
+	gSched.sleepStart = cpu_frt_count_get();
+	gSched.sleeping = 1;
+
+	SchedSleepUnmasking(mask);
+
+	gSched.sleeping = 0;
+	gSched.idle += (uint16_t)(cpu_frt_count_get() - gSched.sleepStart);
+}
+
+
+/*
+//
+// This function finds the released task with the earliest deadline.
+// A task is released one period before its deadline.
+//
+*/
+
+static SchedTask *SchedNextTask(unsigned long now)
+{
+	SchedTask *task, *best;
+
+	best = NULL;
+
+	for (task = gSched.tasks; task != NULL; task = task->next)
+	{
+		if ((long)(now - (task->deadline - task->period)) < 0)
+			continue;
+
+		if (best == NULL || (long)(task->deadline - best->deadline) < 0)
+			best = task;
+	}
+
+	return best;
+}
+
+
+static void SchedRunNextDeferred(void)
+{
+	SchedDeferred item;
+
+	item = gSched.deferred[gSched.deferHead];
+	gSched.deferHead = (gSched.deferHead + 1) % kSchedDeferSize;
+	gSched.deferCount--;
+
+	gSched.stats.deferredRun++;
+	item.proc(item.work);
+}
+
+
+/*
+//
+// This function runs one piece of work, if there is any and the
+// frame has time for it. Returns 0 if it ran nothing.
+//
+*/
+
+static int SchedRunOne(void)
+{
+	SchedTask *task;
+	unsigned long now;
+
+	now = *gSched.ticks;
+	task = SchedNextTask(now);
+
+	if (task != NULL && ((long)(task->deadline - now) <= 0 || SchedInBudget()))
+	{
+		if ((long)(now - task->deadline) > 0)
+			gSched.stats.deadlinesMissed++;
+
+		if (task->period == 0)
+			SchedRemoveTask(task);
+		else if ((long)(now - task->deadline) >= 0)
+			task->deadline = now + task->period;	/* fell behind: don't try to catch up */
+		else
+			task->deadline += task->period;
+
+		gSched.stats.tasksRun++;
+		task->proc(task->work);
+		return 1;
+	}
+
+	if (gSched.deferCount > 0 && SchedInBudget())
+	{
+		SchedRunNextDeferred();
+		return 1;
+	}
+
+	return 0;
+}
+
+
+void SchedSleepUntil(unsigned long tick)
+{
+	while ((long)(*gSched.ticks - tick) < 0)
+	{
+		if (!SchedRunOne())
+			SchedSleep(tick);
+	}
+}
+
+
+void SchedWaitVblank(void)
+{
+	SchedSleepUntil(*gSched.ticks + 1);
+}
+
+
+void SchedAddTask(SchedTask *task, SchedProc proc, void *work, unsigned long period)
+{
+	task->proc = proc;
+	task->work = work;
+	task->period = period;
+	task->deadline = *gSched.ticks + (period ? period : 1);
+
+	task->next = gSched.tasks;
+	gSched.tasks = task;
+}
+
+
+void SchedRemoveTask(SchedTask *task)
+{
+	SchedTask **link;
+
+	for (link = &gSched.tasks; *link != NULL; link = &(*link)->next)
+	{
+		if (*link == task)
+		{
+			*link = task->next;
+			task->next = NULL;
+			return;
+		}
+	}
+}
+
+
+int SchedDefer(SchedProc proc, void *work)
+{
+	SchedDeferred *item;
+
+	if (gSched.deferCount == kSchedDeferSize)
+	{
+		gSched.stats.deferredDropped++;
+		return 0;
+	}
+
+	item = &gSched.deferred[(gSched.deferHead + gSched.deferCount) % kSchedDeferSize];
+	item->proc = proc;
+	item->work = work;
+	gSched.deferCount++;
+
+	return 1;
+}
+
+
+void SchedRunDeferred(void)
+{
+	while (gSched.deferCount > 0)
+		SchedRunNextDeferred();
+}
+
+
+const SchedStats *SchedGetStats(void)
+{
+	return &gSched.stats;
+}
+
+
+void SchedResetStats(void)
+{
+	gSched.stats.minHeadroom = 100;
+	gSched.stats.frames = 0;
+	gSched.stats.tasksRun = 0;
+	gSched.stats.deadlinesMissed = 0;
+	gSched.stats.deferredRun = 0;
+	gSched.stats.deferredDropped = 0;
+}
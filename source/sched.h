@@ -0,0 +1,81 @@
+/*****************************************************************
+*
+* sched.h
+*
+* Cooperative frame scheduler driven by v-blank out.
+*
+* Instead of spinning on gTimer, the game sleeps until a tick with
+* SchedSleepUntil. While it waits, the scheduler runs the tasks that
+* are due, earliest deadline first, then the deferred work queue,
+* and puts the CPU to sleep until the next interrupt when there is
+* nothing left. Work is only started while the frame is younger
+* than kSchedBudget percent, so it never eats the time the game
+* needs right after v-blank; a task that is about to miss its
+* deadline runs regardless.
+*
+* Everything runs on the master SH-2 outside interrupts, except
+* SchedVblank, which the v-blank out handler calls after advancing
+* the timer.
+*
+*****************************************************************/
+
+
+#ifndef __SCHED__
+#define	__SCHED__
+
+#define	kSchedBudget		75		/* percent of a frame that work may start in */
+#define	kSchedDeferSize		16		/* deferred work items */
+
+typedef void (*SchedProc)(void *work);
+
+typedef struct SchedTask
+{
+	SchedProc			proc;
+	void				*work;
+	unsigned long		period;		/* ticks between runs, 0 = run once */
+	unsigned long		deadline;	/* tick it must have run by */
+	struct SchedTask	*next;
+} SchedTask;
+
+typedef struct
+{
+	unsigned			headroom;		/* percent of the last frame spent asleep */
+	unsigned			minHeadroom;	/* lowest since SchedResetStats */
+	unsigned long		frames;
+	unsigned long		tasksRun;
+	unsigned long		deadlinesMissed;
+	unsigned long		deferredRun;
+	unsigned long		deferredDropped;	/* queue was full */
+} SchedStats;
+
+/* ticks is the counter the v-blank out handler advances */
+
+void SchedInit(volatile unsigned long *ticks);
+
+/* Call from the v-blank out handler, after advancing the ticks */
+
+void SchedVblank(void);
+
+/* Runs work and sleeps until *ticks reaches tick */
+
+void SchedSleepUntil(unsigned long tick);
+void SchedWaitVblank(void);
+
+/* A task first runs within period ticks; period 0 runs it once, within a tick */
+
+void SchedAddTask(SchedTask *task, SchedProc proc, void *work, unsigned long period);
+void SchedRemoveTask(SchedTask *task);
+
+/* Queues proc(work) for idle time. Returns 0 if the queue is full. */
+
+int SchedDefer(SchedProc proc, void *work);
+
+/* Runs all the deferred work now, budget or not, as before exiting */
+
+void SchedRunDeferred(void);
+
+const SchedStats *SchedGetStats(void);
+void SchedResetStats(void);
+
+
+#endif	/* __SCHED__ */
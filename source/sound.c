@@ -0,0 +1,157 @@
+/*****************************************************************
+*
+* sound.c
+*
+* The SH-2's side of the sound driver, see sound.h.
+*
+* The command ring is the only thing both CPUs write: the SH-2 fills
+* in a command and then moves head past it, and the driver reads up
+* to head and moves tail. Neither waits for the other.
+*
+*****************************************************************/
+
+#include <string.h>
+
+#include "sound.h"
+
+#define	kSoundSampleAlign	4		/* DMA longs */
+
+/* The layout both CPUs agree on */
+
+typedef char SoundSharedCheck[sizeof(SoundShared) == kSoundSharedSize ? 1 : -1];
+
+
+int SoundInit(Sound *sound, void *ram, const void *driver)
+{
+	const SoundHeader *header = (const SoundHeader *)((const unsigned char *)driver + kSoundHeader);
+
+	memset(sound, 0, sizeof(*sound));
+
+	if (header->magic != kSoundMagic || header->size <= kSoundHeader
+		|| header->size > kSoundDriverSize)
+		return 0;
+
+	sound->ram = ram;
+	sound->shared = (volatile SoundShared *)((unsigned char *)ram + kSoundShared);
+	sound->next = kSoundData;
+
+	/* The driver's bss and stack, the shared area and the rings start */
+	/* out zero; the driver sets magic when it's running */
+
+	memset(ram, 0, kSoundData);
+	memcpy(ram, driver, header->size);
+	return 1;
+}
+
+
+int SoundReady(const Sound *sound)
+{
+	return sound->shared != NULL && sound->shared->magic == kSoundMagic;
+}
+
+
+int SoundLoad(Sound *sound, const PackAsset *asset, SoundReadProc read, void *ref)
+{
+	volatile SoundSample *sample;
+	unsigned long size;
+
+	if (sound->shared == NULL || asset->type != kPackSound || sound->count == kSoundSamples)
+		return -1;
+
+	if (asset->format != kPackPCM8 && asset->format != kPackPCM16 && asset->format != kPackADPCM4)
+		return -1;
+
+	size = asset->dataSize;
+	if (size == 0 || size > kSoundRAMSize - sound->next)
+		return -1;
+
+	if (!read(asset->dataOffset, (void *)(sound->ram + sound->next), size, ref))
+		return -1;
+
+	/* In the table before its number is handed out, so the driver */
+	/* never sees a command for a sample that isn't there yet */
+
+	sample = &sound->shared->samples[sound->count];
+	sample->address = sound->next;
+	sample->size = size;
+	sample->rate = (uint16_t)asset->rate;
+	sample->format = asset->format;
+	sample->unused = 0;
+
+	sound->next += (size + kSoundSampleAlign - 1) & ~(unsigned long)(kSoundSampleAlign - 1);
+	return sound->count++;
+}
+
+
+/*
+//
+// This function puts a command on the ring. Returns 0 if it's full.
+//
+*/
+
+static int SoundCommandPut(Sound *sound, int op, int voice, int sample, int volume, int pan, int flags)
+{
+	volatile SoundShared *shared = sound->shared;
+	volatile SoundCommand *command;
+	unsigned head, next;
+
+	if (shared == NULL)
+		return 0;
+
+	head = shared->head;
+	next = (head + 1) % kSoundCommands;
+	if (next == shared->tail)
+		return 0;
+
+	command = &shared->commands[head];
+	command->op = (uint8_t)op;
+	command->voice = (uint8_t)voice;
+	command->volume = (uint8_t)volume;
+	command->pan = (uint8_t)pan;
+	command->sample = (uint16_t)sample;
+	command->flags = (uint8_t)flags;
+	command->unused = 0;
+
+	shared->head = (uint16_t)next;
+	return 1;
+}
+
+
+int SoundPlay(Sound *sound, int sample, int voice, int volume, int pan, int flags)
+{
+	if (sample < 0 || sample >= sound->count)
+		return 0;
+
+	if (voice != kSoundAnyVoice && (voice < 0 || voice >= kSoundVoices))
+		return 0;
+
+	if (volume < 0)
+		volume = 0;
+	else if (volume > 255)
+		volume = 255;
+
+	if (pan < 0)
+		pan = 0;
+	else if (pan > 255)
+		pan = 255;
+
+	return SoundCommandPut(sound, kSoundPlay, voice, sample, volume, pan, flags);
+}
+
+
+int SoundStop(Sound *sound, int voice)
+{
+	if (voice != kSoundAllVoices && (voice < 0 || voice >= kSoundVoices))
+		return 0;
+
+	return SoundCommandPut(sound, kSoundStop, voice, 0, 0, 0, 0);
+}
+
+
+int SoundPlaying(const Sound *sound, int voice)
+{
+	if (sound->shared == NULL || voice < 0 || voice >= kSoundVoices)
+		return 0;
+
+	return (sound->shared->voices >> voice) & 1;
+}
@@ -0,0 +1,149 @@
+/*****************************************************************
+*
+* sound.h
+*
+* UI sounds, played by the 68000 sound driver in m68k/ out of sound
+* RAM. The SH-2 loads the driver and the samples once; after that,
+* playing a sound is writing an 8-byte command into a ring in sound
+* RAM, and the driver does the rest. The main CPU never touches
+* sample data while a sound plays.
+*
+* Sound RAM, as the 68000 sees it (the SH-2 sees it at 0x25A00000):
+*
+*	0x00000		the driver: vectors, kSoundHeader, code, stack
+*	0x06000		SoundShared: the command ring and the sample table
+*	0x07000		a ring of kSoundRingSamples 16-bit samples a voice
+*	0x0B000		the samples, as they are in the asset archive
+*
+* Every voice is an SCSP slot looping over its ring, which the driver
+* keeps filled ahead of it, decoding the sound's ADPCM (or copying its
+* PCM) as it goes. The slots do the mixing, volume and pan; the driver
+* keeps count of where each one is by the SCSP's own timer.
+*
+* SoundShared is read by both CPUs, so it's made of fixed-size
+* fields, the 32-bit ones on 4-byte boundaries, and comes out the
+* same to the SH-2 and 68000 compilers (and the host's); sound.c
+* checks it's kSoundSharedSize.
+*
+*****************************************************************/
+
+
+#ifndef __SOUND__
+#define	__SOUND__
+
+#include <stdint.h>
+
+#include "pack.h"
+
+#define	kSoundMagic				0x4E4C5344		/* "NLSD" */
+#define	kSoundRAMSize			0x80000
+#define	kSoundHeader			0x100			/* in the driver, after the vectors */
+#define	kSoundDriverSize		0x6000
+#define	kSoundShared			0x6000
+#define	kSoundRings				0x7000
+#define	kSoundData				0xB000
+
+#define	kSoundCommands			32
+#define	kSoundSamples			128
+#define	kSoundVoices			8
+#define	kSoundRingSamples		1024
+#define	kSoundSharedSize		(12 + kSoundCommands * 8 + kSoundSamples * 12)
+
+#define	kSoundAnyVoice			0xFF	/* a free voice, or the one playing longest */
+#define	kSoundAllVoices			0xFF
+
+/* Command ops */
+
+enum
+{
+	kSoundNop,
+	kSoundPlay,
+	kSoundStop
+};
+
+/* Play flags */
+
+#define	kSoundLoop				0x01	/* until stopped */
+
+typedef struct
+{
+	uint8_t			op;
+	uint8_t			voice;
+	uint8_t			volume;			/* 0 to 255 */
+	uint8_t			pan;			/* 0 left, 128 center, 255 right */
+	uint16_t		sample;
+	uint8_t			flags;
+	uint8_t			unused;
+} SoundCommand;
+
+typedef struct
+{
+	uint32_t		address;		/* in sound RAM */
+	uint32_t		size;			/* bytes */
+	uint16_t		rate;			/* samples a second */
+	uint8_t			format;			/* kPackPCM8, kPackPCM16, kPackADPCM4 */
+	uint8_t			unused;
+} SoundSample;
+
+typedef struct
+{
+	uint32_t		magic;			/* kSoundMagic once the driver runs */
+	uint16_t		head;			/* next command the SH-2 writes */
+	uint16_t		tail;			/* next command the driver reads */
+	uint16_t		voices;			/* a bit for every voice playing */
+	uint16_t		ticks;			/* the driver's timer, to see it's alive */
+	SoundCommand	commands[kSoundCommands];
+	SoundSample		samples[kSoundSamples];
+} SoundShared;
+
+/* The driver image starts its header at kSoundHeader */
+
+typedef struct
+{
+	uint32_t		magic;			/* kSoundMagic */
+	uint32_t		size;			/* bytes to copy to sound RAM */
+} SoundHeader;
+
+/* Reads size bytes of the archive from offset. Returns 0 if it can't. */
+
+typedef int (*SoundReadProc)(unsigned long offset, void *buffer, unsigned long size, void *ref);
+
+typedef struct
+{
+	volatile unsigned char	*ram;
+	volatile SoundShared	*shared;
+	unsigned long			next;		/* free sound RAM for samples */
+	int						count;		/* samples loaded */
+} Sound;
+
+/* Copies the driver image (sound_m68k, which the build links in from */
+/* m68k/) into ram, sound RAM, and clears the rest of what the driver */
+/* uses. The 68000 has to be stopped (SMPC SNDOFF) before, and started */
+/* (SNDON) after. Returns 0 if it isn't a driver. */
+
+int SoundInit(Sound *sound, void *ram, const void *driver);
+
+/* The driver has started */
+
+int SoundReady(const Sound *sound);
+
+/* Reads a sound asset into sound RAM. Returns its sample number, or */
+/* -1 if it isn't a sound, doesn't fit, or can't be read. */
+
+int SoundLoad(Sound *sound, const PackAsset *asset, SoundReadProc read, void *ref);
+
+/* Plays sample on voice, or kSoundAnyVoice. Returns 0 if the command */
+/* ring is full. */
+
+int SoundPlay(Sound *sound, int sample, int voice, int volume, int pan, int flags);
+
+/* Stops voice, or kSoundAllVoices */
+
+int SoundStop(Sound *sound, int voice);
+
+/* The driver has voice playing, as of the last commands it read */
+
+int SoundPlaying(const Sound *sound, int voice);
+
+
+#endif	/* __SOUND__ */
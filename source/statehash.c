@@ -0,0 +1,187 @@
+/*****************************************************************
+*
+* statehash.c
+*
+* Incremental state hash and sync-sniffer, see statehash.h.
+*
+*****************************************************************/
+
+#include "statehash.h"
+
+
+/*
+//
+// This function mixes a field's index and value into 32 bits. The
+// finisher is MurmurHash3's, so every input bit moves about half of
+// the output bits.
+//
+*/
+
+static inline uint32_t StateHashMix(int field, uint32_t value)
+{
+	uint32_t x;
+
+	x = value ^ ((uint32_t)(field + 1) * 0x9E3779B9U);
+	x ^= x >> 16;
+	x *= 0x85EBCA6BU;
+	x ^= x >> 13;
+	x *= 0xC2B2AE35U;
+	x ^= x >> 16;
+
+	return x;
+}
+
+
+static inline uint32_t StateHashValue(const void *state, const StateHashField *field)
+{
+	const unsigned char *p = (const unsigned char *)state + field->offset;
+
+	switch (field->size)
+	{
+		case 1:		return *p;
+		case 2:		return *(const uint16_t *)p;
+		default:	return *(const uint32_t *)p;
+	}
+}
+
+
+uint32_t StateHashAll(const void *state, const StateHashField *fields, int fieldCount)
+{
+	uint32_t hash;
+	int iii;
+
+	hash = 0;
+	for (iii = 0; iii < fieldCount; iii++)
+		hash ^= StateHashMix(iii, StateHashValue(state, &fields[iii]));
+
+	return hash;
+}
+
+
+uint32_t StateHashOne(const void *state, const StateHashField *fields, int field)
+{
+	return StateHashMix(field, StateHashValue(state, &fields[field]));
+}
+
+
+uint32_t StateHashUpdate(uint32_t hash, const void *before, const void *after,
+	const StateHashField *fields, uint32_t mask, uint32_t *changed)
+{
+	uint32_t oldValue, newValue;
+	int iii;
+
+	*changed = 0;
+
+	for (iii = 0; mask != 0; iii++, mask >>= 1)
+	{
+		if (!(mask & 1))
+			continue;
+
+		oldValue = StateHashValue(before, &fields[iii]);
+		newValue = StateHashValue(after, &fields[iii]);
+
+		if (oldValue != newValue)
+		{
+			hash ^= StateHashMix(iii, oldValue) ^ StateHashMix(iii, newValue);
+			*changed |= 1UL << iii;
+		}
+	}
+
+	return hash;
+}
+
+
+void StateHashReset(StateHashHistory *history)
+{
+	int iii;
+
+	for (iii = 0; iii < kStateHashHistory; iii++)
+		history->frames[iii].frame = -1;
+
+	history->remoteOffset = 0;
+	history->lastMatch = -1;
+}
+
+
+void StateHashRecord(StateHashHistory *history, long frame, uint32_t hash, uint32_t changed)
+{
+	StateHashFrame *entry = &history->frames[frame & (kStateHashHistory - 1)];
+
+	entry->frame = frame;
+	entry->hash = hash;
+	entry->changed = changed;
+}
+
+
+/*
+//
+// This function folds a frame's hash into a byte. 0 is kept for
+// "nothing to check".
+//
+*/
+
+static unsigned char StateHashFold(uint32_t hash)
+{
+	hash ^= hash >> 16;
+	hash ^= hash >> 8;
+	hash &= 0xFF;
+
+	return hash ? (unsigned char)hash : 1;
+}
+
+
+unsigned char StateHashCheckByte(const StateHashHistory *history, long frame)
+{
+	const StateHashFrame *entry;
+
+	if (frame < 0)
+		return 0;
+
+	entry = &history->frames[frame & (kStateHashHistory - 1)];
+	return (entry->frame == frame) ? StateHashFold(entry->hash) : 0;
+}
+
+
+int StateHashCheck(StateHashHistory *history, long remoteFrame, unsigned char check)
+{
+	const StateHashFrame *entry;
+	unsigned char local;
+	long frame, first;
+
+	frame = remoteFrame - history->remoteOffset;
+	local = StateHashCheckByte(history, frame);
+
+	if (check == 0 || local == 0)
+		return 1;
+
+	history->checked++;
+	if (local == check)
+	{
+		history->lastMatch = frame;
+		return 1;
+	}
+
+	history->mismatches++;
+	if (!history->diverged)
+	{
+		/* Skipped checks leave more than one frame to blame */
+
+		first = history->lastMatch + 1;
+		if (first <= frame - kStateHashHistory)
+			first = frame - kStateHashHistory + 1;
+
+		history->diverged = 1;
+		history->firstBadFrame = first;
+		history->badFrame = frame;
+		history->badFields = 0;
+
+		for (; first <= frame; first++)
+		{
+			entry = &history->frames[first & (kStateHashHistory - 1)];
+			if (entry->frame == first)
+				history->badFields |= entry->changed;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,114 @@
+/*****************************************************************
+*
+* statehash.h
+*
+* Incremental 32-bit hash of a game state, and the sync-sniffer
+* that compares it with the remote side's.
+*
+* The hash is the XOR of a mix of every field's index and value,
+* so a field that changes is taken out with its old value and put
+* back in with its new one. The game describes its state with a
+* table of fields; each frame it hashes only the fields the code
+* that ran could have changed, and only the ones that did change
+* cost a mix.
+*
+* Every confirmed frame's hash goes into a history window. Packets
+* carry a byte of the hash of the frame kStateHashLag before the
+* one they belong to, which both sides have normally confirmed by
+* then, so the receiver can check it against its own hash of that
+* frame. The two sides went apart after the last frame that matched
+* and by the first one that didn't, which are the same frame unless
+* checks were skipped; the fields that changed in between are the
+* suspects.
+*
+* Both are only hints. A byte lets one mismatch in 256 through, so
+* the first check that fails can be a frame or more after the one
+* that went wrong, and the range widens with it. The suspects are
+* the fields the game's own code changed, from the masks it hashes
+* with: a field changed outside those (a missing mask bit, a stray
+* write) is never a suspect. So on the first mismatch the game
+* opens a resync session (resync.h), where both sides send the hash
+* of each field of a snapshot taken after it, and the fields whose
+* hashes differ are named instead.
+*
+*****************************************************************/
+
+
+#ifndef __STATEHASH__
+#define	__STATEHASH__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define	kStateHashMaxFields		32
+#define	kStateHashHistory		64		/* frames, a power of two */
+#define	kStateHashLag			16		/* a packet checks the frame this far back */
+
+typedef struct
+{
+	unsigned short	offset;
+	unsigned short	size;			/* 1, 2 or 4 bytes */
+	const char		*name;
+} StateHashField;
+
+#define	STATEHASH_FIELD(type, member)	\
+	{ offsetof(type, member), sizeof(((type *)0)->member), #member }
+
+typedef struct
+{
+	long			frame;			/* -1 = empty */
+	uint32_t		hash;
+	uint32_t		changed;		/* bit per field that changed on this frame */
+} StateHashFrame;
+
+typedef struct
+{
+	StateHashFrame	frames[kStateHashHistory];
+	long			remoteOffset;	/* remote frame number minus ours */
+
+	unsigned long	checked;
+	unsigned long	mismatches;
+	long			lastMatch;		/* -1 = none this session */
+
+	/* where the sides first went apart */
+	int				diverged;
+	long			firstBadFrame;	/* earliest it could have been */
+	long			badFrame;		/* the frame that didn't match */
+	uint32_t		badFields;		/* the suspects, or once named, the fields that differ */
+	int				named;			/* badFields came from the remote's field hashes */
+	long			namedFrame;		/* the snapshot they differ in, counted as resync.h does */
+} StateHashHistory;
+
+/* The hash of every field */
+
+uint32_t StateHashAll(const void *state, const StateHashField *fields, int fieldCount);
+
+/* The hash of one field, what StateHashAll mixes in for it */
+
+uint32_t StateHashOne(const void *state, const StateHashField *fields, int field);
+
+/* Brings hash from before to after for the fields in mask, and returns */
+/* it. The fields that changed are put in *changed. */
+
+uint32_t StateHashUpdate(uint32_t hash, const void *before, const void *after,
+	const StateHashField *fields, uint32_t mask, uint32_t *changed);
+
+/* Empties the window, for a session whose frame numbers start over */
+
+void StateHashReset(StateHashHistory *history);
+
+/* Call with each confirmed frame's hash */
+
+void StateHashRecord(StateHashHistory *history, long frame, uint32_t hash, uint32_t changed);
+
+/* The byte a packet carries for frame: 0 if it isn't in the window */
+
+unsigned char StateHashCheckByte(const StateHashHistory *history, long frame);
+
+/* Checks a byte the remote sent for its frame remoteFrame. Returns 0 */
+/* if it doesn't match; 1 if it does or there's nothing to check. */
+
+int StateHashCheck(StateHashHistory *history, long remoteFrame, unsigned char check);
+
+
+#endif	/* __STATEHASH__ */
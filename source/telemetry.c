@@ -0,0 +1,246 @@
+/*****************************************************************
+*
+* telemetry.c
+*
+* Network telemetry from XBGetInfo(), see telemetry.h.
+*
+* XBInfo's counters only ever go up (and wrap), so each sample adds
+* the difference from the previous one to the session.
+*
+*****************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "telemetry.h"
+
+static const char *gCounterNames[kTelemetryCounters] =
+{
+	"recoveries", "bad", "nodata", "redials", "overruns", "parity", "framing"
+};
+
+
+/*
+//
+// This function reads the error counters in XBInfo order.
+//
+*/
+
+static void TelemetryCounters(const XBInfo *info, unsigned short *counters)
+{
+	counters[kTelemetryRecoveries] = info->errorRecoveriesCount;
+	counters[kTelemetryBadPackets] = info->badPacketCount;
+	counters[kTelemetryNoData] = info->noDataCount;
+	counters[kTelemetryRedials] = info->redialCount;
+	counters[kTelemetryOverruns] = info->overrunErrorCount;
+	counters[kTelemetryParity] = info->parityErrorCount;
+	counters[kTelemetryFraming] = info->frameErrorCount;
+}
+
+
+void TelemetryInit(Telemetry *tel)
+{
+	memset(tel, 0, sizeof(*tel));
+}
+
+
+void TelemetryBeginSession(Telemetry *tel, const XBInfo *info, unsigned long tick,
+	int rate, int size)
+{
+	unsigned number;
+
+	number = tel->session.number;
+	memset(&tel->session, 0, sizeof(tel->session));
+
+	tel->session.number = number + 1;
+	tel->session.rate = rate;
+	tel->session.size = size;
+	tel->session.startTick = tick;
+	tel->session.minRoundTrip = 0xFFFF;
+
+	tel->last = *info;
+	tel->lastRoundTrip = info->roundTripLatency;
+	tel->active = 1;
+}
+
+
+int TelemetryEndSession(Telemetry *tel, unsigned long tick)
+{
+	if (!tel->active)
+		return 0;
+
+	tel->session.ticks = tick - tel->session.startTick;
+	tel->active = 0;
+
+	return 1;
+}
+
+
+void TelemetrySampleInfo(Telemetry *tel, const XBInfo *info, XBErr err, unsigned long tick)
+{
+	TelemetrySession *session = &tel->session;
+	TelemetrySample *sample;
+	unsigned short now[kTelemetryCounters], before[kTelemetryCounters];
+	unsigned short roundTrip, jitter, moved;
+	int iii;
+
+	TelemetryCounters(info, now);
+	TelemetryCounters(&tel->last, before);
+
+	moved = 0;
+	for (iii = 0; iii < kTelemetryCounters; iii++)
+	{
+		if (now[iii] != before[iii])
+			moved |= 1 << iii;
+	}
+
+	roundTrip = info->roundTripLatency;
+
+	sample = &tel->ring[tel->sampleCount++ & (kTelemetrySamples - 1)];
+	sample->tick = tick;
+	sample->err = (short)err;
+	sample->roundTrip = roundTrip;
+	sample->queue = info->gameDataQueueSize;
+	sample->counters = moved;
+
+	if (tel->active)
+	{
+		session->exchanges++;
+		session->packets += info->packetCount - tel->last.packetCount;
+		session->bytesRead += info->bytesReadCount - tel->last.bytesReadCount;
+		session->bytesWritten += info->bytesWrittenCount - tel->last.bytesWrittenCount;
+
+		for (iii = 0; iii < kTelemetryCounters; iii++)
+			session->counters[iii] += (unsigned short)(now[iii] - before[iii]);
+
+		jitter = (roundTrip > tel->lastRoundTrip) ? roundTrip - tel->lastRoundTrip
+			: tel->lastRoundTrip - roundTrip;
+
+		if (roundTrip < session->minRoundTrip)
+			session->minRoundTrip = roundTrip;
+		if (roundTrip > session->maxRoundTrip)
+			session->maxRoundTrip = roundTrip;
+		session->roundTripTotal += roundTrip;
+		session->jitterTotal += jitter;
+
+		session->latency[roundTrip < kTelemetryBuckets ? roundTrip : kTelemetryBuckets - 1]++;
+		session->jitter[jitter < kTelemetryBuckets ? jitter : kTelemetryBuckets - 1]++;
+	}
+
+	tel->last = *info;
+	tel->lastRoundTrip = roundTrip;
+}
+
+
+unsigned long TelemetryAverage(unsigned long total, unsigned long count)
+{
+	return count ? total * 100 / count : 0;
+}
+
+
+unsigned TelemetryPermille(unsigned long count, unsigned long exchanges)
+{
+	return exchanges ? (unsigned)(count * 1000 / exchanges) : 0;
+}
+
+
+void TelemetryHistogram(const unsigned long *buckets, char *out)
+{
+	unsigned long most;
+	int iii;
+
+	most = 0;
+	for (iii = 0; iii < kTelemetryBuckets; iii++)
+	{
+		if (buckets[iii] > most)
+			most = buckets[iii];
+	}
+
+	for (iii = 0; iii < kTelemetryBuckets; iii++)
+	{
+		if (buckets[iii] == 0)
+			out[iii] = '.';
+		else
+			out[iii] = '0' + (char)((buckets[iii] * 9 + most - 1) / most);
+	}
+	out[kTelemetryBuckets] = '\0';
+}
+
+
+/*
+//
+// This function writes a histogram's non-empty buckets.
+//
+*/
+
+static void TelemetryDumpBuckets(const char *name, const unsigned long *buckets,
+	TelemetryWriteProc write, void *ref)
+{
+	char line[32 + kTelemetryBuckets * 16];
+	int length, iii;
+
+	length = sprintf(line, "%-8s", name);
+	for (iii = 0; iii < kTelemetryBuckets; iii++)
+	{
+		if (buckets[iii] != 0)
+			length += sprintf(line + length, " %d%s:%lu", iii,
+				(iii == kTelemetryBuckets - 1) ? "+" : "", buckets[iii]);
+	}
+
+	write(line, ref);
+}
+
+
+void TelemetryDump(const Telemetry *tel, TelemetryWriteProc write, void *ref)
+{
+	const TelemetrySession *session = &tel->session;
+	const TelemetrySample *sample;
+	unsigned long first, index, average, jitter;
+	char line[256];
+	unsigned permille;
+	int length, iii;
+
+	average = TelemetryAverage(session->roundTripTotal, session->exchanges);
+	jitter = TelemetryAverage(session->jitterTotal, session->exchanges);
+
+	sprintf(line, "session %u  rate %d  size %d  ticks %lu  exchanges %lu",
+		session->number, session->rate, session->size, session->ticks, session->exchanges);
+	write(line, ref);
+
+	sprintf(line, "round trip min %u  avg %lu.%02lu  max %u  jitter avg %lu.%02lu",
+		session->exchanges ? session->minRoundTrip : 0, average / 100, average % 100,
+		session->maxRoundTrip, jitter / 100, jitter % 100);
+	write(line, ref);
+
+	sprintf(line, "packets %lu  read %lu B  written %lu B",
+		session->packets, session->bytesRead, session->bytesWritten);
+	write(line, ref);
+
+	length = sprintf(line, "errors ");
+	for (iii = 0; iii < kTelemetryCounters; iii++)
+	{
+		permille = TelemetryPermille(session->counters[iii], session->exchanges);
+		length += sprintf(line + length, " %s %lu (%u.%u%%)", gCounterNames[iii],
+			session->counters[iii], permille / 10, permille % 10);
+	}
+	write(line, ref);
+
+	TelemetryDumpBuckets("latency", session->latency, write, ref);
+	TelemetryDumpBuckets("jitter", session->jitter, write, ref);
+
+	/* The session's samples that are still in the ring */
+
+	first = (tel->sampleCount > kTelemetrySamples) ? tel->sampleCount - kTelemetrySamples : 0;
+
+	for (index = first; index < tel->sampleCount; index++)
+	{
+		sample = &tel->ring[index & (kTelemetrySamples - 1)];
+		if (sample->tick - session->startTick > session->ticks)
+			continue;
+
+		sprintf(line, "sample %lu  err %d  rtt %u  queue %u  counters %02x",
+			sample->tick - session->startTick, sample->err, sample->roundTrip,
+			sample->queue, sample->counters);
+		write(line, ref);
+	}
+}
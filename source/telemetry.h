@@ -0,0 +1,116 @@
+/*****************************************************************
+*
+* telemetry.h
+*
+* Network telemetry from XBGetInfo().
+*
+* Every exchange is sampled into a ring buffer and added to the
+* statistics of the session it belongs to: round trip latency and
+* jitter histograms, and how often each error counter moved. A
+* session runs from one XBOpenSession to the next, so each one has
+* a single exchange rate and packet size. When it ends, its summary
+* (and the samples still in the ring) can be written out as text
+* lines, to compare lines and settings with real numbers.
+*
+* Latency is the library's round trip in ticks; jitter is how much
+* it moved from one exchange to the next.
+*
+*****************************************************************/
+
+
+#ifndef __TELEMETRY__
+#define	__TELEMETRY__
+
+#include "XBand/XBANDLIB.H"
+
+#define	kTelemetrySamples	256		/* ring buffer, a power of two */
+#define	kTelemetryBuckets	12		/* ticks; the last one is "or more" */
+
+/* The XBInfo error counters, in XBInfo order */
+
+enum
+{
+	kTelemetryRecoveries,
+	kTelemetryBadPackets,
+	kTelemetryNoData,
+	kTelemetryRedials,
+	kTelemetryOverruns,
+	kTelemetryParity,
+	kTelemetryFraming,
+	kTelemetryCounters
+};
+
+typedef struct
+{
+	unsigned long	tick;
+	short			err;			/* what XBExchangeGameData returned */
+	unsigned short	roundTrip;
+	unsigned short	queue;
+	unsigned short	counters;		/* bit per error counter that moved */
+} TelemetrySample;
+
+typedef struct
+{
+	unsigned		number;			/* sessions since TelemetryInit */
+	int				rate;
+	int				size;
+	unsigned long	startTick;
+	unsigned long	ticks;
+	unsigned long	exchanges;
+
+	unsigned long	packets;
+	unsigned long	bytesRead;
+	unsigned long	bytesWritten;
+	unsigned long	counters[kTelemetryCounters];
+
+	unsigned short	minRoundTrip;
+	unsigned short	maxRoundTrip;
+	unsigned long	roundTripTotal;
+	unsigned long	jitterTotal;
+	unsigned long	latency[kTelemetryBuckets];
+	unsigned long	jitter[kTelemetryBuckets];
+} TelemetrySession;
+
+typedef struct
+{
+	TelemetrySample		ring[kTelemetrySamples];
+	unsigned long		sampleCount;	/* ever taken; the newest is at sampleCount - 1 */
+
+	TelemetrySession	session;
+	int					active;
+	XBInfo				last;			/* counters at the previous sample */
+	unsigned short		lastRoundTrip;
+} Telemetry;
+
+typedef void (*TelemetryWriteProc)(const char *line, void *ref);
+
+void TelemetryInit(Telemetry *tel);
+
+/* Call when a session opens, after ending the one before */
+
+void TelemetryBeginSession(Telemetry *tel, const XBInfo *info, unsigned long tick,
+	int rate, int size);
+
+/* Returns 0 if there was no session */
+
+int TelemetryEndSession(Telemetry *tel, unsigned long tick);
+
+/* Call after every XBExchangeGameData */
+
+void TelemetrySampleInfo(Telemetry *tel, const XBInfo *info, XBErr err, unsigned long tick);
+
+/* Writes a session's summary and its samples still in the ring */
+
+void TelemetryDump(const Telemetry *tel, TelemetryWriteProc write, void *ref);
+
+/* Averages in hundredths of a tick, and rates in tenths of a percent */
+
+unsigned long TelemetryAverage(unsigned long total, unsigned long count);
+unsigned TelemetryPermille(unsigned long count, unsigned long exchanges);
+
+/* A histogram as one digit per bucket, 0-9 scaled to the biggest */
+
+void TelemetryHistogram(const unsigned long *buckets, char *out);
+
+
+#endif	/* __TELEMETRY__ */
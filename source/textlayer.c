@@ -0,0 +1,191 @@
+/*****************************************************************
+*
+* textlayer.c
+*
+* Retained text screen in front of dbgio, see textlayer.h.
+*
+*****************************************************************/
+
+#include <yaul.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "textlayer.h"
+
+/* Unchanged cells a run may carry rather than end; a cursor escape */
+/* costs six to eight bytes */
+
+#define	kTextRunGap		6
+
+
+void TextInit(TextLayer *text)
+{
+	memset(text->cells, ' ', sizeof(text->cells));
+	memset(text->shown, ' ', sizeof(text->shown));
+	text->dirty = 0;
+	text->x = 0;
+	text->y = 0;
+	text->lastBytes = 0;
+	text->lastCells = 0;
+	text->totalBytes = 0;
+}
+
+
+void TextSetCursor(TextLayer *text, int x, int y)
+{
+	text->x = x;
+	text->y = y;
+}
+
+
+/*
+//
+// This function writes one character at the cursor. Writing what
+// is already there doesn't mark the row.
+//
+*/
+
+static void TextPutc(TextLayer *text, char c)
+{
+	if (c == '\n')
+	{
+		text->x = 0;
+		text->y++;
+		return;
+	}
+
+	if (text->x >= kTextColumns)
+	{
+		text->x = 0;
+		text->y++;
+	}
+
+	if (text->x >= 0 && text->y >= 0 && text->y < kTextRows
+		&& text->cells[text->y][text->x] != c)
+	{
+		text->cells[text->y][text->x] = c;
+		text->dirty |= 1UL << text->y;
+	}
+
+	text->x++;
+}
+
+
+/*
+//
+// This function reads an escape sequence after the ESC, and returns
+// what follows it.
+//
+*/
+
+static const char *TextEscape(TextLayer *text, const char *string)
+{
+	int value[2] = { 0, 0 };
+	int count = 0;
+
+	if (*string != '[')
+		return string;
+
+	for (string++; *string != '\0'; string++)
+	{
+		if (*string >= '0' && *string <= '9')
+			value[count] = value[count] * 10 + (*string - '0');
+		else if (*string == ';' && count == 0)
+			count = 1;
+		else
+			break;
+	}
+
+	if (*string == 'H')
+		TextSetCursor(text, value[1], value[0]);
+
+	return (*string != '\0') ? string + 1 : string;
+}
+
+
+void TextPuts(TextLayer *text, const char *string)
+{
+	while (*string != '\0')
+	{
+		if (*string == '\033')
+			string = TextEscape(text, string + 1);
+		else
+			TextPutc(text, *string++);
+	}
+}
+
+
+void TextPrintf(TextLayer *text, const char *format, ...)
+{
+	char buffer[256];
+	va_list args;
+
+	va_start(args, format);
+	vsnprintf(buffer, sizeof(buffer), format, args);
+	va_end(args);
+
+	TextPuts(text, buffer);
+}
+
+
+/*
+//
+// This function sends each run of changed cells as a cursor move
+// and the run's characters, all in one dbgio_puts.
+//
+*/
+
+unsigned TextFlush(TextLayer *text)
+{
+	static char buffer[kTextRows * kTextColumns * 2 + 1];	/* up to 5 cursor escapes a row */
+	unsigned length, cells;
+	int row, column, last, end;
+
+	length = 0;
+	cells = 0;
+
+	for (row = 0; text->dirty != 0 && row < kTextRows; row++)
+	{
+		if (!(text->dirty & (1UL << row)))
+			continue;
+		text->dirty &= ~(1UL << row);
+
+		column = 0;
+		while (column < kTextColumns)
+		{
+			if (text->cells[row][column] == text->shown[row][column])
+			{
+				column++;
+				continue;
+			}
+
+			/* Carry on through short stretches of unchanged cells */
+
+			last = column;
+			for (end = column + 1; end < kTextColumns && end - last <= kTextRunGap; end++)
+			{
+				if (text->cells[row][end] != text->shown[row][end])
+					last = end;
+			}
+
+			length += sprintf(buffer + length, "\033[%d;%dH", row, column);
+			memcpy(buffer + length, &text->cells[row][column], last - column + 1);
+			memcpy(&text->shown[row][column], &text->cells[row][column], last - column + 1);
+			length += last - column + 1;
+			cells += last - column + 1;
+
+			column = last + 1;
+		}
+	}
+
+	buffer[length] = '\0';
+	if (length > 0)
+		dbgio_puts(buffer);
+
+	text->lastBytes = length;
+	text->lastCells = cells;
+	text->totalBytes += length;
+
+	return length;
+}
@@ -0,0 +1,56 @@
+/*****************************************************************
+*
+* textlayer.h
+*
+* Retained text screen in front of dbgio.
+*
+* The game writes its text into a grid of cells every frame, as it
+* always did with dbgio_printf. Only cells that differ from what is
+* already on screen are sent on: TextFlush compares the grid with a
+* copy of what dbgio holds and passes dbgio one cursor move and run
+* of characters for each stretch that changed. A frame that redraws
+* the same text costs nothing past the compare.
+*
+* Positions are the ones in the dbgio cursor escape, ESC[row;colH.
+* Text past the last column wraps to the next row.
+*
+*****************************************************************/
+
+
+#ifndef __TEXTLAYER__
+#define	__TEXTLAYER__
+
+#include <stdint.h>
+
+#define	kTextColumns	40
+#define	kTextRows		28
+
+typedef struct
+{
+	char			cells[kTextRows][kTextColumns];		/* what the game wrote */
+	char			shown[kTextRows][kTextColumns];		/* what dbgio has */
+	uint32_t		dirty;			/* rows written since the last flush */
+	int				x;
+	int				y;
+
+	/* statistics */
+	unsigned		lastBytes;		/* passed to dbgio by the last flush */
+	unsigned		lastCells;
+	unsigned long	totalBytes;
+} TextLayer;
+
+void TextInit(TextLayer *text);
+
+void TextSetCursor(TextLayer *text, int x, int y);
+
+/* Understands '\n' and the ESC[row;colH cursor escape */
+
+void TextPuts(TextLayer *text, const char *string);
+void TextPrintf(TextLayer *text, const char *format, ...) __attribute__ ((format (printf, 2, 3)));
+
+/* Sends the changed cells to dbgio. Returns the bytes it passed on. */
+
+unsigned TextFlush(TextLayer *text);
+
+
+#endif	/* __TEXTLAYER__ */
@@ -0,0 +1,209 @@
+/*****************************************************************
+*
+* bmpread.c
+*
+* Windows BMP reader for nlpack: 1-, 4- and 8-bit with a palette,
+* plain or RLE, and 24-bit.
+*
+*****************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "nlpack.h"
+
+#define	kBmpRGB			0
+#define	kBmpRLE8		1
+#define	kBmpRLE4		2
+
+
+static unsigned BmpGet16(const unsigned char *in)
+{
+	return in[0] | (in[1] << 8);
+}
+
+static unsigned long BmpGet32(const unsigned char *in)
+{
+	return in[0] | (in[1] << 8) | ((unsigned long)in[2] << 16) | ((unsigned long)in[3] << 24);
+}
+
+
+/*
+//
+// This function expands RLE4 or RLE8 into image, whose rows are
+// bottom-up like the file's.
+//
+*/
+
+static const char *BmpReadRLE(const unsigned char *in, const unsigned char *end,
+	NLImage *image, int nibbles)
+{
+	unsigned char *pixels = image->pixels;
+	int x, y, count, value, iii;
+
+	x = 0;
+	y = 0;
+
+	while (in + 2 <= end)
+	{
+		count = *in++;
+		value = *in++;
+
+		if (count > 0)
+		{
+			for (iii = 0; iii < count && x < image->width; iii++, x++)
+			{
+				if (y < image->height)
+					pixels[y * image->width + x] = nibbles
+						? ((iii & 1) ? (value & 15) : (value >> 4)) : value;
+			}
+			continue;
+		}
+
+		switch (value)
+		{
+			case 0:		/* end of line */
+				x = 0;
+				y++;
+				break;
+
+			case 1:		/* end of bitmap */
+				return NULL;
+
+			case 2:		/* delta */
+				if (in + 2 > end)
+					return "truncated RLE delta";
+				x += in[0];
+				y += in[1];
+				in += 2;
+				break;
+
+			default:	/* a literal run, padded to 16 bits */
+				count = nibbles ? (value + 1) / 2 : value;
+				if (in + count > end)
+					return "truncated RLE run";
+
+				for (iii = 0; iii < value && x < image->width; iii++, x++)
+				{
+					if (y < image->height)
+						pixels[y * image->width + x] = nibbles
+							? ((iii & 1) ? (in[iii / 2] & 15) : (in[iii / 2] >> 4)) : in[iii];
+				}
+
+				in += (count + 1) & ~1;
+				break;
+		}
+	}
+
+	return NULL;
+}
+
+
+const char *BmpRead(const unsigned char *data, size_t size, NLImage *image)
+{
+	const unsigned char *info, *row;
+	unsigned long pixelOffset, infoSize, compression, colors;
+	unsigned char *flipped;
+	long height;
+	int bits, topDown, stride, x, y, iii;
+	const char *error;
+
+	if (size < 54 || data[0] != 'B' || data[1] != 'M')
+		return "not a BMP";
+
+	pixelOffset = BmpGet32(data + 10);
+	info = data + 14;
+	infoSize = BmpGet32(info);
+	if (infoSize < 40 || 14 + infoSize > size || pixelOffset > size)
+		return "unsupported BMP header";
+
+	image->width = (int)BmpGet32(info + 4);
+	height = (long)(int)BmpGet32(info + 8);
+	bits = BmpGet16(info + 14);
+	compression = BmpGet32(info + 16);
+	colors = BmpGet32(info + 32);
+
+	topDown = height < 0;
+	image->height = (int)(topDown ? -height : height);
+	if (image->width <= 0 || image->height <= 0 || image->width > 16384 || image->height > 16384)
+		return "bad BMP size";
+
+	if (bits <= 8)
+	{
+		if (colors == 0 || colors > (1UL << bits))
+			colors = 1UL << bits;
+		if (14 + infoSize + colors * 4 > size)
+			return "truncated BMP palette";
+
+		image->colors = (int)colors;
+		for (iii = 0; iii < (int)colors; iii++)
+		{
+			image->palette[iii][0] = info[infoSize + iii * 4 + 2];
+			image->palette[iii][1] = info[infoSize + iii * 4 + 1];
+			image->palette[iii][2] = info[infoSize + iii * 4];
+		}
+	}
+	else if (bits == 24 && compression == kBmpRGB)
+		image->colors = 0;
+	else
+		return "unsupported BMP depth";
+
+	image->transparent = -1;
+	image->pixels = calloc((size_t)image->width * image->height, bits == 24 ? 3 : 1);
+	if (image->pixels == NULL)
+		return "out of memory";
+
+	if (compression == kBmpRLE4 || compression == kBmpRLE8)
+	{
+		if ((compression == kBmpRLE4) != (bits == 4) || topDown)
+			return "bad BMP compression";
+
+		error = BmpReadRLE(data + pixelOffset, data + size, image, compression == kBmpRLE4);
+		if (error != NULL)
+			return error;
+	}
+	else if (compression == kBmpRGB)
+	{
+		stride = ((image->width * bits + 31) / 32) * 4;
+		if (pixelOffset + (unsigned long)stride * image->height > size)
+			return "truncated BMP pixels";
+
+		for (y = 0; y < image->height; y++)
+		{
+			row = data + pixelOffset + (size_t)y * stride;
+
+			for (x = 0; x < image->width; x++)
+			{
+				if (bits == 24)
+				{
+					image->pixels[(y * image->width + x) * 3] = row[x * 3 + 2];
+					image->pixels[(y * image->width + x) * 3 + 1] = row[x * 3 + 1];
+					image->pixels[(y * image->width + x) * 3 + 2] = row[x * 3];
+				}
+				else
+					image->pixels[y * image->width + x] = (row[x * bits / 8]
+						>> (8 - bits - (x * bits) % 8)) & ((1 << bits) - 1);
+			}
+		}
+	}
+	else
+		return "unsupported BMP compression";
+
+	/* Bottom-up rows are turned over */
+
+	if (!topDown)
+	{
+		stride = image->width * (bits == 24 ? 3 : 1);
+		flipped = malloc((size_t)stride * image->height);
+		if (flipped == NULL)
+			return "out of memory";
+
+		for (y = 0; y < image->height; y++)
+			memcpy(flipped + (size_t)y * stride, image->pixels + (size_t)(image->height - 1 - y) * stride, stride);
+
+		free(image->pixels);
+		image->pixels = flipped;
+	}
+
+	return NULL;
+}
@@ -0,0 +1,280 @@
+/*****************************************************************
+*
+* gifread.c
+*
+* GIF87a/89a reader for nlpack. Only the first frame is kept, drawn
+* over the logical screen, which is filled with the transparent
+* color if the frame has one and the background color if not.
+*
+*****************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "nlpack.h"
+
+#define	kGifMaxCodes		4096
+
+
+static unsigned GifGet16(const unsigned char *in)
+{
+	return in[0] | (in[1] << 8);
+}
+
+
+static const unsigned char *GifSkipBlocks(const unsigned char *in, const unsigned char *end)
+{
+	while (in < end && *in != 0)
+		in += 1 + *in;
+
+	return (in < end) ? in + 1 : NULL;
+}
+
+
+/*
+//
+// This function decodes a frame's LZW data into count pixels.
+//
+*/
+
+static const char *GifDecode(const unsigned char *in, const unsigned char *end, int minSize,
+	unsigned char *pixels, long count)
+{
+	static unsigned short prefix[kGifMaxCodes];
+	static unsigned char suffix[kGifMaxCodes];
+	static unsigned char stack[kGifMaxCodes + 1];
+	unsigned long bits;
+	int bitCount, blockLeft, codeSize, clear, next, code, inCode, previous, first, depth;
+	long out;
+
+	if (minSize < 2 || minSize > 11)
+		return "bad GIF code size";
+
+	clear = 1 << minSize;
+	codeSize = minSize + 1;
+	next = clear + 2;
+	previous = -1;
+	first = 0;
+	bits = 0;
+	bitCount = 0;
+	blockLeft = 0;
+	out = 0;
+
+	for (code = 0; code < clear; code++)
+		suffix[code] = (unsigned char)code;
+
+	while (out < count)
+	{
+		while (bitCount < codeSize)
+		{
+			if (blockLeft == 0)
+			{
+				if (in >= end || *in == 0)
+					return NULL;	/* short data: the rest stays background */
+				blockLeft = *in++;
+			}
+			if (in >= end)
+				return "truncated GIF data";
+
+			bits |= (unsigned long)*in++ << bitCount;
+			bitCount += 8;
+			blockLeft--;
+		}
+
+		code = bits & ((1 << codeSize) - 1);
+		bits >>= codeSize;
+		bitCount -= codeSize;
+
+		if (code == clear)
+		{
+			codeSize = minSize + 1;
+			next = clear + 2;
+			previous = -1;
+			continue;
+		}
+
+		if (code == clear + 1)
+			break;
+
+		if (previous < 0)
+		{
+			if (code > clear)
+				return "bad first GIF code";
+
+			pixels[out++] = (unsigned char)code;
+			previous = first = code;
+			continue;
+		}
+
+		/* The code not in the table yet is the previous string */
+		/* and its own first pixel */
+
+		inCode = code;
+		depth = 0;
+
+		if (code >= next)
+		{
+			if (code > next)
+				return "bad GIF code";
+
+			stack[depth++] = (unsigned char)first;
+			code = previous;
+		}
+
+		while (code >= clear)
+		{
+			stack[depth++] = suffix[code];
+			code = prefix[code];
+		}
+
+		first = code;
+		stack[depth++] = (unsigned char)first;
+
+		while (depth > 0 && out < count)
+			pixels[out++] = stack[--depth];
+
+		if (next < kGifMaxCodes)
+		{
+			prefix[next] = (unsigned short)previous;
+			suffix[next] = (unsigned char)first;
+			next++;
+
+			if (next == (1 << codeSize) && codeSize < 12)
+				codeSize++;
+		}
+
+		previous = inCode;
+	}
+
+	return NULL;
+}
+
+
+const char *GifRead(const unsigned char *data, size_t size, NLImage *image)
+{
+	const unsigned char *in, *end, *table;
+	unsigned char *frame;
+	int flags, background, transparent, left, top, width, height, interlaced;
+	int tableColors, row, pass, x, y, iii;
+	static const int passStart[4] = { 0, 4, 2, 1 };
+	static const int passStep[4] = { 8, 8, 4, 2 };
+	const char *error;
+
+	if (size < 13 || (memcmp(data, "GIF87a", 6) != 0 && memcmp(data, "GIF89a", 6) != 0))
+		return "not a GIF";
+
+	end = data + size;
+	image->width = GifGet16(data + 6);
+	image->height = GifGet16(data + 8);
+	flags = data[10];
+	background = data[11];
+	transparent = -1;
+	in = data + 13;
+
+	if (image->width == 0 || image->height == 0)
+		return "bad GIF size";
+
+	image->colors = 0;
+	if (flags & 0x80)
+	{
+		image->colors = 2 << (flags & 7);
+		if (in + image->colors * 3 > end)
+			return "truncated GIF palette";
+
+		memcpy(image->palette, in, image->colors * 3);
+		in += image->colors * 3;
+	}
+
+	while (in < end)
+	{
+		if (*in == 0x3B)
+			return "no GIF frame";
+
+		if (*in == 0x21)
+		{
+			/* The graphic control extension has the transparent color */
+
+			if (in + 3 <= end && in[1] == 0xF9 && in[2] >= 4 && in + 7 <= end && (in[3] & 1))
+				transparent = in[6];
+
+			in = GifSkipBlocks(in + 2, end);
+			if (in == NULL)
+				return "truncated GIF extension";
+			continue;
+		}
+
+		if (*in != 0x2C || in + 10 > end)
+			return "bad GIF block";
+
+		left = GifGet16(in + 1);
+		top = GifGet16(in + 3);
+		width = GifGet16(in + 5);
+		height = GifGet16(in + 7);
+		flags = in[9];
+		interlaced = (flags & 0x40) != 0;
+		in += 10;
+
+		if (flags & 0x80)
+		{
+			tableColors = 2 << (flags & 7);
+			table = in;
+			in += tableColors * 3;
+			if (in > end)
+				return "truncated GIF palette";
+
+			image->colors = tableColors;
+			memcpy(image->palette, table, tableColors * 3);
+		}
+
+		if (image->colors == 0)
+			return "GIF without a palette";
+		if (in >= end)
+			return "truncated GIF frame";
+
+		frame = malloc((size_t)width * height + 1);
+		image->pixels = malloc((size_t)image->width * image->height);
+		if (frame == NULL || image->pixels == NULL)
+			return "out of memory";
+
+		memset(frame, transparent >= 0 ? transparent : background, (size_t)width * height);
+		memset(image->pixels, transparent >= 0 ? transparent : background,
+			(size_t)image->width * image->height);
+
+		error = GifDecode(in + 1, end, in[0], frame, (long)width * height);
+		if (error != NULL)
+		{
+			free(frame);
+			return error;
+		}
+
+		/* Place the frame's rows, in interlaced order if need be */
+
+		row = 0;
+		for (pass = interlaced ? 0 : 3; pass < 4; pass++)
+		{
+			for (y = interlaced ? passStart[pass] : 0; y < height; y += interlaced ? passStep[pass] : 1, row++)
+			{
+				if (top + y >= image->height)
+					continue;
+
+				for (x = 0; x < width && left + x < image->width; x++)
+					image->pixels[(top + y) * image->width + left + x] = frame[row * width + x];
+			}
+		}
+
+		free(frame);
+
+		/* Pixels past the palette are clamped rather than trusted */
+
+		for (iii = 0; iii < image->width * image->height; iii++)
+		{
+			if (image->pixels[iii] >= image->colors)
+				image->pixels[iii] = 0;
+		}
+
+		image->transparent = (transparent < image->colors) ? transparent : -1;
+		return NULL;
+	}
+
+	return "no GIF frame";
+}
@@ -0,0 +1,503 @@
+/*****************************************************************
+*
+* jpegread.c
+*
+* Baseline JPEG reader for nlpack: Huffman, 8-bit, one scan, 1 or 3
+* components with any sampling up to 2x2, and restart markers. It
+* runs at build time, so it is written to be short rather than
+* fast; the IDCT is a plain floating-point one.
+*
+*****************************************************************/
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nlpack.h"
+
+#define	kJpegMaxComponents	3
+
+typedef struct
+{
+	unsigned char	bits[17];		/* codes of each length */
+	unsigned char	values[256];
+	int				minCode[17];
+	int				maxCode[18];
+	int				valueIndex[17];
+} JpegHuffman;
+
+typedef struct
+{
+	int				id;
+	int				h;
+	int				v;
+	int				quant;
+	int				dcTable;
+	int				acTable;
+	int				dc;				/* predictor */
+	int				stride;			/* plane width, in pixels */
+	unsigned char	*plane;
+} JpegComponent;
+
+typedef struct
+{
+	const unsigned char	*in;
+	const unsigned char	*end;
+	unsigned long		bits;
+	int					bitCount;
+
+	unsigned short		quant[4][64];
+	JpegHuffman			huffman[2][4];	/* DC, AC */
+	JpegComponent		components[kJpegMaxComponents];
+	int					componentCount;
+	int					width;
+	int					height;
+	int					maxH;
+	int					maxV;
+	int					restartInterval;
+} JpegDecoder;
+
+static const unsigned char gZigzag[64] =
+{
+	 0,  1,  8, 16,  9,  2,  3, 10, 17, 24, 32, 25, 18, 11,  4,  5,
+	12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13,  6,  7, 14, 21, 28,
+	35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+	58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63
+};
+
+
+static unsigned JpegGet16(const unsigned char *in)
+{
+	return (in[0] << 8) | in[1];
+}
+
+
+static void JpegBuildHuffman(JpegHuffman *table)
+{
+	int code, length, index;
+
+	code = 0;
+	index = 0;
+
+	for (length = 1; length <= 16; length++)
+	{
+		table->valueIndex[length] = index;
+		table->minCode[length] = code;
+		code += table->bits[length];
+		index += table->bits[length];
+		table->maxCode[length] = table->bits[length] ? code - 1 : -1;
+		code <<= 1;
+	}
+
+	table->maxCode[17] = 0x7FFFFFFF;
+}
+
+
+/*
+//
+// Entropy-coded data: bits with the 0xFF00 stuffing taken out. A
+// marker ends the data; past it the bits read as zeros.
+//
+*/
+
+static int JpegBit(JpegDecoder *decoder)
+{
+	int byte;
+
+	if (decoder->bitCount == 0)
+	{
+		byte = 0;
+		if (decoder->in < decoder->end)
+		{
+			byte = *decoder->in;
+
+			if (byte == 0xFF)
+			{
+				if (decoder->in + 1 < decoder->end && decoder->in[1] == 0)
+					decoder->in += 2;
+				else
+					byte = 0;	/* a marker: leave it */
+			}
+			else
+				decoder->in++;
+		}
+
+		decoder->bits = byte;
+		decoder->bitCount = 8;
+	}
+
+	decoder->bitCount--;
+	return (decoder->bits >> decoder->bitCount) & 1;
+}
+
+
+static int JpegBits(JpegDecoder *decoder, int count)
+{
+	int value = 0;
+
+	while (count-- > 0)
+		value = (value << 1) | JpegBit(decoder);
+
+	return value;
+}
+
+
+static int JpegExtend(int value, int count)
+{
+	return (count > 0 && value < (1 << (count - 1))) ? value - (1 << count) + 1 : value;
+}
+
+
+static int JpegDecodeHuffman(JpegDecoder *decoder, const JpegHuffman *table)
+{
+	int code, length;
+
+	code = JpegBit(decoder);
+	for (length = 1; length <= 16; length++)
+	{
+		if (table->maxCode[length] >= 0 && code <= table->maxCode[length])
+			return table->values[table->valueIndex[length] + code - table->minCode[length]];
+		code = (code << 1) | JpegBit(decoder);
+	}
+
+	return -1;
+}
+
+
+static void JpegIdct(const float *in, unsigned char *out, int stride)
+{
+	static float cosines[8][8];
+	static int ready;
+	float temp[64], sum;
+	int x, y, u, v;
+
+	if (!ready)
+	{
+		for (x = 0; x < 8; x++)
+		{
+			for (u = 0; u < 8; u++)
+				cosines[x][u] = (float)((u == 0 ? sqrt(0.5) : 1.0) * cos((2 * x + 1) * u * M_PI / 16));
+		}
+		ready = 1;
+	}
+
+	for (y = 0; y < 8; y++)
+	{
+		for (u = 0; u < 8; u++)
+		{
+			sum = 0;
+			for (v = 0; v < 8; v++)
+				sum += cosines[y][v] * in[v * 8 + u];
+			temp[y * 8 + u] = sum / 2;
+		}
+	}
+
+	for (y = 0; y < 8; y++)
+	{
+		for (x = 0; x < 8; x++)
+		{
+			sum = 0;
+			for (u = 0; u < 8; u++)
+				sum += cosines[x][u] * temp[y * 8 + u];
+
+			sum = sum / 2 + 128.5f;
+			out[y * stride + x] = (unsigned char)(sum < 0 ? 0 : (sum > 255 ? 255 : sum));
+		}
+	}
+}
+
+
+static const char *JpegDecodeBlock(JpegDecoder *decoder, JpegComponent *component,
+	unsigned char *out)
+{
+	const unsigned short *quant = decoder->quant[component->quant];
+	float block[64];
+	int symbol, count, index;
+
+	memset(block, 0, sizeof(block));
+
+	symbol = JpegDecodeHuffman(decoder, &decoder->huffman[0][component->dcTable]);
+	if (symbol < 0)
+		return "bad JPEG DC code";
+
+	component->dc += JpegExtend(JpegBits(decoder, symbol), symbol);
+	block[0] = (float)(component->dc * quant[0]);
+
+	for (index = 1; index < 64; index++)
+	{
+		symbol = JpegDecodeHuffman(decoder, &decoder->huffman[1][component->acTable]);
+		if (symbol < 0)
+			return "bad JPEG AC code";
+		if (symbol == 0)
+			break;
+
+		index += symbol >> 4;
+		count = symbol & 15;
+		if (index > 63)
+			return "bad JPEG run";
+
+		block[gZigzag[index]] = (float)(JpegExtend(JpegBits(decoder, count), count) * quant[index]);
+	}
+
+	JpegIdct(block, out, component->stride);
+	return NULL;
+}
+
+
+static const char *JpegDecodeScan(JpegDecoder *decoder)
+{
+	JpegComponent *component;
+	int mcuWidth, mcuHeight, mcusAcross, mcusDown, mcu, mx, my, bx, by, iii;
+	const char *error;
+
+	mcuWidth = 8 * decoder->maxH;
+	mcuHeight = 8 * decoder->maxV;
+	mcusAcross = (decoder->width + mcuWidth - 1) / mcuWidth;
+	mcusDown = (decoder->height + mcuHeight - 1) / mcuHeight;
+
+	for (iii = 0; iii < decoder->componentCount; iii++)
+	{
+		component = &decoder->components[iii];
+		component->stride = mcusAcross * 8 * component->h;
+		component->plane = calloc((size_t)component->stride * mcusDown * 8 * component->v, 1);
+		if (component->plane == NULL)
+			return "out of memory";
+	}
+
+	for (mcu = 0; mcu < mcusAcross * mcusDown; mcu++)
+	{
+		if (decoder->restartInterval && mcu > 0 && mcu % decoder->restartInterval == 0)
+		{
+			/* Byte-align and step over the RSTn marker */
+
+			decoder->bitCount = 0;
+			while (decoder->in + 1 < decoder->end
+				&& !(decoder->in[0] == 0xFF && decoder->in[1] >= 0xD0 && decoder->in[1] <= 0xD7))
+				decoder->in++;
+			decoder->in += 2;
+
+			for (iii = 0; iii < decoder->componentCount; iii++)
+				decoder->components[iii].dc = 0;
+		}
+
+		mx = mcu % mcusAcross;
+		my = mcu / mcusAcross;
+
+		for (iii = 0; iii < decoder->componentCount; iii++)
+		{
+			component = &decoder->components[iii];
+
+			for (by = 0; by < component->v; by++)
+			{
+				for (bx = 0; bx < component->h; bx++)
+				{
+					error = JpegDecodeBlock(decoder, component, component->plane
+						+ ((size_t)(my * component->v + by) * 8) * component->stride
+						+ (mx * component->h + bx) * 8);
+					if (error != NULL)
+						return error;
+				}
+			}
+		}
+	}
+
+	return NULL;
+}
+
+
+/*
+//
+// This function turns the planes into RGB, upsampling the chroma
+// by repeating it.
+//
+*/
+
+static void JpegConvert(JpegDecoder *decoder, NLImage *image)
+{
+	const JpegComponent *components = decoder->components;
+	unsigned char *out;
+	float luma, cb, cr, value[3];
+	int x, y, iii;
+
+	for (y = 0; y < decoder->height; y++)
+	{
+		for (x = 0; x < decoder->width; x++)
+		{
+			out = image->pixels + ((size_t)y * decoder->width + x) * 3;
+			luma = components[0].plane[(y * components[0].v / decoder->maxV) * components[0].stride
+				+ x * components[0].h / decoder->maxH];
+
+			if (decoder->componentCount == 1)
+			{
+				out[0] = out[1] = out[2] = (unsigned char)luma;
+				continue;
+			}
+
+			cb = components[1].plane[(y * components[1].v / decoder->maxV) * components[1].stride
+				+ x * components[1].h / decoder->maxH] - 128.0f;
+			cr = components[2].plane[(y * components[2].v / decoder->maxV) * components[2].stride
+				+ x * components[2].h / decoder->maxH] - 128.0f;
+
+			value[0] = luma + 1.402f * cr;
+			value[1] = luma - 0.344136f * cb - 0.714136f * cr;
+			value[2] = luma + 1.772f * cb;
+
+			for (iii = 0; iii < 3; iii++)
+				out[iii] = (unsigned char)(value[iii] < 0 ? 0 : (value[iii] > 255 ? 255 : value[iii] + 0.5f));
+		}
+	}
+}
+
+
+const char *JpegRead(const unsigned char *data, size_t size, NLImage *image)
+{
+	static JpegDecoder decoder;
+	const unsigned char *in, *end, *segment;
+	JpegHuffman *table;
+	int marker, length, count, iii, jjj, id;
+	const char *error;
+
+	if (size < 4 || data[0] != 0xFF || data[1] != 0xD8)
+		return "not a JPEG";
+
+	memset(&decoder, 0, sizeof(decoder));
+	in = data + 2;
+	end = data + size;
+
+	while (in + 4 <= end)
+	{
+		if (in[0] != 0xFF)
+			return "bad JPEG marker";
+
+		marker = in[1];
+		if (marker == 0xFF)
+		{
+			in++;
+			continue;
+		}
+
+		length = JpegGet16(in + 2);
+		segment = in + 4;
+		if (in + 2 + length > end)
+			return "truncated JPEG segment";
+
+		switch (marker)
+		{
+			case 0xC0:		/* SOF0, SOF1: baseline and extended Huffman */
+			case 0xC1:
+				if (segment[0] != 8)
+					return "JPEG isn't 8-bit";
+
+				decoder.height = JpegGet16(segment + 1);
+				decoder.width = JpegGet16(segment + 3);
+				decoder.componentCount = segment[5];
+				if (decoder.componentCount != 1 && decoder.componentCount != kJpegMaxComponents)
+					return "unsupported JPEG components";
+
+				for (iii = 0; iii < decoder.componentCount; iii++)
+				{
+					decoder.components[iii].id = segment[6 + iii * 3];
+					decoder.components[iii].h = segment[7 + iii * 3] >> 4;
+					decoder.components[iii].v = segment[7 + iii * 3] & 15;
+					decoder.components[iii].quant = segment[8 + iii * 3] & 3;
+
+					if (decoder.components[iii].h < 1 || decoder.components[iii].h > 2
+						|| decoder.components[iii].v < 1 || decoder.components[iii].v > 2)
+						return "unsupported JPEG sampling";
+
+					if (decoder.components[iii].h > decoder.maxH)
+						decoder.maxH = decoder.components[iii].h;
+					if (decoder.components[iii].v > decoder.maxV)
+						decoder.maxV = decoder.components[iii].v;
+				}
+				break;
+
+			case 0xC2:
+			case 0xC3:
+				return "progressive or lossless JPEG";
+
+			case 0xC4:		/* DHT */
+				for (iii = 0; iii < length - 2; )
+				{
+					table = &decoder.huffman[(segment[iii] >> 4) & 1][segment[iii] & 3];
+					count = 0;
+					for (jjj = 1; jjj <= 16; jjj++)
+					{
+						table->bits[jjj] = segment[iii + jjj];
+						count += table->bits[jjj];
+					}
+					if (count > 256 || iii + 17 + count > length - 2)
+						return "bad JPEG Huffman table";
+
+					memcpy(table->values, segment + iii + 17, count);
+					JpegBuildHuffman(table);
+					iii += 17 + count;
+				}
+				break;
+
+			case 0xDB:		/* DQT */
+				for (iii = 0; iii < length - 2; )
+				{
+					id = segment[iii] & 3;
+					for (jjj = 0; jjj < 64; jjj++)
+					{
+						decoder.quant[id][jjj] = (segment[iii] >> 4)
+							? JpegGet16(segment + iii + 1 + jjj * 2) : segment[iii + 1 + jjj];
+					}
+					iii += 1 + ((segment[iii] >> 4) ? 128 : 64);
+				}
+				break;
+
+			case 0xDD:		/* DRI */
+				decoder.restartInterval = JpegGet16(segment);
+				break;
+
+			case 0xDA:		/* SOS */
+				if (decoder.componentCount == 0)
+					return "JPEG scan before the frame";
+				if (segment[0] != decoder.componentCount)
+					return "multi-scan JPEG";
+
+				for (iii = 0; iii < segment[0]; iii++)
+				{
+					for (jjj = 0; jjj < decoder.componentCount; jjj++)
+					{
+						if (decoder.components[jjj].id == segment[1 + iii * 2])
+						{
+							decoder.components[jjj].dcTable = segment[2 + iii * 2] >> 4;
+							decoder.components[jjj].acTable = segment[2 + iii * 2] & 3;
+						}
+					}
+				}
+
+				decoder.in = in + 2 + length;
+				decoder.end = end;
+
+				error = JpegDecodeScan(&decoder);
+				if (error == NULL)
+				{
+					image->width = decoder.width;
+					image->height = decoder.height;
+					image->colors = 0;
+					image->transparent = -1;
+					image->pixels = malloc((size_t)decoder.width * decoder.height * 3);
+					if (image->pixels == NULL)
+						error = "out of memory";
+					else
+						JpegConvert(&decoder, image);
+				}
+
+				for (iii = 0; iii < decoder.componentCount; iii++)
+					free(decoder.components[iii].plane);
+
+				return error;
+
+			default:		/* APPn, COM and the rest */
+				break;
+		}
+
+		in += 2 + length;
+	}
+
+	return "no JPEG scan";
+}
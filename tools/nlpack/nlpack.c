@@ -0,0 +1,602 @@
+/*****************************************************************
+*
+* nlpack.c
+*
+* Converts a directory of PC assets into the Saturn asset archive
+* described in source/pack.h, at build time:
+*
+*	GIF, BMP, JPE	palette images as 4- or 8-bit indices with an
+*					RGB1555 palette, JPEGs as RGB1555
+*	WAV				4-bit ADPCM for the sound driver, or signed PCM for
+*					the SCSP with -p
+*	WDT, HTM, TXT	copied as they are
+*
+* Anything else (the XBAND OS's own EXE and BIN files) is left out.
+*
+*	nlpack -o ARCHIVE [-c PATTERN]... [-a ALIGN] [-p] [-v] DIRECTORY...
+*
+*	-c	images whose names match PATTERN are laid out as 8x8 VDP2
+*		cells rather than rows
+*	-a	align palettes and data to ALIGN bytes (kPackAlign); 2048
+*		puts each on its own CD sector
+*	-p	sounds are left as PCM rather than ADPCM (m68k/adpcm.h)
+*	-v	prints every asset
+*
+*****************************************************************/
+
+#include <ctype.h>
+#include <dirent.h>
+#include <fnmatch.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "adpcm.h"
+#include "nlpack.h"
+#include "pack.h"
+
+#define	kMaxAssets			1024
+#define	kMaxPatterns		16
+
+typedef struct
+{
+	char			path[1024];
+	PackAsset		asset;
+	unsigned char	*palette;
+	unsigned char	*data;
+} Entry;
+
+static Entry gEntries[kMaxAssets];
+static int gEntryCount;
+static const char *gCellPatterns[kMaxPatterns];
+static int gCellPatternCount;
+static unsigned long gAlign = kPackAlign;
+static int gPCM;
+static int gVerbose;
+
+
+static void Put16(unsigned char *out, unsigned value)
+{
+	out[0] = (unsigned char)(value >> 8);
+	out[1] = (unsigned char)value;
+}
+
+static void Put32(unsigned char *out, unsigned long value)
+{
+	out[0] = (unsigned char)(value >> 24);
+	out[1] = (unsigned char)(value >> 16);
+	out[2] = (unsigned char)(value >> 8);
+	out[3] = (unsigned char)value;
+}
+
+
+static unsigned char *ReadFile(const char *path, size_t *size)
+{
+	unsigned char *data;
+	FILE *file;
+	long length;
+
+	file = fopen(path, "rb");
+	if (file == NULL)
+		return NULL;
+
+	fseek(file, 0, SEEK_END);
+	length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	data = malloc(length > 0 ? (size_t)length : 1);
+	if (data != NULL && fread(data, 1, (size_t)length, file) != (size_t)length)
+	{
+		free(data);
+		data = NULL;
+	}
+
+	fclose(file);
+	*size = (size_t)length;
+	return data;
+}
+
+
+static const char *Extension(const char *name)
+{
+	const char *dot = strrchr(name, '.');
+
+	return dot ? dot + 1 : "";
+}
+
+
+static int IsCells(const char *name)
+{
+	int iii;
+
+	for (iii = 0; iii < gCellPatternCount; iii++)
+	{
+		if (fnmatch(gCellPatterns[iii], name, 0) == 0)
+			return 1;
+	}
+
+	return 0;
+}
+
+
+/*
+//
+// Images.
+//
+*/
+
+static unsigned short RGB1555(const unsigned char *rgb)
+{
+	return (unsigned short)(0x8000 | ((rgb[2] >> 3) << 10) | ((rgb[1] >> 3) << 5) | (rgb[0] >> 3));
+}
+
+
+/*
+//
+// This function stores a pixel at (x, y) of an image laid out as
+// asset says: rows of rate bytes, or 8x8 cells a row of cells at a
+// time.
+//
+*/
+
+static void PutPixel(const PackAsset *asset, unsigned char *data, int x, int y, unsigned value)
+{
+	int bits, cellBytes, cellsAcross;
+	unsigned long offset;
+
+	bits = (asset->format == kPackIndexed4) ? 4 : (asset->format == kPackIndexed8) ? 8 : 16;
+
+	if (asset->layout == kPackCells)
+	{
+		cellBytes = 64 * bits / 8;
+		cellsAcross = (asset->width + 7) / 8;
+		offset = ((unsigned long)(y / 8) * cellsAcross + x / 8) * cellBytes
+			+ ((y & 7) * 8 + (x & 7)) * bits / 8;
+	}
+	else
+		offset = (unsigned long)y * asset->rate + (unsigned long)x * bits / 8;
+
+	switch (bits)
+	{
+		case 4:
+			if (x & 1)
+				data[offset] = (data[offset] & 0xF0) | (value & 15);
+			else
+				data[offset] = (data[offset] & 0x0F) | (value << 4);
+			break;
+
+		case 8:
+			data[offset] = (unsigned char)value;
+			break;
+
+		default:
+			Put16(data + offset, value);
+			break;
+	}
+}
+
+
+static const char *ConvertImage(NLImage *image, Entry *entry)
+{
+	PackAsset *asset = &entry->asset;
+	unsigned char swap[3];
+	int maxUsed, shift, bits, paddedWidth, paddedHeight, colors, x, y, iii;
+	unsigned value;
+
+	asset->type = kPackImage;
+	asset->layout = IsCells(asset->name) ? kPackCells : kPackRows;
+	asset->width = (unsigned short)image->width;
+	asset->height = (unsigned short)image->height;
+	paddedWidth = (image->width + 7) & ~7;
+	paddedHeight = (asset->layout == kPackCells) ? (image->height + 7) & ~7 : image->height;
+	shift = 0;
+
+	if (image->colors == 0)
+		asset->format = kPackRGB1555;
+	else
+	{
+		/* Pixel code 0 is transparent to the VDPs. The image's */
+		/* transparent color moves there; without one, the colors */
+		/* move up one, if they fit in the same depth. */
+
+		if (image->transparent >= 0)
+		{
+			memcpy(swap, image->palette[0], 3);
+			memcpy(image->palette[0], image->palette[image->transparent], 3);
+			memcpy(image->palette[image->transparent], swap, 3);
+
+			for (iii = 0; iii < image->width * image->height; iii++)
+			{
+				if (image->pixels[iii] == image->transparent)
+					image->pixels[iii] = 0;
+				else if (image->pixels[iii] == 0)
+					image->pixels[iii] = (unsigned char)image->transparent;
+			}
+		}
+
+		/* The depth comes after the swap, which can move color 0's */
+		/* pixels up to the transparent color's index */
+
+		maxUsed = 0;
+		for (iii = 0; iii < image->width * image->height; iii++)
+		{
+			if (image->pixels[iii] > maxUsed)
+				maxUsed = image->pixels[iii];
+		}
+
+		bits = (maxUsed < 16) ? 4 : 8;
+
+		if (image->transparent >= 0)
+			asset->flags |= kPackTransparent;
+		else if (maxUsed + 1 < (1 << bits))
+			shift = 1;
+		else
+			asset->flags |= kPackZeroOpaque;
+
+		asset->format = (bits == 4) ? kPackIndexed4 : kPackIndexed8;
+
+		colors = image->colors + shift;
+		if (colors > (1 << bits))
+			colors = 1 << bits;
+
+		asset->paletteColors = (unsigned short)colors;
+		entry->palette = calloc(colors, 2);
+		if (entry->palette == NULL)
+			return "out of memory";
+
+		for (iii = shift; iii < colors; iii++)
+			Put16(entry->palette + iii * 2, RGB1555(image->palette[iii - shift]));
+	}
+
+	bits = (asset->format == kPackIndexed4) ? 4 : (asset->format == kPackIndexed8) ? 8 : 16;
+	asset->rate = (unsigned long)paddedWidth * bits / 8;
+	asset->dataSize = asset->rate * paddedHeight;
+	entry->data = calloc(asset->dataSize, 1);
+	if (entry->data == NULL)
+		return "out of memory";
+
+	for (y = 0; y < image->height; y++)
+	{
+		for (x = 0; x < image->width; x++)
+		{
+			if (asset->format == kPackRGB1555)
+				value = RGB1555(image->pixels + ((size_t)y * image->width + x) * 3);
+			else
+				value = image->pixels[(size_t)y * image->width + x] + shift;
+
+			PutPixel(asset, entry->data, x, y, value);
+		}
+	}
+
+	free(image->pixels);
+	return NULL;
+}
+
+
+static const char *ConvertSound(NLSound *sound, Entry *entry)
+{
+	PackAsset *asset = &entry->asset;
+	unsigned long iii;
+
+	asset->type = kPackSound;
+	asset->rate = sound->rate;
+
+	if (!gPCM)
+	{
+		/* To 16 bits, then a quarter of that */
+
+		if (sound->bits == 8)
+		{
+			for (iii = 0; iii < sound->frames; iii++)
+				sound->samples[iii] = (short)(sound->samples[iii] * 256);
+		}
+
+		asset->format = kPackADPCM4;
+		entry->data = malloc(AdpcmBytes(sound->frames) + 1);
+		if (entry->data == NULL)
+			return "out of memory";
+
+		asset->dataSize = AdpcmEncode(sound->samples, sound->frames, entry->data);
+		free(sound->samples);
+		return NULL;
+	}
+
+	asset->format = (sound->bits == 8) ? kPackPCM8 : kPackPCM16;
+	asset->dataSize = sound->frames * (sound->bits / 8);
+	entry->data = malloc(asset->dataSize + 1);
+	if (entry->data == NULL)
+		return "out of memory";
+
+	for (iii = 0; iii < sound->frames; iii++)
+	{
+		if (sound->bits == 8)
+			entry->data[iii] = (unsigned char)(signed char)sound->samples[iii];
+		else
+			Put16(entry->data + iii * 2, (unsigned short)sound->samples[iii]);
+	}
+
+	free(sound->samples);
+	return NULL;
+}
+
+
+/*
+//
+// This function converts one file into its entry. Returns 0 for a
+// file that isn't packed.
+//
+*/
+
+static int Convert(Entry *entry)
+{
+	const char *extension = Extension(entry->asset.name);
+	unsigned char *data;
+	const char *error;
+	NLImage image;
+	NLSound sound;
+	size_t size;
+
+	if (strcmp(extension, "EXE") == 0 || strcmp(extension, "BIN") == 0)
+		return 0;
+
+	data = ReadFile(entry->path, &size);
+	if (data == NULL)
+	{
+		fprintf(stderr, "nlpack: can't read %s\n", entry->path);
+		exit(1);
+	}
+
+	memset(&image, 0, sizeof(image));
+	memset(&sound, 0, sizeof(sound));
+
+	if (strcmp(extension, "GIF") == 0)
+		error = GifRead(data, size, &image);
+	else if (strcmp(extension, "BMP") == 0)
+		error = BmpRead(data, size, &image);
+	else if (strcmp(extension, "JPE") == 0 || strcmp(extension, "JPG") == 0)
+		error = JpegRead(data, size, &image);
+	else if (strcmp(extension, "WAV") == 0)
+	{
+		error = WavRead(data, size, &sound);
+		if (error == NULL)
+			error = ConvertSound(&sound, entry);
+	}
+	else
+	{
+		entry->asset.type = kPackRaw;
+		entry->asset.format = kPackBytes;
+		entry->asset.dataSize = size;
+		entry->data = data;
+		return 1;
+	}
+
+	if (error == NULL && image.pixels != NULL)
+		error = ConvertImage(&image, entry);
+
+	if (error != NULL)
+	{
+		fprintf(stderr, "nlpack: %s: %s\n", entry->path, error);
+		exit(1);
+	}
+
+	free(data);
+	return 1;
+}
+
+
+static void AddDirectory(const char *directory)
+{
+	char path[1024];
+	struct dirent *item;
+	struct stat info;
+	Entry *entry;
+	DIR *dir;
+	int iii;
+
+	dir = opendir(directory);
+	if (dir == NULL)
+	{
+		fprintf(stderr, "nlpack: can't open %s\n", directory);
+		exit(1);
+	}
+
+	while ((item = readdir(dir)) != NULL)
+	{
+		if (item->d_name[0] == '.')
+			continue;
+
+		/* Subdirectories are only packed if they're named too */
+
+		snprintf(path, sizeof(path), "%s/%s", directory, item->d_name);
+		if (stat(path, &info) != 0 || !S_ISREG(info.st_mode))
+			continue;
+
+		if (strlen(item->d_name) >= kPackNameSize)
+		{
+			fprintf(stderr, "nlpack: %s/%s: name too long\n", directory, item->d_name);
+			exit(1);
+		}
+
+		if (gEntryCount == kMaxAssets)
+		{
+			fprintf(stderr, "nlpack: more than %d assets\n", kMaxAssets);
+			exit(1);
+		}
+
+		entry = &gEntries[gEntryCount];
+		memset(entry, 0, sizeof(*entry));
+		strcpy(entry->path, path);
+
+		for (iii = 0; item->d_name[iii]; iii++)
+			entry->asset.name[iii] = (char)toupper((unsigned char)item->d_name[iii]);
+
+		for (iii = 0; iii < gEntryCount; iii++)
+		{
+			if (strcmp(gEntries[iii].asset.name, entry->asset.name) == 0)
+			{
+				fprintf(stderr, "nlpack: %s is in more than one directory\n", entry->asset.name);
+				exit(1);
+			}
+		}
+
+		if (Convert(entry))
+			gEntryCount++;
+	}
+
+	closedir(dir);
+}
+
+
+static int CompareEntries(const void *a, const void *b)
+{
+	return strncmp(((const Entry *)a)->asset.name, ((const Entry *)b)->asset.name, kPackNameSize);
+}
+
+
+static unsigned long Align(unsigned long offset)
+{
+	return (offset + gAlign - 1) / gAlign * gAlign;
+}
+
+
+/*
+//
+// This function lays the blocks out after the index and writes the
+// archive.
+//
+*/
+
+static void WriteArchive(const char *path)
+{
+	static const unsigned char zeros[2048];
+	unsigned char header[kPackHeaderSize], record[kPackEntrySize];
+	unsigned long offset, position;
+	PackAsset *asset;
+	FILE *file;
+	int iii;
+
+	qsort(gEntries, gEntryCount, sizeof(Entry), CompareEntries);
+
+	offset = kPackHeaderSize + (unsigned long)gEntryCount * kPackEntrySize;
+	for (iii = 0; iii < gEntryCount; iii++)
+	{
+		asset = &gEntries[iii].asset;
+
+		if (asset->paletteColors > 0)
+		{
+			offset = Align(offset);
+			asset->paletteOffset = offset;
+			offset += asset->paletteColors * 2;
+		}
+
+		offset = Align(offset);
+		asset->dataOffset = offset;
+		asset->checksum = PackChecksum(gEntries[iii].data, asset->dataSize);
+		offset += asset->dataSize;
+	}
+
+	file = fopen(path, "wb");
+	if (file == NULL)
+	{
+		fprintf(stderr, "nlpack: can't write %s\n", path);
+		exit(1);
+	}
+
+	memcpy(header, kPackMagic, 4);
+	Put16(header + 4, kPackVersion);
+	Put16(header + 6, (unsigned)gEntryCount);
+	Put32(header + 8, offset);
+	Put32(header + 12, gAlign);
+	fwrite(header, 1, sizeof(header), file);
+
+	for (iii = 0; iii < gEntryCount; iii++)
+	{
+		asset = &gEntries[iii].asset;
+
+		memset(record, 0, sizeof(record));
+		memcpy(record, asset->name, kPackNameSize);
+		record[16] = asset->type;
+		record[17] = asset->format;
+		record[18] = asset->layout;
+		record[19] = asset->flags;
+		Put16(record + 20, asset->width);
+		Put16(record + 22, asset->height);
+		Put32(record + 24, asset->rate);
+		Put32(record + 28, asset->paletteOffset);
+		Put16(record + 32, asset->paletteColors);
+		Put32(record + 36, asset->dataOffset);
+		Put32(record + 40, asset->dataSize);
+		Put32(record + 44, asset->checksum);
+		fwrite(record, 1, sizeof(record), file);
+	}
+
+	position = kPackHeaderSize + (unsigned long)gEntryCount * kPackEntrySize;
+	for (iii = 0; iii < gEntryCount; iii++)
+	{
+		asset = &gEntries[iii].asset;
+
+		if (asset->paletteColors > 0)
+		{
+			fwrite(zeros, 1, asset->paletteOffset - position, file);
+			fwrite(gEntries[iii].palette, 2, asset->paletteColors, file);
+			position = asset->paletteOffset + asset->paletteColors * 2;
+		}
+
+		fwrite(zeros, 1, asset->dataOffset - position, file);
+		fwrite(gEntries[iii].data, 1, asset->dataSize, file);
+		position = asset->dataOffset + asset->dataSize;
+
+		if (gVerbose)
+			printf("%-12s type %u format %u layout %u flags %u %4ux%-4u %6lu B at %08lx\n",
+				asset->name, asset->type, asset->format, asset->layout, asset->flags,
+				asset->width, asset->height, asset->dataSize, asset->dataOffset);
+	}
+
+	if (fclose(file) != 0)
+	{
+		fprintf(stderr, "nlpack: can't write %s\n", path);
+		exit(1);
+	}
+
+	printf("nlpack: %d assets, %lu bytes\n", gEntryCount, position);
+}
+
+
+int main(int argc, char **argv)
+{
+	const char *output;
+	int iii;
+
+	output = NULL;
+
+	for (iii = 1; iii < argc && argv[iii][0] == '-'; iii++)
+	{
+		if (strcmp(argv[iii], "-o") == 0 && iii + 1 < argc)
+			output = argv[++iii];
+		else if (strcmp(argv[iii], "-c") == 0 && iii + 1 < argc && gCellPatternCount < kMaxPatterns)
+			gCellPatterns[gCellPatternCount++] = argv[++iii];
+		else if (strcmp(argv[iii], "-a") == 0 && iii + 1 < argc)
+			gAlign = strtoul(argv[++iii], NULL, 0);
+		else if (strcmp(argv[iii], "-p") == 0)
+			gPCM = 1;
+		else if (strcmp(argv[iii], "-v") == 0)
+			gVerbose = 1;
+		else
+			break;
+	}
+
+	if (output == NULL || iii == argc || gAlign == 0 || gAlign > 2048)
+	{
+		fprintf(stderr, "usage: nlpack -o ARCHIVE [-c PATTERN]... [-a ALIGN] [-p] [-v] DIRECTORY...\n");
+		return 2;
+	}
+
+	AdpcmInit();
+
+	for (; iii < argc; iii++)
+		AddDirectory(argv[iii]);
+
+	WriteArchive(output);
+	return 0;
+}
@@ -0,0 +1,44 @@
+/*****************************************************************
+*
+* nlpack.h
+*
+* The readers nlpack.c converts assets with. Each one takes a whole
+* file in memory and returns NULL, or what was wrong with it.
+*
+*****************************************************************/
+
+
+#ifndef __NLPACK__
+#define	__NLPACK__
+
+#include <stddef.h>
+
+/* A decoded image: palette indices, or RGB when colors is 0 */
+
+typedef struct
+{
+	int				width;
+	int				height;
+	int				colors;			/* palette entries, 0 for RGB */
+	int				transparent;	/* palette index, -1 for none */
+	unsigned char	palette[256][3];
+	unsigned char	*pixels;		/* a byte per pixel, or 3 for RGB */
+} NLImage;
+
+/* A decoded sound: signed samples, one channel */
+
+typedef struct
+{
+	unsigned long	rate;
+	int				bits;			/* 8 or 16 */
+	unsigned long	frames;
+	short			*samples;
+} NLSound;
+
+const char *BmpRead(const unsigned char *data, size_t size, NLImage *image);
+const char *GifRead(const unsigned char *data, size_t size, NLImage *image);
+const char *JpegRead(const unsigned char *data, size_t size, NLImage *image);
+const char *WavRead(const unsigned char *data, size_t size, NLSound *sound);
+
+
+#endif	/* __NLPACK__ */
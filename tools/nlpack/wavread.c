@@ -0,0 +1,90 @@
+/*****************************************************************
+*
+* wavread.c
+*
+* RIFF WAVE reader for nlpack: PCM, 8 or 16 bits, mono or stereo
+* (mixed down, since the UI sounds are played on one slot).
+*
+*****************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "nlpack.h"
+
+#define	kWavPCM			1
+
+
+static unsigned WavGet16(const unsigned char *in)
+{
+	return in[0] | (in[1] << 8);
+}
+
+static unsigned long WavGet32(const unsigned char *in)
+{
+	return in[0] | (in[1] << 8) | ((unsigned long)in[2] << 16) | ((unsigned long)in[3] << 24);
+}
+
+
+const char *WavRead(const unsigned char *data, size_t size, NLSound *sound)
+{
+	const unsigned char *in, *end, *format, *samples;
+	unsigned long chunkSize, sampleBytes, frame;
+	int channels, bytes, channel, sum;
+
+	if (size < 12 || memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0)
+		return "not a WAVE";
+
+	in = data + 12;
+	end = data + size;
+	format = NULL;
+	samples = NULL;
+	sampleBytes = 0;
+
+	while (in + 8 <= end)
+	{
+		chunkSize = WavGet32(in + 4);
+		if (chunkSize > (unsigned long)(end - in - 8))
+			chunkSize = (unsigned long)(end - in - 8);	/* some writers overstate the last chunk */
+
+		if (memcmp(in, "fmt ", 4) == 0 && chunkSize >= 16)
+			format = in + 8;
+		else if (memcmp(in, "data", 4) == 0)
+		{
+			samples = in + 8;
+			sampleBytes = chunkSize;
+		}
+
+		in += 8 + ((chunkSize + 1) & ~1UL);
+	}
+
+	if (format == NULL || samples == NULL)
+		return "WAVE without fmt or data";
+
+	channels = WavGet16(format + 2);
+	sound->rate = WavGet32(format + 4);
+	sound->bits = WavGet16(format + 14);
+
+	if (WavGet16(format) != kWavPCM || channels < 1 || channels > 2
+		|| (sound->bits != 8 && sound->bits != 16))
+		return "unsupported WAVE format";
+
+	bytes = sound->bits / 8;
+	sound->frames = sampleBytes / (bytes * channels);
+	sound->samples = malloc((sound->frames + 1) * sizeof(short));
+	if (sound->samples == NULL)
+		return "out of memory";
+
+	for (frame = 0; frame < sound->frames; frame++)
+	{
+		sum = 0;
+		for (channel = 0; channel < channels; channel++)
+		{
+			in = samples + (frame * channels + channel) * bytes;
+			sum += (bytes == 1) ? (in[0] - 128) : (short)WavGet16(in);
+		}
+		sound->samples[frame] = (short)(sum / channels);
+	}
+
+	return NULL;
+}
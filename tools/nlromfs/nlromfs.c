@@ -0,0 +1,433 @@
+/*****************************************************************
+*
+* nlromfs.c
+*
+* Builds the compressed romdisk image described in source/romdisk.h
+* out of a directory, in place of genromfs:
+*
+*	nlromfs -d DIRECTORY -f IMAGE [-b SHIFT] [-v]
+*
+*	-b	blocks of 1 << SHIFT bytes, 9 to 15; smaller blocks read
+*		faster at random, bigger ones compress better
+*	-v	prints every file
+*
+* The compressor is greedy with a hash chain, which is plenty for a
+* build step; the format's work is all on the decoding side. Every
+* block is decoded again with the game's own RomdiskDecode before it
+* is written, so a bad image fails the build rather than the game.
+*
+*****************************************************************/
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "romdisk.h"
+
+#define	kMaxFiles			4096
+#define	kHashBits			14
+#define	kChainSteps			64
+#define	kMaxOffset			65535
+
+typedef struct
+{
+	char			path[kRomdiskPathSize];
+	unsigned long	size;
+	unsigned long	firstBlock;
+	unsigned char	*data;
+} File;
+
+static File gFiles[kMaxFiles];
+static int gFileCount;
+static unsigned gBlockShift = kRomdiskBlockShift;
+static int gVerbose;
+
+
+static void Put16(unsigned char *out, unsigned value)
+{
+	out[0] = (unsigned char)(value >> 8);
+	out[1] = (unsigned char)value;
+}
+
+static void Put32(unsigned char *out, unsigned long value)
+{
+	out[0] = (unsigned char)(value >> 24);
+	out[1] = (unsigned char)(value >> 16);
+	out[2] = (unsigned char)(value >> 8);
+	out[3] = (unsigned char)value;
+}
+
+
+static unsigned char *ReadFile(const char *path, unsigned long *size)
+{
+	unsigned char *data;
+	FILE *file;
+	long length;
+
+	file = fopen(path, "rb");
+	if (file == NULL)
+		return NULL;
+
+	fseek(file, 0, SEEK_END);
+	length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	data = malloc(length > 0 ? (size_t)length : 1);
+	if (data != NULL && fread(data, 1, (size_t)length, file) != (size_t)length)
+	{
+		free(data);
+		data = NULL;
+	}
+
+	fclose(file);
+	*size = (unsigned long)length;
+	return data;
+}
+
+
+/*
+//
+// This function adds the files under directory, named relative to
+// the romdisk's root, prefix.
+//
+*/
+
+static void AddDirectory(const char *directory, const char *prefix)
+{
+	char path[1024], name[1024];
+	struct dirent *item;
+	struct stat info;
+	File *file;
+	DIR *dir;
+
+	dir = opendir(directory);
+	if (dir == NULL)
+	{
+		fprintf(stderr, "nlromfs: can't open %s\n", directory);
+		exit(1);
+	}
+
+	while ((item = readdir(dir)) != NULL)
+	{
+		if (strcmp(item->d_name, ".") == 0 || strcmp(item->d_name, "..") == 0)
+			continue;
+
+		snprintf(path, sizeof(path), "%s/%s", directory, item->d_name);
+		snprintf(name, sizeof(name), "%s%s", prefix, item->d_name);
+
+		if (stat(path, &info) != 0)
+		{
+			fprintf(stderr, "nlromfs: can't stat %s\n", path);
+			exit(1);
+		}
+
+		if (S_ISDIR(info.st_mode))
+		{
+			strncat(name, "/", sizeof(name) - strlen(name) - 1);
+			AddDirectory(path, name);
+			continue;
+		}
+
+		if (strlen(name) >= kRomdiskPathSize)
+		{
+			fprintf(stderr, "nlromfs: %s: path too long\n", name);
+			exit(1);
+		}
+
+		if (gFileCount == kMaxFiles)
+		{
+			fprintf(stderr, "nlromfs: more than %d files\n", kMaxFiles);
+			exit(1);
+		}
+
+		file = &gFiles[gFileCount++];
+		memset(file, 0, sizeof(*file));
+		strcpy(file->path, name);
+
+		file->data = ReadFile(path, &file->size);
+		if (file->data == NULL)
+		{
+			fprintf(stderr, "nlromfs: can't read %s\n", path);
+			exit(1);
+		}
+	}
+
+	closedir(dir);
+}
+
+
+static int CompareFiles(const void *a, const void *b)
+{
+	return strncmp(((const File *)a)->path, ((const File *)b)->path, kRomdiskPathSize);
+}
+
+
+static unsigned Hash(const unsigned char *in)
+{
+	unsigned long value = ((unsigned long)in[0] << 24) | (in[1] << 16) | (in[2] << 8) | in[3];
+
+	return (unsigned)((value * 2654435761UL) & 0xFFFFFFFFUL) >> (32 - kHashBits);
+}
+
+
+static unsigned char *PutLength(unsigned char *out, unsigned long length)
+{
+	while (length >= 255)
+	{
+		*out++ = 255;
+		length -= 255;
+	}
+
+	*out++ = (unsigned char)length;
+	return out;
+}
+
+
+static unsigned char *PutSequence(unsigned char *out, const unsigned char *literals,
+	unsigned long literalCount, unsigned long offset, unsigned long matchLength)
+{
+	unsigned char *token = out++;
+	unsigned long length;
+
+	*token = (unsigned char)((literalCount < 15 ? literalCount : 15) << 4);
+	if (literalCount >= 15)
+		out = PutLength(out, literalCount - 15);
+
+	memcpy(out, literals, literalCount);
+	out += literalCount;
+
+	if (matchLength > 0)
+	{
+		Put16(out, (unsigned)offset);
+		out += 2;
+
+		length = matchLength - kRomdiskMinMatch;
+		*token |= (unsigned char)(length < 15 ? length : 15);
+		if (length >= 15)
+			out = PutLength(out, length - 15);
+	}
+
+	return out;
+}
+
+
+/*
+//
+// This function compresses one block into out, which must have room
+// for size plus a little. Returns the compressed size.
+//
+*/
+
+static unsigned long Compress(const unsigned char *in, unsigned long size, unsigned char *out)
+{
+	static long head[1 << kHashBits];
+	static long chain[1 << 15];
+	unsigned long position, literalStart, bestLength, bestOffset, length;
+	unsigned char *start = out;
+	long candidate;
+	unsigned hash;
+	int steps;
+
+	memset(head, -1, sizeof(head));
+	position = 0;
+	literalStart = 0;
+
+	while (position + kRomdiskMinMatch <= size)
+	{
+		hash = Hash(in + position);
+		bestLength = 0;
+		bestOffset = 0;
+
+		for (candidate = head[hash], steps = 0; candidate >= 0 && steps < kChainSteps;
+			candidate = chain[candidate], steps++)
+		{
+			if (position - candidate > kMaxOffset)
+				break;
+
+			for (length = 0; position + length < size
+				&& in[candidate + length] == in[position + length]; length++)
+				;
+
+			if (length > bestLength)
+			{
+				bestLength = length;
+				bestOffset = position - candidate;
+			}
+		}
+
+		chain[position] = head[hash];
+		head[hash] = (long)position;
+
+		if (bestLength < kRomdiskMinMatch)
+		{
+			position++;
+			continue;
+		}
+
+		out = PutSequence(out, in + literalStart, position - literalStart, bestOffset, bestLength);
+
+		/* The matched bytes go into the chains too */
+
+		for (length = 1; length < bestLength && position + length + kRomdiskMinMatch <= size; length++)
+		{
+			hash = Hash(in + position + length);
+			chain[position + length] = head[hash];
+			head[hash] = (long)(position + length);
+		}
+
+		position += bestLength;
+		literalStart = position;
+	}
+
+	out = PutSequence(out, in + literalStart, size - literalStart, 0, 0);
+	return out - start;
+}
+
+
+static void WriteImage(const char *path)
+{
+	unsigned char header[kRomdiskHeaderSize], entry[kRomdiskEntrySize], word[4];
+	unsigned char *blocks, *offsets, *out, *check;
+	unsigned long blockSize, blockCount, dataStart, dataSize, raw, length, compressed, block;
+	unsigned long at;
+	FILE *output;
+	int iii;
+
+	qsort(gFiles, gFileCount, sizeof(File), CompareFiles);
+
+	blockSize = 1UL << gBlockShift;
+	blockCount = 0;
+	raw = 0;
+	for (iii = 0; iii < gFileCount; iii++)
+	{
+		gFiles[iii].firstBlock = blockCount;
+		blockCount += (gFiles[iii].size + blockSize - 1) >> gBlockShift;
+		raw += gFiles[iii].size;
+	}
+
+	/* Worst case, every block stored as it is */
+
+	blocks = malloc(raw + 1);
+	offsets = malloc((blockCount + 1) * 4);
+	out = malloc(blockSize * 2 + 64);
+	check = malloc(blockSize);
+	if (blocks == NULL || offsets == NULL || out == NULL || check == NULL)
+	{
+		fprintf(stderr, "nlromfs: out of memory\n");
+		exit(1);
+	}
+
+	dataStart = kRomdiskHeaderSize + (unsigned long)gFileCount * kRomdiskEntrySize + (blockCount + 1) * 4;
+	dataSize = 0;
+	block = 0;
+
+	for (iii = 0; iii < gFileCount; iii++)
+	{
+		for (at = 0; at < gFiles[iii].size; at += blockSize, block++)
+		{
+			length = gFiles[iii].size - at;
+			if (length > blockSize)
+				length = blockSize;
+
+			compressed = Compress(gFiles[iii].data + at, length, out);
+			if (compressed >= length)
+			{
+				memcpy(blocks + dataSize, gFiles[iii].data + at, length);
+				compressed = length;
+			}
+			else
+			{
+				if (RomdiskDecode(out, compressed, check, length) != length
+					|| memcmp(check, gFiles[iii].data + at, length) != 0)
+				{
+					fprintf(stderr, "nlromfs: %s: block at %lu doesn't decode\n", gFiles[iii].path, at);
+					exit(1);
+				}
+
+				memcpy(blocks + dataSize, out, compressed);
+			}
+
+			Put32(offsets + block * 4, dataStart + dataSize);
+			dataSize += compressed;
+		}
+
+		if (gVerbose)
+			printf("%-40s %8lu B, blocks %lu-%lu\n", gFiles[iii].path, gFiles[iii].size,
+				gFiles[iii].firstBlock, block);
+	}
+
+	Put32(offsets + blockCount * 4, dataStart + dataSize);
+
+	output = fopen(path, "wb");
+	if (output == NULL)
+	{
+		fprintf(stderr, "nlromfs: can't write %s\n", path);
+		exit(1);
+	}
+
+	memset(header, 0, sizeof(header));
+	memcpy(header, kRomdiskMagic, 4);
+	Put16(header + 4, kRomdiskVersion);
+	Put16(header + 6, (unsigned)gFileCount);
+	Put32(header + 8, blockCount);
+	Put16(header + 12, gBlockShift);
+	fwrite(header, 1, sizeof(header), output);
+
+	for (iii = 0; iii < gFileCount; iii++)
+	{
+		memset(entry, 0, sizeof(entry));
+		memcpy(entry, gFiles[iii].path, strlen(gFiles[iii].path));
+		Put32(word, gFiles[iii].size);
+		memcpy(entry + kRomdiskPathSize, word, 4);
+		Put32(word, gFiles[iii].firstBlock);
+		memcpy(entry + kRomdiskPathSize + 4, word, 4);
+		fwrite(entry, 1, sizeof(entry), output);
+	}
+
+	fwrite(offsets, 4, blockCount + 1, output);
+	fwrite(blocks, 1, dataSize, output);
+
+	if (fclose(output) != 0)
+	{
+		fprintf(stderr, "nlromfs: can't write %s\n", path);
+		exit(1);
+	}
+
+	printf("nlromfs: %d files, %lu bytes in %lu\n", gFileCount, raw, dataStart + dataSize);
+}
+
+
+int main(int argc, char **argv)
+{
+	const char *directory, *output;
+	int iii;
+
+	directory = NULL;
+	output = NULL;
+
+	for (iii = 1; iii < argc; iii++)
+	{
+		if (strcmp(argv[iii], "-d") == 0 && iii + 1 < argc)
+			directory = argv[++iii];
+		else if (strcmp(argv[iii], "-f") == 0 && iii + 1 < argc)
+			output = argv[++iii];
+		else if (strcmp(argv[iii], "-b") == 0 && iii + 1 < argc)
+			gBlockShift = (unsigned)atoi(argv[++iii]);
+		else if (strcmp(argv[iii], "-v") == 0)
+			gVerbose = 1;
+		else
+			break;
+	}
+
+	if (directory == NULL || output == NULL || iii < argc || gBlockShift < 9 || gBlockShift > 15)
+	{
+		fprintf(stderr, "usage: nlromfs -d DIRECTORY -f IMAGE [-b SHIFT] [-v]\n");
+		return 2;
+	}
+
+	AddDirectory(directory, "");
+	WriteImage(output);
+	return 0;
+}
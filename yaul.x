@@ -25,6 +25,10 @@ PROVIDE (__master_stack_end = ORIGIN (master_stack) - LENGTH (master_stack));
 PROVIDE_HIDDEN (__slave_stack = ORIGIN (slave_stack));
 PROVIDE_HIDDEN (__slave_stack_end = ORIGIN (slave_stack) - LENGTH (slave_stack));
 
+/* For source/memory.c, which reports how much of ram is left */
+PROVIDE (__ram_start = ORIGIN (ram));
+PROVIDE (__ram_end = ORIGIN (ram) + LENGTH (ram));
+
 SECTIONS
 {
   .text ORIGIN (ram) :
@@ -144,3 +148,6 @@ SECTIONS
   __end = __bss_end + SIZEOF (.uncached);
   PROVIDE (_end = __bss_end + SIZEOF (.uncached));
 }
+
+/* The sections aren't placed in ram, so nothing else would notice */
+ASSERT (__end <= ORIGIN (ram) + LENGTH (ram), "the program doesn't fit in ram")